@@ -61,7 +61,7 @@ if [ "${DOCKER_ONLY}" == "1" ] ; then
     echo "Building only the Docker container"
 
     # Make sure we have the server and ffmpeg.
-    for F in build/ffmpeg/install/bin/{ffmpeg,ffprobe,zmqsend} build/server/install/bin/live-video-streamer-server ; do
+    for F in build/ffmpeg/install/bin/{ffmpeg,ffprobe} build/server/install/bin/live-video-streamer-server ; do
         if [ ! -e "${F}" ] ; then
             echo "Directory ${F} does not exist! Run without -d." !>&2
             exit 1
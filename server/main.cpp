@@ -3,17 +3,22 @@
 #include "api/ProbeResource.hpp"
 #include "configuration/configuration.hpp"
 #include "configuration/defaults.hpp"
+#include "ffmpeg/calibrate.hpp"
 #include "instance/ChannelsIndexResource.hpp"
 #include "instance/State.hpp"
 #include "log/FileLog.hpp"
+#include "log/MemoryLog.hpp"
 #include "server/HttpServer.hpp"
 #include "server/Path.hpp"
 #include "util/Event.hpp"
+#include "util/IOContextPool.hpp"
 #include "util/util.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 
 namespace
 {
@@ -27,23 +32,57 @@ Config::Root loadConfig(const std::filesystem::path &path)
     return Config::Root::fromJson(std::string_view((const char *)bytes.data(), bytes.size()));
 }
 
+/**
+ * Measure this host's encoders into the compute.calibration file.
+ *
+ * This is a separate step from running the server, so that the measurements aren't skewed by the channels' encoding.
+ *
+ * @return The exit code.
+ */
+int calibrate(const Config::Root &config)
+{
+    if (config.compute.calibration.empty()) {
+        throw std::runtime_error("compute.calibration isn't set, so there's nowhere to store the measurements.");
+    }
+
+    IOContext ioc;
+    Log::MemoryLog log(ioc, config.log.level, true);
+    bool complete = false;
+    spawnDetached(ioc, [&]() -> Awaitable<void> {
+        std::vector<Config::EncoderThroughput> throughputs =
+            co_await Ffmpeg::calibrate(ioc, log, config.compute.calibration, Ffmpeg::calibratableCodecs);
+        complete = std::ranges::all_of(Ffmpeg::calibratableCodecs, [&throughputs](Codec::VideoCodec codec) {
+            return std::ranges::any_of(throughputs, [codec](const Config::EncoderThroughput &t) {
+                return t.codec == codec;
+            });
+        });
+    });
+    ioc.run();
+    return complete ? 0 : 1;
+}
+
 } // namespace
 
 int main(int argc, const char * const *argv)
 {
     try {
-        /* Parse the argument. */
-        if (argc != 2) {
-            throw std::runtime_error("Usage: "s + (argc ? argv[0] : "") + " configuration.json");
+        /* Parse the arguments. */
+        bool calibrating = argc == 3 && argv[1] == "--calibrate"sv;
+        if (argc != 2 && !calibrating) {
+            throw std::runtime_error("Usage: "s + (argc ? argv[0] : "") + " [--calibrate] configuration.json");
         }
-        std::filesystem::path configPath = argv[1];
+        std::filesystem::path configPath = argv[argc - 1];
 
         /* Load and populate a config object. */
         Config::Root config = loadConfig(configPath);
+        if (calibrating) {
+            return calibrate(config);
+        }
 
         /* Create the instance state. */
         IOContext ioc;
-        Instance::State st{config, ioc};
+        IOContextPool iocs(ioc, config.network.threads);
+        Instance::State st{config, iocs};
 
         /* Create global resources for the API. */
         st.getServer().addResource<Api::ConfigResource>("api/config", st, configPath);
@@ -66,7 +105,7 @@ int main(int argc, const char * const *argv)
 
                 // Hang this coroutine forever. Interesting things happen as a result of the server handling requests
                 // in another coroutine.
-                Event event(ioc);
+                Event event;
                 while (true) {
                     co_await event.wait();
                 }
@@ -78,7 +117,7 @@ int main(int argc, const char * const *argv)
                 fprintf(stderr, "Exited with an unknown exception.\n");
             }
         });
-        ioc.run();
+        iocs.run();
     }
     catch (const std::exception &e) {
         fprintf(stderr, "Exited with exception: %s\n", e.what());
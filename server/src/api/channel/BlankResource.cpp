@@ -18,14 +18,23 @@ void from_json(const nlohmann::json &j, BlankResource::RequestObject &out)
 
 } // namespace Api::Channel
 
-Api::Channel::BlankResource::~BlankResource() = default;
+Api::Channel::BlankResource::~BlankResource()
+{
+    Ffmpeg::zmqDisconnect(address);
+}
 
 Awaitable<void> Api::Channel::BlankResource::handleRequest(const RequestObject &request)
 {
-    co_await Ffmpeg::zmqsend(ioc, address, {
+    std::vector<std::chrono::microseconds> latencies = co_await Ffmpeg::zmqsend(ioc, address, {
         { "vblank", "enable", request.blank ? "1" : "0" },
         { "ablank", "enable", request.blank ? "1" : "0" }
     });
+
+    /* Record how long ffmpeg took to apply the commands. */
+    using Ms = std::chrono::duration<double, std::milli>;
+    log << "zmq" << Log::Level::debug << (request.blank ? "Blanking" : "Unblanking") << " took "
+        << Ms(latencies.at(0)).count() << " ms for the video and " << Ms(latencies.at(1)).count()
+        << " ms for the audio.";
 }
 
 Awaitable<void> Api::Channel::BlankResource::postAsync(Server::Response &, Server::Request &request)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "log/Log.hpp"
 #include "server/Resource.hpp"
 
 class IOContext;
@@ -34,7 +35,10 @@ public:
      *
      * @param address The FFmpeg ZMQ filter's address.
      */
-    BlankResource(IOContext &ioc, std::string address) : ioc(ioc), address(std::move(address)) {}
+    BlankResource(IOContext &ioc, Log::Log &log, std::string address) :
+        ioc(ioc), log(log("blank")), address(std::move(address))
+    {
+    }
 
     /**
      * Do stuff in response to a (received) Request.
@@ -49,6 +53,7 @@ public:
 
 private:
     IOContext &ioc;
+    Log::Context log;
     std::string address;
 };
 
@@ -183,6 +183,11 @@ struct Dash final
 struct ChannelFfmpeg final
 {
     std::string filterZmq;
+    bool separateEncoders = false;
+    bool handover = false;
+    unsigned int suspendWhenIdle = 0;
+    bool cascadeScaling = true;
+    unsigned int benchmark = 0;
 
     bool operator==(const ChannelFfmpeg &) const;
 };
@@ -217,6 +222,14 @@ struct Channel final
      * Determine whether the channel differs only by its UID and things that are calculated from it by default.
      */
     bool differsByUidOnly(const Channel &other) const;
+
+    /**
+     * Determine whether the qualities' audio is encoded once and shared between them.
+     *
+     * This is the case when more than one quality has audio and they all have the same audio settings, unless each
+     * quality is encoded separately.
+     */
+    bool sharesAudio() const;
 };
 
 /**
@@ -230,6 +243,7 @@ struct Network final
     unsigned int transitLatency = 50;
     unsigned int transitJitter = 200;
     unsigned int transitBufferSize = 32768;
+    unsigned int threads = 0;
 
     bool operator==(const Network &) const;
 };
@@ -256,6 +270,7 @@ struct Directory final
     bool secure = false;
     bool ephemeral = false;
     size_t maxWritableSize = 0;
+    size_t memoryCacheSize = 16;
 
     bool operator==(const Directory &) const;
 };
@@ -282,6 +297,29 @@ struct Features final
     bool operator==(const Features &) const;
 };
 
+/**
+ * The compute key.
+ */
+struct Compute final
+{
+    std::string calibration;
+    unsigned int budget = 80;
+    unsigned int startupParallelism = 8;
+
+    bool operator==(const Compute &) const;
+};
+
+/**
+ * The probeCache key.
+ */
+struct ProbeCache final
+{
+    std::string path;
+    unsigned int ttl = 600;
+
+    bool operator==(const ProbeCache &) const;
+};
+
 /**
  * The separatedIngestSources key.
  */
@@ -354,6 +392,8 @@ public:
     Http http;
     Log log;
     Features features;
+    Compute compute;
+    ProbeCache probeCache;
     std::map<std::string, SeparatedIngestSource> separatedIngestSources;
 
     bool operator==(const Root &) const;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "media/codec.hpp"
 #include "util/asio.hpp"
 
 #include <functional>
@@ -17,6 +18,23 @@ namespace Config
 {
 
 class Root;
+enum class H26xPreset;
+
+/**
+ * How quickly an encoder can encode on this host, as measured by calibration.
+ */
+struct EncoderThroughput final
+{
+    Codec::VideoCodec codec;
+    H26xPreset preset;
+    unsigned int width;
+    unsigned int height;
+
+    /**
+     * The number of pixels encoded per second of CPU time.
+     */
+    double pixelsPerCpuSecond;
+};
 
 /**
  * A function that probes a media source with ffprobe and returns information about it.
@@ -26,6 +44,15 @@ class Root;
 using ProbeFunction = std::function<Awaitable<MediaInfo::SourceInfo>(const std::string &url,
                                                                      const std::vector<std::string> &arguments)>;
 
+/**
+ * A function that gets the throughput of the given codecs' presets on this host, measuring them if necessary.
+ *
+ * @param path The compute.calibration field, which is where the measurements are stored.
+ * @param codecs The codecs whose throughput is needed.
+ */
+using CalibrateFunction = std::function<Awaitable<std::vector<EncoderThroughput>>(
+    const std::string &path, const std::vector<Codec::VideoCodec> &codecs)>;
+
 /**
  * Fill in initial defaults for a configuration.
  *
@@ -50,7 +77,9 @@ void fillInInitialDefaults(Root &config);
  *              to cache the result of probes that are for devices that are already in use. This also makes it possible
  *              to capture probe results.
  * @param config The configuration to fill in.
+ * @param calibrate The function to use for getting the throughput of the encoders, if compute.calibration is set. If
+ *                  this isn't given, the presets are chosen by a crude model instead.
  */
-Awaitable<void> fillInDefaults(const ProbeFunction &probe, Root &config);
+Awaitable<void> fillInDefaults(const ProbeFunction &probe, Root &config, const CalibrateFunction &calibrate = {});
 
 } // namespace Config
@@ -1,6 +1,96 @@
 #include "configuration/configuration.hpp"
+#include "configuration/defaults.hpp"
 
 #include <cassert>
+#include <cmath>
+#include <span>
+
+namespace
+{
+
+using namespace Config;
+
+/**
+ * Choose a preset without knowing anything about the host.
+ *
+ * Currently, this is tuned crudely and rather non-generically for the Ryzen 7950X.
+ */
+H26xPreset getUncalibratedPreset(const VideoQuality &q)
+{
+    /* Get the stream parameters. */
+    unsigned int width = *q.width;
+    unsigned int height = *q.height;
+    unsigned int fps = (q.frameRate.numerator + q.frameRate.denominator - 1) / q.frameRate.denominator;
+
+    /* Choose a preset based on the above. */
+    if (fps >= 60) {
+        return H26xPreset::ultrafast;
+    }
+    else if (width <= 1920 && height <= 1080) {
+        return (fps <= 30) ? H26xPreset::medium : H26xPreset::faster;
+    }
+    else if (width <= 3840 && height <= 2160) {
+        return (fps <= 30) ? H26xPreset::faster : H26xPreset::superfast;
+    }
+    else {
+        return H26xPreset::ultrafast;
+    }
+}
+
+/**
+ * Get the number of pixels a quality encodes per second.
+ */
+double getPixelRate(const VideoQuality &q)
+{
+    return (double)*q.width * *q.height * q.frameRate.numerator / q.frameRate.denominator;
+}
+
+/**
+ * Get the CPU time it takes to encode a second of a quality with a given preset.
+ *
+ * The throughput is taken from the calibrated resolution closest to the quality's, because the encoders are more
+ * efficient at higher resolutions.
+ *
+ * @return The CPU time in seconds, or nothing if the preset hasn't been calibrated for the codec.
+ */
+std::optional<double> getCost(const VideoQuality &q, H26xPreset preset, std::span<const EncoderThroughput> throughputs)
+{
+    double pixels = (double)*q.width * *q.height;
+    const EncoderThroughput *closest = nullptr;
+    for (const EncoderThroughput &t: throughputs) {
+        if (t.codec != q.codec || t.preset != preset) {
+            continue;
+        }
+        if (!closest || std::abs(std::log(pixels / ((double)t.width * t.height))) <
+                        std::abs(std::log(pixels / ((double)closest->width * closest->height)))) {
+            closest = &t;
+        }
+    }
+    if (!closest) {
+        return std::nullopt;
+    }
+    return getPixelRate(q) / closest->pixelsPerCpuSecond;
+}
+
+/**
+ * A quality whose preset is being chosen from the calibration.
+ */
+struct Choice final
+{
+    VideoQuality &q;
+
+    /**
+     * The calibrated presets for the quality's codec, from the fastest, with the CPU time they'd take per second.
+     */
+    std::vector<std::pair<H26xPreset, double>> costs;
+
+    /**
+     * The index in costs of the currently chosen preset.
+     */
+    size_t index;
+};
+
+} // namespace
 
 namespace Config
 {
@@ -8,41 +98,75 @@ namespace Config
 /**
  * Fills in the compute trade-off.
  *
- * Currently, this is tuned crudely and rather non-generically for the Ryzen 7950X. This model will probably be improved
- * over time.
+ * If the host has been calibrated, this starts every quality whose preset isn't configured at the slowest calibrated
+ * preset, and then repeatedly moves whichever of them saves the most CPU time to its next faster preset until the
+ * qualities of all the channels fit within the CPU budget. Otherwise, a crude model is used.
+ *
+ * Only the video encoders are counted against the budget. Decoding, scaling, and audio are left to the headroom the
+ * budget leaves, since their cost depends on the sources, which calibration doesn't measure.
+ *
+ * @param throughputs The calibration of the host's encoders, which might be empty.
+ * @param numCpus The number of hardware threads on the host.
  */
-void fillInCompute(Root &config)
+void fillInCompute(Root &config, std::span<const EncoderThroughput> throughputs, unsigned int numCpus)
 {
+    /* Work out which presets there's a choice for, and how much CPU time the rest of the qualities use. */
+    double budget = (double)numCpus * config.compute.budget / 100;
+    double used = 0;
+    std::vector<Choice> choices;
     for (auto &[name, channel]: config.channels) {
         for (Quality &q: channel.qualities) {
             assert(q.video.width);
             assert(q.video.height);
             assert(q.video.frameRate.type == FrameRate::fps);
 
-            /* Get the stream parameters. */
-            unsigned int width = *q.video.width;
-            unsigned int height = *q.video.height;
-            unsigned int fps =
-                (q.video.frameRate.numerator + q.video.frameRate.denominator - 1) / q.video.frameRate.denominator;
-
-            /* Choose a preset based on the above. */
+            // Count the configured presets against the budget.
             std::optional<H26xPreset> &preset = q.video.h26xPreset;
             if (preset) {
+                used += getCost(q.video, *preset, throughputs).value_or(0);
                 continue;
             }
-            if (fps >= 60) {
-                preset = H26xPreset::ultrafast;
+
+            // Offer the choice of the calibrated presets, or fall back to the crude model if there aren't any.
+            Choice choice{ .q = q.video };
+            for (int p = (int)H26xPreset::ultrafast; p <= (int)H26xPreset::placebo; p++) {
+                if (std::optional<double> cost = getCost(q.video, (H26xPreset)p, throughputs)) {
+                    choice.costs.emplace_back((H26xPreset)p, *cost);
+                }
             }
-            else if (width <= 1920 && height <= 1080) {
-                preset = (fps <= 30) ? H26xPreset::medium : H26xPreset::faster;
+            if (choice.costs.empty()) {
+                preset = getUncalibratedPreset(q.video);
+                continue;
             }
-            else if (width <= 3840 && height <= 2160) {
-                preset = (fps <= 30) ? H26xPreset::faster : H26xPreset::superfast;
+            choice.index = choice.costs.size() - 1;
+            used += choice.costs.back().second;
+            choices.emplace_back(std::move(choice));
+        }
+    }
+
+    /* Speed up the presets that save the most until everything fits. */
+    while (used > budget) {
+        Choice *best = nullptr;
+        double bestSaving = 0;
+        for (Choice &choice: choices) {
+            if (choice.index == 0) {
+                continue;
             }
-            else {
-                preset = H26xPreset::ultrafast;
+            double saving = choice.costs[choice.index].second - choice.costs[choice.index - 1].second;
+            if (!best || saving > bestSaving) {
+                best = &choice;
+                bestSaving = saving;
             }
         }
+        if (!best) {
+            break; // Everything's already as fast as it goes.
+        }
+        best->index--;
+        used -= bestSaving;
+    }
+
+    for (Choice &choice: choices) {
+        choice.q.h26xPreset = choice.costs[choice.index].first;
     }
 }
 
@@ -3,6 +3,9 @@
 #include "ffmpeg/ffprobe.hpp"
 #include "server/Path.hpp"
 
+#include <set>
+#include <thread>
+
 namespace
 {
 
@@ -49,10 +52,51 @@ Awaitable<void>
 fillInQualitiesFromFfprobe(std::vector<Quality> &qualities, const Source &source, const ProbeFunction &probe);
 
 void fillInQuality(Config::Quality &q, const Root &config, const Channel &channel);
-void fillInCompute(Root &config);
+void fillInCompute(Root &config, std::span<const EncoderThroughput> throughputs, unsigned int numCpus);
+Awaitable<void> fillInChannel(const std::string &path, Channel &channel, const Root &config,
+                              const ProbeFunction &probe);
 
 } // namespace Config
 
+/**
+ * Fill in the defaults for a channel.
+ */
+Awaitable<void> Config::fillInChannel(const std::string &path, Channel &channel, const Root &config,
+                                      const ProbeFunction &probe)
+{
+    // Replace ingest:// URLs with ingest_http:// URLs.
+    if (channel.source.url.starts_with("ingest://")) {
+        channel.source.url = "ingest_http://localhost:" + std::to_string(config.network.port) + "/ingest/" +
+                             channel.source.url.substr(9);
+    }
+
+    // If there are no qualities, add one for fillInQualitiesFromFfprobe to fill in.
+    if (channel.qualities.empty()) {
+        channel.qualities.emplace_back();
+    }
+
+    // Fill in the information we get from ffprobe. This is done first because a lot of other stuff is based on this.
+    co_await fillInQualitiesFromFfprobe(channel.qualities, channel.source, probe);
+
+    // Fill in prerequisites to the latency tracker.
+    if (!channel.source.latency) {
+        channel.source.latency = 0; // TODO: fill this in based on source type or even see if ffprobe can help.
+    }
+
+    // Fill in other per-channel parameters.
+    if (channel.uid.empty()) {
+        channel.uid = generateUid();
+    }
+    if (channel.ffmpeg.filterZmq.empty()) {
+        channel.ffmpeg.filterZmq = "ipc:///tmp/rise-ffmpeg-zmq_" + sanitizePathToFilename(path + "_" + channel.uid);
+    }
+
+    // Fill in other parameters of each quality.
+    for (Config::Quality &q: channel.qualities) {
+        fillInQuality(q, config, channel);
+    }
+}
+
 void Config::fillInInitialDefaults(Root &config)
 {
     /* Set up separated ingests for channels that listen for their source rather than connecting to or otherwise reading
@@ -96,7 +140,7 @@ void Config::fillInInitialDefaults(Root &config)
     }
 }
 
-Awaitable<void> Config::fillInDefaults(const ProbeFunction &probe, Root &config)
+Awaitable<void> Config::fillInDefaults(const ProbeFunction &probe, Root &config, const CalibrateFunction &calibrate)
 {
     // TODO: This is likely no longer correct, since the ffprobeage will need to be changed to cope with
     //       multiple input ports.
@@ -105,42 +149,32 @@ Awaitable<void> Config::fillInDefaults(const ProbeFunction &probe, Root &config)
         config.log.print = config.log.path.empty(); // By default, print if and only if we're not logging to a file.
     }
 
-    /* Fill in the channels. */
+    /* Fill in the channels. These are done in parallel, because probing a source can take seconds. */
+    std::vector<Awaitable<void>> awaitables;
+    awaitables.reserve(config.channels.size());
     for (auto &[path, channel]: config.channels) {
-        // Replace ingest:// URLs with ingest_http:// URLs.
-        if (channel.source.url.starts_with("ingest://")) {
-            channel.source.url = "ingest_http://localhost:" + std::to_string(config.network.port) + "/ingest/" +
-                                 channel.source.url.substr(9);
-        }
-
-        // If there are no qualities, add one for fillInQualitiesFromFfprobe to fill in.
-        if (channel.qualities.empty()) {
-            channel.qualities.emplace_back();
-        }
-
-        // Fill in the information we get from ffprobe. This is done first because a lot of other stuff is based on
-        // this.
-        co_await fillInQualitiesFromFfprobe(channel.qualities, channel.source, probe);
-
-        // Fill in prerequisites to the latency tracker.
-        if (!channel.source.latency) {
-            channel.source.latency = 0; // TODO: fill this in based on source type or even see if ffprobe can help.
-        }
+        awaitables.emplace_back(fillInChannel(path, channel, config, probe));
+    }
+    co_await awaitTree(awaitables, config.compute.startupParallelism);
 
-        // Fill in other per-channel parameters.
-        if (channel.uid.empty()) {
-            channel.uid = generateUid();
-        }
-        if (channel.ffmpeg.filterZmq.empty()) {
-            channel.ffmpeg.filterZmq = "ipc:///tmp/rise-ffmpeg-zmq_" + sanitizePathToFilename(path + "_" + channel.uid);
+    /* Fill in the compute trade-off. */
+    // Get the throughput of the encoders whose preset we're choosing, if the host has been calibrated.
+    std::vector<EncoderThroughput> throughputs;
+    if (calibrate && !config.compute.calibration.empty()) {
+        std::set<Codec::VideoCodec> codecs;
+        for (const auto &[path, channel]: config.channels) {
+            for (const Quality &q: channel.qualities) {
+                if (!q.video.h26xPreset &&
+                    (q.video.codec == Codec::VideoCodec::h264 || q.video.codec == Codec::VideoCodec::h265)) {
+                    codecs.emplace(q.video.codec);
+                }
+            }
         }
-
-        // Fill in other parameters of each quality.
-        for (Config::Quality &q: channel.qualities) {
-            fillInQuality(q, config, channel);
+        if (!codecs.empty()) {
+            throughputs = co_await calibrate(config.compute.calibration, { codecs.begin(), codecs.end() });
         }
     }
 
-    /* Fill in the compute trade-off. */
-    fillInCompute(config);
+    // Choose the presets.
+    fillInCompute(config, throughputs, std::max(std::thread::hardware_concurrency(), 1u));
 }
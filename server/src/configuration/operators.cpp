@@ -30,6 +30,8 @@ bool Config::Network::operator==(const Network &) const = default;
 bool Config::Http::operator==(const Http &) const = default;
 bool Config::Log::operator==(const Log &) const = default;
 bool Config::Features::operator==(const Features &) const = default;
+bool Config::Compute::operator==(const Compute &) const = default;
+bool Config::ProbeCache::operator==(const ProbeCache &) const = default;
 bool Config::SeparatedIngestSource::operator==(const SeparatedIngestSource &) const = default;
 bool Config::Root::operator==(const Root &) const = default;
 
@@ -58,3 +60,27 @@ bool Config::Channel::differsByUidOnly(const Channel &other) const
     /* Done :) */
     return result;
 }
+
+bool Config::Channel::sharesAudio() const
+{
+    if (ffmpeg.separateEncoders) {
+        return false;
+    }
+
+    /* Compare each quality's audio with the first that has any. */
+    const AudioQuality *first = nullptr;
+    unsigned int numWithAudio = 0;
+    for (const Quality &q: qualities) {
+        if (!q.audio) {
+            continue;
+        }
+        if (!first) {
+            first = &q.audio;
+        }
+        else if (q.audio != *first) {
+            return false;
+        }
+        numWithAudio++;
+    }
+    return numWithAudio > 1;
+}
@@ -215,6 +215,11 @@ static void from_json(const nlohmann::json &j, ChannelFfmpeg &out)
 {
     Json::ObjectDeserializer d(j, "ffmpeg");
     d(out.filterZmq, "filterZmq");
+    d(out.separateEncoders, "separateEncoders");
+    d(out.handover, "handover");
+    d(out.suspendWhenIdle, "suspendWhenIdle");
+    d(out.cascadeScaling, "cascadeScaling");
+    d(out.benchmark, "benchmark");
     d();
 }
 
@@ -248,6 +253,7 @@ static void from_json(const nlohmann::json &j, Directory &out)
     d(out.secure, "secure");
     d(out.ephemeral, "ephemeral");
     d(out.maxWritableSize, "maxWritableSize");
+    d(out.memoryCacheSize, "memoryCacheSize");
     d();
 }
 
@@ -267,6 +273,7 @@ static void from_json(const nlohmann::json &j, Network &out)
     d(out.transitLatency, "transitLatency");
     d(out.transitJitter, "transitJitter");
     d(out.transitBufferSize, "transitBufferSize");
+    d(out.threads, "threads");
     d();
 }
 
@@ -304,6 +311,25 @@ static void from_json(const nlohmann::json &j, Features &out)
     d();
 }
 
+/// @ingroup configuration_implementation
+static void from_json(const nlohmann::json &j, Compute &out)
+{
+    Json::ObjectDeserializer d(j, "compute");
+    d(out.calibration, "calibration");
+    d(out.budget, "budget");
+    d(out.startupParallelism, "startupParallelism");
+    d();
+}
+
+/// @ingroup configuration_implementation
+static void from_json(const nlohmann::json &j, ProbeCache &out)
+{
+    Json::ObjectDeserializer d(j, "probeCache");
+    d(out.path, "path");
+    d(out.ttl, "ttl");
+    d();
+}
+
 /// @ingroup configuration_implementation
 static void from_json(const nlohmann::json &j, SeparatedIngestSource &out)
 {
@@ -343,6 +369,8 @@ Config::Root Config::Root::fromJson(std::string_view jsonString)
         d(root.http, "http");
         d(root.log, "log");
         d(root.features, "features");
+        d(root.compute, "compute");
+        d(root.probeCache, "probeCache");
         d(root.separatedIngestSources, "separatedIngestSources");
         d();
     }
@@ -144,6 +144,11 @@ static void to_json(nlohmann::json &j, const History &in)
 static void to_json(nlohmann::json &j, const ChannelFfmpeg &in)
 {
     j["filterZmq"] = in.filterZmq;
+    j["separateEncoders"] = in.separateEncoders;
+    j["handover"] = in.handover;
+    j["suspendWhenIdle"] = in.suspendWhenIdle;
+    j["cascadeScaling"] = in.cascadeScaling;
+    j["benchmark"] = in.benchmark;
 }
 
 /// @ingroup configuration_implementation
@@ -166,6 +171,7 @@ static void to_json(nlohmann::json &j, const Directory &in)
     j["secure"] = in.secure;
     j["ephemeral"] = in.ephemeral;
     j["maxWritableSize"] = in.maxWritableSize;
+    j["memoryCacheSize"] = in.memoryCacheSize;
 }
 
 /// @ingroup configuration_implementation
@@ -177,6 +183,7 @@ static void to_json(nlohmann::json &j, const Network &in)
     j["transitLatency"] = in.transitLatency;
     j["transitJitter"] = in.transitJitter;
     j["transitBufferSize"] = in.transitBufferSize;
+    j["threads"] = in.threads;
 }
 
 /// @ingroup configuration_implementation
@@ -219,6 +226,21 @@ static void to_json(nlohmann::json &j, const Features &in)
     j["channelIndex"] = in.channelIndex;
 }
 
+/// @ingroup configuration_implementation
+static void to_json(nlohmann::json &j, const Compute &in)
+{
+    j["calibration"] = in.calibration;
+    j["budget"] = in.budget;
+    j["startupParallelism"] = in.startupParallelism;
+}
+
+/// @ingroup configuration_implementation
+static void to_json(nlohmann::json &j, const ProbeCache &in)
+{
+    j["path"] = in.path;
+    j["ttl"] = in.ttl;
+}
+
 /// @ingroup configuration_implementation
 static void to_json(nlohmann::json &j, const SeparatedIngestSource &in)
 {
@@ -240,6 +262,8 @@ std::string Config::Root::toJson() const
     j["http"] = http;
     j["log"] = log;
     j["features"] = features;
+    j["compute"] = compute;
+    j["probeCache"] = probeCache;
     j["separatedIngestSources"] = separatedIngestSources;
     return Json::dump(j);
 }
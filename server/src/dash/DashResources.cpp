@@ -7,19 +7,24 @@
 #include "dash/SegmentResource.hpp"
 #include "dash/InterleaveResource.hpp"
 #include "dash/SegmentIndexDescriptorResource.hpp"
+#include "ffmpeg/Arguments.hpp"
+#include "ffmpeg/Process.hpp"
 #include "log/Log.hpp"
 #include "resources/ConstantResource.hpp"
-#include "resources/ErrorResource.hpp"
 #include "resources/PutResource.hpp"
 #include "server/Server.hpp"
 #include "util/asio.hpp"
+#include "util/debug.hpp"
+#include "util/TimerWheel.hpp"
 #include "util/json.hpp"
 #include "util/util.hpp"
 
-#include <boost/asio/steady_timer.hpp>
-
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
 
 /// @addtogroup dash
 /// @{
@@ -32,6 +37,12 @@
 namespace
 {
 
+/**
+ * How far ahead of the decoder a resumed encoder's first segment starts, at the least, so that the encoder is running
+ * in time for it.
+ */
+constexpr double encoderStartSeconds = 1;
+
 /**
  * Format the current time as a lexicographically sortable human readable timestamp.
  */
@@ -80,6 +91,19 @@ std::string getInitializerName(unsigned int streamIndex)
     return name;
 }
 
+/**
+ * Get the name of the manifest file of a stream, for when each stream has its own.
+ *
+ * @param streamIndex The interleave stream index.
+ * @return The name of the manifest file (without directory).
+ */
+std::string getStreamManifestName(unsigned int streamIndex)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "manifest-stream%u.mpd", streamIndex);
+    return name;
+}
+
 /**
  * Get the name of a segment index descriptor file.
  *
@@ -107,6 +131,17 @@ std::string getInterleaveName(unsigned int interleaveIndex, unsigned int segment
     return name;
 }
 
+/**
+ * Get the part of an interleave file's name that comes before the segment index.
+ *
+ * @param interleaveIndex The interleave stream index.
+ * @return The start of the name of the interleave's files.
+ */
+std::string getInterleavePrefix(unsigned int interleaveIndex)
+{
+    return "interleaved" + std::to_string(interleaveIndex) + "-";
+}
+
 /**
  * A resource that expires after a given amount of time.
  */
@@ -118,45 +153,34 @@ public:
      */
     ~ExpiringResource()
     {
-        if (path.empty()) {
-            return; // Presumably, we moved out of this object.
-        }
         server.removeResource(path);
     }
 
-    // Only move construction.
+    // No copying or moving, because the expiry timer can't move.
     ExpiringResource(const ExpiringResource &) = delete;
-    ExpiringResource &operator=(ExpiringResource &&) = delete;
     ExpiringResource &operator=(const ExpiringResource &) = delete;
 
-    /**
-     * Determine if the interleave has expired.
-     */
-    bool expired(std::chrono::steady_clock::time_point now) const
-    {
-        return now > expiry;
-    }
-
 protected:
     /**
      * Set up to remove a resource from the server after a given expiry.
      *
+     * @param timerWheel The timer wheel to schedule the expiry in.
+     * @param onExpiry What to call when the resource expires. This is expected to destroy this object.
      * @param server The server to remove from upon destruction.
      * @param path The path where the resource is to be created. The subclass is expected to create this resource.
      * @param lifetimeMs The lifetime, in ms, of the resource.
      * @param delayExpiry Whether to delay the expiry until after updateExpiry is called.
      */
-    explicit ExpiringResource(Server::Server &server, Server::Path path, unsigned int lifetimeMs,
-                              bool delayExpiry = false) :
-        server(server), path(std::move(path)), lifetimeMs(lifetimeMs)
+    explicit ExpiringResource(Util::TimerWheel &timerWheel, std::function<void()> onExpiry, Server::Server &server,
+                              Server::Path path, unsigned int lifetimeMs, bool delayExpiry = false) :
+        server(server), path(std::move(path)), lifetimeMs(lifetimeMs), onExpiry(std::move(onExpiry)),
+        expiryTimer(timerWheel)
     {
         if (!delayExpiry) {
             updateExpiry();
         }
     }
 
-    ExpiringResource(ExpiringResource &&) = default;
-
     /**
      * The path to the resource.
      */
@@ -170,16 +194,10 @@ protected:
      */
     void updateExpiry()
     {
-        expiry = std::chrono::steady_clock::now() + std::chrono::milliseconds(lifetimeMs);
+        expiryTimer.expiresAfter(std::chrono::milliseconds(lifetimeMs), onExpiry);
     }
 
 private:
-    /**
-     * The largest value that the steady clock can represent.
-     */
-    static constexpr auto maxSteadyTime =
-        std::chrono::steady_clock::duration(std::numeric_limits<std::chrono::steady_clock::duration::rep>::max());
-
     /**
      * The server to remove the resource from in the destructor.
      */
@@ -198,9 +216,14 @@ private:
     const unsigned int lifetimeMs;
 
     /**
-     * When the segment is to expire.
+     * What to call when the resource expires.
+     */
+    const std::function<void()> onExpiry;
+
+    /**
+     * Calls onExpiry once the resource has expired.
      */
-    std::chrono::steady_clock::time_point expiry{maxSteadyTime};
+    Util::TimerWheel::Timer expiryTimer;
 };
 
 } // namespace
@@ -214,6 +237,8 @@ public:
     /**
      * Create the interleave segment.
      *
+     * @param timerWheel The timer wheel to schedule the expiry in.
+     * @param onExpiry What to call when the interleave expires.
      * @param server The server to create the interleave in.
      * @param path The path to the interleave.
      * @param lifetimeMs The lifetime of the interleave, in seconds. The expiry timer starts once the last stream has
@@ -222,9 +247,10 @@ public:
      * @param args The arguments to give to Dash::InterleaveResource::InterleaveResource.
      */
     template <typename... Args>
-    explicit InterleaveExpiringResource(Server::Server &server, Server::Path path, unsigned int lifetimeMs,
+    explicit InterleaveExpiringResource(Util::TimerWheel &timerWheel, std::function<void()> onExpiry,
+                                        Server::Server &server, Server::Path path, unsigned int lifetimeMs,
                                         unsigned int numStreams, Args &&...args) :
-        ExpiringResource(server, std::move(path), lifetimeMs, true),
+        ExpiringResource(timerWheel, std::move(onExpiry), server, std::move(path), lifetimeMs, true),
         remainingResources(numStreams),
         resource(server.addOrReplaceResource<Dash::InterleaveResource>(getPath(), std::forward<Args>(args)...))
     {
@@ -244,6 +270,18 @@ public:
         return *this;
     }
 
+    /**
+     * Record that the streams that haven't been given this interleave never will be, such as because their encoder has
+     * been stopped.
+     */
+    void skipRemainingStreams()
+    {
+        if (remainingResources > 0) {
+            remainingResources = 0;
+            updateExpiry();
+        }
+    }
+
     /**
      * Get a shared pointer to the interleave resource.
      */
@@ -260,14 +298,6 @@ public:
         return *resource;
     }
 
-    /**
-     * Determine if the interleave has expired.
-     */
-    bool expired(std::chrono::steady_clock::time_point now) const
-    {
-        return remainingResources == 0 && ExpiringResource::expired(now);
-    }
-
 private:
     /**
      * The number of streams that use this resource that haven't yet claimed it.
@@ -295,15 +325,18 @@ public:
     /**
      * Create a DASH segment resource.
      *
+     * @param timerWheel The timer wheel to schedule the expiry in.
+     * @param onExpiry What to call when the segment expires.
      * @param server The server to create the resource in.
      * @param path The path at which to create the segment.
      * @param lifetimeMs The lifetime, in ms, of the segment.
      * @param args The arguments to give to Dash::SegmentResource::SegmentResource.
      */
     template <typename... Args>
-    explicit SegmentExpiringResource(Server::Server &server, Server::Path path, unsigned int lifetimeMs,
+    explicit SegmentExpiringResource(Util::TimerWheel &timerWheel, std::function<void()> onExpiry,
+                                     Server::Server &server, Server::Path path, unsigned int lifetimeMs,
                                      Args &&...args) :
-        ExpiringResource(server, std::move(path), lifetimeMs)
+        ExpiringResource(timerWheel, std::move(onExpiry), server, std::move(path), lifetimeMs)
     {
         server.addOrReplaceResource<Dash::SegmentResource>(getPath(), std::forward<Args>(args)...);
         updateExpiry();
@@ -311,15 +344,22 @@ public:
 };
 
 /**
- * Maintain a garbage collectable map of segment descriptors.
+ * Maintain a map of segment descriptors that remove themselves when they expire.
  *
- * @tparam T A type with an expired method that takes the current time and returns whether the segment has expired or
- *           not. When destroyed, the T object should remove its segment from the server.
+ * @tparam T A type whose constructor takes a timer wheel and a function to call when the segment expires, followed by
+ *           whatever arguments are given to get. When destroyed, the T object should remove its segment from the
+ *           server.
  */
 template <typename T>
 class StreamSegmentSet
 {
 public:
+    explicit StreamSegmentSet(Util::TimerWheel &timerWheel) : timerWheel(timerWheel) {}
+
+    // The segments' expiry callbacks refer to this object.
+    StreamSegmentSet(const StreamSegmentSet &) = delete;
+    StreamSegmentSet &operator=(const StreamSegmentSet &) = delete;
+
     /**
      * Get or create a T for a given index.
      *
@@ -332,23 +372,12 @@ public:
     {
         auto it = segments.find(index);
         if (it == segments.end()) {
-            it = segments.emplace(index, T(std::forward<Args>(args)...)).first;
+            it = segments.try_emplace(index, timerWheel, [this, index]() { segments.erase(index); },
+                                      std::forward<Args>(args)...).first;
         }
         return it->second;
     }
 
-    /**
-     * Garbage collect the segments.
-     *
-     * @param now The time to consider to be now for the purposes of garbage collection.
-     */
-    void gc(std::chrono::steady_clock::time_point now)
-    {
-        std::erase_if(segments, [now](const auto &v) {
-            return v.second.expired(now);
-        });
-    }
-
     /**
      * Get the index of the last segment, if any.
      */
@@ -360,7 +389,19 @@ public:
         return segments.rbegin()->first;
     }
 
+    /**
+     * Call a function with each T whose index is before a given one.
+     */
+    template <typename F>
+    void forEachBefore(unsigned int index, F &&fn)
+    {
+        for (auto it = segments.begin(); it != segments.end() && it->first < index; it++) {
+            fn(it->second);
+        }
+    }
+
 private:
+    Util::TimerWheel &timerWheel;
     std::map<unsigned int, T> segments;
 };
 
@@ -384,82 +425,211 @@ std::string getLiveInfo(const Config::Channel &config, const Server::Path &uidPa
 class Dash::DashResources::Interleave final : public StreamSegmentSet<InterleaveExpiringResource>
 {
 public:
-    explicit Interleave(Server::Server &server, const Server::Path &uidPath, unsigned int interleaveIndex,
-                        const Config::Channel &channelConfig, const Config::Http &httpConfig) :
-        server(server), uidPath(uidPath), interleaveIndex(interleaveIndex),
+    explicit Interleave(Util::TimerWheel &timerWheel, Server::Server &server, const Server::Path &uidPath,
+                        unsigned int interleaveIndex, const Config::Channel &channelConfig,
+                        const Config::Http &httpConfig) :
+        StreamSegmentSet(timerWheel), server(server), uidPath(uidPath), interleaveIndex(interleaveIndex),
         numEphemeralNotFoundSegments(httpConfig.cacheNonLiveTime * 1000 / channelConfig.dash.segmentDuration + 1)
     {
     }
 
+    ~Interleave()
+    {
+        server.removeEphemeralWhenNotFoundRange(uidPath, getInterleavePrefix(interleaveIndex));
+    }
+
     /**
-     * Add ephemeral not-found interleave segments, that haven't already been added, to cover the period after the given
-     * segment index.
+     * Extend the range of interleave segments that have ephemeral not-found responses to cover the period after the
+     * given segment index.
      *
-     * These not-found error segments have ephemeral caching so that the not-found is not still cached by the time they
-     * become pre-available.
+     * These not-found responses have ephemeral caching so that the not-found is not still cached by the time the
+     * segments become pre-available.
      */
     void addEphemeralNotFoundSegments(unsigned int segmentIndex)
     {
-        /* Figure out the start and end range of the not-found segments to create. */
-        unsigned int firstEphemeralNotFoundSegment = std::max(segmentIndex + 1, nextEphemeralNotFoundSegment);
+        firstEphemeralNotFoundSegment = std::max(segmentIndex + 1, firstEphemeralNotFoundSegment);
         nextEphemeralNotFoundSegment = std::max(segmentIndex + numEphemeralNotFoundSegments + 1,
                                                 nextEphemeralNotFoundSegment);
-
-        /* Create the resources for the not-found segments. */
-        for (unsigned int i = firstEphemeralNotFoundSegment; i < nextEphemeralNotFoundSegment; i++) {
-            Server::Path path = uidPath / getInterleaveName(interleaveIndex, i);
-            server.addResource<Server::ErrorResource>(path, Server::ErrorKind::NotFound, Server::CacheKind::ephemeral,
-                                                      true);
-        }
+        server.setEphemeralWhenNotFoundRange(uidPath, getInterleavePrefix(interleaveIndex),
+                                             firstEphemeralNotFoundSegment, nextEphemeralNotFoundSegment);
     }
 
 private:
     Server::Server &server;
     const Server::Path &uidPath;
     const unsigned int interleaveIndex;
-    const unsigned int numEphemeralNotFoundSegments; ///< The number of not-found to create after the last live segment.
-    unsigned int nextEphemeralNotFoundSegment = 0; ///< The first not-found segment that's not been created yet.
+    const unsigned int numEphemeralNotFoundSegments; ///< The number of not-found after the last live segment.
+    unsigned int firstEphemeralNotFoundSegment = 0; ///< The first segment with an ephemeral not-found.
+    unsigned int nextEphemeralNotFoundSegment = 0; ///< The first segment after those with an ephemeral not-found.
 };
 
-class Dash::DashResources::Stream final : public StreamSegmentSet<SegmentExpiringResource> {};
+class Dash::DashResources::Stream final : public StreamSegmentSet<SegmentExpiringResource>
+{
+public:
+    using StreamSegmentSet::StreamSegmentSet;
+
+    /**
+     * Get a timer for creating the segment after a given one, creating the timer if necessary.
+     */
+    Util::TimerWheel::Timer &getPreAvailabilityTimer(Util::TimerWheel &timerWheel, unsigned int segmentIndex)
+    {
+        return preAvailabilityTimers.try_emplace(segmentIndex, timerWheel).first->second;
+    }
+
+    /**
+     * Remove the timer for creating the segment after a given one.
+     */
+    void removePreAvailabilityTimer(unsigned int segmentIndex)
+    {
+        preAvailabilityTimers.erase(segmentIndex);
+    }
+
+private:
+    /**
+     * The timers for creating each stream's next segment when it becomes pre-available, by the index of the segment
+     * before it.
+     */
+    std::map<unsigned int, Util::TimerWheel::Timer> preAvailabilityTimers;
+};
+
+/**
+ * Keeps track of when each quality's interleave was last requested, so qualities that nobody is watching can be
+ * suspended, and resumed when they're requested again.
+ *
+ * GET requests are handled in any thread, and the interleaves that record them can outlive the DashResources, so this
+ * is shared between them.
+ */
+class Dash::DashResources::Demand final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Demand(size_t numQualities) :
+        suspended(numQualities), suspendedAt(numQualities), lastRequested(numQualities)
+    {
+        for (std::atomic<Clock::rep> &t: lastRequested) {
+            t = Clock::now().time_since_epoch().count();
+        }
+    }
+
+    /**
+     * Record that a quality's interleave has been requested, waking whatever is waiting to resume it if it's suspended.
+     *
+     * This can be called from any thread.
+     */
+    void request(unsigned int interleaveIndex)
+    {
+        lastRequested[interleaveIndex] = Clock::now().time_since_epoch().count();
+        if (suspended[interleaveIndex]) {
+            std::lock_guard lock(mutex);
+            requested = true;
+            event.notifyAll();
+        }
+    }
+
+    /**
+     * Get when a quality's interleave was last requested.
+     */
+    Clock::time_point getLastRequested(unsigned int interleaveIndex) const
+    {
+        return Clock::time_point(Clock::duration(lastRequested[interleaveIndex]));
+    }
+
+    /**
+     * Wait until a suspended quality has been requested.
+     *
+     * @return Whether a quality was requested, rather than the DashResources being destroyed.
+     */
+    Awaitable<bool> wait()
+    {
+        std::unique_lock lock(mutex);
+        while (!requested && alive) {
+            co_await event.wait(lock);
+        }
+        requested = false;
+        co_return alive;
+    }
+
+    /**
+     * Stop anything waiting, because the DashResources is being destroyed.
+     */
+    void kill()
+    {
+        std::lock_guard lock(mutex);
+        alive = false;
+        event.notifyAll();
+    }
+
+    /**
+     * Whether each quality is suspended.
+     *
+     * This is only modified in the main IO context.
+     */
+    std::vector<std::atomic<bool>> suspended;
+
+    /**
+     * When each quality was suspended.
+     *
+     * This is only used in the main IO context.
+     */
+    std::vector<Clock::time_point> suspendedAt;
+
+private:
+    /**
+     * Protects requested and alive, so a request can't be missed between checking them and waiting.
+     */
+    std::mutex mutex;
+
+    /**
+     * Notified when a suspended quality is requested.
+     */
+    Event event;
+
+    /**
+     * When each quality was last requested, as the count of its time since the clock's epoch.
+     */
+    std::vector<std::atomic<Clock::rep>> lastRequested;
+
+    /**
+     * Whether a suspended quality has been requested since the last wait.
+     */
+    bool requested = false;
+
+    /**
+     * Whether the DashResources still exists.
+     */
+    bool alive = true;
+};
 
 Dash::DashResources::~DashResources()
 {
+    if (demand) {
+        demand->kill();
+    }
     streams.clear();
     interleaves.clear();
-    server.removeResourceTree(basePath);
-    server.removeResourceTree(Server::Path("api/channels") / basePath);
+    server.removeResourceTree(uidPath);
+    if (published) {
+        server.removeResource(basePath / "info.json");
+        server.removeResourceTree(Server::Path("api/channels") / basePath);
+    }
 }
 
 Dash::DashResources::DashResources(IOContext &ioc, Log::Log &log, const Config::Channel &channelConfig,
                                    const Config::Http &httpConfig, Server::Path basePath, Server::Server &server,
-                                   const Ffmpeg::Process &ffmpegProcess) :
+                                   const Ffmpeg::Process &ffmpegProcess, bool publish,
+                                   std::function<void(unsigned int, bool, Ffmpeg::Timestamp, unsigned int)>
+                                   setEncoding) :
     ioc(ioc), log(log), logContext(log("dash")), config(channelConfig), server(server),
-    basePath(std::move(basePath)), uidPath(this->basePath / channelConfig.uid),
+    timerWheel(Util::TimerWheel::get(ioc)), basePath(std::move(basePath)), uidPath(this->basePath / channelConfig.uid),
     persistenceDirectory(config.history.persistentStorage.empty() ? std::filesystem::path{} :
                          std::filesystem::path(config.history.persistentStorage) / formatPersistenceTimestamp()),
-    exists(std::make_shared<char>(0))
+    sharesAudio(channelConfig.sharesAudio()), ffmpegProcess(ffmpegProcess),
+    setEncoding(std::move(setEncoding)), startTime(std::chrono::steady_clock::now())
 {
     logContext << "base path" << Log::Level::info << (std::string)getBasePath();
     logContext << "uid path" << Log::Level::info << (std::string)getUidPath();
 
-    /* Create the API resources. */
-    {
-        Server::Path apiBasePath = Server::Path("api/channels") / this->basePath;
-
-        auto blankResource = server.addResource<Api::Channel::BlankResource>(apiBasePath / "blank", ioc,
-                                                                             channelConfig.ffmpeg.filterZmq);
-        server.addResource<Api::Channel::InterjectionResource>(apiBasePath / "interject", ioc, *this, ffmpegProcess,
-                                                               *blankResource);
-
-        server.addResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_json", *this,
-                                                           Api::Channel::SendDataResource::Kind::userJson);
-        server.addResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_binary", *this,
-                                                           Api::Channel::SendDataResource::Kind::userBinary);
-        server.addResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_string", *this,
-                                                           Api::Channel::SendDataResource::Kind::userString);
-    }
-
     /* Create the persistence directory. */
     if (!persistenceDirectory.empty()) {
         logContext << "persistence" << Log::Level::info << persistenceDirectory;
@@ -480,118 +650,148 @@ Dash::DashResources::DashResources(IOContext &ioc, Log::Log &log, const Config::
             }
         }
 
+        // If the qualities share their audio, report what's saved by not encoding, uploading and keeping the history of
+        // the others.
+        if (sharesAudio) {
+            unsigned int numAvoidedStreams = numAudioStreams - 1;
+            unsigned int bitrate = std::find_if(config.qualities.begin(), config.qualities.end(),
+                                                [](const Config::Quality &q) { return (bool)q.audio; })->audio.bitrate;
+            logContext << "sharedAudio" << Log::Level::info << Json::dump({
+                { "avoidedStreams", numAvoidedStreams },
+                { "ingestSavingKbps", numAvoidedStreams * bitrate },
+                { "historySavingBytes", (uint64_t)numAvoidedStreams * bitrate * 125 * config.history.historyLength }
+            });
+            numAudioStreams = 1;
+        }
+
         // Create DASH stream tracking for each audio and video stream.
-        streams.resize(config.qualities.size() + numAudioStreams);
+        size_t numStreams = config.qualities.size() + numAudioStreams;
+        streams.reserve(numStreams);
+        for (size_t i = 0; i < numStreams; i++) {
+            streams.emplace_back(std::make_unique<Stream>(timerWheel));
+        }
+        segmentIndexOffsets.resize(numStreams, 0);
 
         // Create RISE interleave tracking. There are currently as many interleaves as video streams.
         interleaves.reserve(config.qualities.size());
         for (unsigned int i = 0; i < (unsigned int)config.qualities.size(); i++) {
-            interleaves.emplace_back(server, uidPath, i, config, httpConfig);
+            interleaves.emplace_back(std::make_unique<Interleave>(timerWheel, server, uidPath, i, config, httpConfig));
         }
     }
 
-    /* Add resources. */
-    // The info.json.
-    server.addResource<Server::ConstantResource>(this->basePath / "info.json", getLiveInfo(config, uidPath),
-                                                 "application/json", Server::CacheKind::ephemeral, true);
-
-    // The manifest.mpd file.
-    server.addResource<Server::PutResource>(uidPath / "manifest.mpd", ioc, getPersistencePath("manifest.mpd"),
-                                            Server::CacheKind::fixed, 1 << 16, true);
-
-    // For now, each video quality has a single corresponding audio quality.
-    {
-        unsigned int videoIndex = 0;
-        unsigned int audioIndex = (unsigned int)config.qualities.size();
-        for (const Config::Quality &q: config.qualities) {
-            // Add the initializer segment.
-            {
-                std::string initializerSegmentName = getInitializerName(videoIndex);
-                server.addResource<Server::PutResource>(uidPath / initializerSegmentName, ioc,
-                                                        getPersistencePath(initializerSegmentName),
-                                                        Server::CacheKind::fixed,
-                                                        1 << 14, true);
+    /* Keep track of which qualities are being watched, if the ones that aren't are to be suspended. This needs each
+       quality to have its own encoder. It isn't done with persistence, since a resumed encoder would overwrite the
+       persisted segments by naming its segments from the start again. */
+    if (config.ffmpeg.separateEncoders && config.ffmpeg.suspendWhenIdle > 0 && persistenceDirectory.empty() &&
+        this->setEncoding) {
+        demand = std::make_shared<Demand>(config.qualities.size());
+        spawnDetached(ioc, [this, demand = demand]() -> Awaitable<void> {
+            // The wait is the only suspension, and it returns false once this object has been destroyed, so this is
+            // only used while it exists.
+            while (co_await demand->wait()) {
+                try {
+                    resumeRequestedQualities();
+                }
+                catch (const std::exception &e) {
+                    logContext << Log::Level::error << "Exception while resuming qualities: " << e.what() << ".";
+                }
             }
-            // Add the first video segment and corresponding interleave.
-            createSegment(videoIndex, 1);
-
-            // Next video stream.
-            videoIndex++;
+        });
+    }
 
-            // Likewise for audio.
-            if (!q.audio) {
-                continue;
-            }
-            {
-                std::string initializerSegmentName = getInitializerName(audioIndex);
-                server.addResource<Server::PutResource>(uidPath / initializerSegmentName, ioc,
-                                                        getPersistencePath(initializerSegmentName),
-                                                        Server::CacheKind::fixed,
-                                                        1 << 14, true);
-            }
-            createSegment(audioIndex, 1);
-            audioIndex++;
+    /* Add resources. */
+    // The manifest.mpd file, or each stream's manifest if each quality is encoded by a separate ffmpeg.
+    if (!config.ffmpeg.separateEncoders) {
+        server.addResource<Server::PutResource>(uidPath / "manifest.mpd", ioc, getPersistencePath("manifest.mpd"),
+                                                Server::CacheKind::fixed, 1 << 16, true);
+    }
+    else {
+        for (unsigned int i = 0; i < (unsigned int)streams.size(); i++) {
+            std::string manifestName = getStreamManifestName(i);
+            server.addResource<Server::PutResource>(uidPath / manifestName, ioc, getPersistencePath(manifestName),
+                                                    Server::CacheKind::fixed, 1 << 16, true);
         }
     }
+
+    // Each stream's initializer segment and first segment, which creates the corresponding interleaves.
+    for (unsigned int streamIndex = 0; streamIndex < (unsigned int)streams.size(); streamIndex++) {
+        std::string initializerSegmentName = getInitializerName(streamIndex);
+        server.addResource<Server::PutResource>(uidPath / initializerSegmentName, ioc,
+                                                getPersistencePath(initializerSegmentName), Server::CacheKind::fixed,
+                                                1 << 14, true);
+        createSegment(streamIndex, 1);
+    }
+
+    /* Publish the info.json and the API, now that there's something for them to refer to. */
+    if (publish) {
+        this->publish();
+    }
 }
 
 void Dash::DashResources::notifySegmentStart(unsigned int streamIndex, unsigned int segmentIndex)
 {
+    assert(ioc.get_executor().running_in_this_thread());
     logContext << "segmentStart" << Log::Level::info << Json::dump({
         { "streamIndex", streamIndex },
         { "segmentIndex", segmentIndex }
     });
+    unsigned int interleaveSegmentIndex = segmentIndex + segmentIndexOffsets[streamIndex];
 
-    spawnDetached(ioc, [=, this, stillExists = std::weak_ptr(exists)]() -> Awaitable<void> {
-        /* Don't play with a dead object. */
-        if (stillExists.expired()) {
-            co_return;
-        }
+    /* Update the segment index descriptor. */
+    try {
+        server.addOrReplaceResource<SegmentIndexResource>(uidPath / getSegmentIndexDescriptorName(streamIndex),
+                                                          interleaveSegmentIndex);
+    }
+    catch (const std::exception &e) {
+        logContext << Log::Level::error
+                   << "Exception while creating segment index descriptor " << segmentIndex
+                   << " for stream " << (streamIndex + 1) << ": " << e.what() << ".";
+    }
+    catch (...) {
+        logContext << Log::Level::error
+                   << "Unknown exception while creating segment index descriptor " << segmentIndex
+                   << " for stream " << (streamIndex + 1) << ".";
+    }
 
-        /* Update the segment index descriptor. */
-        try {
-            server.addOrReplaceResource<SegmentIndexResource>(uidPath / getSegmentIndexDescriptorName(streamIndex),
-                                                              segmentIndex);
-        }
-        catch (const std::exception &e) {
-            logContext << Log::Level::error
-                       << "Exception while creating segment index descriptor " << segmentIndex
-                       << " for stream " << (streamIndex + 1) << ": " << e.what() << ".";
-        }
-        catch (...) {
-            logContext << Log::Level::error
-                       << "Unknown exception while creating segment index descriptor " << segmentIndex
-                       << " for stream " << (streamIndex + 1) << ".";
+    /* A stream's first segment has finished once its second starts. */
+    if (interleaveSegmentIndex == 2) {
+        numStreamsWithFirstSegment++;
+        firstSegmentEvent.notifyAll();
+        if (numStreamsWithFirstSegment == streams.size()) {
+            logContext << "first segment" << Log::Level::info << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - startTime).count() << " ms after starting.";
         }
+    }
 
-        /* Create the next segment's resource once it's time for it to become pre-available. */
-        try {
-            // Wait for the segment to become pre-available.
-            boost::asio::steady_timer timer(ioc);
-            timer.expires_from_now(std::chrono::milliseconds(config.dash.segmentDuration -
-                                                             config.dash.preAvailabilityTime));
-            co_await timer.async_wait(boost::asio::use_awaitable);
-
-            // The this object might have been deleted while waiting.
-            if (stillExists.expired()) {
-                co_return;
-            }
+    /* A stopped encoder might still be finishing off its last segment, but there's nothing after that. */
+    if (getIsSuspended(streamIndex)) {
+        return;
+    }
 
-            // Create the segment.
+    /* Keep the suspended qualities' interleaves going alongside this one. */
+    if (demand && interleaveSegmentIndex > latestStartedSegmentIndex) {
+        latestStartedSegmentIndex = interleaveSegmentIndex;
+        updateSuspendedQualities(interleaveSegmentIndex);
+    }
+
+    /* Create the next segment's resource once it's time for it to become pre-available. The timer belongs to the
+       stream, so it's cancelled if this object is destroyed first. */
+    Util::TimerWheel::Timer &timer = streams[streamIndex]->getPreAvailabilityTimer(timerWheel, segmentIndex);
+    timer.expiresAfter(std::chrono::milliseconds(config.dash.segmentDuration - config.dash.preAvailabilityTime),
+                       [this, streamIndex, segmentIndex]() {
+        streams[streamIndex]->removePreAvailabilityTimer(segmentIndex);
+        if (getIsSuspended(streamIndex)) {
+            return;
+        }
+        try {
             createSegment(streamIndex, segmentIndex + 1);
         }
         catch (const std::exception &e) {
-            if (stillExists.expired()) {
-                co_return;
-            }
             logContext << Log::Level::error
                        << "Exception while creating pre-available segment " << segmentIndex
                        << " for stream " << (streamIndex + 1) << ": " << e.what() << ".";
         }
         catch (...) {
-            if (stillExists.expired()) {
-                co_return;
-            }
             logContext << Log::Level::error
                        << "Unknown exception while creating pre-available segment " << segmentIndex
                        << " for stream " << (streamIndex + 1) << ".";
@@ -599,12 +799,56 @@ void Dash::DashResources::notifySegmentStart(unsigned int streamIndex, unsigned
     });
 }
 
+void Dash::DashResources::publish()
+{
+    /* The API resources. */
+    Server::Path apiBasePath = Server::Path("api/channels") / basePath;
+
+    auto blankResource = server.addOrReplaceResource<Api::Channel::BlankResource>(apiBasePath / "blank", ioc, log,
+                                                                                  config.ffmpeg.filterZmq);
+    server.addOrReplaceResource<Api::Channel::InterjectionResource>(apiBasePath / "interject", ioc, *this,
+                                                                    ffmpegProcess, *blankResource);
+
+    server.addOrReplaceResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_json", *this,
+                                                                Api::Channel::SendDataResource::Kind::userJson);
+    server.addOrReplaceResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_binary", *this,
+                                                                Api::Channel::SendDataResource::Kind::userBinary);
+    server.addOrReplaceResource<Api::Channel::SendDataResource>(apiBasePath / "send_user_string", *this,
+                                                                Api::Channel::SendDataResource::Kind::userString);
+
+    /* The info.json. This is last, so that by the time clients move over to this object's streams, the API refers to
+       them too. */
+    server.addOrReplaceResource<Server::ConstantResource>(basePath / "info.json", getLiveInfo(config, uidPath),
+                                                          "application/json", Server::CacheKind::ephemeral, true);
+    published = true;
+}
+
+Awaitable<bool> Dash::DashResources::waitForFirstSegment(std::chrono::milliseconds timeout)
+{
+    /* Wake up when the timeout expires. The timer belongs to this coroutine, so it's cancelled when this returns. */
+    bool timedOut = false;
+    Util::TimerWheel::Timer timer(timerWheel);
+    timer.expiresAfter(timeout, [this, &timedOut]() {
+        timedOut = true;
+        firstSegmentEvent.notifyAll();
+    });
+
+    /* Wait for every stream, or the timeout. */
+    while (numStreamsWithFirstSegment < streams.size() && !timedOut) {
+        co_await firstSegmentEvent.wait();
+    }
+    co_return numStreamsWithFirstSegment >= streams.size();
+}
+
 void Dash::DashResources::addControlChunk(std::span<const std::byte> chunkData, ControlChunkType type)
 {
+    /* Copy the data once, so every interleave can share it. */
+    Util::SharedBuffer sharedChunkData = Util::SharedBuffer::copy(chunkData);
+
     /* Add the control chunk to every interleave. */
     for (unsigned int i = 0; i < interleaves.size(); i++) {
         // Find the last interleave segment.
-        std::optional<unsigned int> lastSegmentIndex = interleaves[i].getLastSegmentIndex();
+        std::optional<unsigned int> lastSegmentIndex = interleaves[i]->getLastSegmentIndex();
         if (!lastSegmentIndex) {
             lastSegmentIndex = 1; // This is the index of the first segment, and we haven't had any yet.
         }
@@ -626,7 +870,7 @@ void Dash::DashResources::addControlChunk(std::span<const std::byte> chunkData,
         }
 
         // Add the control chunk.
-        segment->addControlChunk(chunkData, type);
+        segment->addControlChunk(sharedChunkData, type);
     }
 }
 
@@ -648,29 +892,179 @@ void Dash::DashResources::createSegment(unsigned int streamIndex, unsigned int s
     assert(streamIndex < streams.size());
     bool isAudio = streamIndex >= config.qualities.size();
 
-    /* Garbage collect existing segments. */
-    gcSegments();
-
-    /* Create a new interleave segment if the one we need doesn't exist already. */
-    // Figure out the interleave index.
-    unsigned int interleaveIndex = (streamIndex >= config.qualities.size()) ?
-                                   streamIndex - (unsigned int)config.qualities.size() : streamIndex;
-
-    // Create the corresponding interleave segment if it doesn't already exist.
-    InterleaveExpiringResource &interleave = getInterleaveSegment(interleaveIndex, segmentIndex);
+    /* Create new interleave segments if the ones we need don't exist already. */
+    // Figure out the interleave indices, and the index of the segment within them.
+    std::vector<unsigned int> interleaveIndices = getInterleaveIndices(streamIndex);
+    unsigned int interleaveSegmentIndex = segmentIndex + segmentIndexOffsets[streamIndex];
+
+    // Create the corresponding interleave segments if they don't already exist.
+    std::vector<InterleaveExpiringResource *> interleaveSegments;
+    std::vector<std::shared_ptr<Dash::InterleaveResource>> interleaveResources;
+    for (unsigned int interleaveIndex: interleaveIndices) {
+        InterleaveExpiringResource &interleave = getInterleaveSegment(interleaveIndex, interleaveSegmentIndex);
+        interleaveSegments.push_back(&interleave);
+        interleaveResources.emplace_back(interleave);
+    }
 
     /* Add the new segment. */
     {
         std::string segmentName = getSegmentName(streamIndex, segmentIndex);
-        streams[streamIndex].get(segmentIndex, server, uidPath / segmentName, config.history.historyLength * 1000,
-                                 ioc, log, config.dash, *this, streamIndex, segmentIndex, interleave, interleaveIndex,
-                                 isAudio ? 1 : 0, getPersistencePath(segmentName));
+        streams[streamIndex]->get(segmentIndex, server, uidPath / segmentName, config.history.historyLength * 1000,
+                                 ioc, log, config.dash, *this, streamIndex, segmentIndex,
+                                 std::move(interleaveResources), interleaveIndices, isAudio ? 1 : 0,
+                                 getPersistencePath(segmentName));
+    }
+    for (InterleaveExpiringResource *interleave: interleaveSegments) {
+        ++*interleave; // The stream now has been given the interleave.
     }
-    ++interleave; // The stream now has been given the interleave.
 
     /* Set the caching for the following interleave segments (up to however many could be reached with fixed caching) to
        ephemeral. */
-    interleaves[interleaveIndex].addEphemeralNotFoundSegments(segmentIndex);
+    for (unsigned int interleaveIndex: interleaveIndices) {
+        interleaves[interleaveIndex]->addEphemeralNotFoundSegments(interleaveSegmentIndex);
+    }
+
+    /* Make the same segment of the suspended qualities' interleaves pre-available, so that requesting it can resume
+       them. */
+    if (demand && interleaveSegmentIndex > latestPreAvailableSegmentIndex) {
+        latestPreAvailableSegmentIndex = interleaveSegmentIndex;
+        for (unsigned int i = 0; i < interleaves.size(); i++) {
+            if (demand->suspended[i]) {
+                getInterleaveSegment(i, interleaveSegmentIndex);
+                interleaves[i]->addEphemeralNotFoundSegments(interleaveSegmentIndex);
+            }
+        }
+    }
+}
+
+unsigned int Dash::DashResources::getInterleaveIndex(unsigned int streamIndex) const
+{
+    /* The video streams come first, in the same order as the qualities. */
+    if (streamIndex < config.qualities.size()) {
+        return streamIndex;
+    }
+
+    /* The audio streams are in the same order as the qualities that have audio. */
+    assert(!sharesAudio);
+    unsigned int audioIndex = streamIndex - (unsigned int)config.qualities.size();
+    for (unsigned int i = 0; i < config.qualities.size(); i++) {
+        if (config.qualities[i].audio && audioIndex-- == 0) {
+            return i;
+        }
+    }
+    unreachable();
+}
+
+std::vector<unsigned int> Dash::DashResources::getInterleaveIndices(unsigned int streamIndex) const
+{
+    if (streamIndex < config.qualities.size() || !sharesAudio) {
+        return { getInterleaveIndex(streamIndex) };
+    }
+
+    /* The shared audio stream goes into every quality that has audio. */
+    std::vector<unsigned int> result;
+    for (unsigned int i = 0; i < config.qualities.size(); i++) {
+        if (config.qualities[i].audio) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+bool Dash::DashResources::getIsSuspended(unsigned int streamIndex) const
+{
+    return demand && demand->suspended[getInterleaveIndex(streamIndex)];
+}
+
+void Dash::DashResources::updateSuspendedQualities(unsigned int segmentIndex)
+{
+    /* Count the qualities that are being encoded, since the last one is never suspended. */
+    unsigned int numActive = (unsigned int)std::count(demand->suspended.begin(), demand->suspended.end(), false);
+
+    Demand::Clock::time_point now = Demand::Clock::now();
+    for (unsigned int i = 0; i < interleaves.size(); i++) {
+        // Suspend qualities that nobody has requested for long enough.
+        if (!demand->suspended[i]) {
+            if (numActive > 1 &&
+                now - demand->getLastRequested(i) >= std::chrono::seconds(config.ffmpeg.suspendWhenIdle)) {
+                suspendQuality(i);
+                numActive--;
+            }
+            continue;
+        }
+
+        // The suspended qualities' earlier segments are over, so end them for anything that's reading them.
+        endInterleaveSegments(i, segmentIndex);
+
+        // Point new clients at the live segment, like for the streams that are being encoded.
+        for (unsigned int streamIndex = 0; streamIndex < streams.size(); streamIndex++) {
+            if (getInterleaveIndex(streamIndex) == i) {
+                server.addOrReplaceResource<SegmentIndexResource>(
+                    uidPath / getSegmentIndexDescriptorName(streamIndex), segmentIndex);
+            }
+        }
+    }
+}
+
+void Dash::DashResources::suspendQuality(unsigned int interleaveIndex)
+{
+    logContext << "suspend" << Log::Level::info << interleaveIndex;
+    demand->suspended[interleaveIndex] = true;
+    demand->suspendedAt[interleaveIndex] = Demand::Clock::now();
+    setEncoding(interleaveIndex, false, {}, 0);
+}
+
+void Dash::DashResources::resumeRequestedQualities()
+{
+    /* Find out where the stream is up to. This doesn't wait, because the ffmpeg process can be destroyed while waiting.
+       If it hasn't output anything yet, the qualities stay suspended until they're next requested. */
+    std::optional<Ffmpeg::Timestamp> streamStart = ffmpegProcess.tryGetFirstPts();
+    std::optional<Ffmpeg::Timestamp> pts = ffmpegProcess.tryGetPts();
+    if (!streamStart || !pts) {
+        logContext << "resume" << Log::Level::warning << "Can't resume qualities before ffmpeg has output anything.";
+        return;
+    }
+    double decodedSeconds = pts->getValueInSeconds();
+
+    for (unsigned int i = 0; i < interleaves.size(); i++) {
+        // Only the qualities that have been requested since they were suspended.
+        if (!demand->suspended[i] || demand->getLastRequested(i) <= demand->suspendedAt[i]) {
+            continue;
+        }
+        logContext << "resume" << Log::Level::info << i;
+
+        // The DASH muxer measures the segments from the first timestamp it's given, so the encoder skips to the start
+        // of a segment, on the grid that the other encoders have from starting at the start of the stream. That's the
+        // segment after the live one, which is likely to be the pre-available one that was requested, unless it starts
+        // too soon for the encoder to be running by then. Those before it won't get any more data.
+        unsigned int segmentIndex = latestStartedSegmentIndex + 1;
+        while (Ffmpeg::Arguments::getVideoSegmentStart(config.dash, config.qualities[i].video, *streamStart,
+                                                       segmentIndex).getValueInSeconds() <
+               decodedSeconds + encoderStartSeconds) {
+            segmentIndex++;
+        }
+        endInterleaveSegments(i, segmentIndex);
+        demand->suspended[i] = false;
+
+        // The encoder numbers its segments from 1 again, and uses the same names as before, so the old segments of
+        // its streams go. The interleaves keep their data.
+        for (unsigned int streamIndex = 0; streamIndex < streams.size(); streamIndex++) {
+            if (getInterleaveIndex(streamIndex) == i) {
+                streams[streamIndex] = std::make_unique<Stream>(timerWheel);
+                segmentIndexOffsets[streamIndex] = segmentIndex - 1;
+                createSegment(streamIndex, 1);
+            }
+        }
+        setEncoding(i, true, *streamStart, segmentIndex);
+    }
+}
+
+void Dash::DashResources::endInterleaveSegments(unsigned int interleaveIndex, unsigned int segmentIndex)
+{
+    interleaves[interleaveIndex]->forEachBefore(segmentIndex, [](InterleaveExpiringResource &segment) {
+        (*segment).endStreams();
+        segment.skipRemainingStreams();
+    });
 }
 
 Dash::DashResources::InterleaveExpiringResource &
@@ -684,23 +1078,15 @@ Dash::DashResources::getInterleaveSegment(unsigned int interleaveIndex, unsigned
 
     /* Create the interleave and the descriptor we keep track of it with. */
     const Config::Quality &q = config.qualities[interleaveIndex];
-    return interleaves[interleaveIndex].get(segmentIndex, server,
+    return interleaves[interleaveIndex]->get(segmentIndex, server,
                                             uidPath / getInterleaveName(interleaveIndex, segmentIndex),
-                                            config.history.historyLength * 1000, interleaveNumStreams, ioc, log,
+                                            config.history.historyLength * 1000, interleaveNumStreams, log,
                                             interleaveNumStreams,
                                             (*q.minInterleaveRate * *q.minInterleaveWindow + 7) / 8,
-                                            *q.minInterleaveWindow, q.interleaveTimestampInterval);
-}
-
-void Dash::DashResources::gcSegments()
-{
-    auto now = std::chrono::steady_clock::now();
-    for (Stream &s: streams) {
-        s.gc(now);
-    }
-    for (Interleave &i: interleaves) {
-        i.gc(now);
-    }
+                                            *q.minInterleaveWindow, q.interleaveTimestampInterval,
+                                            demand ? std::function<void()>([demand = demand, interleaveIndex]() {
+                                                demand->request(interleaveIndex);
+                                            }) : std::function<void()>());
 }
 
 std::filesystem::path Dash::DashResources::getPersistencePath(std::string_view fileName) const
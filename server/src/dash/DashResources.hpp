@@ -2,16 +2,27 @@
 
 #include "ControlChunkType.hpp"
 
+#include "ffmpeg/Timestamp.hpp"
 #include "log/Log.hpp"
 #include "server/Path.hpp"
+#include "util/Event.hpp"
 
+#include <chrono>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <span>
 #include <vector>
 
 class IOContext;
 
+namespace Util
+{
+
+class TimerWheel;
+
+} // namespace Util
+
 namespace Config
 {
 
@@ -68,9 +79,18 @@ public:
     /**
      * Add the resources to the server for accepting DASH and converting to RISE, and prepare to manage that process
      * ongoing.
+     *
+     * @param publish Whether to publish the info.json and API resources now. If not, publish() does so later. This
+     *                allows the resources to be prepared while another object with the same base path is still live.
+     * @param setEncoding What to call to stop (with false) or restart (with true) the encoding of the quality with
+     *                    the given index, when it's being suspended because nobody is watching it. This is only used
+     *                    if the configuration enables suspension. A restarted encoder is given the first timestamp of
+     *                    the stream and the index of the segment to start at, for Ffmpeg::Arguments::liveEncode.
      */
     explicit DashResources(IOContext &ioc, Log::Log &log, const Config::Channel &config, const Config::Http &httpConfig,
-                           Server::Path basePath, Server::Server &server, const Ffmpeg::Process &ffmpegProcess);
+                           Server::Path basePath, Server::Server &server, const Ffmpeg::Process &ffmpegProcess,
+                           bool publish = true,
+                           std::function<void(unsigned int, bool, Ffmpeg::Timestamp, unsigned int)> setEncoding = {});
 
     DashResources(const DashResources &) = delete;
     DashResources & operator=(const DashResources &) = delete;
@@ -81,10 +101,34 @@ public:
      * This is needed so that the pre-availability of the next segment can be scheduled.
      *
      * @param streamIndex The stream index whose segment has started.
-     * @param segmentIndex The index of the segment that's started.
+     * @param segmentIndex The index of the segment that's started, as ffmpeg numbers it.
      */
     void notifySegmentStart(unsigned int streamIndex, unsigned int segmentIndex);
 
+    /**
+     * Publish the info.json and API resources, replacing those of any other object with the same base path.
+     *
+     * Replacing the info.json is what moves clients over to this object's streams.
+     */
+    void publish();
+
+    /**
+     * Record that another object has published its resources in place of this one's, so that this doesn't remove them
+     * when it's destroyed.
+     */
+    void markSuperseded()
+    {
+        published = false;
+    }
+
+    /**
+     * Wait until every stream has finished its first segment.
+     *
+     * @param timeout How long to wait for.
+     * @return Whether every stream has finished its first segment, rather than the wait timing out.
+     */
+    Awaitable<bool> waitForFirstSegment(std::chrono::milliseconds timeout);
+
     /**
      * Add a control chunk to all the interleaves' latest segments.
      *
@@ -133,24 +177,63 @@ private:
     class Interleave;
     class Stream;
     class InterleaveExpiringResource;
+    class Demand;
 
     /**
      * Create the resources for the given segment.
      *
      * @param streamIndex The stream to which the segment belongs.
-     * @param segmentIndex The index of the segment within the stream.
+     * @param segmentIndex The index of the segment within the stream, as ffmpeg numbers it.
      */
     void createSegment(unsigned int streamIndex, unsigned int segmentIndex);
 
     /**
-     * Get (and possibly create) the given segment of the given interleave.
+     * Get the index of the interleave (and quality) that a stream belongs to.
+     *
+     * A shared audio stream belongs to every quality that has audio, so this is only valid for it if the qualities are
+     * never suspended.
      */
-    InterleaveExpiringResource &getInterleaveSegment(unsigned int interleaveIndex, unsigned int segmentIndex);
+    unsigned int getInterleaveIndex(unsigned int streamIndex) const;
+
+    /**
+     * Get the indices of the interleaves (and qualities) that a stream is interleaved into.
+     */
+    std::vector<unsigned int> getInterleaveIndices(unsigned int streamIndex) const;
+
+    /**
+     * Get whether the quality that a stream belongs to is suspended.
+     */
+    bool getIsSuspended(unsigned int streamIndex) const;
+
+    /**
+     * Bring the suspended qualities up to date with a new segment being started by the qualities that are being
+     * encoded, and suspend any of those that nobody is watching.
+     *
+     * @param segmentIndex The index of the interleave segment that's started.
+     */
+    void updateSuspendedQualities(unsigned int segmentIndex);
+
+    /**
+     * Stop encoding a quality.
+     */
+    void suspendQuality(unsigned int interleaveIndex);
+
+    /**
+     * Restart encoding the suspended qualities that have been requested since they were suspended.
+     *
+     * This doesn't suspend, so the caller can check that this object still exists immediately before calling it.
+     */
+    void resumeRequestedQualities();
+
+    /**
+     * End a quality's interleave segments before a given one, since they're not going to get any more data.
+     */
+    void endInterleaveSegments(unsigned int interleaveIndex, unsigned int segmentIndex);
 
     /**
-     * Remove segments that should have expired and should no longer be accessible.
+     * Get (and possibly create) the given segment of the given interleave.
      */
-    void gcSegments();
+    InterleaveExpiringResource &getInterleaveSegment(unsigned int interleaveIndex, unsigned int segmentIndex);
 
     /**
      * Get the full path to save the given DASH file to, if we're saving persistently.
@@ -163,6 +246,11 @@ private:
     const Config::Channel &config;
     Server::Server &server;
 
+    /**
+     * Schedules segment pre-availability and expiry.
+     */
+    Util::TimerWheel &timerWheel;
+
     /**
      * The base path for all the resources this object manages.
      */
@@ -178,20 +266,78 @@ private:
      */
     const std::filesystem::path persistenceDirectory;
 
+    /**
+     * Whether the qualities share a single audio stream.
+     */
+    const bool sharesAudio;
+
     /**
      * Tracks state for each non-interleave stream.
+     *
+     * These are never moved, because their timers refer to them.
      */
-    std::vector<Stream> streams;
+    std::vector<std::unique_ptr<Stream>> streams;
 
     /**
      * Tracks state for each interleave stream.
+     *
+     * These are never moved, because their timers refer to them.
+     */
+    std::vector<std::unique_ptr<Interleave>> interleaves;
+
+    /**
+     * The PTS source given to the API resources.
+     */
+    const Ffmpeg::Process &ffmpegProcess;
+
+    /**
+     * Whether this object's info.json and API resources are the ones in the server.
+     */
+    bool published = false;
+
+    /**
+     * The number of streams that have started their second segment, and thus have finished their first.
+     */
+    unsigned int numStreamsWithFirstSegment = 0;
+
+    /**
+     * Notified when a stream finishes its first segment.
+     */
+    Event firstSegmentEvent;
+
+    /**
+     * Tracks which qualities are being watched, if qualities are suspended when they're not. Otherwise null.
+     *
+     * This is shared with the interleaves, which can outlive this object.
+     */
+    std::shared_ptr<Demand> demand;
+
+    /**
+     * Stops and restarts the encoding of a quality.
+     */
+    const std::function<void(unsigned int, bool, Ffmpeg::Timestamp, unsigned int)> setEncoding;
+
+    /**
+     * For each stream, what to add to ffmpeg's segment indices to get the interleave segment indices.
+     *
+     * ffmpeg numbers a quality's segments from 1 again when it's restarted, so this is nonzero once it's been resumed.
+     */
+    std::vector<unsigned int> segmentIndexOffsets;
+
+    /**
+     * The latest interleave segment that a quality that's being encoded has started.
+     */
+    unsigned int latestStartedSegmentIndex = 0;
+
+    /**
+     * The latest interleave segment that has become pre-available for a quality that's being encoded.
      */
-    std::vector<Interleave> interleaves;
+    unsigned int latestPreAvailableSegmentIndex = 0;
 
     /**
-     * Something to create weak pointers from to determine from a coroutine whether the object parent still exist.
+     * When this object was created, for reporting how long the streams took to start.
      */
-    std::shared_ptr<char> exists;
+    const std::chrono::steady_clock::time_point startTime;
 };
 
 } // namespace Dash
@@ -0,0 +1,301 @@
+#include "FanOut.hpp"
+
+#include "util/asio.hpp"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <vector>
+
+namespace
+{
+
+/**
+ * When a chunk was first and last written to a subscriber that was waiting for it.
+ */
+struct DeliveryTimes final
+{
+    std::optional<std::chrono::steady_clock::time_point> first;
+    std::chrono::steady_clock::time_point last;
+
+    /**
+     * Include a delivery at another time, or the deliveries from another set of times.
+     */
+    void merge(std::chrono::steady_clock::time_point firstTime, std::chrono::steady_clock::time_point lastTime)
+    {
+        first = first ? std::min(*first, firstTime) : firstTime;
+        last = std::max(last, lastTime);
+    }
+};
+
+} // namespace
+
+/**
+ * Something a subscriber waits on until its lane wakes it, in the same way as Event::Timer.
+ */
+struct Dash::FanOut::Timer final
+{
+    explicit Timer(const boost::asio::any_io_executor &executor) : timer(executor)
+    {
+        /* The std::chrono::years value is guaranteed to allow at least this. */
+        timer.expires_from_now(std::chrono::years(40000));
+    }
+
+    boost::asio::steady_timer timer;
+};
+
+/**
+ * The subscribers that are waiting in a particular IO context.
+ */
+struct Dash::FanOut::Lane final
+{
+    explicit Lane(boost::asio::any_io_executor executor) : executor(std::move(executor)) {}
+
+    /**
+     * The executor of the IO context, which is the only place the subscribers' timers can be cancelled from.
+     */
+    boost::asio::any_io_executor executor;
+
+    /**
+     * Subscribers that are waiting for the next notification.
+     */
+    std::vector<std::shared_ptr<Timer>> waiting;
+
+    /**
+     * Subscribers that are being woken by the current pass, in the order they're being woken.
+     */
+    std::vector<std::shared_ptr<Timer>> waking;
+
+    /**
+     * The index in waking of the next subscriber to wake.
+     */
+    size_t nextToWake = 0;
+
+    /**
+     * How far to rotate the order of the subscribers in the next pass.
+     */
+    size_t rotation = 0;
+
+    /**
+     * Whether there's been a notification since the current pass started.
+     */
+    bool notified = false;
+
+    /**
+     * Whether a batch has been posted to the IO context, but not yet run.
+     */
+    bool scheduled = false;
+
+    /**
+     * Protects deliveries, instead of the state's mutex, so subscribers in different IO contexts don't contend to
+     * record their deliveries. Only getStats shares it with the lane's own thread.
+     */
+    std::mutex deliveriesMutex;
+
+    /**
+     * When each chunk was first and last written to this lane's subscribers, by index.
+     */
+    std::vector<DeliveryTimes> deliveries;
+};
+
+/**
+ * Everything that's shared between threads.
+ */
+struct Dash::FanOut::State final
+{
+    /**
+     * Get the lane for an executor, creating it if necessary.
+     *
+     * The mutex must be held.
+     */
+    Lane &getLane(const boost::asio::any_io_executor &executor)
+    {
+        for (const std::unique_ptr<Lane> &lane: lanes) {
+            if (lane->executor == executor) {
+                return *lane;
+            }
+        }
+        return *lanes.emplace_back(std::make_unique<Lane>(executor));
+    }
+
+    /**
+     * Post the next batch of a lane to its IO context.
+     *
+     * The lane's subscribers keep the owner of this object alive while they're waiting, and there's always at least
+     * one waiting subscriber while a batch is scheduled.
+     */
+    void schedule(Lane &lane, size_t batchSize)
+    {
+        boost::asio::post(lane.executor, [this, &lane, batchSize]() { wake(lane, batchSize); });
+    }
+
+    /**
+     * Wake the next batch of a lane's subscribers.
+     *
+     * This runs in the lane's IO context.
+     */
+    void wake(Lane &lane, size_t batchSize)
+    {
+        std::vector<std::shared_ptr<Timer>> batch;
+        bool more = false;
+        {
+            std::lock_guard lock(mutex);
+
+            /* If the last pass has finished, start a new one for everything that's waiting now. */
+            if (lane.waking.empty() && lane.notified) {
+                lane.notified = false;
+                lane.waking.swap(lane.waiting);
+                if (!lane.waking.empty()) {
+                    size_t rotation = lane.rotation++ % lane.waking.size();
+                    std::rotate(lane.waking.begin(), lane.waking.begin() + (ptrdiff_t)rotation, lane.waking.end());
+                }
+            }
+
+            /* Take the next batch. */
+            size_t n = std::min(batchSize, lane.waking.size() - lane.nextToWake);
+            auto batchBegin = lane.waking.begin() + (ptrdiff_t)lane.nextToWake;
+            batch.assign(batchBegin, batchBegin + (ptrdiff_t)n);
+            lane.nextToWake += n;
+            if (lane.nextToWake == lane.waking.size()) {
+                lane.waking.clear();
+                lane.nextToWake = 0;
+            }
+
+            /* Figure out if there's more to do after this batch. */
+            more = !lane.waking.empty() || (lane.notified && !lane.waiting.empty());
+            lane.scheduled = more;
+        }
+
+        /* Wake the batch. Their coroutines are queued before the next batch is, so they get to write first. */
+        for (const std::shared_ptr<Timer> &timer: batch) {
+            timer->timer.cancel();
+        }
+        if (more) {
+            schedule(lane, batchSize);
+        }
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Lane>> lanes;
+
+    /**
+     * When each chunk was published.
+     */
+    std::vector<std::chrono::steady_clock::time_point> published;
+};
+
+Dash::FanOut::~FanOut() = default;
+
+Dash::FanOut::FanOut(size_t batchSize) : batchSize(std::max(batchSize, (size_t)1)), state(std::make_unique<State>())
+{
+}
+
+void Dash::FanOut::publish(std::chrono::steady_clock::time_point time)
+{
+    std::lock_guard lock(state->mutex);
+    state->published.push_back(time);
+}
+
+void Dash::FanOut::notify()
+{
+    std::lock_guard lock(state->mutex);
+    for (const std::unique_ptr<Lane> &lane: state->lanes) {
+        if (lane->waiting.empty()) {
+            continue;
+        }
+        lane->notified = true;
+        if (!lane->scheduled) {
+            lane->scheduled = true;
+            state->schedule(*lane, batchSize);
+        }
+    }
+}
+
+Dash::FanOut::Stats Dash::FanOut::getStats() const
+{
+    std::lock_guard lock(state->mutex);
+
+    /* Merge the lanes' delivery times. */
+    std::vector<DeliveryTimes> deliveries(state->published.size());
+    for (const std::unique_ptr<Lane> &lane: state->lanes) {
+        std::lock_guard laneLock(lane->deliveriesMutex);
+        for (size_t i = 0; i < lane->deliveries.size(); i++) {
+            const DeliveryTimes &times = lane->deliveries[i];
+            if (times.first) {
+                deliveries[i].merge(*times.first, times.last);
+            }
+        }
+    }
+
+    /* Summarise them. */
+    Stats stats;
+    std::chrono::steady_clock::duration totalTimeToLast{};
+    for (size_t i = 0; i < deliveries.size(); i++) {
+        const DeliveryTimes &times = deliveries[i];
+        if (!times.first) {
+            continue;
+        }
+        std::chrono::steady_clock::duration timeToLast = times.last - state->published[i];
+        stats.chunks++;
+        stats.maxTimeToLast = std::max(stats.maxTimeToLast, timeToLast);
+        stats.maxSpread = std::max(stats.maxSpread, times.last - *times.first);
+        totalTimeToLast += timeToLast;
+    }
+    if (stats.chunks > 0) {
+        stats.meanTimeToLast = totalTimeToLast / stats.chunks;
+    }
+    return stats;
+}
+
+Dash::FanOut::Subscriber::~Subscriber() = default;
+
+Dash::FanOut::Subscriber::Subscriber(FanOut &fanOut, const boost::asio::any_io_executor &executor) :
+    fanOut(fanOut), timer(std::make_shared<Timer>(executor))
+{
+    std::lock_guard lock(fanOut.state->mutex);
+    lane = &fanOut.state->getLane(executor);
+    firstLiveIndex = fanOut.state->published.size();
+}
+
+Awaitable<void> Dash::FanOut::Subscriber::wait(std::unique_lock<std::mutex> &lock)
+{
+    assert(lock.owns_lock());
+    [[maybe_unused]] boost::asio::any_io_executor executor = co_await boost::asio::this_coro::executor;
+    assert(executor == lane->executor);
+
+    /* Register the wait with this IO context's lane before giving up the lock. */
+    {
+        std::lock_guard stateLock(fanOut.state->mutex);
+        lane->waiting.push_back(timer);
+    }
+    lock.unlock();
+
+    /* Now we can wait. The lane wakes this from this coroutine's own executor, so that can only happen once this
+       coroutine has suspended. */
+    co_await timer->timer.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+    lock.lock();
+}
+
+void Dash::FanOut::Subscriber::delivered(size_t begin, size_t end)
+{
+    begin = std::max(begin, firstLiveIndex);
+    if (begin >= end) {
+        return;
+    }
+
+    /* Record the time in this subscriber's lane, which only this thread and getStats use. */
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard lock(lane->deliveriesMutex);
+    if (lane->deliveries.size() < end) {
+        lane->deliveries.resize(end);
+    }
+    for (size_t i = begin; i < end; i++) {
+        lane->deliveries[i].merge(now, now);
+    }
+}
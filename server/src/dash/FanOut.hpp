@@ -0,0 +1,161 @@
+#pragma once
+
+#include "util/awaitable.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace Dash
+{
+
+/**
+ * Wakes the GET requests that are following a growing sequence of chunks, and measures how quickly each chunk reaches
+ * them.
+ *
+ * Waking every waiting request at once would queue all of them onto their IO contexts in one go, stalling everything
+ * else those contexts have to do until they've all written the chunk. Instead, each IO context has a lane that wakes at
+ * most batchSize of its subscribers and then lets other work run before waking the next batch. The order in which a
+ * lane wakes its subscribers rotates with each notification, so no subscriber is always the last to get a chunk.
+ *
+ * The object may be used from any thread. Each IO context that has subscribers must be run by only one thread.
+ */
+class FanOut final
+{
+public:
+    class Subscriber;
+
+    /**
+     * How quickly chunks reached the subscribers that were waiting for them.
+     *
+     * Only subscribers that subscribed before a chunk was published are counted for it, so requests that catch up on
+     * old chunks don't distort the figures.
+     */
+    struct Stats final
+    {
+        /**
+         * The number of chunks that reached at least one subscriber that was waiting for them.
+         */
+        size_t chunks = 0;
+
+        /**
+         * The longest time from a chunk being published to it being written to the last of its subscribers.
+         */
+        std::chrono::steady_clock::duration maxTimeToLast{};
+
+        /**
+         * The mean time from a chunk being published to it being written to the last of its subscribers.
+         */
+        std::chrono::steady_clock::duration meanTimeToLast{};
+
+        /**
+         * The largest difference between the first and last subscriber to be written a chunk.
+         */
+        std::chrono::steady_clock::duration maxSpread{};
+    };
+
+    /**
+     * The default maximum number of subscribers that each lane wakes before letting other work run.
+     */
+    static constexpr size_t defaultBatchSize = 32;
+
+    ~FanOut();
+
+    /**
+     * Constructor :)
+     *
+     * @param batchSize The maximum number of subscribers that each lane wakes before letting other work run.
+     */
+    explicit FanOut(size_t batchSize = defaultBatchSize);
+
+    /**
+     * Record that a new chunk has been published.
+     *
+     * This should be called with the owner's lock held (the one given to Subscriber::wait), at the same time the chunk
+     * is made available, so that subscribers agree on which chunks were published before they subscribed.
+     *
+     * @param time When the chunk was received.
+     */
+    void publish(std::chrono::steady_clock::time_point time);
+
+    /**
+     * Wake every waiting subscriber, in batches.
+     *
+     * This can be called without the owner's lock held.
+     */
+    void notify();
+
+    /**
+     * Get how quickly the chunks so far reached their subscribers.
+     */
+    Stats getStats() const;
+
+private:
+    struct Lane;
+    struct State;
+    struct Timer;
+
+    const size_t batchSize;
+    std::unique_ptr<State> state;
+};
+
+/**
+ * A GET request that's following the chunks of a FanOut.
+ *
+ * This must only be used from the coroutine that created it.
+ */
+class FanOut::Subscriber final
+{
+public:
+    ~Subscriber();
+
+    /**
+     * Subscribe to a FanOut.
+     *
+     * This should be called with the owner's lock held.
+     *
+     * @param executor The executor of the coroutine that's subscribing, which must be the one that uses this object.
+     */
+    explicit Subscriber(FanOut &fanOut, const boost::asio::any_io_executor &executor);
+
+    Subscriber(const Subscriber &) = delete;
+    Subscriber &operator=(const Subscriber &) = delete;
+
+    /**
+     * Wait to be woken by FanOut::notify, unlocking the owner's mutex while waiting.
+     *
+     * This works like Event::wait(std::unique_lock<std::mutex> &): a notification that happens after the caller
+     * checked its condition can't be missed. Spurious wakeups are permitted.
+     *
+     * @param lock A lock on the owner's mutex. This is held again when this returns.
+     */
+    Awaitable<void> wait(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * Record that a range of chunks has been written to this subscriber.
+     *
+     * @param begin The index of the first chunk that was written.
+     * @param end One past the index of the last chunk that was written.
+     */
+    void delivered(size_t begin, size_t end);
+
+private:
+    FanOut &fanOut;
+
+    /**
+     * The lane for the subscriber's IO context.
+     */
+    Lane *lane;
+
+    /**
+     * The index of the first chunk that this subscriber was waiting for, rather than catching up on.
+     */
+    size_t firstLiveIndex;
+
+    /**
+     * What this subscriber waits on. It's shared with the lane while the subscriber is waiting.
+     */
+    std::shared_ptr<Timer> timer;
+};
+
+} // namespace Dash
@@ -3,8 +3,12 @@
 #include "server/Request.hpp"
 #include "server/Response.hpp"
 #include "util/asio.hpp"
+#include "util/RandomPool.hpp"
 
-#include <random>
+#include <boost/asio/this_coro.hpp>
+
+#include <cstring>
+#include <optional>
 
 namespace
 {
@@ -20,28 +24,74 @@ void writeLittleEndianInteger(std::byte (&dst)[8], uint64_t src)
 }
 
 /**
- * Generate some random data.
+ * Build the header of an interleave chunk.
  *
- * @param length The amount of random data to generate, in bytes.
- * @return A least length bytes of data. This may be rounded up by a small amount for efficiency.
+ * @param streamIndex The index of the stream the chunk belongs to.
+ * @param dataSize The size of the chunk's data, not including prefixData.
+ * @param addTimestamp Whether to add a timestamp to the chunk header.
+ * @param prefixData Data to add to the chunk after its header but before the data. This is useful for inserting the
+ *                   control chunk header without unnecessary copying.
+ * @return The header, followed by the prefix data.
  */
-std::vector<std::byte> getRandomData(unsigned int length)
+std::vector<std::byte> getChunkHeader(unsigned int streamIndex, uint64_t dataSize, bool addTimestamp,
+                                      std::span<const std::byte> prefixData = {})
 {
-    /* Persistent PRNG state. */
-    // This uses 32-bit arithmetic because std::minstd_rand has values that are chosen for 32-bit arithmetic.
-    static std::minstd_rand engine;
-    static std::uniform_int_distribution<uint32_t> distribution(0, ~(uint32_t)0);
-
-    /* Figure out how many 32-bit values are needed to achieve a length of at least that given. */
-    unsigned int n = (length + 3) / 4;
-
-    /* Return the random data. */
-    std::vector<std::byte> result(n * 4);
-    for (unsigned int i = 0; i < n; i++) {
-        uint32_t value = distribution(engine);
-        memcpy(result.data() + i * 4, &value, 4);
+    /* Calculate the length. */
+    unsigned int lengthId = 0;
+    unsigned int lengthByteCount = 0;
+    std::byte lengthBytes[8];
+
+    // Calculate the length as a little-endian value.
+    uint64_t chunkDataSize = prefixData.size() + dataSize;
+    writeLittleEndianInteger(lengthBytes, chunkDataSize);
+
+    // Figure out the length ID.
+    if (chunkDataSize < 1 << 8) {
+        lengthId = 0;
+    }
+    else if (chunkDataSize < 1 << 16) {
+        lengthId = 1;
+    }
+    else if (chunkDataSize < (size_t)1 << 32) {
+        lengthId = 2;
+    }
+    else {
+        lengthId = 3;
+    }
+
+    // Compute the number of bytes for the length for the given length ID.
+    lengthByteCount = 1 << lengthId;
+
+    /* Compute the timestamp. */
+    std::byte timestampBytes[8];
+    if (addTimestamp) {
+        std::chrono::system_clock::time_point sysNow = std::chrono::system_clock::now();
+        uint64_t utcµs = std::chrono::round<std::chrono::microseconds>(sysNow.time_since_epoch()).count();
+        writeLittleEndianInteger(timestampBytes, utcµs);
+    }
+
+    /* Calculate the content ID. */
+    std::byte contentId = (std::byte)(streamIndex | (addTimestamp ? 1 << 5 : 0) | (lengthId << 6));
+
+    /* Build the header. */
+    // Create a block of memory of the correct size.
+    unsigned int chunkDataOffset = 1 + lengthByteCount + (addTimestamp ? sizeof(timestampBytes) : 0);
+    std::vector<std::byte> header(chunkDataOffset + prefixData.size());
+
+    // Copy the content ID into the header.
+    header[0] = contentId;
+
+    // Copy the length into the header.
+    memcpy(header.data() + 1, lengthBytes, lengthByteCount);
+
+    // Copy the timestamp into the header.
+    if (addTimestamp) {
+        memcpy(header.data() + 1 + lengthByteCount, timestampBytes, sizeof(timestampBytes));
     }
-    return result;
+
+    // Copy the prefix data;
+    memcpy(header.data() + chunkDataOffset, prefixData.data(), prefixData.size());
+    return header;
 }
 
 } // namespace
@@ -49,50 +99,124 @@ std::vector<std::byte> getRandomData(unsigned int length)
 static_assert(std::ratio_less_equal<std::chrono::system_clock::period, std::micro>::value,
               "System clock resolution is insufficient.");
 
-Dash::InterleaveResource::~InterleaveResource() = default;
+Dash::InterleaveResource::~InterleaveResource()
+{
+    /* Record how quickly the chunks reached the GET requests that were waiting for them. */
+    FanOut::Stats stats = fanOut.getStats();
+    if (stats.chunks > 0) {
+        using Ms = std::chrono::duration<double, std::milli>;
+        log << "fanout" << Log::Level::debug << stats.chunks << " chunks took a mean of "
+            << Ms(stats.meanTimeToLast).count() << " ms and a maximum of " << Ms(stats.maxTimeToLast).count()
+            << " ms to reach the last subscriber. The largest spread between subscribers was "
+            << Ms(stats.maxSpread).count() << " ms.";
+    }
+}
 
-Dash::InterleaveResource::InterleaveResource(IOContext &ioc, Log::Log &log, unsigned int numStreams,
+Dash::InterleaveResource::InterleaveResource(Log::Log &log, unsigned int numStreams,
                                              unsigned int minInterleaveBytesPerWindow,
-                                             unsigned int minInterleaveWindowMs, unsigned int timestampIntervalMs) :
-    Resource(true), log(log("interleave")), numRemainingStreams(numStreams),
+                                             unsigned int minInterleaveWindowMs, unsigned int timestampIntervalMs,
+                                             std::function<void()> onGet) :
+    Resource(true), log(log("interleave")), numStreams(numStreams), numRemainingStreams(numStreams),
     minInterleaveBytesPerWindow(minInterleaveBytesPerWindow), minInterleaveWindowMs(minInterleaveWindowMs),
-    timestampIntervalMs(timestampIntervalMs), event(ioc)
+    timestampIntervalMs(timestampIntervalMs), onGet(std::move(onGet))
 {
+    assert(numStreams <= maxStreams);
 }
 
 Awaitable<void> Dash::InterleaveResource::getAsync(Server::Response &response, Server::Request &request)
 {
+    /* Let whatever's interested know that this interleave is being watched. */
+    if (onGet) {
+        onGet();
+    }
+
     /* Keep sending more chunks to the client until the streams all end and the client's received all the chunks. */
-    for (size_t i = 0; !hasEnded() || i < data.size(); i++) {
+    std::unique_lock lock(mutex);
+    FanOut::Subscriber subscriber(fanOut, co_await boost::asio::this_coro::executor);
+    std::optional<Util::RateMeter> sent;
+    if (minInterleaveBytesPerWindow > 0) {
+        sent.emplace(std::chrono::milliseconds(minInterleaveWindowMs));
+    }
+    std::chrono::steady_clock::time_point firstSent;
+    for (size_t i = 0; !hasEnded() || i < chunks.size();) {
         // Wait for more data to become available if necessary.
-        assert(i <= data.size());
-        while (i == data.size()) {
-            co_await event.wait();
+        assert(i <= chunks.size());
+        while (i == chunks.size()) {
+            co_await subscriber.wait(lock);
+        }
+        assert(i < chunks.size());
+
+        // Give the response every chunk that's available, so a request that's behind catches up with a single flush.
+        // This shares the chunks' data rather than copying it.
+        size_t begin = i;
+        size_t sentSize = 0;
+        for (; i < chunks.size(); i++) {
+            const Chunk &chunk = chunks[i];
+            Util::SharedBuffer parts[] = { chunk.header, chunk.data };
+            response.write(std::span(parts, chunk.data.empty() ? 1 : 2));
+            sentSize += chunk.size();
+        }
+
+        // Pad what's sent to this request with extra data if needed to maintain the minimum rate. This is done per
+        // request, based on what the request itself has been sent, so the padding isn't stored or sent to requests
+        // that are catching up. We can't (and shouldn't) append extra data if the interleave has ended anyway. The CDN
+        // should flush its buffers in that case.
+        if (sent) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (begin == 0) {
+                firstSent = now;
+            }
+            sent->add(sentSize, now);
+
+            unsigned int extraData = hasEnded() ? 0 : getPaddingDataLengthForWindow(*sent, firstSent, now);
+            if (extraData > 0) {
+                // We use random data to make sure there's no compression anywhere that reduces the effective rate. It's
+                // sliced from a shared pool, so no generation or allocation is needed. The length doesn't account for
+                // the size of the chunk header for the random data, so this can be a few bytes over, but that's OK.
+                Util::SharedBuffer padding = Util::RandomPool::getShared().get(extraData);
+                std::byte controlChunkHeader = (std::byte)ControlChunkType::discard;
+                Util::SharedBuffer parts[] = {
+                    getChunkHeader(maxStreams, padding.size(), false, std::span(&controlChunkHeader, 1)),
+                    padding
+                };
+                response.write(parts);
+                sent->add(parts[0].size() + parts[1].size(), now);
+            }
         }
-        assert(i < data.size());
 
-        // Give the response the next piece of data.
-        response << data[i].first;
+        // Send them, without holding the lock.
+        lock.unlock();
         co_await response.flush();
+        lock.lock();
+        subscriber.delivered(begin, i);
     }
 }
 
-void Dash::InterleaveResource::addStreamData(std::span<const std::byte> dataPart, unsigned int streamIndex)
+bool Dash::InterleaveResource::getAllowConcurrentGet() const noexcept
+{
+    return true;
+}
+
+void Dash::InterleaveResource::addStreamData(Util::SharedBuffer dataPart, unsigned int streamIndex)
 {
     assert(streamIndex < maxStreams);
+
+    /* Ignore anything that arrives after the stream has ended, such as from a segment that was ended by endStreams. */
+    if (endedStreams & (uint32_t{1} << streamIndex)) {
+        return;
+    }
     assert(numRemainingStreams > 0);
+    if (dataPart.empty()) {
+        endedStreams |= uint32_t{1} << streamIndex;
+    }
 
     started = true;
 
     /* We need to know when the chunk was received for some of the realtime stuff below. */
     std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
-    /* Record if this stream is ending. */
-    if (dataPart.empty()) {
-        numRemainingStreams--;
-    }
-    // Even if the stream is ending, we need to put an empty chunk (with its header) into the interleave so that the
-    // client knows it's ended.
+    // If the stream is ending, we need to put an empty chunk (with its header) into the interleave so that the client
+    // knows it's ended. This also records that the stream has ended.
 
     /* Figure out whether there should be a timestamp. */
     bool addTimestamp = false;
@@ -104,153 +228,75 @@ void Dash::InterleaveResource::addStreamData(std::span<const std::byte> dataPart
     }
 
     /* Append the chunk and notify anything that's waiting for it. */
-    addChunk(dataPart, streamIndex, now, addTimestamp);
-
-    /* Pad the interleave with extra data if needed to maintain the minimum rate. */
-    // We can't (and shouldn't) append extra data if the stream is ending anyway. The CDN should flush its buffers in
-    // that case.
-    if (hasEnded()) {
-        return;
-    }
-
-    // Figure out how much data we need to pad.
-    unsigned int extraData = getPaddingDataLengthForWindow(now);
+    addChunk(std::move(dataPart), streamIndex, now, addTimestamp);
+}
 
-    // Don't generate a padding chunk if we don't need any data.
-    if (extraData == 0) {
-        return;
+void Dash::InterleaveResource::endStreams()
+{
+    for (unsigned int i = 0; i < numStreams; i++) {
+        addStreamData({}, i);
     }
-
-    // We use random data to make sure there's no compression anywhere that reduces the effective rate. The length
-    // doesn't account for the size of the chunk header for the random data, so this can be a few bytes over, but that's
-    // OK.
-    addControlChunk(getRandomData(extraData), ControlChunkType::discard, now);
 }
 
-void Dash::InterleaveResource::addControlChunk(std::span<const std::byte> chunkData, ControlChunkType type)
+void Dash::InterleaveResource::addControlChunk(Util::SharedBuffer chunkData, ControlChunkType type)
 {
-    addControlChunk(chunkData, type, std::chrono::steady_clock::now());
+    addControlChunk(std::move(chunkData), type, std::chrono::steady_clock::now());
 }
 
-void Dash::InterleaveResource::addChunk(std::span<const std::byte> dataPart, unsigned int streamIndex,
+void Dash::InterleaveResource::addChunk(Util::SharedBuffer dataPart, unsigned int streamIndex,
                                         std::chrono::steady_clock::time_point now, bool addTimestamp,
                                         std::span<const std::byte> prefixData)
 {
     assert(streamIndex < maxStreams + 1);
 
-    /* Calculate the length. */
-    unsigned int lengthId = 0;
-    unsigned int lengthByteCount = 0;
-    std::byte lengthBytes[8];
-
-    // Calculate the length as a little-endian value.
-    uint64_t chunkDataSize = prefixData.size() + dataPart.size();
-    writeLittleEndianInteger(lengthBytes, chunkDataSize);
-
-    // Figure out the length ID.
-    if (chunkDataSize < 1 << 8) {
-        lengthId = 0;
-    }
-    else if (chunkDataSize < 1 << 16) {
-        lengthId = 1;
-    }
-    else if (chunkDataSize < (size_t)1 << 32) {
-        lengthId = 2;
-    }
-    else {
-        lengthId = 3;
-    }
-
-    // Compute the number of bytes for the length for the given length ID.
-    lengthByteCount = 1 << lengthId;
-
-    /* Compute the timestamp. */
-    std::byte timestampBytes[8];
-    if (addTimestamp) {
-        std::chrono::system_clock::time_point sysNow = std::chrono::system_clock::now();
-        uint64_t utcµs = std::chrono::round<std::chrono::microseconds>(sysNow.time_since_epoch()).count();
-        writeLittleEndianInteger(timestampBytes, utcµs);
-    }
-
-    /* Calculate the content ID. */
-    std::byte contentId = (std::byte)(streamIndex | (addTimestamp ? 1 << 5 : 0) | (lengthId << 6));
-
-    /* Build the complete chunk. */
-    // Create a block of memory of the correct size.
-    unsigned int chunkDataOffset = 1 + lengthByteCount + (addTimestamp ? sizeof(timestampBytes) : 0);
-    size_t dataPartOffset = chunkDataOffset + prefixData.size();
-    std::vector<std::byte> chunk(dataPartOffset + dataPart.size());
-
-    // Copy the content ID into the chunk.
-    chunk[0] = contentId;
-
-    // Copy the length into the chunk.
-    memcpy(chunk.data() + 1, lengthBytes, lengthByteCount);
-
-    // Copy the timestamp into the chunk.
-    if (addTimestamp) {
-        memcpy(chunk.data() + 1 + lengthByteCount, timestampBytes, sizeof(timestampBytes));
-    }
-
-    // Copy the prefix data;
-    memcpy(chunk.data() + chunkDataOffset, prefixData.data(), prefixData.size());
-
-    // Copy the data itself.
-    memcpy(chunk.data() + dataPartOffset, dataPart.data(), dataPart.size());
+    /* Build the chunk's header. The data itself is kept separately so it doesn't have to be copied. */
+    std::vector<std::byte> header = getChunkHeader(streamIndex, dataPart.size(), addTimestamp, prefixData);
 
     /* Append the chunk to the list of chunks and notify anything that's waiting that we have a new chunk. */
-    data.emplace_back(chunk, now);
-    event.notifyAll();
+    bool isEmpty = dataPart.empty();
+    {
+        std::lock_guard lock(mutex);
+        chunks.push_back({ .header = std::move(header), .data = std::move(dataPart) });
+        fanOut.publish(now);
+
+        // An empty data chunk marks the end of its stream. This is recorded at the same time as the chunk is added so
+        // GET requests don't see the interleave end before they've seen the last chunk.
+        if (streamIndex < maxStreams && isEmpty) {
+            numRemainingStreams--;
+        }
+    }
+    fanOut.notify();
 }
 
-void Dash::InterleaveResource::addControlChunk(std::span<const std::byte> chunkData, ControlChunkType type,
+void Dash::InterleaveResource::addControlChunk(Util::SharedBuffer chunkData, ControlChunkType type,
                                                std::chrono::steady_clock::time_point now)
 {
     assert(!hasEnded());
     std::byte controlChunkHeader = (std::byte)type;
-    addChunk(chunkData, maxStreams, now, false, std::span(&controlChunkHeader, 1));
+    addChunk(std::move(chunkData), maxStreams, now, false, std::span(&controlChunkHeader, 1));
 }
 
-unsigned int Dash::InterleaveResource::getPaddingDataLengthForWindow(std::chrono::steady_clock::time_point now) const
+unsigned int Dash::InterleaveResource::getPaddingDataLengthForWindow(Util::RateMeter &sent,
+                                                                   std::chrono::steady_clock::time_point firstSent,
+                                                                   std::chrono::steady_clock::time_point now) const
 {
-    assert(!data.empty());
-
-    /* No data is needed if the minimum interleave rate is zero. */
-    if (minInterleaveBytesPerWindow == 0) {
-        return 0;
-    }
-
     /* Figure out when the start of the window to consider is. */
     std::chrono::steady_clock::time_point windowStart =
         now - std::chrono::duration_cast<std::chrono::steady_clock::duration>
               (std::chrono::milliseconds(minInterleaveWindowMs));
 
-    /* If the earliest chunk is still in the window (but not at its earliest edge), then we might receive more real
-       data. */
-    if (data.front().second > windowStart) {
+    /* If the request was first sent something within the window (but not at its earliest edge), then we might send it
+       more real data. */
+    if (firstSent > windowStart) {
         return 0;
     }
 
-    /* Figure out how much data is in that window by iterating the received data, starting from the end. */
-    size_t dataInWindow = 0;
-    for (auto it = data.rbegin(); it != data.rend(); ++it) {
-        const auto &[pastChunk, timeReceived] = *it;
-
-        // If we've gone past the start of the window, the summation is complete.
-        if (timeReceived < windowStart) {
-            break;
-        }
-
-        // Add the amount of data received in this chunk.
-        dataInWindow += pastChunk.size();
-
-        // If we've exceeded the amount of data needed, we don't need to add any extra.
-        if (dataInWindow >= minInterleaveBytesPerWindow) {
-            return 0;
-        }
-    }
+    /* Figure out how much data is in that window. */
+    size_t dataInWindow = sent.getAmountInWindow(now);
 
     /* Return the amount of extra data we need. */
-    assert(dataInWindow < minInterleaveBytesPerWindow);
+    if (dataInWindow >= minInterleaveBytesPerWindow) {
+        return 0;
+    }
     return (unsigned int)(minInterleaveBytesPerWindow - dataInWindow);
 }
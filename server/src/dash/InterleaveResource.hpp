@@ -1,12 +1,16 @@
 #pragma once
 
 #include "ControlChunkType.hpp"
+#include "FanOut.hpp"
 
 #include "log/Log.hpp"
 #include "server/Resource.hpp"
-#include "util/Event.hpp"
+#include "util/RateMeter.hpp"
+#include "util/SharedBuffer.hpp"
 
 #include <chrono>
+#include <functional>
+#include <mutex>
 #include <span>
 #include <string_view>
 #include <vector>
@@ -39,20 +43,32 @@ public:
      *                              value is set to disable the minimum rate, which is useful for testing.
      * @param timestampIntervalMs The interval, in ms, between timestamps. The default is set to disable timestamps,
      *                            which is useful for testing.
+     * @param onGet What to call whenever a GET request for the interleave arrives. This is called from whichever
+     *              thread is handling the request.
      */
-    explicit InterleaveResource(IOContext &ioc, Log::Log &log, unsigned int numStreams,
+    explicit InterleaveResource(Log::Log &log, unsigned int numStreams,
                                 unsigned int minInterleaveBytesPerWindow = 0, unsigned int minInterleaveWindowMs = ~0u,
-                                unsigned int timestampIntervalMs = ~0u);
+                                unsigned int timestampIntervalMs = ~0u, std::function<void()> onGet = {});
 
     Awaitable<void> getAsync(Server::Response &response, Server::Request &request) override;
 
+    bool getAllowConcurrentGet() const noexcept override;
+
     /**
      * Append data to a stream in the interleave.
      *
-     * @param dataPart The data to append. The stream is ended if this is empty.
+     * @param dataPart The data to append. The stream is ended if this is empty. This is shared, not copied. This is
+     *                 ignored if the stream has already ended.
      * @param streamIndex The index of the stream within the interleave. Must be less than maxStreams.
      */
-    void addStreamData(std::span<const std::byte> dataPart, unsigned int streamIndex);
+    void addStreamData(Util::SharedBuffer dataPart, unsigned int streamIndex);
+
+    /**
+     * End every stream in the interleave that hasn't already ended.
+     *
+     * This is for when the streams' sources have gone away, so that GET requests don't wait forever.
+     */
+    void endStreams();
 
     /**
      * Add a control chunk to the interleave.
@@ -60,10 +76,10 @@ public:
      * This method should not be called if every stream in the interleave has ended. This condition can be tested for
      * with hasEnded.
      *
-     * @param chunkData The data for the control chunk.
+     * @param chunkData The data for the control chunk. This is shared, not copied.
      * @param type The control chunk type.
      */
-    void addControlChunk(std::span<const std::byte> chunkData, ControlChunkType type);
+    void addControlChunk(Util::SharedBuffer chunkData, ControlChunkType type);
 
     /**
      * Determine if data has been received for any stream.
@@ -82,6 +98,32 @@ public:
     }
 
 private:
+    /**
+     * A chunk in the interleave.
+     *
+     * The header is kept separately from the data so the data can be shared with wherever it came from.
+     */
+    struct Chunk final
+    {
+        /**
+         * Get the total size of the chunk, in bytes.
+         */
+        size_t size() const
+        {
+            return header.size() + data.size();
+        }
+
+        /**
+         * The chunk's header, followed by its prefix data (if any).
+         */
+        Util::SharedBuffer header;
+
+        /**
+         * The chunk's data.
+         */
+        Util::SharedBuffer data;
+    };
+
     /**
      * Append a chunk to the interleave.
      *
@@ -93,7 +135,7 @@ private:
      * @param prefixData Data to add to the chunk after its header but before dataPart. This is useful for inserting the
      *                   control chunk header without unnecessary copying.
      */
-    void addChunk(std::span<const std::byte> dataPart, unsigned int streamIndex,
+    void addChunk(Util::SharedBuffer dataPart, unsigned int streamIndex,
                   std::chrono::steady_clock::time_point now, bool addTimestamp,
                   std::span<const std::byte> prefixData = {});
 
@@ -105,15 +147,19 @@ private:
      * @param now The time of the event that created the chunk. This must be at least as large as for the last chunk.
      *            This exists as a parameter for efficiency reasons.
      */
-    void addControlChunk(std::span<const std::byte> chunkData, ControlChunkType type,
+    void addControlChunk(Util::SharedBuffer chunkData, ControlChunkType type,
                          std::chrono::steady_clock::time_point now);
 
     /**
-     * Figure out how much extra data, in bytes, is needed to meet the minimum interleave rate.
+     * Figure out how much extra data, in bytes, a GET request needs to be sent to meet the minimum interleave rate.
      *
-     * This method must not be called until at least one data chunk has been added to the stream.
+     * @param sent Measures what's been sent to the request over the window.
+     * @param firstSent When the request was first sent something.
+     * @param now The current time.
      */
-    unsigned int getPaddingDataLengthForWindow(std::chrono::steady_clock::time_point now) const;
+    unsigned int getPaddingDataLengthForWindow(Util::RateMeter &sent,
+                                               std::chrono::steady_clock::time_point firstSent,
+                                               std::chrono::steady_clock::time_point now) const;
 
     Log::Context log;
 
@@ -122,11 +168,21 @@ private:
      */
     bool started = false;
 
+    /**
+     * The number of streams in the interleave.
+     */
+    const unsigned int numStreams;
+
     /**
      * The number of streams in the interleave that haven't yet finished.
      */
     unsigned int numRemainingStreams;
 
+    /**
+     * A bit for each stream that has finished.
+     */
+    uint32_t endedStreams = 0;
+
     /**
      * The minimum amount of data, in bytes, to emit per interleave window.
      */
@@ -148,16 +204,26 @@ private:
     std::chrono::steady_clock::time_point lastTimestamp;
 
     /**
-     * The event to notify when a new data part is available to any GET requests.
+     * What to call whenever a GET request arrives.
      */
-    Event event;
+    const std::function<void()> onGet;
 
     /**
-     * The data we've received for this interleave.
+     * Wakes the GET requests when a new chunk is available.
+     */
+    FanOut fanOut;
+
+    /**
+     * Protects chunks and numRemainingStreams from GET requests being handled in other threads.
      *
-     * Each element is a pair: { received data, time the data is received }.
+     * These are only modified from the main IO context, so the main IO context doesn't need to take this to read them.
+     */
+    mutable std::mutex mutex;
+
+    /**
+     * The chunks we've received for this interleave.
      */
-    std::vector<std::pair<std::vector<std::byte>, std::chrono::steady_clock::time_point>> data;
+    std::vector<Chunk> chunks;
 };
 
 } // namespace Dash
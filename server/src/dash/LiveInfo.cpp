@@ -80,6 +80,11 @@ nlohmann::json getAudioConfigs(const Config::Channel &config)
     for (const Config::Quality &q: config.qualities) {
         if (q.audio) {
             j.push_back(getAudioConfig(q.audio));
+
+            // A shared audio stream is only listed once.
+            if (config.sharesAudio()) {
+                break;
+            }
         }
     }
     return j;
@@ -90,8 +95,9 @@ nlohmann::json getAvMap(const Config::Channel &config)
     nlohmann::json j = nlohmann::json::array();
     size_t videoIndex = 0;
     size_t audioIndex = config.qualities.size();
+    bool sharesAudio = config.sharesAudio();
     for (const Config::Quality &q: config.qualities) {
-        j.push_back({ videoIndex++, q.audio ? audioIndex++ : (nlohmann::json)nullptr });
+        j.push_back({ videoIndex++, q.audio ? (sharesAudio ? audioIndex : audioIndex++) : (nlohmann::json)nullptr });
     }
     return j;
 }
@@ -15,11 +15,11 @@ Dash::SegmentResource::~SegmentResource() = default;
 Dash::SegmentResource::SegmentResource(IOContext &ioc, Log::Log &log, const Config::Dash &config,
                                        Dash::DashResources &resources,
                                        unsigned int streamIndex, unsigned int segmentIndex,
-                                       std::shared_ptr<InterleaveResource> interleave,
-                                       unsigned int interleaveIndex, unsigned int indexInInterleave,
-                                       std::filesystem::path path) :
-    Resource(config.expose), log(log("segment")), event(ioc), resources(resources),
-    streamIndex(streamIndex), segmentIndex(segmentIndex), interleave(std::move(interleave)),
+                                       std::vector<std::shared_ptr<InterleaveResource>> interleaves,
+                                       const std::vector<unsigned int> &interleaveIndices,
+                                       unsigned int indexInInterleave, std::filesystem::path path) :
+    Resource(config.expose), log(log("segment")), resources(resources),
+    streamIndex(streamIndex), segmentIndex(segmentIndex), interleaves(std::move(interleaves)),
     indexInInterleave(indexInInterleave),
     file(path.empty() ? Util::File() : Util::File(ioc, std::move(path), true, false))
 {
@@ -27,7 +27,7 @@ Dash::SegmentResource::SegmentResource(IOContext &ioc, Log::Log &log, const Conf
     this->log << "new" << Log::Level::info << Json::dump({
         { "streamIndex", streamIndex },
         { "segmentIndex", segmentIndex },
-        { "interleaveIndex", interleaveIndex },
+        { "interleaveIndices", interleaveIndices },
         { "indexInInterleave", indexInInterleave },
     });
 }
@@ -39,11 +39,12 @@ Awaitable<void> Dash::SegmentResource::getAsync(Server::Response &response, Serv
     }
 
     /* Keep waiting for more data until we've had it all. */
+    std::unique_lock lock(mutex);
     for (size_t i = 0; ; i++) {
         // Wait for more data to become available if necessary.
         assert(i <= data.size());
         while (i == data.size()) {
-            co_await event.wait();
+            co_await event.wait(lock);
         }
         assert(i < data.size());
 
@@ -65,7 +66,7 @@ Awaitable<void> Dash::SegmentResource::putAsync(Server::Response &response, Serv
     /* Read the request's data. */
     for (bool first = true; ; first = false) {
         // Get the next piece of data for the segment.
-        std::vector<std::byte> dataPart = co_await request.readSome();
+        Util::SharedBuffer dataPart = co_await request.readSome();
 
         // Notify the resources (and log for ourselves) that we've started receiving.
         if (first) {
@@ -73,8 +74,10 @@ Awaitable<void> Dash::SegmentResource::putAsync(Server::Response &response, Serv
             log << "start" << Log::Level::info;
         }
 
-        // Hand the data over to the interleave.
-        interleave->addStreamData(dataPart, indexInInterleave);
+        // Hand the data over to the interleaves. They share it, rather than copying it.
+        for (const std::shared_ptr<InterleaveResource> &interleave: interleaves) {
+            interleave->addStreamData(dataPart, indexInInterleave);
+        }
 
         // Write to the file if we're given one.
         if (file) {
@@ -84,7 +87,10 @@ Awaitable<void> Dash::SegmentResource::putAsync(Server::Response &response, Serv
         // Record the data if it's useful, and notify anything waiting for it.
         bool isEmpty = dataPart.empty();
         if (getIsPublic()) {
-            data.emplace_back(std::move(dataPart));
+            {
+                std::lock_guard lock(mutex);
+                data.emplace_back(std::move(dataPart));
+            }
             event.notifyAll();
         }
 
@@ -99,3 +105,8 @@ size_t Dash::SegmentResource::getMaxPutRequestLength() const noexcept
 {
     return size_t{1} << 32;
 }
+
+bool Dash::SegmentResource::getAllowConcurrentGet() const noexcept
+{
+    return true;
+}
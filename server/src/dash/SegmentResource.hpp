@@ -4,7 +4,9 @@
 #include "server/Resource.hpp"
 #include "util/Event.hpp"
 #include "util/File.hpp"
+#include "util/SharedBuffer.hpp"
 
+#include <mutex>
 #include <vector>
 
 namespace Config
@@ -34,18 +36,21 @@ public:
      * @param resources The coordination object.
      * @param streamIndex The index of the stream to which this segment belongs.
      * @param segmentIndex The index of this segment.
-     * @param interleave The interleave that this segment is to be interleaved into.
-     * @param interleaveIndex The index of the interleave (not the interleave segment, which is the same as the segment
-     *                        index).
-     * @param indexInInterleave The index of this stream in the interleave.
+     * @param interleaves The interleaves that this segment is to be interleaved into. There's more than one if the
+     *                    stream is shared between qualities.
+     * @param interleaveIndices The indices of the interleaves (not the interleave segments, which are the same as the
+     *                          segment index).
+     * @param indexInInterleave The index of this stream in the interleaves.
      * @param path The path of the file to write the received data to.
      */
     explicit SegmentResource(IOContext &ioc, Log::Log &log, const Config::Dash &config, DashResources &resources,
                              unsigned int streamIndex, unsigned int segmentIndex,
-                             std::shared_ptr<InterleaveResource> interleave,
-                             unsigned int interleaveIndex, unsigned int indexInInterleave, std::filesystem::path path);
+                             std::vector<std::shared_ptr<InterleaveResource>> interleaves,
+                             const std::vector<unsigned int> &interleaveIndices, unsigned int indexInInterleave,
+                             std::filesystem::path path);
 
     size_t getMaxPutRequestLength() const noexcept override;
+    bool getAllowConcurrentGet() const noexcept override;
 
 private:
     /**
@@ -81,19 +86,29 @@ private:
     const unsigned int segmentIndex;
 
     /**
-     * The interleave this segment gets interleaved into.
+     * The interleaves this segment gets interleaved into.
      */
-    std::shared_ptr<InterleaveResource> interleave;
+    std::vector<std::shared_ptr<InterleaveResource>> interleaves;
 
     /**
-     * The index of this segment's stream in the interleave.
+     * The index of this segment's stream in the interleaves.
      */
     const unsigned int indexInInterleave;
 
+    /**
+     * Protects data from GET requests being handled in other threads.
+     *
+     * The data is only modified by the PUT request, which is always handled in the main IO context, so it doesn't need
+     * to take this to read it.
+     */
+    std::mutex mutex;
+
     /**
      * The data we've received for this segment.
+     *
+     * This is shared with the request it was received from and with the interleave, rather than copied.
      */
-    std::vector<std::vector<std::byte>> data;
+    std::vector<Util::SharedBuffer> data;
 
     /**
      * The file to write the segment to as it's received.
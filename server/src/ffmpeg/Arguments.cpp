@@ -4,7 +4,9 @@
 #include "util/debug.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <span>
 
 using namespace std::string_literals;
@@ -198,50 +200,117 @@ std::string getTimestampFilter(unsigned int width)
     return buffer;
 }
 
+/**
+ * Determine whether a frame rate is at least another one.
+ */
+bool isAtLeast(const Config::FrameRate &a, const Config::FrameRate &b)
+{
+    return (uint64_t)a.numerator * b.denominator >= (uint64_t)b.numerator * a.denominator;
+}
+
+/**
+ * Work out which quality each quality is to be scaled from.
+ *
+ * @param cascade Whether to scale each quality from the next larger one it can be, rather than from the source.
+ * @return For each quality, the index of the quality it's scaled from, or nothing if it's scaled from the source.
+ */
+std::vector<std::optional<size_t>> getScaleInputs(std::span<const Config::Quality> qualities, bool cascade)
+{
+    std::vector<std::optional<size_t>> result(qualities.size());
+    if (!cascade) {
+        return result;
+    }
+    for (size_t i = 0; i < qualities.size(); i++) {
+        const Config::VideoQuality &q = qualities[i].video;
+        uint64_t area = (uint64_t)*q.width * *q.height;
+
+        // The smallest quality that's larger than this one, and whose frames include all of this one's. Qualities of
+        // the same size are ordered by their index, so they don't scale from each other.
+        std::optional<uint64_t> inputArea;
+        for (size_t j = 0; j < qualities.size(); j++) {
+            const Config::VideoQuality &candidate = qualities[j].video;
+            uint64_t candidateArea = (uint64_t)*candidate.width * *candidate.height;
+            bool isLarger = candidateArea > area || (candidateArea == area && j < i);
+            if (isLarger && *candidate.width >= *q.width && *candidate.height >= *q.height &&
+                isAtLeast(candidate.frameRate, q.frameRate) && (!inputArea || candidateArea < *inputArea)) {
+                result[i] = j;
+                inputArea = candidateArea;
+            }
+        }
+    }
+    return result;
+}
+
 /**
  * Create the video filter string.
  *
  * This assumes a single video input stream.
  * The output streams are v0, v1, v2, ..., one for each quality.
+ *
+ * @param cascade Whether to scale each quality from the next larger one, rather than all of them from the source.
  */
-std::string getLiveVideoFilter(const Config::Channel &config)
+std::string getLiveVideoFilter(const Config::Channel &config, bool cascade)
 {
-    /* Add the ZMQ interface. */
-    // The ZMQ interface is a filter that needs to be sandwiched between a source and sink of some kind. Rather than
-    // inserting it arbitrarily somewhere, just create a separate null source and sink for it.
-    std::string result = "nullsrc,zmq=bind_address='" + escapeFilterArgument(config.ffmpeg.filterZmq) + "',nullsink; ";
+    std::vector<std::optional<size_t>> inputs = getScaleInputs(config.qualities, cascade);
 
     /* Blankable input. */
-    result += "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; ";
+    std::string result = "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; ";
 
-    /* Split the input. */
-    result += "[vsrc]split=" + std::to_string(config.qualities.size());
+    /* Split the input between the qualities that are scaled from it. */
+    result += "[vsrc]split=" + std::to_string(std::count(inputs.begin(), inputs.end(), std::nullopt));
     for (size_t i = 0; i < config.qualities.size(); i++) {
-        result += "[vin" + std::to_string(i) + "]";
+        if (!inputs[i]) {
+            result += "[vin" + std::to_string(i) + "]";
+        }
     }
     result += "; "; // Next filter.
 
-    /* Filter each stream. */
-    for (size_t i = 0; i < config.qualities.size(); i++) {
+    /* Filter each stream, largest first when cascading, so each comes after the one it's scaled from. */
+    std::vector<size_t> order(config.qualities.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    if (cascade) {
+        std::stable_sort(order.begin(), order.end(), [&config](size_t a, size_t b) {
+            const Config::VideoQuality &qa = config.qualities[a].video;
+            const Config::VideoQuality &qb = config.qualities[b].video;
+            return (uint64_t)*qa.width * *qa.height > (uint64_t)*qb.width * *qb.height;
+        });
+    }
+    for (size_t i: order) {
         const Config::Quality &q = config.qualities[i];
         result +=
             // Input
             "[vin" + std::to_string(i) + "]"
 
-            // Set frame rate by dropping (or, in theory, duplicating) frames.
+            // Set frame rate by dropping (or, in theory, duplicating) frames. This is done first, so that frames that
+            // are dropped aren't scaled.
             "fps=" + std::to_string(q.video.frameRate.numerator) + "/" +
                      std::to_string(q.video.frameRate.denominator) + ","
 
             // Resample the frames to a set resolution.
             "scale=" + std::to_string(*q.video.width) + "x" + std::to_string(*q.video.height);
 
-        // Impose the timestamp.
-        if (config.source.timestamp) {
+        // Impose the timestamp. Qualities that are scaled from another quality already have it.
+        if (config.source.timestamp && !inputs[i]) {
             result += getTimestampFilter(*q.video.width);
         }
 
-        // Output name.
-        result += "[v" + std::to_string(i) + "]";
+        // Output name, split between the output and the qualities that are scaled from this one.
+        size_t numScaledFromThis = std::count(inputs.begin(), inputs.end(), i);
+        if (numScaledFromThis == 0) {
+            result += "[v" + std::to_string(i) + "]";
+        }
+        else {
+            result += "[vs" + std::to_string(i) + "]; "
+                      "[vs" + std::to_string(i) + "]split=" + std::to_string(numScaledFromThis + 1) +
+                      "[v" + std::to_string(i) + "]";
+            for (size_t j = 0; j < inputs.size(); j++) {
+                if (inputs[j] == i) {
+                    result += "[vin" + std::to_string(j) + "]";
+                }
+            }
+        }
 
         // Next filter.
         result += "; ";
@@ -256,7 +325,7 @@ std::string getLiveVideoFilter(const Config::Channel &config)
  *
  * This assumes a single audio input stream.
  * The output streams are identical and are named a0, a1, a2, ...,
- * one for each quality.
+ * one for each quality. If the qualities share their audio, there's just a0.
  *
  * It is invalid to use this if the media source has no audio.
  */
@@ -264,7 +333,10 @@ std::string getLiveAudioFilter(const Config::Channel &config)
 {
     std::string result;
 
-    /* Blankable input. */
+    /* Blankable input. If the qualities share their audio, there's nothing to split. */
+    if (config.sharesAudio()) {
+        return "[0:a]volume@ablank=volume=0.0:enable=0[a0]; ";
+    }
     result += "[0:a]volume@ablank=volume=0.0:enable=0[asrc]; ";
 
     /* Split the input. */
@@ -283,7 +355,14 @@ std::string getLiveAudioFilter(const Config::Channel &config)
  */
 std::vector<std::string> getLiveFilterArgs(const Config::Channel &config)
 {
-    std::string filter = getLiveVideoFilter(config);
+    /* Add the ZMQ interface. */
+    // The ZMQ interface is a filter that needs to be sandwiched between a source and sink of some kind. Rather than
+    // inserting it arbitrarily somewhere, just create a separate null source and sink for it.
+    std::string filter = "nullsrc,zmq=bind_address='" + escapeFilterArgument(config.ffmpeg.filterZmq) + "',nullsink; ";
+
+    /* The video filter. */
+    filter += getLiveVideoFilter(config, config.ffmpeg.cascadeScaling);
+
     /* Only add the audio filter if any of the configured qualities have audio,
      * which we expect to only happen when the media source has audio as well. */
     if (std::any_of(
@@ -299,8 +378,9 @@ std::vector<std::string> getLiveFilterArgs(const Config::Channel &config)
 /**
  * Get the arguments to build the map from filtered input to streams to encode.
  */
-std::vector<std::string> getLiveMapArgs(std::span<const Config::Quality> qualities)
+std::vector<std::string> getLiveMapArgs(const Config::Channel &config)
 {
+    std::span<const Config::Quality> qualities = config.qualities;
     std::vector<std::string> result;
 
     /* Video streams. */
@@ -308,6 +388,11 @@ std::vector<std::string> getLiveMapArgs(std::span<const Config::Quality> qualiti
         result.insert(result.end(), { "-map", "[v" + std::to_string(i) + "]" });
     }
 
+    /* Audio streams, of which there's only one if it's shared. */
+    if (config.sharesAudio()) {
+        result.insert(result.end(), { "-map", "[a0]" });
+        return result;
+    }
     for (size_t i = 0; i < qualities.size(); i++) {
         // Don't try to map audio if the quality does not have it
         if (!qualities[i].audio) {
@@ -373,11 +458,18 @@ std::string getFfmpegCodecName(Codec::AudioCodec codec)
 /**
  * Arguments that apply to all video streams, with per stream parameters.
  *
+ * @param gridKeyFrames Whether to force the key frames at multiples of the key frame interval in the timestamps, rather
+ *                      than by counting the key frames forced so far. Counting only works for an encoder that starts
+ *                      at the start of the stream: one that starts part way through would make every frame a key frame
+ *                      until its count caught up.
  * @return A vector of stream-type specific arguments. The first element of the inner vector should have a stream specifier
  *         appended.
  */
-std::vector<std::vector<std::string>> getLiveVideoStreamArgs(const Config::VideoQuality &q, const Config::Dash &dash)
+std::vector<std::vector<std::string>> getLiveVideoStreamArgs(const Config::VideoQuality &q, const Config::Dash &dash,
+                                                             bool gridKeyFrames = false)
 {
+    std::string segmentDuration = std::to_string(dash.segmentDuration);
+    std::string gopsPerSegment = std::to_string(q.gopsPerSegment * 1000);
     return {
         { "-c", getFfmpegCodecName(q.codec) }, // Codec.
         { "-crf", std::to_string(q.crf) }, // Constant rate factor.
@@ -388,8 +480,10 @@ std::vector<std::vector<std::string>> getLiveVideoStreamArgs(const Config::Video
 
         // Force IDR I-frames at segment boundaries.
         { "-forced-idr", "1" },
-        { "-force_key_frames", "expr:gte(t, n_forced * " + std::to_string(dash.segmentDuration) + " / " +
-                                                           std::to_string(q.gopsPerSegment * 1000) + ")" }
+        { "-force_key_frames", gridKeyFrames ?
+            "expr:if(isnan(prev_forced_t), 1, gte(t, (floor(prev_forced_t * " + gopsPerSegment + " / " +
+            segmentDuration + ") + 1) * " + segmentDuration + " / " + gopsPerSegment + "))" :
+            "expr:gte(t, n_forced * " + segmentDuration + " / " + gopsPerSegment + ")" }
     };
 }
 
@@ -500,7 +594,7 @@ std::vector<std::string> getLiveEncoderArgs(const Config::Channel &channel)
         append(result, getLiveVideoStreamArgsForCodec(channel.qualities[i].video), suffix);
     }
 
-    /* Per stream arguments for video. */
+    /* Per stream arguments for audio. A shared audio stream is encoded with the settings that every quality has. */
     {
         size_t audioStreamIndex = 0;
         for (const Config::Quality &q: channel.qualities) {
@@ -509,6 +603,9 @@ std::vector<std::string> getLiveEncoderArgs(const Config::Channel &channel)
             }
             std::string suffix = ":a:" + std::to_string(audioStreamIndex++);
             append(result, getLiveAudioStreamArgs(q.audio), suffix);
+            if (channel.sharesAudio()) {
+                break;
+            }
         }
     }
 
@@ -578,6 +675,45 @@ std::string formatDecimalFixedPoint(unsigned int n, unsigned int dp)
     return result + fractional;
 }
 
+/**
+ * Format a timestamp as an ffmpeg expression for its value in seconds.
+ */
+std::string formatTimestamp(Ffmpeg::Timestamp timestamp)
+{
+    auto [numerator, denominator] = timestamp.getTimeBase();
+    return std::to_string(timestamp.getValue()) + " * " + std::to_string(numerator) + " / " +
+           std::to_string(denominator);
+}
+
+/**
+ * Divide, rounding towards positive infinity.
+ *
+ * @param d The divisor, which must be positive.
+ */
+int64_t divideRoundingUp(int64_t n, int64_t d)
+{
+    assert(d > 0);
+    return n / d + (n % d > 0 ? 1 : 0);
+}
+
+/**
+ * Get where a segment of a quality's audio starts, when it's encoded with the arguments from liveEncode.
+ *
+ * Every audio frame is a key frame, so the DASH muxer starts segment n at the first one that's at least n - 1 segment
+ * durations after the first timestamp. The video's first timestamp stands for the audio's.
+ *
+ * @param streamStart The first timestamp of the stream.
+ * @param segmentIndex The index of the segment, counting from 1 at the start of the stream.
+ */
+Ffmpeg::Timestamp getAudioSegmentStart(const Config::Dash &dashConfig, Ffmpeg::Timestamp streamStart,
+                                       unsigned int segmentIndex)
+{
+    assert(segmentIndex > 0);
+    auto [numerator, denominator] = streamStart.getTimeBase();
+    int64_t segmentsDuration = (int64_t)(segmentIndex - 1) * dashConfig.segmentDuration;
+    return { streamStart.getValue() * numerator * 1000 + segmentsDuration * denominator, 1, denominator * 1000 };
+}
+
 /**
  * Get the arguments to make ffmpeg write information about encoded frames to stdout.
  */
@@ -589,11 +725,36 @@ std::vector<std::string> getLiveStreamMuxInfoStdoutArgs()
     };
 }
 
+/**
+ * Get the index that DashResources gives to the audio stream of a quality.
+ *
+ * The video streams come first, and then the audio streams of the qualities that have audio.
+ */
+size_t getAudioStreamIndex(std::span<const Config::Quality> qualities, size_t qualityIndex)
+{
+    assert(qualities[qualityIndex].audio);
+    return qualities.size() + std::count_if(qualities.begin(), qualities.begin() + (ptrdiff_t)qualityIndex,
+                                            [](const Config::Quality &q) { return (bool)q.audio; });
+}
+
+/**
+ * Get the URL of a resource in the server.
+ */
+std::string getLocalUrl(const Config::Network &networkConfig, std::string_view path)
+{
+    return "http://localhost:" + std::to_string(networkConfig.port) + "/" + std::string(path);
+}
+
 /**
  * Arguments that apply to DASH outputs.
+ *
+ * @param dashConfig The channel's DASH configuration.
+ * @param adaptationSets The value for -adaptation_sets.
+ * @param segmentNameArgs Arguments that set the names of the segments.
+ * @param url The URL of the manifest.
  */
-std::vector<std::string> getDashOutputArgs(const Config::Channel &channelConfig, const Config::Network &networkConfig,
-                                           std::string_view uidPath)
+std::vector<std::string> getDashOutputArgs(const Config::Dash &dashConfig, const std::string &adaptationSets,
+                                           const std::vector<std::string> &segmentNameArgs, const std::string &url)
 {
     std::vector<std::string> result = getRealtimeOutputArgs();
     result.insert(result.end(), {
@@ -601,7 +762,7 @@ std::vector<std::string> getDashOutputArgs(const Config::Channel &channelConfig,
         "-f", "dash",
 
         // Stream selection.
-        "-adaptation_sets", "id=0,streams=v"s + (hasAudio(channelConfig.qualities) ? " id=1,streams=a" : ""),
+        "-adaptation_sets", adaptationSets,
 
         // Emit the type of DASH manifest that allows seeking to the in-progress live-edge segment without confusion.
         "-use_timeline", "0",
@@ -609,9 +770,11 @@ std::vector<std::string> getDashOutputArgs(const Config::Channel &channelConfig,
 
         // DASH segment configuration.
         "-dash_segment_type", "mp4",
-        "-single_file", "0",
-        "-media_seg_name", "chunk-stream$RepresentationID$-$Number%09d$.$ext$",
-        "-seg_duration", formatDecimalFixedPoint(channelConfig.dash.segmentDuration, 3),
+        "-single_file", "0"
+    });
+    append(result, segmentNameArgs);
+    result.insert(result.end(), {
+        "-seg_duration", formatDecimalFixedPoint(dashConfig.segmentDuration, 3),
         "-format_options", "movflags=cmaf",
         "-frag_type", "every_frame",
 
@@ -628,17 +791,90 @@ std::vector<std::string> getDashOutputArgs(const Config::Channel &channelConfig,
         "-streaming", "1",
         "-index_correction", "0",
 
-        // Upload via HTTP PUT.
+        // Upload via HTTP PUT. Each output keeps its connection open between uploads, so a segment doesn't need a new
+        // connection (and connection coroutine) on the server.
         "-tcp_nodelay", "1", // I'm not sure if this does anything for HTTP/DASH.
         "-method", "PUT",
+        "-http_persistent", "1",
         "-remove_at_exit", "1",
 
         // The actual manifest output.
-        "http://localhost:" + std::to_string(networkConfig.port) + "/" + std::string(uidPath) + "/manifest.mpd"
+        url
     });
     return result;
 }
 
+/**
+ * Arguments that apply to the DASH output of a process that encodes all the streams.
+ */
+std::vector<std::string> getDashOutputArgs(const Config::Channel &channelConfig, const Config::Network &networkConfig,
+                                           std::string_view uidPath)
+{
+    return getDashOutputArgs(channelConfig.dash,
+                             "id=0,streams=v"s + (hasAudio(channelConfig.qualities) ? " id=1,streams=a" : ""),
+                             { "-media_seg_name", "chunk-stream$RepresentationID$-$Number%09d$.$ext$" },
+                             getLocalUrl(networkConfig, std::string(uidPath) + "/manifest.mpd"));
+}
+
+/**
+ * Arguments that apply to the DASH output of a single stream.
+ *
+ * ffmpeg names a DASH output's streams by their index in that output, so the stream's index among all the channel's
+ * streams is put into the names explicitly. Each stream has its own manifest.
+ *
+ * @param streamIndex The index of the stream, as DashResources numbers them.
+ * @param type The stream type, either "v" or "a".
+ */
+std::vector<std::string> getSingleStreamDashOutputArgs(const Config::Channel &channelConfig,
+                                                       const Config::Network &networkConfig, std::string_view uidPath,
+                                                       size_t streamIndex, const std::string &type)
+{
+    std::string stream = std::to_string(streamIndex);
+    return getDashOutputArgs(channelConfig.dash, "id=0,streams=" + type, {
+        "-init_seg_name", "init-stream" + stream + ".$ext$",
+        "-media_seg_name", "chunk-stream" + stream + "-$Number%09d$.$ext$"
+    }, getLocalUrl(networkConfig, std::string(uidPath) + "/manifest-stream" + stream + ".mpd"));
+}
+
+/**
+ * Arguments for the outputs of the decoder when each quality is encoded separately.
+ *
+ * Each quality's filtered frames go, uncompressed, to their own stream in the server, for their encoder to read.
+ */
+std::vector<std::string> getLiveDecodedOutputArgs(std::span<const Config::Quality> qualities,
+                                                  const Config::Network &networkConfig, std::string_view decodePath)
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < qualities.size(); i++) {
+        // Stream selection.
+        result.insert(result.end(), { "-map", "[v" + std::to_string(i) + "]" });
+        if (qualities[i].audio) {
+            result.insert(result.end(), { "-map", "[a" + std::to_string(i) + "]" });
+        }
+
+        // Raw frames and samples.
+        append(result, getLiveVideoStreamArgs(), ":v");
+        result.insert(result.end(), {
+            "-c:v", "rawvideo",
+            "-c:a", "pcm_s16le"
+        });
+
+        // Output. The timestamps of the first quality's frames stand for the whole stream's, since they come from here
+        // whether or not its encoder is running.
+        append(result, getRealtimeOutputArgs());
+        if (i == 0) {
+            append(result, getLiveStreamMuxInfoStdoutArgs());
+        }
+        result.insert(result.end(), {
+            "-f", "nut",
+            "-tcp_nodelay", "1",
+            "-method", "PUT",
+            getLocalUrl(networkConfig, std::string(decodePath) + "/" + std::to_string(i))
+        });
+    }
+    return result;
+}
+
 } // namespace
 
 Ffmpeg::Arguments::~Arguments() = default;
@@ -649,6 +885,44 @@ std::string Ffmpeg::Arguments::decodeUrl(std::string_view url, std::string_view
            "http://" + std::string(url.substr(14)) + "/" + std::string(part) : std::string(url);
 }
 
+bool Ffmpeg::Arguments::getIsExclusiveSource(std::string_view url, const std::vector<std::string> &arguments)
+{
+    /* Separated ingest streams are sent to the server by a single ingest process. */
+    if (url.starts_with("ingest_http://")) {
+        return true;
+    }
+
+    /* Capture devices generally can't be opened twice. */
+    static constexpr std::string_view deviceFormats[] = {
+        "alsa", "avfoundation", "decklink", "dshow", "fbdev", "gdigrab", "jack", "kmsgrab", "openal", "oss", "pulse",
+        "sndio", "v4l2", "vfwcap", "video4linux2", "x11grab"
+    };
+    if (url.starts_with("/dev/")) {
+        return true;
+    }
+    for (size_t i = 0; i + 1 < arguments.size(); i++) {
+        if (arguments[i] == "-f" && std::ranges::find(deviceFormats, arguments[i + 1]) != std::end(deviceFormats)) {
+            return true;
+        }
+    }
+
+    /* Only one process can listen on the same address. This is either an argument, or an option in the URL's query
+       (e.g: rtmp://...?listen or srt://...?mode=listener). */
+    if (std::ranges::find(arguments, "-listen") != arguments.end()) {
+        return true;
+    }
+    size_t query = url.find('?');
+    while (query != std::string_view::npos) {
+        size_t end = url.find('&', query + 1);
+        std::string_view option = url.substr(query + 1, (end == std::string_view::npos) ? end : end - query - 1);
+        if (option == "listen" || option.starts_with("listen=") || option == "mode=listener") {
+            return option != "listen=0";
+        }
+        query = end;
+    }
+    return false;
+}
+
 Ffmpeg::Arguments Ffmpeg::Arguments::liveStream(const Config::Channel &channelConfig,
                                                 const Config::Network &networkConfig, std::string_view uidPath)
 {
@@ -662,7 +936,7 @@ Ffmpeg::Arguments Ffmpeg::Arguments::liveStream(const Config::Channel &channelCo
     append(result.ffmpegArguments, getInputArgs(channelConfig.source.url, channelConfig.source.arguments,
                                                 channelConfig.source.loop));
     append(result.ffmpegArguments, getLiveFilterArgs(channelConfig));
-    append(result.ffmpegArguments, getLiveMapArgs(channelConfig.qualities));
+    append(result.ffmpegArguments, getLiveMapArgs(channelConfig));
     append(result.ffmpegArguments, getLiveEncoderArgs(channelConfig));
     append(result.ffmpegArguments, getLiveStreamMuxInfoStdoutArgs());
     append(result.ffmpegArguments, getDashOutputArgs(channelConfig, networkConfig, uidPath));
@@ -670,6 +944,153 @@ Ffmpeg::Arguments Ffmpeg::Arguments::liveStream(const Config::Channel &channelCo
     return result;
 }
 
+Ffmpeg::Arguments Ffmpeg::Arguments::liveDecode(const Config::Channel &channelConfig,
+                                                const Config::Network &networkConfig, std::string_view decodePath)
+{
+    Ffmpeg::Arguments result;
+
+    result.sourceUrl = channelConfig.source.url;
+    result.sourceArguments = channelConfig.source.arguments;
+    result.cacheProbe = true;
+
+    append(result.ffmpegArguments, getGlobalArgs());
+    append(result.ffmpegArguments, getInputArgs(channelConfig.source.url, channelConfig.source.arguments,
+                                                channelConfig.source.loop));
+    append(result.ffmpegArguments, getLiveFilterArgs(channelConfig));
+    append(result.ffmpegArguments, getLiveDecodedOutputArgs(channelConfig.qualities, networkConfig, decodePath));
+
+    return result;
+}
+
+Ffmpeg::Arguments Ffmpeg::Arguments::liveEncode(const Config::Channel &channelConfig,
+                                                const Config::Network &networkConfig, std::string_view decodePath,
+                                                std::string_view uidPath, size_t qualityIndex,
+                                                Timestamp streamStart, unsigned int segmentIndex)
+{
+    Ffmpeg::Arguments result;
+    const Config::Quality &q = channelConfig.qualities[qualityIndex];
+
+    result.sourceUrl = getLocalUrl(networkConfig, std::string(decodePath) + "/" + std::to_string(qualityIndex));
+
+    append(result.ffmpegArguments, getGlobalArgs());
+    append(result.ffmpegArguments, getInputArgs(result.sourceUrl, { "-f", "nut" }, false));
+
+    /* The video output. */
+    result.ffmpegArguments.insert(result.ffmpegArguments.end(), { "-map", "0:v" });
+    if (streamStart) {
+        // Start at the key frame that the other encoders start the segment at.
+        result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+            "-filter:v:0", "select='gte(t, " + formatTimestamp(getVideoSegmentStart(channelConfig.dash, q.video,
+                                                                                    streamStart, segmentIndex)) + ")'"
+        });
+    }
+    append(result.ffmpegArguments, getLiveVideoStreamArgs(), ":v");
+    append(result.ffmpegArguments, getLiveVideoStreamArgs(q.video, channelConfig.dash, true), ":v:0");
+    append(result.ffmpegArguments, getLiveVideoStreamArgsForCodec(q.video), ":v:0");
+    append(result.ffmpegArguments, getSingleStreamDashOutputArgs(channelConfig, networkConfig, uidPath,
+                                                                 qualityIndex, "v"));
+
+    /* The audio output. */
+    if (q.audio) {
+        result.ffmpegArguments.insert(result.ffmpegArguments.end(), { "-map", "0:a" });
+        if (streamStart) {
+            result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+                "-filter:a:0", "aselect='gte(t, " + formatTimestamp(getAudioSegmentStart(channelConfig.dash,
+                                                                                         streamStart, segmentIndex)) +
+                               ")'"
+            });
+        }
+        append(result.ffmpegArguments, getLiveAudioStreamArgs(), ":a");
+        append(result.ffmpegArguments, getLiveAudioStreamArgs(q.audio), ":a:0");
+        append(result.ffmpegArguments, getSingleStreamDashOutputArgs(
+            channelConfig, networkConfig, uidPath, getAudioStreamIndex(channelConfig.qualities, qualityIndex), "a"));
+    }
+
+    return result;
+}
+
+Ffmpeg::Timestamp Ffmpeg::Arguments::getVideoSegmentStart(const Config::Dash &dashConfig,
+                                                           const Config::VideoQuality &videoConfig,
+                                                           Timestamp streamStart, unsigned int segmentIndex)
+{
+    assert(segmentIndex > 0);
+    if (segmentIndex == 1) {
+        return streamStart;
+    }
+
+    /* Find the first point on the key frame grid that's at or after the first timestamp. The grid has gopsPerSegment
+       points per segment duration, like the -force_key_frames expression. */
+    auto [numerator, denominator] = streamStart.getTimeBase();
+    int64_t gridDenominator = (int64_t)videoConfig.gopsPerSegment * 1000;
+    int64_t firstGridIndex = divideRoundingUp(streamStart.getValue() * numerator * gridDenominator,
+                                              denominator * dashConfig.segmentDuration);
+
+    /* The segment starts a whole number of segment durations after that. */
+    int64_t gridIndex = firstGridIndex + (int64_t)(segmentIndex - 1) * videoConfig.gopsPerSegment;
+    return { gridIndex * dashConfig.segmentDuration, 1, gridDenominator };
+}
+
+Ffmpeg::Arguments Ffmpeg::Arguments::benchmarkFilter(const Config::Channel &channelConfig, bool cascade)
+{
+    Ffmpeg::Arguments result;
+
+    result.sourceUrl = channelConfig.source.url;
+    result.sourceArguments = channelConfig.source.arguments;
+
+    append(result.ffmpegArguments, getGlobalArgs());
+    result.ffmpegArguments.emplace_back("-benchmark"); // Report the CPU time used when done.
+    append(result.ffmpegArguments, getInputArgs(channelConfig.source.url, channelConfig.source.arguments,
+                                                channelConfig.source.loop));
+    result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+        "-filter_complex", getLiveVideoFilter(channelConfig, cascade)
+    });
+
+    /* Throw the filtered frames away, so only the decoding and filtering is measured. */
+    for (size_t i = 0; i < channelConfig.qualities.size(); i++) {
+        result.ffmpegArguments.insert(result.ffmpegArguments.end(), { "-map", "[v" + std::to_string(i) + "]" });
+    }
+    result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+        "-t", std::to_string(channelConfig.ffmpeg.benchmark),
+        "-f", "null",
+        "-"
+    });
+
+    return result;
+}
+
+Ffmpeg::Arguments Ffmpeg::Arguments::calibrate(unsigned int width, unsigned int height, unsigned int frames,
+                                               std::optional<Codec::VideoCodec> codec, Config::H26xPreset preset)
+{
+    Ffmpeg::Arguments result;
+
+    result.sourceUrl = "testsrc2=size=" + std::to_string(width) + "x" + std::to_string(height) + ":rate=25";
+
+    append(result.ffmpegArguments, getGlobalArgs());
+    result.ffmpegArguments.emplace_back("-benchmark"); // Report the CPU time used when done.
+    result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+        "-f", "lavfi",
+        "-i", result.sourceUrl,
+        "-frames:v", std::to_string(frames)
+    });
+    append(result.ffmpegArguments, getLiveVideoStreamArgs(), ":v");
+
+    /* The encoder, configured as it is for the live streams apart from the rate control, which depends on the
+       quality. */
+    if (codec) {
+        result.ffmpegArguments.insert(result.ffmpegArguments.end(), {
+            "-c:v", getFfmpegCodecName(*codec),
+            "-crf:v", "25",
+            "-preset:v", h26xPresetToString(preset),
+            "-tune:v", "zerolatency"
+        });
+    }
+
+    /* Throw the encoded frames away. */
+    result.ffmpegArguments.insert(result.ffmpegArguments.end(), { "-f", "null", "-" });
+
+    return result;
+}
+
 Ffmpeg::Arguments Ffmpeg::Arguments::ingest(const Config::SeparatedIngestSource &ingestConfig,
                                             const Config::Network &networkConfig, std::string_view name)
 {
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "media/codec.hpp"
+#include "Timestamp.hpp"
+
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -8,8 +12,11 @@ namespace Config
 {
 
 struct Channel;
+struct Dash;
 struct Network;
 struct SeparatedIngestSource;
+struct VideoQuality;
+enum class H26xPreset;
 
 } // namespace Config
 
@@ -35,6 +42,18 @@ public:
      */
     static std::string decodeUrl(std::string_view url, std::string_view part);
 
+    /**
+     * Determine whether a source can only be read by one process at a time.
+     *
+     * Such sources can't be probed or benchmarked while a channel is reading them, and a channel that reads one can't
+     * run alongside its replacement. They include separated ingest (ingest_http://) streams, capture devices, and
+     * sources that ffmpeg listens for a connection from.
+     *
+     * @param url The source's URL.
+     * @param arguments The ffmpeg arguments for the source.
+     */
+    static bool getIsExclusiveSource(std::string_view url, const std::vector<std::string> &arguments);
+
     /**
      * Generate the arguments for starting a live stream with ffmpeg.
      *
@@ -45,6 +64,81 @@ public:
     static Arguments liveStream(const Config::Channel &channelConfig, const Config::Network &networkConfig,
                                 std::string_view uidPath);
 
+    /**
+     * Generate the arguments for decoding and filtering a live stream, for when each quality is encoded separately.
+     *
+     * The uncompressed frames of each quality are PUT to the server at decodePath/N, where N is the index of the
+     * quality. This process reports the stream's timestamps, since an encoder isn't necessarily always running.
+     *
+     * @param channelConfig The configuration object for the specific channel.
+     * @param networkConfig The channel configuration object for the network.
+     * @param decodePath The base path in the server for the decoded streams.
+     */
+    static Arguments liveDecode(const Config::Channel &channelConfig, const Config::Network &networkConfig,
+                                std::string_view decodePath);
+
+    /**
+     * Generate the arguments for encoding a single quality of a live stream from the output of liveDecode.
+     *
+     * Each stream has its own DASH output, with the same segment names as liveStream gives them. The key frames are
+     * placed by their timestamps, so an encoder that starts part way through the stream puts them in the same places as
+     * one that started at the start.
+     *
+     * @param channelConfig The configuration object for the specific channel.
+     * @param networkConfig The channel configuration object for the network.
+     * @param decodePath The base path in the server for the decoded streams.
+     * @param uidPath The base path for the DASH streams.
+     * @param qualityIndex The index of the quality to encode.
+     * @param streamStart The first timestamp of the stream, if the encoder is starting part way through it. The DASH
+     *                    muxer measures the segments from the first timestamp it's given, so the encoder then drops
+     *                    what comes before the start of segment segmentIndex, for its segments to line up with those
+     *                    of an encoder that started at the start.
+     * @param segmentIndex The index, counting from the start of the stream, of the segment to start at.
+     */
+    static Arguments liveEncode(const Config::Channel &channelConfig, const Config::Network &networkConfig,
+                                std::string_view decodePath, std::string_view uidPath, size_t qualityIndex,
+                                Timestamp streamStart = {}, unsigned int segmentIndex = 1);
+
+    /**
+     * Get where a segment of a quality's video starts, when it's encoded with the arguments from liveEncode.
+     *
+     * The DASH muxer starts segment n at the first key frame that's at least n - 1 segment durations after the first
+     * timestamp, and the key frames are forced on a grid in the timestamps.
+     *
+     * @param streamStart The first timestamp of the stream.
+     * @param segmentIndex The index of the segment, counting from 1 at the start of the stream.
+     * @return The timestamp of the segment's first frame, or, after the first segment, the point on the key frame grid
+     *         that the first frame is the first at or after.
+     */
+    static Timestamp getVideoSegmentStart(const Config::Dash &dashConfig, const Config::VideoQuality &videoConfig,
+                                          Timestamp streamStart, unsigned int segmentIndex);
+
+    /**
+     * Generate the arguments for measuring the CPU time it takes to decode and filter a channel's video.
+     *
+     * This reads channelConfig.ffmpeg.benchmark seconds of the source, and throws the filtered frames away. ffmpeg
+     * reports the time it took at the end.
+     *
+     * @param channelConfig The configuration object for the specific channel.
+     * @param cascade Whether to scale the qualities in a cascade, rather than each from the source.
+     */
+    static Arguments benchmarkFilter(const Config::Channel &channelConfig, bool cascade);
+
+    /**
+     * Generate the arguments for measuring the CPU time it takes to encode synthetic video with an encoder.
+     *
+     * The video is generated by ffmpeg itself, so no media is needed. ffmpeg reports the time it took at the end.
+     *
+     * @param width The width of the video.
+     * @param height The height of the video.
+     * @param frames The number of frames to encode.
+     * @param codec The codec to encode with, or nothing to measure just generating the video, so that can be
+     *              subtracted.
+     * @param preset The H.264/H.265 preset to use.
+     */
+    static Arguments calibrate(unsigned int width, unsigned int height, unsigned int frames,
+                               std::optional<Codec::VideoCodec> codec, Config::H26xPreset preset);
+
     /**
      * Generate arguments for separated ingest using ffmpeg.
      *
@@ -95,7 +95,7 @@ void handleFfmpegStdoutLine(Ffmpeg::Timestamp &pts, std::string_view line)
 } // namespace
 
 Ffmpeg::Process::Process(IOContext &ioc, Log::Log &log, Arguments arguments, bool earlyTerminateFatal) :
-    log(log("ffmpeg")), subprocess(ioc, "ffmpeg", arguments.getFfmpegArguments(), false), event(ioc),
+    log(log("ffmpeg")), subprocess(ioc, "ffmpeg", arguments.getFfmpegArguments(), false),
     terminateIsFatal(earlyTerminateFatal)
 {
     /* Log the arguments given to ffmpeg. */
@@ -145,6 +145,7 @@ Ffmpeg::Process::Process(IOContext &ioc, Log::Log &log, Arguments arguments, boo
                 bool isFirst = !pts;
                 handleFfmpegStdoutLine(pts, *line);
                 if (isFirst) {
+                    firstPts = pts;
                     event.notifyAll();
                 }
             }
@@ -193,3 +194,9 @@ Awaitable<Ffmpeg::Timestamp> Ffmpeg::Process::getPts() const
     /* We have a PTS. */
     co_return pts;
 }
+
+Awaitable<Ffmpeg::Timestamp> Ffmpeg::Process::getFirstPts() const
+{
+    co_await getPts();
+    co_return firstPts;
+}
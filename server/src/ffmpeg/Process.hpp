@@ -7,6 +7,8 @@
 #include "util/Event.hpp"
 #include "util/subprocess.hpp"
 
+#include <optional>
+
 /**
  * @defgroup ffmpeg FFmpeg
  *
@@ -63,6 +65,35 @@ public:
      */
     Awaitable<Timestamp> getPts() const;
 
+    /**
+     * Get the presentation timestamp of the start of the output.
+     *
+     * Like getPts, this waits until the first timestamp arrives.
+     */
+    Awaitable<Timestamp> getFirstPts() const;
+
+    /**
+     * Get the latest presentation timestamp of the output, without waiting.
+     *
+     * This is for callers that can't keep a reference to this object while suspended.
+     *
+     * @return The same as getPts, or nothing if no timestamp has arrived yet.
+     */
+    std::optional<Timestamp> tryGetPts() const
+    {
+        return pts ? std::optional(pts) : std::nullopt;
+    }
+
+    /**
+     * Get the presentation timestamp of the start of the output, without waiting.
+     *
+     * @return The same as getFirstPts, or nothing if no timestamp has arrived yet.
+     */
+    std::optional<Timestamp> tryGetFirstPts() const
+    {
+        return pts ? std::optional(firstPts) : std::nullopt;
+    }
+
 private:
     Log::Context log;
     Subprocess::Subprocess subprocess;
@@ -71,6 +102,7 @@ private:
     bool capturedProbe = false;
     bool finishedReadingStdout = false;
     bool finishedReadingStderrAndTerminated = false;
+    Timestamp firstPts;
     Timestamp pts;
 };
 
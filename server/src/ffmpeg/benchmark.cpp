@@ -0,0 +1,83 @@
+#include "benchmark.hpp"
+
+#include "Arguments.hpp"
+#include "log.hpp"
+
+#include "util/subprocess.hpp"
+#include "util/util.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+
+/**
+ * Parse a time that ffmpeg reports, like "utime=1.234s".
+ *
+ * @param field The field, including its name.
+ * @param name The expected name of the field.
+ */
+std::chrono::milliseconds parseTime(std::string_view field, std::string_view name)
+{
+    // Check the name and unit.
+    std::string_view fieldName;
+    std::string_view value;
+    Util::split(field, { fieldName, value }, '=');
+    if (fieldName != name || !value.ends_with('s')) {
+        throw std::invalid_argument("Malformed benchmark time.");
+    }
+    value.remove_suffix(1);
+
+    // ffmpeg gives the seconds to three decimal places.
+    std::string_view seconds;
+    std::string_view milliseconds;
+    Util::split(value, { seconds, milliseconds }, '.');
+    if (milliseconds.size() != 3) {
+        throw std::invalid_argument("Malformed benchmark time.");
+    }
+    return std::chrono::seconds(Util::parseInt64(seconds)) +
+           std::chrono::milliseconds(Util::parseInt64(milliseconds));
+}
+
+} // namespace
+
+std::optional<Ffmpeg::BenchmarkResult> Ffmpeg::parseBenchmarkLine(std::string_view message)
+{
+    /* The line we're after is "bench: utime=<t>s stime=<t>s rtime=<t>s". There's also "bench: maxrss=...". */
+    if (!message.starts_with("bench: utime=")) {
+        return std::nullopt;
+    }
+    message.remove_prefix(7);
+
+    /* Parse the times. */
+    std::string_view userTime;
+    std::string_view systemTime;
+    std::string_view realTime;
+    try {
+        Util::split(message, { userTime, systemTime, realTime });
+        return BenchmarkResult{
+            .userTime = parseTime(userTime, "utime"),
+            .systemTime = parseTime(systemTime, "stime"),
+            .realTime = parseTime(realTime, "rtime")
+        };
+    }
+    catch (const std::exception &) {
+        return std::nullopt;
+    }
+}
+
+Awaitable<std::optional<Ffmpeg::BenchmarkResult>> Ffmpeg::benchmark(IOContext &ioc, const Arguments &arguments)
+{
+    Subprocess::Subprocess subprocess(ioc, "ffmpeg", arguments.getFfmpegArguments(), false, false);
+
+    /* Look for the benchmark among the logging, which comes at the end. */
+    std::optional<BenchmarkResult> result;
+    while (std::optional<std::string> line = co_await subprocess.readStderrLine()) {
+        if (std::optional<BenchmarkResult> lineResult = parseBenchmarkLine(ParsedFfmpegLogLine(*line).message)) {
+            result = lineResult;
+        }
+    }
+
+    co_await subprocess.wait(false);
+    co_return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "util/asio.hpp"
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+namespace Ffmpeg
+{
+
+class Arguments;
+
+/**
+ * The resources an ffmpeg process used, as reported by its -benchmark option.
+ */
+struct BenchmarkResult final
+{
+    std::chrono::milliseconds userTime{};
+    std::chrono::milliseconds systemTime{};
+    std::chrono::milliseconds realTime{};
+};
+
+/**
+ * Parse the message of the line ffmpeg logs with the -benchmark option.
+ *
+ * @param message The message, without the log level.
+ * @return The result, or nothing if the message isn't the benchmark line.
+ */
+std::optional<BenchmarkResult> parseBenchmarkLine(std::string_view message);
+
+/**
+ * Run ffmpeg until it finishes, and get what it reports with the -benchmark option.
+ *
+ * @param arguments The arguments to give to ffmpeg, which should include -benchmark.
+ * @return The result, or nothing if ffmpeg didn't report it.
+ */
+Awaitable<std::optional<BenchmarkResult>> benchmark(IOContext &ioc, const Arguments &arguments);
+
+} // namespace Ffmpeg
@@ -0,0 +1,254 @@
+#include "calibrate.hpp"
+
+#include "Arguments.hpp"
+#include "benchmark.hpp"
+
+#include "configuration/configuration.hpp"
+#include "log/Log.hpp"
+#include "util/debug.hpp"
+#include "util/File.hpp"
+#include "util/json.hpp"
+#include "util/util.hpp"
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+/**
+ * The codecs that can be calibrated, with their names in the file.
+ */
+constexpr std::pair<Codec::VideoCodec, const char *> calibratedCodecs[] = {
+    { Codec::VideoCodec::h264, "h264" },
+    { Codec::VideoCodec::h265, "h265" }
+};
+
+/**
+ * The presets that are calibrated, with their names in the file.
+ */
+constexpr std::pair<Config::H26xPreset, const char *> calibratedPresets[] = {
+    { Config::H26xPreset::ultrafast, "ultrafast" },
+    { Config::H26xPreset::superfast, "superfast" },
+    { Config::H26xPreset::veryfast, "veryfast" },
+    { Config::H26xPreset::faster, "faster" },
+    { Config::H26xPreset::fast, "fast" },
+    { Config::H26xPreset::medium, "medium" }
+};
+
+/**
+ * The resolutions that are calibrated.
+ */
+constexpr std::pair<unsigned int, unsigned int> calibratedResolutions[] = {
+    { 640, 360 },
+    { 1280, 720 },
+    { 1920, 1080 }
+};
+
+/**
+ * The number of frames to encode for each measurement.
+ */
+constexpr unsigned int calibrationFrames = 100;
+
+/**
+ * Get the name of a codec or preset in the file.
+ */
+template <typename T, size_t N>
+const char *getName(const std::pair<T, const char *> (&names)[N], T value)
+{
+    for (const auto &[v, name]: names) {
+        if (v == value) {
+            return name;
+        }
+    }
+    unreachable();
+}
+
+/**
+ * Get a codec or preset from its name in the file.
+ *
+ * @throws std::runtime_error if the name isn't known.
+ */
+template <typename T, size_t N>
+T getValue(const std::pair<T, const char *> (&names)[N], std::string_view name)
+{
+    for (const auto &[value, n]: names) {
+        if (n == name) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Unknown name: " + std::string(name));
+}
+
+/**
+ * Load the measurements stored in the file.
+ *
+ * @return The measurements, or nothing if the file doesn't exist or isn't valid.
+ */
+std::vector<Config::EncoderThroughput> load(Log::Context &logContext, const std::filesystem::path &path)
+{
+    std::vector<Config::EncoderThroughput> result;
+    if (!std::filesystem::exists(path)) {
+        return result;
+    }
+
+    try {
+        std::vector<std::byte> data = Util::readFile(path);
+        nlohmann::json j = Json::parse({ (const char *)data.data(), data.size() });
+        for (const nlohmann::json &element: j) {
+            Config::EncoderThroughput &t = result.emplace_back();
+            Json::ObjectDeserializer d(element);
+            std::string codecName;
+            std::string presetName;
+            d(codecName, "codec", true);
+            d(presetName, "preset", true);
+            d(t.width, "width", true);
+            d(t.height, "height", true);
+            d(t.pixelsPerCpuSecond, "pixelsPerCpuSecond", true);
+            d();
+            t.codec = getValue(calibratedCodecs, codecName);
+            t.preset = getValue(calibratedPresets, presetName);
+        }
+    }
+    catch (const std::exception &e) {
+        logContext << "invalid" << Log::Level::warning << "Ignoring the calibration file, because it is invalid: " <<
+                      e.what();
+        result.clear();
+    }
+    return result;
+}
+
+/**
+ * Measure the CPU time ffmpeg takes.
+ */
+Awaitable<std::optional<std::chrono::milliseconds>> measure(IOContext &ioc, const Ffmpeg::Arguments &arguments)
+{
+    std::optional<Ffmpeg::BenchmarkResult> result = co_await Ffmpeg::benchmark(ioc, arguments);
+    if (!result) {
+        co_return std::nullopt;
+    }
+    co_return result->userTime + result->systemTime;
+}
+
+/**
+ * Measure the throughput of each of the presets of a codec.
+ *
+ * @return The measurements for every calibrated resolution.
+ * @throws std::runtime_error If any of the benchmarks fails, so that a codec is never calibrated from only some of the
+ *                            resolutions.
+ */
+Awaitable<std::vector<Config::EncoderThroughput>> calibrateCodec(IOContext &ioc, Log::Context &logContext,
+                                                                 Codec::VideoCodec codec)
+{
+    std::vector<Config::EncoderThroughput> result;
+    for (auto [width, height]: calibratedResolutions) {
+        // Measure generating the video, so that it can be subtracted.
+        std::optional<std::chrono::milliseconds> baseline = co_await measure(ioc, Ffmpeg::Arguments::calibrate(
+            width, height, calibrationFrames, std::nullopt, Config::H26xPreset::medium));
+        if (!baseline) {
+            throw std::runtime_error("ffmpeg didn't report a benchmark.");
+        }
+
+        // Measure the encoders.
+        for (auto [preset, presetName]: calibratedPresets) {
+            std::optional<std::chrono::milliseconds> cpuTime = co_await measure(ioc, Ffmpeg::Arguments::calibrate(
+                width, height, calibrationFrames, codec, preset));
+            if (!cpuTime) {
+                throw std::runtime_error("ffmpeg didn't report a benchmark.");
+            }
+            std::chrono::milliseconds encodeTime = std::max(*cpuTime - *baseline, std::chrono::milliseconds(1));
+            Config::EncoderThroughput &t = result.emplace_back(Config::EncoderThroughput{
+                .codec = codec,
+                .preset = preset,
+                .width = width,
+                .height = height,
+                .pixelsPerCpuSecond = (double)width * height * calibrationFrames * 1000 / encodeTime.count()
+            });
+            logContext << "measured" << Log::Level::info << Json::dump({
+                { "codec", getName(calibratedCodecs, codec) },
+                { "preset", presetName },
+                { "width", width },
+                { "height", height },
+                { "cpuTimeMs", encodeTime.count() },
+                { "pixelsPerCpuSecond", t.pixelsPerCpuSecond }
+            });
+        }
+    }
+    co_return result;
+}
+
+/**
+ * Check whether a codec has been measured.
+ */
+bool getIsMeasured(std::span<const Config::EncoderThroughput> measurements, Codec::VideoCodec codec)
+{
+    return std::ranges::any_of(measurements, [codec](const Config::EncoderThroughput &t) { return t.codec == codec; });
+}
+
+} // namespace
+
+const std::vector<Codec::VideoCodec> Ffmpeg::calibratableCodecs = { Codec::VideoCodec::h264, Codec::VideoCodec::h265 };
+
+Awaitable<std::vector<Config::EncoderThroughput>> Ffmpeg::calibrate(IOContext &ioc, Log::Log &log,
+                                                                    std::filesystem::path path,
+                                                                    std::vector<Codec::VideoCodec> codecs)
+{
+    Log::Context logContext = log("calibrate");
+    std::vector<Config::EncoderThroughput> result = load(logContext, path);
+
+    /* Measure the codecs that haven't been measured before. */
+    bool measured = false;
+    for (Codec::VideoCodec codec: codecs) {
+        if (std::ranges::none_of(calibratedCodecs, [codec](const auto &c) { return c.first == codec; }) ||
+            getIsMeasured(result, codec)) {
+            continue;
+        }
+        logContext << Log::Level::info << "Calibrating " << getName(calibratedCodecs, codec) << ".";
+        try {
+            // Only keep the codec's measurements if they're complete.
+            std::vector<Config::EncoderThroughput> codecResult = co_await calibrateCodec(ioc, logContext, codec);
+            result.insert(result.end(), codecResult.begin(), codecResult.end());
+            measured = true;
+        }
+        catch (const std::exception &e) {
+            logContext << "exception" << Log::Level::error << e.what();
+        }
+    }
+
+    /* Store the measurements for next time. */
+    if (measured) {
+        nlohmann::json j = nlohmann::json::array();
+        for (const Config::EncoderThroughput &t: result) {
+            j.push_back({
+                { "codec", getName(calibratedCodecs, t.codec) },
+                { "preset", getName(calibratedPresets, t.preset) },
+                { "width", t.width },
+                { "height", t.height },
+                { "pixelsPerCpuSecond", t.pixelsPerCpuSecond }
+            });
+        }
+        Util::File file(ioc, path, true, false);
+        co_await file.write(Json::dump(j, 4));
+    }
+
+    co_return result;
+}
+
+std::vector<Config::EncoderThroughput> Ffmpeg::loadCalibration(Log::Log &log, const std::filesystem::path &path,
+                                                               const std::vector<Codec::VideoCodec> &codecs)
+{
+    Log::Context logContext = log("calibrate");
+    std::vector<Config::EncoderThroughput> result = load(logContext, path);
+    for (Codec::VideoCodec codec: codecs) {
+        if (std::ranges::any_of(calibratedCodecs, [codec](const auto &c) { return c.first == codec; }) &&
+            !getIsMeasured(result, codec)) {
+            logContext << "uncalibrated" << Log::Level::warning << "Choosing the " <<
+                          getName(calibratedCodecs, codec) << " presets without calibration, because " <<
+                          path.string() << " doesn't have measurements of it. Run the server with --calibrate on an " <<
+                          "idle host to measure it.";
+        }
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "configuration/defaults.hpp"
+#include "util/asio.hpp"
+
+#include <filesystem>
+#include <vector>
+
+namespace Log
+{
+
+class Log;
+
+} // namespace Log
+
+namespace Ffmpeg
+{
+
+/**
+ * The codecs that can be calibrated.
+ */
+extern const std::vector<Codec::VideoCodec> calibratableCodecs;
+
+/**
+ * Measure the throughput of the given codecs' presets on this host.
+ *
+ * Codecs that haven't been measured before are measured by encoding synthetic video for each of the presets at a few
+ * resolutions, which takes a minute or so per codec. Anything else running on the host skews the measurements, so this
+ * is meant to be run as a separate step on an idle host, rather than by a running server. The measurements are stored
+ * in a file, so this only has to happen once per host. Only the H.264 and H.265 presets from ultrafast to medium are
+ * measured: the slower ones are too slow for live streaming, and the other codecs don't use presets.
+ *
+ * @param path The file the measurements are stored in.
+ * @param codecs The codecs to measure.
+ * @return All the measurements in the file, including those of codecs that weren't asked for.
+ */
+Awaitable<std::vector<Config::EncoderThroughput>> calibrate(IOContext &ioc, Log::Log &log, std::filesystem::path path,
+                                                            std::vector<Codec::VideoCodec> codecs);
+
+/**
+ * Get the throughput of the given codecs' presets on this host, as measured by calibrate, without measuring anything.
+ *
+ * @param path The file the measurements are stored in.
+ * @param codecs The codecs whose throughput is needed. A warning is logged for each that hasn't been measured.
+ * @return All the measurements in the file, including those of codecs that weren't asked for.
+ */
+std::vector<Config::EncoderThroughput> loadCalibration(Log::Log &log, const std::filesystem::path &path,
+                                                       const std::vector<Codec::VideoCodec> &codecs);
+
+} // namespace Ffmpeg
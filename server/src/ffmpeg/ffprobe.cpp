@@ -6,8 +6,10 @@
 #include "configuration/configuration.hpp"
 #include "util/asio.hpp"
 #include "util/Event.hpp"
+#include "util/File.hpp"
 #include "util/json.hpp"
 #include "util/subprocess.hpp"
+#include "util/util.hpp"
 
 #include <charconv>
 #include <exception>
@@ -21,8 +23,8 @@
  */
 struct Ffmpeg::ProbeResult::CacheEntry final
 {
-    explicit CacheEntry(IOContext &ioc, std::vector<std::string> arguments) :
-        arguments(std::move(arguments)), event(ioc)
+    explicit CacheEntry(std::vector<std::string> arguments) :
+        arguments(std::move(arguments))
     {
     }
 
@@ -147,56 +149,28 @@ static void from_json(const nlohmann::json &j, AudioStreamInfo &out)
 
 } // namespace MediaInfo
 
-Awaitable<Ffmpeg::ProbeResult> Ffmpeg::ffprobe(IOContext &ioc, std::string_view url, std::vector<std::string> arguments)
+namespace
 {
-    /* Per-URL mutexes so we don't ffprobe the same thing in parallel. */
-    static std::map<std::string, std::weak_ptr<ProbeResult::CacheEntry>> urlResults;
-
-    /* Handle ingest_http:// URLs. */
-    std::string urlString = Arguments::decodeUrl(url, "probe");
-
-    /* Result caching. */
-    // Create a mutex to the URL, so we don't probe it in parallel.
-    std::weak_ptr<ProbeResult::CacheEntry> &weakResult = urlResults[urlString]; // The coordinating reference.
-    std::shared_ptr<ProbeResult::CacheEntry> result = weakResult.lock(); // Get the mutex if it exists.
-
-    // If the cache entry already exists, wait for it to be filled in and return it.
-    if (result) {
-        // Make sure we've not got conflicting arguments.
-        if (result->arguments != arguments) {
-            throw InUseException("FFmpeg URL in use with different arguments.");
-        }
-
-        // Wait for the result to become ready.
-        while (!result->filledIn) {
-            co_await result->event.wait();
-        }
-
-        // Return the result wrapped in the wrapper cass.
-        co_return ProbeResult(result);
-    }
-
-    // Create a cache entry in the map that deletes itself once it runs out of references.
-    result = std::shared_ptr<ProbeResult::CacheEntry>
-             (new ProbeResult::CacheEntry(ioc, std::move(arguments)), [urlString](ProbeResult::CacheEntry *cacheEntry) {
-        assert(urlResults.contains(urlString));
-        assert(urlResults.at(urlString).expired());
-        urlResults.erase(urlString);
-        delete cacheEntry;
-    });
-    weakResult = result;
 
+/**
+ * Run ffprobe.
+ *
+ * @param url The URL to give to ffprobe, which has already been decoded.
+ */
+Awaitable<MediaInfo::SourceInfo> runFfprobe(IOContext &ioc, const std::string &url,
+                                            const std::vector<std::string> &arguments)
+{
     /* Figure out how to run ffprobe. */
     std::vector<std::string_view> args;
-    args.reserve(result->arguments.size() + 4);
+    args.reserve(arguments.size() + 4);
 
     // The source's input arguments.
-    for (std::string_view arg: result->arguments) {
+    for (std::string_view arg: arguments) {
         args.emplace_back(arg);
     }
 
     // The input itself.
-    args.emplace_back(urlString);
+    args.emplace_back(url);
 
     // The output arguments.
     for (const char *arg: {"-of", "json", "-show_streams"}) {
@@ -204,20 +178,10 @@ Awaitable<Ffmpeg::ProbeResult> Ffmpeg::ffprobe(IOContext &ioc, std::string_view
     }
 
     /* Execute ffprobe and parse to JSON. */
-    nlohmann::json j;
-    try {
-        j = Json::parse(co_await Subprocess::getStdout(ioc, "ffprobe", args));
-    }
-    catch (...) {
-        // Store the exception in the result so it can be rethrown when accessed.
-        result->exception = std::current_exception();
-        result->filledIn = true;
-        result->event.notifyAll(); // Alert everything else that's waiting on this result.
-        co_return ProbeResult(result);
-    }
+    nlohmann::json j = Json::parse(co_await Subprocess::getStdout(ioc, "ffprobe", args));
 
     /* Build the result. */
-    MediaInfo::SourceInfo &sourceInfo = result->result;
+    MediaInfo::SourceInfo sourceInfo;
 
     // Parse through each stream looking for the best.
     bool foundDefaultVideo = false;
@@ -248,6 +212,291 @@ Awaitable<Ffmpeg::ProbeResult> Ffmpeg::ffprobe(IOContext &ioc, std::string_view
         }
     }
 
+    co_return sourceInfo;
+}
+
+/**
+ * A result of ffprobe that's kept after nothing refers to it any more.
+ */
+struct StoredResult final
+{
+    MediaInfo::SourceInfo result;
+
+    /**
+     * When the source was probed. This is the system clock, so that it means something after a restart.
+     */
+    std::chrono::system_clock::time_point probedAt;
+
+    /**
+     * Whether the result has been checked since it was loaded from the file.
+     */
+    bool validated = true;
+};
+
+/**
+ * The results of ffprobe that outlive their references, and where to store them.
+ */
+struct ProbeStore final
+{
+    /**
+     * The file the results are stored in, or empty if they're not.
+     */
+    std::filesystem::path path;
+
+    /**
+     * How long a result is reused for.
+     */
+    std::chrono::seconds ttl{0};
+
+    /**
+     * The results, by URL and arguments.
+     */
+    std::map<std::pair<std::string, std::vector<std::string>>, StoredResult> results;
+
+    /**
+     * Whether the results are being written to the file.
+     */
+    bool saving = false;
+
+    /**
+     * Whether the results have changed since they started being written to the file.
+     */
+    bool dirty = false;
+};
+
+ProbeStore probeStore;
+
+/**
+ * Get whether a stored result is too old to use.
+ */
+bool getIsExpired(const StoredResult &stored)
+{
+    return std::chrono::system_clock::now() - stored.probedAt >= probeStore.ttl;
+}
+
+/**
+ * Write the stored results to the file until they stop changing.
+ */
+Awaitable<void> saveResults(IOContext &ioc)
+{
+    while (probeStore.dirty) {
+        probeStore.dirty = false;
+        nlohmann::json j = nlohmann::json::array();
+        for (const auto &[key, stored]: probeStore.results) {
+            if (getIsExpired(stored)) {
+                continue;
+            }
+            nlohmann::json &element = j.emplace_back(nlohmann::json{
+                { "url", key.first },
+                { "arguments", key.second },
+                { "probedAt", std::chrono::duration_cast<std::chrono::seconds>(
+                    stored.probedAt.time_since_epoch()).count() }
+            });
+            if (stored.result.video) {
+                element["video"] = {
+                    { "width", stored.result.video->width },
+                    { "height", stored.result.video->height },
+                    { "frameRate", { stored.result.video->frameRateNumerator,
+                                     stored.result.video->frameRateDenominator } }
+                };
+            }
+            if (stored.result.audio) {
+                element["audio"] = { { "sampleRate", stored.result.audio->sampleRate } };
+            }
+        }
+        Util::File file(ioc, probeStore.path, true, false);
+        co_await file.write(Json::dump(j));
+    }
+}
+
+/**
+ * Arrange for the stored results to be written to the file.
+ */
+void requestSave(IOContext &ioc)
+{
+    if (probeStore.path.empty()) {
+        return;
+    }
+    probeStore.dirty = true;
+    if (probeStore.saving) {
+        return; // The writer will go round again.
+    }
+    probeStore.saving = true;
+    spawnDetached(ioc, [&ioc]() -> Awaitable<void> {
+        try {
+            co_await saveResults(ioc);
+        }
+        catch (const std::exception &) {
+            // The file is only an optimization, so carry on without it.
+        }
+        probeStore.saving = false;
+    });
+}
+
+/**
+ * Remember a result of ffprobe for a while.
+ */
+void storeResult(IOContext &ioc, const std::string &url, const std::vector<std::string> &arguments,
+                 const MediaInfo::SourceInfo &result)
+{
+    if (probeStore.ttl.count() == 0) {
+        return;
+    }
+    probeStore.results[{ url, arguments }] = {
+        .result = result,
+        .probedAt = std::chrono::system_clock::now()
+    };
+    requestSave(ioc);
+}
+
+/**
+ * Probe a source again, to check a result loaded from the file.
+ *
+ * If this fails, the loaded result is kept, because the source might just not allow a second connection while ffmpeg
+ * is reading it.
+ */
+Awaitable<void> revalidate(IOContext &ioc, std::string url, std::vector<std::string> arguments)
+{
+    try {
+        MediaInfo::SourceInfo result = co_await runFfprobe(ioc, url, arguments);
+        storeResult(ioc, url, arguments, result);
+    }
+    catch (const std::exception &) {}
+}
+
+/**
+ * Get a result of ffprobe that was stored recently enough to use.
+ *
+ * If the result was loaded from the file, the source is probed again in the background to check it.
+ *
+ * @param canRevalidate Whether the source can be probed again in the background. Sources that only allow one
+ *                      connection can't, because the channel's ffmpeg is likely to be using them by then, so their
+ *                      results are used until they expire.
+ */
+std::optional<MediaInfo::SourceInfo> getStoredResult(IOContext &ioc, const std::string &url,
+                                                     const std::vector<std::string> &arguments, bool canRevalidate)
+{
+    auto it = probeStore.results.find({ url, arguments });
+    if (it == probeStore.results.end()) {
+        return std::nullopt;
+    }
+    if (getIsExpired(it->second)) {
+        probeStore.results.erase(it);
+        return std::nullopt;
+    }
+
+    if (!it->second.validated && canRevalidate) {
+        it->second.validated = true;
+        spawnDetached(ioc, [&ioc, url, arguments]() -> Awaitable<void> {
+            co_await revalidate(ioc, url, arguments);
+        });
+    }
+    return it->second.result;
+}
+
+} // namespace
+
+void Ffmpeg::setProbeCache(std::filesystem::path path, std::chrono::seconds ttl)
+{
+    probeStore.path = std::move(path);
+    probeStore.ttl = ttl;
+    probeStore.results.clear();
+
+    /* Load the results from a previous run. They're checked in the background when they're first used. */
+    if (probeStore.path.empty() || !std::filesystem::exists(probeStore.path)) {
+        return;
+    }
+    try {
+        std::vector<std::byte> data = Util::readFile(probeStore.path);
+        for (const nlohmann::json &element: Json::parse({ (const char *)data.data(), data.size() })) {
+            StoredResult stored{
+                .probedAt = std::chrono::system_clock::time_point(
+                    std::chrono::seconds(element.at("probedAt").get<int64_t>())),
+                .validated = false
+            };
+            if (element.contains("video")) {
+                const nlohmann::json &video = element.at("video");
+                stored.result.video = MediaInfo::VideoStreamInfo{
+                    .width = video.at("width").get<unsigned int>(),
+                    .height = video.at("height").get<unsigned int>(),
+                    .frameRateNumerator = video.at("frameRate").at(0).get<unsigned int>(),
+                    .frameRateDenominator = video.at("frameRate").at(1).get<unsigned int>()
+                };
+            }
+            if (element.contains("audio")) {
+                stored.result.audio = MediaInfo::AudioStreamInfo{
+                    .sampleRate = element.at("audio").at("sampleRate").get<unsigned int>()
+                };
+            }
+            if (!getIsExpired(stored)) {
+                probeStore.results[{ element.at("url").get<std::string>(),
+                                     element.at("arguments").get<std::vector<std::string>>() }] = std::move(stored);
+            }
+        }
+    }
+    catch (const std::exception &) {
+        // The file is only an optimization, so start again without it.
+        probeStore.results.clear();
+    }
+}
+
+Awaitable<Ffmpeg::ProbeResult> Ffmpeg::ffprobe(IOContext &ioc, std::string_view url, std::vector<std::string> arguments)
+{
+    /* Per-URL mutexes so we don't ffprobe the same thing in parallel. */
+    static std::map<std::string, std::weak_ptr<ProbeResult::CacheEntry>> urlResults;
+
+    /* Handle ingest_http:// URLs. */
+    std::string urlString = Arguments::decodeUrl(url, "probe");
+
+    /* Result caching. */
+    // Create a mutex to the URL, so we don't probe it in parallel.
+    std::weak_ptr<ProbeResult::CacheEntry> &weakResult = urlResults[urlString]; // The coordinating reference.
+    std::shared_ptr<ProbeResult::CacheEntry> result = weakResult.lock(); // Get the mutex if it exists.
+
+    // If the cache entry already exists, wait for it to be filled in and return it.
+    if (result) {
+        // Make sure we've not got conflicting arguments.
+        if (result->arguments != arguments) {
+            throw InUseException("FFmpeg URL in use with different arguments.");
+        }
+
+        // Wait for the result to become ready.
+        while (!result->filledIn) {
+            co_await result->event.wait();
+        }
+
+        // Return the result wrapped in the wrapper cass.
+        co_return ProbeResult(result);
+    }
+
+    // Create a cache entry in the map that deletes itself once it runs out of references.
+    result = std::shared_ptr<ProbeResult::CacheEntry>
+             (new ProbeResult::CacheEntry(std::move(arguments)), [urlString](ProbeResult::CacheEntry *cacheEntry) {
+        assert(urlResults.contains(urlString));
+        assert(urlResults.at(urlString).expired());
+        urlResults.erase(urlString);
+        delete cacheEntry;
+    });
+    weakResult = result;
+
+    /* Use a stored result if there's a recent enough one. */
+    if (std::optional<MediaInfo::SourceInfo> stored = getStoredResult(
+            ioc, urlString, result->arguments, !Arguments::getIsExclusiveSource(url, result->arguments))) {
+        result->result = std::move(*stored);
+    }
+
+    /* Otherwise, run ffprobe. */
+    else {
+        try {
+            result->result = co_await runFfprobe(ioc, urlString, result->arguments);
+            storeResult(ioc, urlString, result->arguments, result->result);
+        }
+        catch (...) {
+            // Store the exception in the result so it can be rethrown when accessed.
+            result->exception = std::current_exception();
+        }
+    }
+
     /* Done :) */
     result->filledIn = true;
     result->event.notifyAll(); // Alert everything else that's waiting on this result.
@@ -3,6 +3,8 @@
 #include "media/MediaInfo.hpp"
 #include "util/asio.hpp"
 
+#include <chrono>
+#include <filesystem>
 #include <span>
 #include <string>
 #include <string_view>
@@ -52,6 +54,17 @@ private:
     std::shared_ptr<CacheEntry> cacheEntry;
 };
 
+/**
+ * Keep the results of ffprobe after nothing refers to them any more, and store them in a file so they survive restarts.
+ *
+ * A result is reused for the same URL and arguments until it's older than the TTL. A result loaded from the file is used
+ * straight away, and the source is probed again in the background to check it for next time.
+ *
+ * @param path The file to store the results in. If empty, they're kept in memory only. Any results in it are loaded.
+ * @param ttl How long to reuse a result for. If 0, results are only reused while something refers to them.
+ */
+void setProbeCache(std::filesystem::path path, std::chrono::seconds ttl);
+
 /**
  * Get information about a media source via ffprobe.
  *
@@ -2,10 +2,15 @@
 
 #include "util/asio.hpp"
 #include "util/Mutex.hpp"
-#include "util/subprocess.hpp"
 
-#include <cassert>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -13,120 +18,300 @@ namespace
 {
 
 /**
- * Represents mutually exclusive access to an FFmpeg filter graph's ZMQ node (at least for this process).
+ * ZMTP frame flags.
  */
-class ZmqClient final
+enum FrameFlags : uint8_t
+{
+    more = 0x01,
+    longSize = 0x02,
+    command = 0x04
+};
+
+/**
+ * Append a ZMTP frame to a buffer.
+ */
+void appendFrame(std::string &buffer, uint8_t flags, std::string_view body)
+{
+    if (body.size() > 255) {
+        buffer += (char)(flags | FrameFlags::longSize);
+        for (int i = 7; i >= 0; i--) {
+            buffer += (char)(uint8_t)((uint64_t)body.size() >> (i * 8));
+        }
+    }
+    else {
+        buffer += (char)flags;
+        buffer += (char)(uint8_t)body.size();
+    }
+    buffer += body;
+}
+
+/**
+ * A persistent connection to an FFmpeg filter graph's ZMQ node.
+ *
+ * This speaks enough of ZMTP 3.0 (https://rfc.zeromq.org/spec/23/) to be a REQ socket with the NULL security
+ * mechanism, which is what the zmq filter's REP socket expects. Unlike a real REQ socket, it writes several requests
+ * before reading the replies, which the REP socket handles in order.
+ */
+class ZmqConnection final
 {
 public:
     /**
-     * Garbage collect the mutual-exclusion stuff.
+     * Get the connection for an address, creating it if necessary.
      */
-    ~ZmqClient()
+    static std::shared_ptr<ZmqConnection> getForAddress(IOContext &ioc, const std::string &address)
     {
-        /* Don't do the cache management stuff if this is the remnant of a moved object. */
-        if (!lock) {
-            return;
+        std::shared_ptr<ZmqConnection> &connection = zmqConnections[address];
+        if (!connection) {
+            connection = std::make_shared<ZmqConnection>(ioc, address);
         }
+        return connection;
+    }
+
+    /**
+     * Forget the connection for an address, so that it's closed once nothing is using it.
+     */
+    static void forgetAddress(const std::string &address)
+    {
+        zmqConnections.erase(address);
+    }
 
-        /* Unlock the mutex and remove our reference to it. */
-        lock.reset();
-        mutex.reset();
+    explicit ZmqConnection(IOContext &ioc, std::string address) : ioc(ioc), address(std::move(address)) {}
 
-        /* Remove the mutex's entry in the mutex map if nothing is using it. */
-        auto it = zmqClients.find(address);
-        assert(it != zmqClients.end());
-        if (it->second.expired()) {
-            zmqClients.erase(it);
+    /**
+     * Send commands to the ZMQ server, and wait for all the replies.
+     *
+     * If the connection has gone stale, such as because ffmpeg has been restarted, this reconnects and tries again.
+     *
+     * @return The round-trip time of each command.
+     * @throws std::runtime_error if a command fails.
+     */
+    Awaitable<std::vector<std::chrono::microseconds>> send(std::span<const Ffmpeg::ZmqCommand> commands)
+    {
+        /* Get exclusive use of the connection. */
+        Mutex::LockGuard lock = co_await mutex.lockGuard();
+
+        /* Send the commands, reconnecting once if an existing connection has failed. */
+        std::vector<std::chrono::microseconds> result;
+        for (int attempt = 0; ; attempt++) {
+            bool reused = (bool)socket;
+            try {
+                if (!socket) {
+                    co_await connect();
+                }
+                result = co_await sendConnected(commands);
+                break;
+            }
+            catch (const boost::system::system_error &) {
+                socket.reset();
+                readBuffer.clear();
+                if (!reused || attempt > 0) {
+                    throw;
+                }
+            }
+            catch (...) {
+                socket.reset();
+                readBuffer.clear();
+                throw;
+            }
         }
+
+        /* Check that there's no error. */
+        for (const std::string &reply: replies) {
+            if (reply.size() < 2 || !reply.starts_with("0 ")) {
+                throw std::runtime_error("FFmpeg ZMQ command failed: " + reply);
+            }
+        }
+        co_return result;
     }
 
+private:
     /**
-     * Get an object to send commands to an FFmpeg filter graph via ZMQ without interference from anything else.
+     * Connect to the ZMQ server, and do the ZMTP handshake.
      */
-    static Awaitable<ZmqClient> getForAddress(IOContext &ioc, std::string address)
+    Awaitable<void> connect()
     {
-        /* Find or create the mutex. */
-        std::shared_ptr<Mutex> mutex;
-        auto it = zmqClients.find(address);
-        if (it == zmqClients.end()) {
-            mutex = std::make_shared<Mutex>(ioc);
-            zmqClients[address] = mutex;
+        /* Connect the socket. */
+        socket = std::make_unique<boost::asio::generic::stream_protocol::socket>((boost::asio::io_context &)ioc);
+        if (address.starts_with("ipc://")) {
+            co_await socket->async_connect(boost::asio::local::stream_protocol::endpoint(address.substr(6)),
+                                           boost::asio::use_awaitable);
+        }
+        else if (address.starts_with("tcp://")) {
+            size_t colon = address.rfind(':');
+            if (colon < 6) {
+                throw std::runtime_error("FFmpeg ZMQ address has no port: " + address);
+            }
+            boost::asio::ip::tcp::resolver resolver((boost::asio::io_context &)ioc);
+            auto endpoints = co_await resolver.async_resolve(address.substr(6, colon - 6), address.substr(colon + 1),
+                                                             boost::asio::use_awaitable);
+            if (endpoints.empty()) {
+                throw std::runtime_error("FFmpeg ZMQ address did not resolve: " + address);
+            }
+            co_await socket->async_connect(endpoints.begin()->endpoint(), boost::asio::use_awaitable);
         }
         else {
-            assert(!it->second.expired());
-            mutex = it->second.lock();
+            throw std::runtime_error("Unsupported FFmpeg ZMQ address: " + address);
         }
 
-        /* Create a ZMQ client object. */
-        co_return ZmqClient(ioc, co_await mutex->lockGuard(), std::move(mutex), std::move(address));
-    }
+        /* Exchange greetings: ZMTP 3.0 with the NULL mechanism, as a client. */
+        std::string greeting(64, '\0');
+        greeting[0] = (char)0xff; // Signature.
+        greeting[9] = 0x7f;
+        greeting[10] = 3; // Version.
+        greeting[11] = 0;
+        greeting.replace(12, 4, "NULL"); // Mechanism.
+        co_await boost::asio::async_write(*socket, boost::asio::buffer(greeting), boost::asio::use_awaitable);
 
-    ZmqClient(ZmqClient &&) = default;
+        std::string peerGreeting = co_await readExact(64);
+        if ((uint8_t)peerGreeting[0] != 0xff || (peerGreeting[9] & 1) != 1 || peerGreeting[10] < 3 ||
+            peerGreeting.compare(12, 5, std::string_view("NULL\0", 5)) != 0) {
+            throw std::runtime_error("FFmpeg ZMQ server sent a bad greeting.");
+        }
+
+        /* Exchange READY commands. */
+        std::string ready = "\x05READY\x0bSocket-Type";
+        ready += std::string_view("\0\0\0\x03REQ", 7);
+        std::string message;
+        appendFrame(message, FrameFlags::command, ready);
+        co_await boost::asio::async_write(*socket, boost::asio::buffer(message), boost::asio::use_awaitable);
+
+        auto [flags, body] = co_await readFrame();
+        if (!(flags & FrameFlags::command) || !body.starts_with("\x05READY")) {
+            throw std::runtime_error("FFmpeg ZMQ server did not accept the connection.");
+        }
+    }
 
     /**
-     * Send a command to the ZMQ server.
+     * Send commands over the connection, and wait for all the replies, which are left in the replies member.
+     *
+     * @return The round-trip time of each command.
      */
-    Awaitable<void> operator()(const Ffmpeg::ZmqCommand &command)
+    Awaitable<std::vector<std::chrono::microseconds>> sendConnected(std::span<const Ffmpeg::ZmqCommand> commands)
     {
-        /* Format the message. */
-        std::string message;
-        message.insert(message.end(), command.target.begin(), command.target.end());
-        message += " ";
-        message.insert(message.end(), command.command.begin(), command.command.end());
-        if (!command.argument.empty()) {
+        /* Format the requests. Each is an empty delimiter frame followed by the message. */
+        std::string requests;
+        for (const Ffmpeg::ZmqCommand &command: commands) {
+            std::string message;
+            message.insert(message.end(), command.target.begin(), command.target.end());
             message += " ";
-            message.insert(message.end(), command.argument.begin(), command.argument.end());
+            message.insert(message.end(), command.command.begin(), command.command.end());
+            if (!command.argument.empty()) {
+                message += " ";
+                message.insert(message.end(), command.argument.begin(), command.argument.end());
+            }
+            appendFrame(requests, FrameFlags::more, {});
+            appendFrame(requests, 0, message);
         }
 
-        /* Send the message. */
-        std::string result = co_await Subprocess::getStdout(ioc, "zmqsend", { "-b", address }, message);
+        /* Send them all at once. */
+        std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+        co_await boost::asio::async_write(*socket, boost::asio::buffer(requests), boost::asio::use_awaitable);
 
-        // Check that there's no error.
-        if (result.size() < 2 || !result.starts_with("0 ")) {
-            throw std::runtime_error("FFmpeg ZMQ command failed: " + result);
+        /* Read all the replies, which come back in the same order, so the next call doesn't get any of them. */
+        std::vector<std::chrono::microseconds> result;
+        result.reserve(commands.size());
+        replies.clear();
+        for (size_t i = 0; i < commands.size(); i++) {
+            // Skip the delimiter, and get the reply.
+            std::string reply;
+            for (bool first = true; ; first = false) {
+                auto [flags, body] = co_await readFrame();
+                if (flags & FrameFlags::command) {
+                    throw std::runtime_error("FFmpeg ZMQ server sent an unexpected command.");
+                }
+                if (!first) {
+                    reply += body;
+                }
+                if (!(flags & FrameFlags::more)) {
+                    break;
+                }
+            }
+            result.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - sent));
+            replies.emplace_back(std::move(reply));
         }
+        co_return result;
     }
 
-private:
-    explicit ZmqClient(IOContext &ioc, Mutex::LockGuard lock, std::shared_ptr<Mutex> mutex, std::string address) :
-        ioc(ioc), mutex(std::move(mutex)), lock(std::make_unique<Mutex::LockGuard>(std::move(lock))),
-        address(std::move(address))
+    /**
+     * Read a frame.
+     *
+     * @return The flags and the body.
+     */
+    Awaitable<std::pair<uint8_t, std::string>> readFrame()
     {
+        std::string header = co_await readExact(2);
+        uint8_t flags = (uint8_t)header[0];
+        uint64_t size = (uint8_t)header[1];
+        if (flags & FrameFlags::longSize) {
+            std::string longSize = co_await readExact(7);
+            for (char c: longSize) {
+                size = (size << 8) | (uint8_t)c;
+            }
+            if (size > (1 << 20)) {
+                throw std::runtime_error("FFmpeg ZMQ server sent an excessively long frame.");
+            }
+        }
+        co_return std::pair(flags, co_await readExact(size));
     }
 
-    static inline std::map<std::string, std::weak_ptr<Mutex>> zmqClients;
+    /**
+     * Read an exact amount of data from the connection.
+     */
+    Awaitable<std::string> readExact(size_t length)
+    {
+        while (readBuffer.size() < length) {
+            char data[4096];
+            size_t n = co_await socket->async_read_some(boost::asio::buffer(data), boost::asio::use_awaitable);
+            readBuffer.append(data, n);
+        }
+        std::string result = readBuffer.substr(0, length);
+        readBuffer.erase(0, length);
+        co_return result;
+    }
+
+    static inline std::map<std::string, std::shared_ptr<ZmqConnection>> zmqConnections;
 
     IOContext &ioc;
-    std::shared_ptr<Mutex> mutex; ///< Keeps the mutex alive so it can be unlocked.
-    std::unique_ptr<Mutex::LockGuard> lock; ///< Keeps the mutex locked.
-    std::string address;
+    const std::string address;
+
+    /**
+     * Stops the replies to different calls from getting mixed up.
+     */
+    Mutex mutex;
+
+    /**
+     * The connection, or null if it's not connected.
+     */
+    std::unique_ptr<boost::asio::generic::stream_protocol::socket> socket;
+
+    /**
+     * Data that's been read but not parsed.
+     */
+    std::string readBuffer;
+
+    /**
+     * The replies to the commands that were last sent.
+     */
+    std::vector<std::string> replies;
 };
 
 } // namespace
 
-Awaitable<void> Ffmpeg::zmqsend(IOContext &ioc, std::string_view address, std::span<const ZmqCommand> commands,
-                                bool sequential)
+Awaitable<std::vector<std::chrono::microseconds>> Ffmpeg::zmqsend(IOContext &ioc, std::string_view address,
+                                                                  std::span<const ZmqCommand> commands)
 {
-    ZmqClient zmqClient = co_await ZmqClient::getForAddress(ioc, (std::string)address);
-
-    if (sequential) {
-        for (const ZmqCommand &command: commands) {
-            co_await zmqClient(command);
-        }
-    }
-    else {
-        std::vector<Awaitable<void>> awaitables;
-        awaitables.reserve(commands.size());
+    std::shared_ptr<ZmqConnection> connection = ZmqConnection::getForAddress(ioc, (std::string)address);
+    co_return co_await connection->send(commands);
+}
 
-        for (const ZmqCommand &command: commands) {
-            awaitables.emplace_back(zmqClient(command));
-        }
-        co_await awaitTree(awaitables);
-    }
+Awaitable<std::vector<std::chrono::microseconds>> Ffmpeg::zmqsend(IOContext &ioc, std::string_view address,
+                                                                  std::initializer_list<ZmqCommand> commands)
+{
+    co_return co_await zmqsend(ioc, address, std::span(commands.begin(), commands.size()));
 }
 
-Awaitable<void> Ffmpeg::zmqsend(IOContext &ioc, std::string_view address, std::initializer_list<ZmqCommand> commands,
-                                bool sequential)
+void Ffmpeg::zmqDisconnect(std::string_view address)
 {
-    co_await zmqsend(ioc, address, std::span(&*commands.begin(), commands.size()), sequential);
+    ZmqConnection::forgetAddress((std::string)address);
 }
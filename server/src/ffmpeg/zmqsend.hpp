@@ -1,7 +1,9 @@
 #pragma once
 
+#include <chrono>
 #include <span>
 #include <string_view>
+#include <vector>
 #include "util/awaitable.hpp"
 
 class IOContext;
@@ -33,18 +35,29 @@ struct ZmqCommand final
 /**
  * Send commands to an FFmpeg filter graph via ZMQ.
  *
- * @param address The address of the filter node's ZMQ server.
- * @param commands The commands to send. They are sent atomically with respect to any other call to zmqsend with the
- *                 same address.
- * @param sequential Submit the commands sequentially. Otherwise, they're submitted in an unspecifed order.
+ * This keeps a connection open to each address, and writes all the commands at once before waiting for the replies, so
+ * ffmpeg usually applies them to the same frame.
+ *
+ * @param address The address of the filter node's ZMQ server: either ipc://path or tcp://host:port.
+ * @param commands The commands to send, which are run in order. They are sent atomically with respect to any other call
+ *                 to zmqsend with the same address.
+ * @return The round-trip time of each command, from when the commands were sent to when its reply was received.
+ * @throws std::runtime_error if a command fails.
  */
-Awaitable<void> zmqsend(IOContext &ioc, std::string_view address, std::span<const ZmqCommand> commands,
-                        bool sequential = false);
+Awaitable<std::vector<std::chrono::microseconds>> zmqsend(IOContext &ioc, std::string_view address,
+                                                          std::span<const ZmqCommand> commands);
 
 /**
  * @copydoc zmqsend
  */
-Awaitable<void> zmqsend(IOContext &ioc, std::string_view address, std::initializer_list<ZmqCommand> commands,
-                        bool sequential = false);
+Awaitable<std::vector<std::chrono::microseconds>> zmqsend(IOContext &ioc, std::string_view address,
+                                                          std::initializer_list<ZmqCommand> commands);
+
+/**
+ * Close the connection that zmqsend keeps to an address, once any commands in progress have finished.
+ *
+ * This should be called when the filter graph is going away, such as when its channel is stopped.
+ */
+void zmqDisconnect(std::string_view address);
 
 } // namespace Ffmpeg
@@ -1,5 +1,8 @@
 #include "State.hpp"
+#include "handover.hpp"
 #include "ffmpeg/Arguments.hpp"
+#include "ffmpeg/benchmark.hpp"
+#include "ffmpeg/calibrate.hpp"
 #include "ffmpeg/ffprobe.hpp"
 #include "ffmpeg/Process.hpp"
 #include "log/MemoryLog.hpp"
@@ -9,6 +12,10 @@
 #include "resources/StreamAndHeadResource.hpp"
 #include "dash/DashResources.hpp"
 #include "configuration/defaults.hpp"
+#include "util/asio.hpp"
+#include "util/IOContextPool.hpp"
+#include "util/json.hpp"
+#include "util/TimerWheel.hpp"
 
 namespace {
 
@@ -34,7 +41,82 @@ void addFilesystemPathsToServer(Server::Server &server, const std::map<std::stri
         server.addResource<Server::FilesystemResource>(path, ioc, directory.localPath, directory.index,
                                                        directory.ephemeral ? Server::CacheKind::ephemeral :
                                                                              Server::CacheKind::fixed,
-                                                       !directory.secure, directory.maxWritableSize << 20);
+                                                       !directory.secure, directory.maxWritableSize << 20,
+                                                       directory.memoryCacheSize << 20);
+    }
+}
+
+/**
+ * Get the amount of a quality's uncompressed stream to buffer between its decoder and its encoder.
+ *
+ * This is a second's worth of frames, so a slow encoder can fall that far behind before it holds back the decoder, and
+ * thus every other quality.
+ */
+size_t getDecodedBufferSize(const Config::Quality &q)
+{
+    size_t frameSize = (size_t)*q.video.width * *q.video.height * 3 / 2; // yuv420p.
+    size_t framesPerSecond = (q.video.frameRate.numerator + q.video.frameRate.denominator - 1) /
+                             q.video.frameRate.denominator;
+    return frameSize * std::max<size_t>(framesPerSecond, 1);
+}
+
+/**
+ * Get the bytes that start a NUT syncpoint.
+ *
+ * A NUT demuxer that has been given the headers can start reading from any syncpoint, so an encoder can join its
+ * quality's uncompressed stream part way through.
+ */
+std::vector<std::byte> getNutSyncpointStartcode()
+{
+    return {
+        std::byte{'N'}, std::byte{'K'}, std::byte{0xE4}, std::byte{0xAD},
+        std::byte{0xEE}, std::byte{0xCA}, std::byte{0x45}, std::byte{0x69}
+    };
+}
+
+/**
+ * Figure out whether a channel can be reconfigured by running the new configuration alongside the old one until it's
+ * ready.
+ */
+bool getCanHandOver(const Config::Channel &oldConfig, const Config::Channel &newConfig)
+{
+    return newConfig.ffmpeg.handover &&
+           // The two have to have their own resources, and their own ZMQ socket.
+           oldConfig.uid != newConfig.uid && oldConfig.ffmpeg.filterZmq != newConfig.ffmpeg.filterZmq &&
+           // Both have to be able to read the source at the same time.
+           !Ffmpeg::Arguments::getIsExclusiveSource(oldConfig.source.url, oldConfig.source.arguments) &&
+           !Ffmpeg::Arguments::getIsExclusiveSource(newConfig.source.url, newConfig.source.arguments);
+}
+
+/**
+ * Measure the CPU time ffmpeg takes to decode and filter a channel's source with each shape of filter graph, and log
+ * it.
+ *
+ * The two are run one after the other, so they don't compete for the CPU with each other.
+ */
+Awaitable<void> benchmarkFilter(IOContext &ioc, Log::Log &log, const Config::Channel &config)
+{
+    Log::Context logContext = log("benchmark");
+    for (bool cascade: { true, false }) {
+        try {
+            std::optional<Ffmpeg::BenchmarkResult> result =
+                co_await Ffmpeg::benchmark(ioc, Ffmpeg::Arguments::benchmarkFilter(config, cascade));
+            if (!result) {
+                logContext << Log::Level::warning << "ffmpeg didn't report a benchmark.";
+                continue;
+            }
+            logContext << "result" << Log::Level::info << Json::dump({
+                { "uid", config.uid },
+                { "cascadeScaling", cascade },
+                { "cpuTimeMs", (result->userTime + result->systemTime).count() },
+                { "userTimeMs", result->userTime.count() },
+                { "systemTimeMs", result->systemTime.count() },
+                { "realTimeMs", result->realTime.count() }
+            });
+        }
+        catch (const std::exception &e) {
+            logContext << "exception" << Log::Level::error << e.what();
+        }
     }
 }
 
@@ -45,42 +127,195 @@ void addFilesystemPathsToServer(Server::Server &server, const std::map<std::stri
  */
 struct Instance::State::Channel final
 {
+    /**
+     * Stop streaming.
+     */
+    ~Channel()
+    {
+        if (!decodePath.empty()) {
+            server.removeResourceTree(decodePath);
+        }
+    }
+
     /**
      * Start streaming.
      */
     explicit Channel(IOContext &ioc, Log::Log &log, const Config::Root &config, const Config::Channel &channelConfig,
-                     const std::string &basePath, Server::Server &server) :
-        ffmpeg(ioc, log, Ffmpeg::Arguments::liveStream(channelConfig, config.network,
-                                                       (std::string)((Server::Path)basePath / channelConfig.uid))),
-        dash(ioc, log, channelConfig, config.http, basePath, server, ffmpeg)
+                     const std::string &basePath, Server::Server &server, bool publish = true) :
+        config(channelConfig),
+        ioc(ioc),
+        log(log),
+        networkConfig(config.network),
+        server(server),
+        uidPath((Server::Path)basePath / channelConfig.uid),
+        decodePath(channelConfig.ffmpeg.separateEncoders ? Server::Path("decode") / basePath / channelConfig.uid :
+                                                           Server::Path()),
+        ffmpegs(startFfmpegs()),
+        dash(ioc, log, this->config, config.http, basePath, server, *ffmpegs.front(), publish,
+             [this](unsigned int qualityIndex, bool encode, Ffmpeg::Timestamp streamStart, unsigned int segmentIndex) {
+                 setEncoding(qualityIndex, encode, streamStart, segmentIndex);
+             }),
+        retirementTimer(Util::TimerWheel::get(ioc))
+    {
+    }
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    /**
+     * Wait for the ffmpeg process that reads the source to cache the result of ffprobe.
+     */
+    Awaitable<void> waitForProbe()
+    {
+        return ffmpegs.front()->waitForProbe();
+    }
+
+    /**
+     * Stop all the ffmpeg processes, encoders first.
+     */
+    Awaitable<void> kill()
     {
+        killed = true; // Don't let suspended qualities restart.
+        for (auto it = ffmpegs.rbegin(); it != ffmpegs.rend(); it++) {
+            if (*it) {
+                co_await (*it)->kill();
+            }
+        }
     }
 
     /**
-     * The ffmpeg subprocess that's streaming to the server.
+     * The channel's configuration.
+     *
+     * This is a copy, so that the channel can outlive the configuration it was created from, such as while it's being
+     * handed over to its replacement.
      */
-    Ffmpeg::Process ffmpeg;
+    const Config::Channel config;
+
+    IOContext &ioc;
+    Log::Log &log;
+    const Config::Network networkConfig;
+    Server::Server &server;
+
+    /**
+     * The base path for the DASH streams.
+     */
+    const Server::Path uidPath;
+
+    /**
+     * Where the uncompressed streams go between the decoder and the encoders, if they're separate.
+     */
+    const Server::Path decodePath;
+
+    /**
+     * The ffmpeg subprocesses that are streaming to the server.
+     *
+     * This is usually a single process that does everything. With separate encoders, the first one decodes and the
+     * rest each encode the quality with the same index. The encoder of a quality that's been suspended is null.
+     */
+    std::vector<std::unique_ptr<Ffmpeg::Process>> ffmpegs;
 
     /**
      * The set of resources that the ffmpeg process streams to (and that converts this from DASH to RISE).
      */
     Dash::DashResources dash;
+
+    /**
+     * Destroys the channel once its segments have expired, after it's been handed over.
+     */
+    Util::TimerWheel::Timer retirementTimer;
+
+private:
+    /**
+     * Start the ffmpeg process, or, with separate encoders, the decoder and the encoders and the resources between
+     * them.
+     */
+    std::vector<std::unique_ptr<Ffmpeg::Process>> startFfmpegs()
+    {
+        std::vector<std::unique_ptr<Ffmpeg::Process>> result;
+
+        /* Everything in one process. */
+        if (!config.ffmpeg.separateEncoders) {
+            result.emplace_back(std::make_unique<Ffmpeg::Process>(
+                ioc, log, Ffmpeg::Arguments::liveStream(config, networkConfig, (std::string)uidPath)));
+            return result;
+        }
+
+        /* A decoder that feeds an encoder for each quality. */
+        // The resources that the decoder PUTs to and the encoders GET from. An encoder can join part way through, so
+        // that one can be restarted without disturbing the others.
+        for (size_t i = 0; i < config.qualities.size(); i++) {
+            server.addResource<Server::StreamAndHeadResource>(decodePath / std::to_string(i), ioc, Server::Path(),
+                                                              getDecodedBufferSize(config.qualities[i]),
+                                                              Server::Path(), 0, std::filesystem::path(),
+                                                              getNutSyncpointStartcode());
+        }
+
+        // The processes.
+        result.emplace_back(std::make_unique<Ffmpeg::Process>(
+            ioc, log, Ffmpeg::Arguments::liveDecode(config, networkConfig, (std::string)decodePath)));
+        for (size_t i = 0; i < config.qualities.size(); i++) {
+            result.emplace_back(startEncoder(i));
+        }
+        return result;
+    }
+
+    /**
+     * Start the encoder for a quality, when each quality is encoded separately.
+     *
+     * @param streamStart The first timestamp of the stream, if the encoder is starting part way through it.
+     * @param segmentIndex The segment to start at, if the encoder is starting part way through the stream.
+     */
+    std::unique_ptr<Ffmpeg::Process> startEncoder(size_t qualityIndex, Ffmpeg::Timestamp streamStart = {},
+                                                  unsigned int segmentIndex = 1)
+    {
+        return std::make_unique<Ffmpeg::Process>(
+            ioc, log, Ffmpeg::Arguments::liveEncode(config, networkConfig, (std::string)decodePath,
+                                                    (std::string)uidPath, qualityIndex, streamStart, segmentIndex));
+    }
+
+    /**
+     * Stop or restart the encoder for a quality that's being suspended or resumed.
+     */
+    void setEncoding(unsigned int qualityIndex, bool encode, Ffmpeg::Timestamp streamStart, unsigned int segmentIndex)
+    {
+        std::unique_ptr<Ffmpeg::Process> &encoder = ffmpegs.at(qualityIndex + 1);
+        if (encode) {
+            if (!encoder && !killed) {
+                encoder = startEncoder(qualityIndex, streamStart, segmentIndex);
+            }
+            return;
+        }
+
+        // Let the encoder finish off its last segment in its own time.
+        if (encoder) {
+            spawnDetached(ioc, [encoder = std::move(encoder)]() -> Awaitable<void> {
+                co_await encoder->kill();
+            });
+        }
+    }
+
+    /**
+     * Whether the processes have been stopped for good.
+     */
+    bool killed = false;
 };
 
 Instance::State::~State() = default;
 
 /// Perform initial setup/configuration.
-Instance::State::State(const Config::Root &initialCfg, IOContext &ioc) :
-    ioc(ioc),
+Instance::State::State(const Config::Root &initialCfg, IOContextPool &iocs) :
+    ioc(iocs.getMain()),
     config(initialCfg),
     requestedConfig(initialCfg),
-    mutex(ioc),
     log(createLog(initialCfg.log, ioc)),
-    server(ioc, *log, initialCfg.network, initialCfg.http)
+    server(iocs, *log, initialCfg.network, initialCfg.http)
 {
     /* Fill in the defaults needed for the rest of this constructor. */
     Config::fillInInitialDefaults(config);
 
+    /* Remember the results of ffprobe, so the channels can start without probing their sources again. */
+    Ffmpeg::setProbeCache(config.probeCache.path, std::chrono::seconds(config.probeCache.ttl));
+
     /* Set up separated ingest. */
     for (const auto &[name, source]: config.separatedIngestSources) {
         // Create the resource for the separated ingest.
@@ -103,6 +338,61 @@ void Instance::State::configCannotChange(bool itChanged, const std::string &name
     }
 }
 
+Awaitable<void> Instance::State::handOver(const std::string &channelPath, std::unique_ptr<Channel> oldChannel)
+{
+    Channel &newChannel = *channels.at(channelPath);
+    Log::Context logContext = (*log)("handover");
+    logContext << "uid" << Log::Level::info << (std::string)newChannel.dash.getUidPath();
+
+    /* Switch once the new channel has a complete segment for every stream. The first segment takes about two segment
+       durations (one to start, and one for the segment itself), so this allows for a slow start too. */
+    if (!co_await handOverChannel(logContext, *oldChannel, newChannel,
+                                  std::chrono::milliseconds(newChannel.config.dash.segmentDuration) * 4)) {
+        // The new channel has been stopped, so put the old one back, and show its configuration as the one in use.
+        if (newChannel.config.source.url != oldChannel->config.source.url) {
+            inUseUrls.erase(newChannel.config.source.url);
+            inUseUrls.emplace(oldChannel->config.source.url);
+        }
+        config.channels.at(channelPath) = oldChannel->config;
+        channels.at(channelPath) = std::move(oldChannel);
+        logContext << "state" << Log::Level::info << "Kept the old channel";
+        co_return;
+    }
+
+    /* Keep serving the old channel's segments until they've expired. */
+    auto it = retiringChannels.insert(retiringChannels.end(), std::move(oldChannel));
+    (*it)->retirementTimer.expiresAfter(std::chrono::seconds((*it)->config.history.historyLength), [this, it]() {
+        retiringChannels.erase(it);
+    });
+    logContext << "state" << Log::Level::info << "Handed over";
+}
+
+Awaitable<void> Instance::State::startChannel(const std::string &channelPath, const Config::Channel &channelConfig,
+                                              bool publish, std::chrono::milliseconds probeTime)
+{
+    /* Compare the shapes of filter graph, if asked to. This is done before the channel's ffmpeg starts, so the two
+       don't compete for the CPU or the source. Separated ingest streams can only be read by the channel's ffmpeg. */
+    if (channelConfig.ffmpeg.benchmark > 0 && !channelConfig.source.url.starts_with("ingest_http://")) {
+        co_await benchmarkFilter(ioc, *log, channelConfig);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Channel &channel = *channels.emplace(channelPath, std::make_unique<Channel>(ioc, *log, config, channelConfig,
+                                                                                 channelPath, server, publish))
+                                .first->second;
+    co_await channel.waitForProbe(); // Avoid running ffprobe redundantly.
+
+    /* Report how long it took, to help find the sources that hold up the others. */
+    Log::Context logContext = (*log)("startup");
+    logContext << "channel" << Log::Level::info << Json::dump({
+        { "path", channelPath },
+        { "uid", channelConfig.uid },
+        { "probeMs", probeTime.count() },
+        { "startMs",
+          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() }
+    });
+}
+
 /// Change the settings. Add as much clever incremental reconfiguration logic here as you like.
 /// Various options are re-read every time they're used and don't require explicit reconfiguration,
 /// so they don't appear specifically within this function.
@@ -114,25 +404,35 @@ Awaitable<void> Instance::State::applyConfiguration(Config::Root newCfg)
     Config::fillInInitialDefaults(newCfg);
     std::set<std::string> newInUseUrls;
     std::vector<Ffmpeg::ProbeResult> probes; // Optimization to keep the probe from running twice.
-    co_await Config::fillInDefaults([this, &newInUseUrls, &probes](const std::string &url,
-                                                                   const std::vector<std::string> &arguments) ->
+    std::map<std::string, std::chrono::milliseconds> probeTimes; // For reporting how long each channel took to start.
+    co_await Config::fillInDefaults([this, &newInUseUrls, &probes, &probeTimes]
+                                    (const std::string &url, const std::vector<std::string> &arguments) ->
                                     Awaitable<MediaInfo::SourceInfo> {
         assert(!newInUseUrls.contains(url)); // This should be imposed by Config::Root::validate.
         inUseUrls.emplace(url); // The new and old URLs are in use at the same time now, but just temporarily.
         newInUseUrls.emplace(url);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         probes.emplace_back(co_await Ffmpeg::ffprobe(ioc, url, arguments));
+        probeTimes[url] =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
         co_return probes.back();
-    }, newCfg);
+    }, newCfg, [this](const std::string &path, const std::vector<Codec::VideoCodec> &codecs) ->
+                   Awaitable<std::vector<Config::EncoderThroughput>> {
+        // Measuring takes about a minute and is skewed by the channels that are running, so it's left to --calibrate.
+        co_return Ffmpeg::loadCalibration(*log, path, codecs);
+    });
 
 #define CANT_CHANGE(N) configCannotChange(config.N != newCfg.N, #N)
     // Listen port can be changed only by restarting the process (and will probably break
     // the settings UI if you're doing that on one of the hardware units).
     CANT_CHANGE(network.port);
     CANT_CHANGE(network.publicPort);
+    CANT_CHANGE(network.threads);
 
     // We don't currently have the code to change these.
     CANT_CHANGE(http.ephemeralWhenNotFound);
     CANT_CHANGE(features);
+    CANT_CHANGE(probeCache);
 
     // Reconfigure the logger.
     if (config.log != newCfg.log) {
@@ -148,9 +448,9 @@ Awaitable<void> Instance::State::applyConfiguration(Config::Root newCfg)
 
     // Delete channels that are simply gone.
     std::vector<std::string> murderise;
-    for (auto &[channelPath, channelConfig]: channels) {
+    for (auto &[channelPath, channel]: channels) {
         if (!newCfg.channels.contains(channelPath)) {
-            co_await channelConfig.ffmpeg.kill();
+            co_await channel->kill();
             murderise.push_back(channelPath);
         }
     }
@@ -159,38 +459,54 @@ Awaitable<void> Instance::State::applyConfiguration(Config::Root newCfg)
     }
 
     // Update channels that have been.. updated.
+    std::map<std::string, std::unique_ptr<Channel>> handovers; // Old channels that keep streaming until replaced.
     for (const auto &[channelPath, channelConfig]: newCfg.channels) {
-        if (channels.contains(channelPath)) {
+        auto it = channels.find(channelPath);
+        if (it != channels.end()) {
             // Only restart streaming if the channel configuration changed.
-            if (channelConfig.differsByUidOnly(config.channels.at(channelPath))) {
+            if (channelConfig.differsByUidOnly(it->second->config)) {
                 continue;
             }
 
-            // Destroy the channel, and rely on the code below to recreate it.
-            auto& node = channels.at(channelPath);
-            co_await node.ffmpeg.kill();
-
-            // Delete the channel. TODO: Can all of the above just... happen in destructors so this is the only line needed?
-            channels.erase(channelPath);
+            // Either keep the channel running until its replacement is ready, or destroy it now. Either way, rely on
+            // the code below to recreate it.
+            if (getCanHandOver(it->second->config, channelConfig)) {
+                handovers.emplace(channelPath, std::move(it->second));
+            }
+            else {
+                co_await it->second->kill();
+            }
+            channels.erase(it);
         }
     }
 
-    /* Move the configuration to its final location so  */
-    // TODO: Either this needs to update only the channels we stopped above, or the channels need a copy of the
-    //       configuration. Exactly what we do here depends on how we hand over a channel from one ffmpeg/DashResources
-    //       to the next. If we do it by having both in parallel, then it'll need to be a copy.
+    /* Move the configuration to its final location. Each channel has its own copy, so this doesn't disturb the ones
+       still running. */
     config = std::move(newCfg);
 
-    /* Start streaming. */
+    /* Start streaming. The channels are started in parallel, because each has to wait for its ffmpeg to probe the
+       source. */
     inUseUrls = std::move(newInUseUrls); // Now we've finished with the old channels, show the new ones as in use.
+    std::vector<Awaitable<void>> startups;
     for (const auto &[channelPath, channelConfig]: config.channels) {
         if (channels.contains(channelPath)) {
             continue;
         }
-        auto it = channels.emplace(std::piecewise_construct, std::forward_as_tuple(channelPath),
-                                   std::forward_as_tuple(ioc, *log, config, channelConfig, channelPath, server));
-        co_await it.first->second.ffmpeg.waitForProbe(); // Avoid running ffprobe redundantly.
+        bool publish = !handovers.contains(channelPath); // A replacement is published once it's ready.
+        auto probeTime = probeTimes.find(channelConfig.source.url);
+        startups.emplace_back(startChannel(channelPath, channelConfig, publish,
+                                           (probeTime == probeTimes.end()) ? std::chrono::milliseconds(0) :
+                                                                             probeTime->second));
+    }
+    co_await awaitTree(startups, config.compute.startupParallelism);
+
+    /* Hand over from the channels that are being replaced. The new channels were all started above, so they warm up in
+       parallel, and they're handed over in parallel as they become ready. */
+    std::vector<Awaitable<void>> handOverAwaitables;
+    for (auto &[channelPath, oldChannel]: handovers) {
+        handOverAwaitables.emplace_back(handOver(channelPath, std::move(oldChannel)));
     }
+    co_await awaitTree(handOverAwaitables);
 
     /* Now that we got here, we successfully applied the new configuration, so record it as the new requested
        configuration. */
@@ -4,9 +4,13 @@
 #include "server/HttpServer.hpp"
 #include "util/Mutex.hpp"
 
+#include <chrono>
+#include <list>
 #include <map>
 #include <stdexcept>
 
+class IOContextPool;
+
 namespace Ffmpeg
 {
 
@@ -104,7 +108,13 @@ private:
     /**
      * The state for the channel that's streaming.
      */
-    std::map<std::string, Channel> channels;
+    std::map<std::string, std::unique_ptr<Channel>> channels;
+
+    /**
+     * Channels that have been handed over to a new channel, and whose segments are still being served until they
+     * expire.
+     */
+    std::list<std::unique_ptr<Channel>> retiringChannels;
 
     /**
      * The set of URLs that are in use by the current configuration.
@@ -120,11 +130,33 @@ private:
     /// Used to throw exceptions if you try to change a setting that isn't allowed to change except on startup.
     void configCannotChange(bool itChanged, const std::string& name) const;
 
+    /**
+     * Switch clients over from a channel to the channel that replaces it, once the new one is ready.
+     *
+     * The old channel is stopped, and destroyed once its segments have expired. If the new channel doesn't become
+     * ready, it's stopped instead, and the old channel and its configuration are put back.
+     *
+     * @param channelPath The path of the channel, whose entry in channels is the replacement, which hasn't published its
+     *                    resources.
+     * @param oldChannel The channel being replaced.
+     */
+    Awaitable<void> handOver(const std::string &channelPath, std::unique_ptr<Channel> oldChannel);
+
+    /**
+     * Create a channel, and wait for its ffmpeg to probe the source.
+     *
+     * @param publish Whether to publish the channel's resources now, rather than when it's handed over to.
+     * @param probeTime How long the source took to probe while filling in the configuration, for reporting.
+     */
+    Awaitable<void> startChannel(const std::string &channelPath, const Config::Channel &channelConfig, bool publish,
+                                 std::chrono::milliseconds probeTime);
+
 public:
     /// Perform initial setup/configuration.
+    /// The HTTP server uses every IO context in the pool. Everything else uses the main one.
     State(
         const Config::Root& initialCfg,
-        IOContext& ioc
+        IOContextPool& iocs
     );
 
     inline IOContext& getIoc() const {
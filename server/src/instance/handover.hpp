@@ -0,0 +1,48 @@
+#pragma once
+
+#include "log/Log.hpp"
+#include "util/awaitable.hpp"
+
+#include <chrono>
+
+/// @addtogroup state
+/// @{
+
+namespace Instance
+{
+
+/**
+ * Switch clients over from a channel to the channel that replaces it, once the new one is ready, and stop the old one.
+ *
+ * If the new channel isn't ready in time, the old one is kept and the new one is stopped instead, so that clients
+ * aren't moved from a working channel to one that might not be working.
+ *
+ * This is a template so that it can be tested without running ffmpeg. A Channel has a kill() coroutine that stops its
+ * ffmpeg, and a dash member with waitForFirstSegment, publish and markSuperseded, like Dash::DashResources.
+ *
+ * @param oldChannel The channel being replaced.
+ * @param newChannel The channel replacing it, which hasn't published its resources.
+ * @param timeout How long to wait for the new channel to be ready before giving up on it.
+ * @return Whether the new channel was ready before the timeout, and so replaced the old one.
+ */
+template <typename Channel>
+Awaitable<bool> handOverChannel(Log::Context &logContext, Channel &oldChannel, Channel &newChannel,
+                                std::chrono::milliseconds timeout)
+{
+    /* Wait for the new channel to have a complete segment for every stream. */
+    if (!co_await newChannel.dash.waitForFirstSegment(timeout)) {
+        logContext << Log::Level::error << "Timed out waiting for the first segment. Keeping the old channel.";
+        co_await newChannel.kill();
+        co_return false;
+    }
+
+    /* Switch to the new channel before stopping the old one, so there's no gap. */
+    newChannel.dash.publish();
+    oldChannel.dash.markSuperseded();
+    co_await oldChannel.kill();
+    co_return true;
+}
+
+} // namespace Instance
+
+/// @}
@@ -6,7 +6,7 @@ Log::FileLog::~FileLog() = default;
 
 Log::FileLog::FileLog(IOContext &ioc, const std::filesystem::path &path, Level minLevel, bool print,
                       size_t endCacheSize, size_t loadCacheSize) :
-    Log(minLevel, print, ioc), mutex(ioc),
+    Log(minLevel, print, ioc),
     file(ioc, path, true, true), endCacheSize(endCacheSize), loadCacheSize(loadCacheSize)
 {
     assert(loadCacheSize > 0);
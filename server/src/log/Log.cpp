@@ -3,6 +3,7 @@
 #include "util/asio.hpp"
 
 #include <cassert>
+#include <optional>
 
 Log::Context::NewItem::~NewItem()
 {
@@ -64,11 +65,12 @@ Log::Log::~Log() = default;
 Log::Log::Log(Level minLevel, bool print, IOContext &ioc) :
     ioc(ioc),
     steadyCreationTime(std::chrono::steady_clock::now()), systemCreationTime(std::chrono::system_clock::now()),
-    minLevel(minLevel), print(print), event(ioc)
+    minLevel(minLevel), print(print)
 {
 }
 
 void Log::Log::reconfigure(Level level, bool p) {
+    std::lock_guard lock(mutex);
     minLevel = level;
     print = p;
 }
@@ -79,24 +81,31 @@ Log::Context Log::Log::operator()(std::string_view name)
 
     /* Find the context index counter if it exists. */
     std::string nameStr(name.data(), name.size());
-    auto it = contextNextIndices.find(nameStr);
-
-    /* If it doesn't exist, create it. */
-    if (it == contextNextIndices.end()) {
-        it = contextNextIndices.insert({nameStr, 0}).first;
+    size_t index;
+    {
+        std::lock_guard lock(mutex);
+        auto it = contextNextIndices.find(nameStr);
+
+        /* If it doesn't exist, create it. */
+        if (it == contextNextIndices.end()) {
+            it = contextNextIndices.insert({nameStr, 0}).first;
+        }
+        index = (*it).second++;
     }
 
     /* Create a new context with the right index. */
-    return Context(*this, std::move(nameStr), (*it).second++);
+    return Context(*this, std::move(nameStr), index);
 }
 
 Awaitable<Log::Item> Log::Log::operator[](size_t index) const
 {
-    assert(index < writtenItems + queue.size());
-
     /* If the item is still in the queue, just return a copy of it. */
-    if (index >= writtenItems) {
-        co_return queue[index - writtenItems];
+    {
+        std::unique_lock lock(mutex);
+        assert(index < writtenItems + queue.size());
+        if (index >= writtenItems) {
+            co_return queue[index - writtenItems];
+        }
     }
 
     /* The item has already left the queue, so get it from where we sent it. */
@@ -110,30 +119,47 @@ Awaitable<void> Log::Log::wait() const
 
 void Log::Log::append(Item item)
 {
-    /* Since we couldn't write the creation log entry in the constructor, write it now. */
-    if (writtenItems == 0 && queue.empty() && minLevel <= Level::info) {
-        scheduleAppend({
-            .logTime = std::chrono::steady_clock::duration(0),
-            .contextTime = std::chrono::steady_clock::duration(0),
-            .systemTime = std::chrono::system_clock::now(),
-            .level = Level::info,
-            .kind = "log",
-            .message = "created",
-            .contextName = "",
-            .contextIndex = 0
-        });
-    }
+    bool startWriter = false;
+    {
+        std::lock_guard lock(mutex);
+
+        /* Since we couldn't write the creation log entry in the constructor, write it now. */
+        if (writtenItems == 0 && queue.empty() && minLevel <= Level::info) {
+            startWriter |= scheduleAppend({
+                .logTime = std::chrono::steady_clock::duration(0),
+                .contextTime = std::chrono::steady_clock::duration(0),
+                .systemTime = std::chrono::system_clock::now(),
+                .level = Level::info,
+                .kind = "log",
+                .message = "created",
+                .contextName = "",
+                .contextIndex = 0
+            });
+        }
 
-    /* Ignore items whose level is lower than the minimum level. */
-    if (item.level < minLevel) {
-        return;
+        /* Ignore items whose level is lower than the minimum level. */
+        if (item.level < minLevel) {
+            return;
+        }
+
+        /* Write the actual log entry. */
+        startWriter |= scheduleAppend(std::move(item));
     }
 
-    /* Write the actual log entry. */
-    scheduleAppend(std::move(item));
+    /* Notify the event now. */
+    // Doing this before scheduling the storage of the queue means it's likely the fast path of operator[] returning
+    // from the queue will be hit. Also, we should do this evne if the scheduler coroutine has already been spawned.
+    event.notifyAll();
+
+    /* If there's an outstanding writer coroutine, leave it to write what we just added. Otherwise, create one. */
+    // New coroutine to actually call store, even though append isn't a coroutine. This is always in the log's own IO
+    // context, even if the item came from another thread.
+    if (startWriter) {
+        spawnDetached(ioc, [this]() -> Awaitable<void> { return scheduleQueue(); });
+    }
 }
 
-void Log::Log::scheduleAppend(Item item)
+bool Log::Log::scheduleAppend(Item item)
 {
     /* Format the message to stderr if we're printing. */
     if (print) {
@@ -143,31 +169,30 @@ void Log::Log::scheduleAppend(Item item)
     /* Add the item to the queue. */
     queue.emplace_back(std::move(item));
 
-    /* Notify the event now. */
-    // Doing this before scheduling the storage of the queue means it's likely the fast path of operator[] returning
-    // from the queue will be hit. Also, we should do this evne if the scheduler coroutine has already been spawned.
-    event.notifyAll();
-
-    /* If there's an outstanding writer coroutine, leave it to write what we just added. Otherwise, create one. */
-    // If our item is the only one, then there won't be a coroutine in flight to do the writing. Otherwise, there will
-    // be from whatever created the already existing items.
-    if (queue.size() > 1) {
-        return;
-    }
-
-    // New coroutine to actually call store, even though scheduleAppend isn't a coroutine.
-    spawnDetached(ioc, [this]() -> Awaitable<void> { return scheduleQueue(); });
+    /* If our item is the only one, then there won't be a coroutine in flight to do the writing. Otherwise, there will
+       be from whatever created the already existing items. */
+    return queue.size() == 1;
 }
 
 Awaitable<void> Log::Log::scheduleQueue()
 {
     /* Keep calling the store coroutine until the queue is empty. New items can be added while we're doing this that
        this loop will handle. */
-    while (!queue.empty()) {
-        // Store the first item.
+    while (true) {
+        // Get the first item.
+        // Unfortunately, this can't be a move because it could race with operator[].
+        std::optional<Item> item;
+        {
+            std::lock_guard lock(mutex);
+            if (queue.empty()) {
+                break;
+            }
+            item = queue.front();
+        }
+
+        // Store it.
         try {
-            // Unfortunately, this can't be a move because it could race with operator[].
-            co_await store(queue.front());
+            co_await store(std::move(*item));
         }
         catch (const std::exception &e) {
             fprintf(stderr, "Error storing exception: %s\n", e.what());
@@ -178,7 +203,11 @@ Awaitable<void> Log::Log::scheduleQueue()
 
         // Now that we've done the store, remove the remnant of the queue item. That signals that this method is not
         // ongoing if this leaves the queue empty.
+        std::lock_guard lock(mutex);
         queue.pop_front();
         writtenItems++;
+        if (queue.empty()) {
+            break;
+        }
     }
 }
@@ -5,6 +5,7 @@
 
 #include <deque>
 #include <map>
+#include <mutex>
 #include <sstream>
 
 #include "util/awaitable.hpp"
@@ -205,6 +206,9 @@ private:
  *
  * This is an abstract class for better testing, to abstract away and separate the Boost filesystem and asio,
  * implementation, and to make it clearer to have different implementations (e.g: an in-memory implementation).
+ *
+ * Contexts can be created and written to from any thread. Storage always happens in the IO context the log was created
+ * with.
  */
 class Log
 {
@@ -235,6 +239,7 @@ public:
      */
     size_t size() const
     {
+        std::lock_guard lock(mutex);
         return writtenItems + queue.size();
     }
 
@@ -291,8 +296,12 @@ private:
 
     /**
      * Schedule the append for ordered asynchronous append.
+     *
+     * This must be called with the mutex locked.
+     *
+     * @return True if there was no writer coroutine already, so one needs to be started.
      */
-    void scheduleAppend(Item item);
+    bool scheduleAppend(Item item);
 
     /**
      * Schedule the storage of everything in the queue (including everything that's added after the call, but prior to
@@ -306,6 +315,11 @@ private:
     Level minLevel;
     bool print;
 
+    /**
+     * Protects the members below from concurrent access by threads that are writing to the log.
+     */
+    mutable std::mutex mutex;
+
     /**
      * The number of items that have been written.
      */
@@ -16,3 +16,8 @@ void Server::ConstantResource::getSync(Response &response, [[maybe_unused]] cons
     response.setMimeType(mimeType);
     response << content;
 }
+
+bool Server::ConstantResource::getAllowConcurrentGet() const noexcept
+{
+    return true;
+}
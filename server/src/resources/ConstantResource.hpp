@@ -55,6 +55,7 @@ public:
     }
 
     void getSync(Response &response, const Request &request) override;
+    bool getAllowConcurrentGet() const noexcept override;
 
 private:
     std::vector<std::byte> content;
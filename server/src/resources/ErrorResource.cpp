@@ -31,3 +31,8 @@ void Server::ErrorResource::putSync(Response& response, const Request&) {
     }
     sendError(response);
 }
+
+bool Server::ErrorResource::getAllowConcurrentGet() const noexcept
+{
+    return true;
+}
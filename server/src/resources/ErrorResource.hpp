@@ -41,6 +41,7 @@ public:
     {}
 
     void getSync(Response &response, const Request &request) override;
+    bool getAllowConcurrentGet() const noexcept override;
     void postSync(Response &response, const Request &request) override;
     void putSync(Response &response, const Request &request) override;
 
@@ -3,10 +3,20 @@
 #include "server/Request.hpp"
 #include "server/Response.hpp"
 #include "util/asio.hpp"
+#include "util/Event.hpp"
 #include "util/File.hpp"
 #include "util/subprocess.hpp"
 
+#include <boost/asio/co_spawn.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <exception>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 
 namespace
 {
@@ -45,10 +55,246 @@ Awaitable<std::string> getMimeTypeForFile(IOContext &ioc, const std::filesystem:
     co_return mimeType;
 }
 
+/**
+ * Convert a file modification time to a time_t, which is the precision of HTTP dates.
+ */
+std::time_t getTimeT(std::filesystem::file_time_type time)
+{
+    return std::chrono::system_clock::to_time_t(
+        std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(time)));
+}
+
+/**
+ * Format a file modification time as an HTTP date.
+ */
+std::string formatHttpDate(std::filesystem::file_time_type time)
+{
+    std::time_t t = getTimeT(time);
+    std::tm tm;
+    gmtime_r(&t, &tm);
+    char result[32];
+    size_t length = std::strftime(result, sizeof(result), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(result, length);
+}
+
+/**
+ * Parse an HTTP date, in any of the formats that RFC 9110 says must be accepted.
+ *
+ * @return The time, or nothing if the date isn't valid.
+ */
+std::optional<std::time_t> parseHttpDate(std::string_view date)
+{
+    std::string dateString(date);
+    for (const char *format: { "%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %e %H:%M:%S %Y" }) {
+        std::tm tm{};
+        const char *end = strptime(dateString.c_str(), format, &tm);
+        if (end && *end == '\0') {
+            return timegm(&tm);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Determine whether an If-None-Match header matches an ETag.
+ */
+bool getETagMatches(std::string_view ifNoneMatch, std::string_view eTag)
+{
+    while (!ifNoneMatch.empty()) {
+        // Get the next tag in the list, ignoring whether it's weak.
+        size_t comma = ifNoneMatch.find(',');
+        std::string_view tag = ifNoneMatch.substr(0, comma);
+        ifNoneMatch = (comma == std::string_view::npos) ? std::string_view{} : ifNoneMatch.substr(comma + 1);
+        while (!tag.empty() && tag.front() == ' ') {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && tag.back() == ' ') {
+            tag.remove_suffix(1);
+        }
+        if (tag.starts_with("W/")) {
+            tag.remove_prefix(2);
+        }
+
+        // Check it.
+        if (tag == "*" || tag == eTag) {
+            return true;
+        }
+    }
+    return false;
+}
+
 } // namespace
 
+/**
+ * What's known about a version of a file.
+ */
+struct Server::FilesystemResource::CachedFile final
+{
+    /**
+     * The modification time and size, which tell when the file has changed.
+     */
+    std::filesystem::file_time_type modified;
+    uintmax_t size;
+
+    std::string mimeType;
+    std::string eTag;
+    std::string lastModified;
+
+    /**
+     * The file's content, or nothing if it's too big to keep in memory.
+     */
+    std::optional<Util::SharedBuffer> content;
+};
+
+/**
+ * The files that have been read, with the least recently used ones thrown away first.
+ *
+ * This is shared between the server's threads, so it's protected by a mutex that's only held while the maps are used.
+ */
+struct Server::FilesystemResource::MemoryCache final
+{
+    /**
+     * How much each file counts against the size limit, on top of its content.
+     */
+    static constexpr size_t entryOverhead = 1 << 10;
+
+    struct Entry final
+    {
+        std::shared_ptr<const CachedFile> file;
+        std::list<std::filesystem::path>::iterator lruPosition;
+    };
+
+    /**
+     * Constructor :)
+     *
+     * @param maxSize The most bytes to keep.
+     */
+    explicit MemoryCache(size_t maxSize) : maxSize(maxSize) {}
+
+    /**
+     * Get a file, if what's cached is still current.
+     */
+    std::shared_ptr<const CachedFile> get(const std::filesystem::path &filePath,
+                                          std::filesystem::file_time_type modified, uintmax_t size)
+    {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(filePath);
+        if (it == entries.end() || it->second.file->modified != modified || it->second.file->size != size) {
+            return nullptr;
+        }
+        lru.splice(lru.begin(), lru, it->second.lruPosition);
+        return it->second.file;
+    }
+
+    /**
+     * Add or replace a file, throwing away the least recently used files until it fits.
+     */
+    void put(const std::filesystem::path &filePath, std::shared_ptr<const CachedFile> file)
+    {
+        std::lock_guard lock(mutex);
+        eraseLocked(filePath);
+        size_t fileSize = getSize(*file);
+        if (fileSize > maxSize) {
+            return;
+        }
+        while (size + fileSize > maxSize) {
+            eraseLocked(lru.back());
+        }
+        lru.push_front(filePath);
+        entries.emplace(filePath, Entry{ std::move(file), lru.begin() });
+        size += fileSize;
+    }
+
+    /**
+     * Forget about a file.
+     */
+    void erase(const std::filesystem::path &filePath)
+    {
+        std::lock_guard lock(mutex);
+        eraseLocked(filePath);
+    }
+
+    /**
+     * The most bytes to keep.
+     */
+    const size_t maxSize;
+
+private:
+    static size_t getSize(const CachedFile &file)
+    {
+        return entryOverhead + (file.content ? file.content->size() : 0);
+    }
+
+    void eraseLocked(const std::filesystem::path &filePath)
+    {
+        auto it = entries.find(filePath);
+        if (it == entries.end()) {
+            return;
+        }
+        size -= getSize(*it->second.file);
+        lru.erase(it->second.lruPosition);
+        entries.erase(it);
+    }
+
+    std::mutex mutex;
+    std::map<std::filesystem::path, Entry> entries;
+
+    /**
+     * The paths in entries, from the most recently used.
+     */
+    std::list<std::filesystem::path> lru;
+
+    /**
+     * The total size of the entries.
+     */
+    size_t size = 0;
+};
+
+/**
+ * A file that's being loaded, which other requests for the same version of the file wait for rather than loading it
+ * again.
+ */
+struct Server::FilesystemResource::PendingLoad final
+{
+    explicit PendingLoad(std::filesystem::file_time_type modified, uintmax_t size) :
+        modified(modified), size(size)
+    {
+    }
+
+    /**
+     * The version of the file that's being loaded.
+     */
+    std::filesystem::file_time_type modified;
+    uintmax_t size;
+
+    /**
+     * The result, or the exception that happened while loading it.
+     */
+    std::shared_ptr<const CachedFile> file;
+    std::exception_ptr exception;
+
+    /**
+     * Notified when the result is filled in.
+     */
+    Event event;
+
+    /**
+     * Whether the result has been filled in.
+     */
+    bool filledIn = false;
+};
+
 Server::FilesystemResource::~FilesystemResource() = default;
 
+Server::FilesystemResource::FilesystemResource(IOContext &ioc, std::filesystem::path path, std::filesystem::path index,
+                                               CacheKind cacheKind, bool isPublic, size_t maxPutSize,
+                                               size_t maxMemoryCacheSize) :
+    Resource(isPublic),
+    ioc(ioc), memoryCache(std::make_unique<MemoryCache>(maxMemoryCacheSize)), path(std::move(path)),
+    index(std::move(index)), cacheKind(cacheKind), maxPutSize(maxPutSize)
+{
+}
+
 Awaitable<void> Server::FilesystemResource::getAsync(Response &response, Request &request)
 {
     /* Set up some response properties. */
@@ -57,29 +303,56 @@ Awaitable<void> Server::FilesystemResource::getAsync(Response &response, Request
     /* Figure out the path. */
     std::filesystem::path filePath = getFullPath(request.getPath());
 
-    /* We need a mutex if we can PUT so there isn't a race condition. */
-    auto lockGuard = maxPutSize ? std::make_unique<Mutex::LockGuard>(co_await mutex.lockGuard()) : nullptr;
-
     /* Check that the path exists and that it's not a directory. */
     // Unfortunately, boost.asio doesn't seem to have anything that would do this.
-    if (!std::filesystem::exists(filePath)) {
+    std::error_code error;
+    std::filesystem::file_status status = std::filesystem::status(filePath, error);
+    if (!std::filesystem::exists(status)) {
         throw Error(ErrorKind::NotFound);
     }
-    if (std::filesystem::is_directory(filePath)) {
+    if (std::filesystem::is_directory(status)) {
         throw Error(ErrorKind::Forbidden);
     }
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(filePath, error);
+    uintmax_t size = std::filesystem::file_size(filePath, error);
+    if (error) {
+        throw Error(ErrorKind::NotFound);
+    }
+
+    /* Get the file from the cache, or read it in the resource's IO context if it's not there or it's changed. */
+    std::shared_ptr<const CachedFile> file = memoryCache->get(filePath, modified, size);
+    if (!file) {
+        file = co_await boost::asio::co_spawn((boost::asio::io_context &)ioc, getFile(filePath, modified, size),
+                                              boost::asio::use_awaitable);
+    }
 
-    /* Set the MIME type. */
-    response.setMimeType(co_await getMimeTypeForFile(ioc, filePath));
+    /* Set the headers, and stop if the client already has the file. */
+    response.setMimeType(file->mimeType);
+    response.setHeader(boost::beast::http::field::etag, file->eTag);
+    response.setHeader(boost::beast::http::field::last_modified, file->lastModified);
+    // If-None-Match takes precedence over If-Modified-Since, which is satisfied if the file is no newer than it.
+    std::string_view ifNoneMatch = request.getHeader(boost::beast::http::field::if_none_match);
+    bool notModified = false;
+    if (!ifNoneMatch.empty()) {
+        notModified = getETagMatches(ifNoneMatch, file->eTag);
+    }
+    else {
+        std::optional<std::time_t> since =
+            parseHttpDate(request.getHeader(boost::beast::http::field::if_modified_since));
+        notModified = since && getTimeT(file->modified) <= *since;
+    }
+    if (notModified) {
+        response.setNotModified();
+        co_return;
+    }
 
-    /* Write the file to the response. */
-    Util::File file(ioc, std::move(filePath));
-    while (true) {
-        std::vector<std::byte> data = co_await file.readSome();
-        if (data.empty()) {
-            co_return;
-        }
-        response << std::move(data);
+    /* Write the file to the response, preferably straight from the file if it's not in memory. */
+    if (file->content) {
+        response << *file->content;
+    }
+    else if (!co_await response.writeFile(filePath, 0, file->size)) {
+        co_await boost::asio::co_spawn((boost::asio::io_context &)ioc, streamFile(response, std::move(filePath)),
+                                       boost::asio::use_awaitable);
     }
 }
 
@@ -93,7 +366,7 @@ Awaitable<void> Server::FilesystemResource::putAsync(Response &response, Request
     /* Figure out the path. */
     std::filesystem::path filePath = getFullPath(request.getPath());
 
-    /* Stop concurrent operations. */
+    /* Stop concurrent PUTs. */
     auto lockGuard = co_await mutex.lockGuard();
 
     /* Check that the path either doesn't exist, or is not a directory. */
@@ -104,15 +377,26 @@ Awaitable<void> Server::FilesystemResource::putAsync(Response &response, Request
     /* Create parent directories if necessary. */
     std::filesystem::create_directories(filePath.parent_path());
 
-    /* Write the file contents. */
-    Util::File file(ioc, std::move(filePath), true, false);
-    while (true) {
-        std::vector<std::byte> data = co_await request.readSome();
-        if (data.empty()) {
-            co_return;
+    /* Write the file contents to a temporary file, and then move it into place, so GET requests never see a partially
+       written file. The temporary file is hidden, and can't be requested at all, because Path doesn't allow ':'. */
+    std::filesystem::path partialPath = filePath.parent_path() / ("." + filePath.filename().string() + ":partial");
+    try {
+        Util::File file(ioc, partialPath, true, false);
+        while (true) {
+            Util::SharedBuffer data = co_await request.readSome();
+            if (data.empty()) {
+                break;
+            }
+            co_await file.write(data);
         }
-        co_await file.write(data);
     }
+    catch (...) {
+        std::error_code error;
+        std::filesystem::remove(partialPath, error);
+        throw;
+    }
+    std::filesystem::rename(partialPath, filePath);
+    memoryCache->erase(filePath);
 }
 
 bool Server::FilesystemResource::getAllowNonEmptyPath() const noexcept
@@ -125,6 +409,90 @@ size_t Server::FilesystemResource::getMaxPutRequestLength() const noexcept
     return maxPutSize;
 }
 
+bool Server::FilesystemResource::getAllowConcurrentGet() const noexcept
+{
+    return true;
+}
+
+Awaitable<std::shared_ptr<const Server::FilesystemResource::CachedFile>>
+Server::FilesystemResource::getFile(std::filesystem::path filePath, std::filesystem::file_time_type modified,
+                                    uintmax_t size)
+{
+    /* Another request might have loaded it since this one looked in the cache. */
+    if (std::shared_ptr<const CachedFile> file = memoryCache->get(filePath, modified, size)) {
+        co_return file;
+    }
+
+    /* If another request is loading the same version of the file, wait for it rather than loading it again. */
+    auto it = pendingLoads.find(filePath);
+    if (it != pendingLoads.end() && it->second->modified == modified && it->second->size == size) {
+        std::shared_ptr<PendingLoad> pending = it->second;
+        while (!pending->filledIn) {
+            co_await pending->event.wait();
+        }
+        if (pending->exception) {
+            std::rethrow_exception(pending->exception);
+        }
+        co_return pending->file;
+    }
+
+    /* Otherwise, load it. */
+    std::shared_ptr<PendingLoad> pending = std::make_shared<PendingLoad>(modified, size);
+    pendingLoads[filePath] = pending;
+    try {
+        pending->file = co_await loadFile(filePath, modified, size);
+        memoryCache->put(filePath, pending->file);
+    }
+    catch (...) {
+        pending->exception = std::current_exception();
+    }
+
+    /* Let everything that's waiting for it have it. A newer version of the file might be being loaded by now. */
+    it = pendingLoads.find(filePath);
+    if (it != pendingLoads.end() && it->second == pending) {
+        pendingLoads.erase(it);
+    }
+    pending->filledIn = true;
+    pending->event.notifyAll();
+    if (pending->exception) {
+        std::rethrow_exception(pending->exception);
+    }
+    co_return pending->file;
+}
+
+Awaitable<std::shared_ptr<const Server::FilesystemResource::CachedFile>>
+Server::FilesystemResource::loadFile(std::filesystem::path filePath, std::filesystem::file_time_type modified,
+                                     uintmax_t size)
+{
+    /* Work out the headers. */
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>(CachedFile{
+        .modified = modified,
+        .size = size,
+        .mimeType = co_await getMimeTypeForFile(ioc, filePath),
+        .eTag = "\"" + std::to_string(modified.time_since_epoch().count()) + "-" + std::to_string(size) + "\"",
+        .lastModified = formatHttpDate(modified)
+    });
+
+    /* Read the content if it's small enough that it won't push too much else out of the cache. */
+    if (size <= memoryCache->maxSize / 8) {
+        Util::File content(ioc, std::move(filePath));
+        file->content = Util::SharedBuffer(co_await content.readAll());
+    }
+    co_return file;
+}
+
+Awaitable<void> Server::FilesystemResource::streamFile(Response &response, std::filesystem::path filePath)
+{
+    Util::File file(ioc, std::move(filePath));
+    while (true) {
+        Util::SharedBuffer data = co_await file.readSome();
+        if (data.empty()) {
+            co_return;
+        }
+        response << std::move(data);
+    }
+}
+
 std::filesystem::path Server::FilesystemResource::getFullPath(const Path &requestPath) const
 {
     // This is protected from directory traversal attacks by the constructor for the object returned by
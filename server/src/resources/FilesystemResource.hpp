@@ -5,6 +5,8 @@
 #include "util/Mutex.hpp"
 
 #include <filesystem>
+#include <map>
+#include <memory>
 
 namespace Server
 {
@@ -16,6 +18,10 @@ class Path;
  *
  * Note that this is not atomic in its use of the filesystem, but that should be acceptable for most applications. If
  * it's not, then the user should use a more sophisticated configuration with a reverse HTTP proxy like Nginx.
+ *
+ * Files are kept in memory once they've been read, along with their MIME type and the ETag and Last-Modified headers,
+ * until they change on disk or are pushed out by other files. GET requests can be served from any of the server's
+ * threads.
  */
 class FilesystemResource final : public Resource
 {
@@ -31,14 +37,11 @@ public:
      * @param isPublic Whether the resource should be available publicly. Only GET can be made public. PUT cannot.
      * @param maxPutSize The maximum size of file that can be PUT into this resource. If zero (the default), PUTting is
      *                   not permitted.
+     * @param maxMemoryCacheSize The number of bytes of files to keep in memory. Zero means not to keep anything.
      */
     FilesystemResource(IOContext &ioc, std::filesystem::path path, std::filesystem::path index,
-                       CacheKind cacheKind = CacheKind::fixed, bool isPublic = false, size_t maxPutSize = 0) :
-        Resource(isPublic),
-        ioc(ioc), mutex(ioc), path(std::move(path)), index(std::move(index)), cacheKind(cacheKind),
-        maxPutSize(maxPutSize)
-    {
-    }
+                       CacheKind cacheKind = CacheKind::fixed, bool isPublic = false, size_t maxPutSize = 0,
+                       size_t maxMemoryCacheSize = defaultMaxMemoryCacheSize);
 
     /**
      * Construct a resource to serve a directory from the file system with an index file.
@@ -48,10 +51,12 @@ public:
      * @param isPublic Whether the resource should be available publicly. Only GET can be made public. PUT cannot.
      * @param maxPutSize The maximum size of file that can be PUT into this resource. If zero (the default), PUTting is
      *                   not permitted.
+     * @param maxMemoryCacheSize The number of bytes of files to keep in memory. Zero means not to keep anything.
      */
     FilesystemResource(IOContext &ioc, std::filesystem::path path, CacheKind cacheKind = CacheKind::fixed,
-                       bool isPublic = false, size_t maxPutSize = 0) :
-        FilesystemResource(ioc, std::move(path), {}, cacheKind, isPublic, maxPutSize)
+                       bool isPublic = false, size_t maxPutSize = 0,
+                       size_t maxMemoryCacheSize = defaultMaxMemoryCacheSize) :
+        FilesystemResource(ioc, std::move(path), {}, cacheKind, isPublic, maxPutSize, maxMemoryCacheSize)
     {
     }
 
@@ -60,6 +65,12 @@ public:
 
     bool getAllowNonEmptyPath() const noexcept override;
     size_t getMaxPutRequestLength() const noexcept override;
+    bool getAllowConcurrentGet() const noexcept override;
+
+    /**
+     * The default number of bytes of files to keep in memory.
+     */
+    static constexpr size_t defaultMaxMemoryCacheSize = 16 << 20;
 
 private:
     /**
@@ -69,8 +80,47 @@ private:
      */
     std::filesystem::path getFullPath(const Path &requestPath) const;
 
+    struct CachedFile;
+    struct MemoryCache;
+    struct PendingLoad;
+
+    /**
+     * Get a file from the cache, or load it if it's not there, sharing the load with concurrent requests for it.
+     *
+     * This must be run in the resource's IO context.
+     */
+    Awaitable<std::shared_ptr<const CachedFile>> getFile(std::filesystem::path filePath,
+                                                         std::filesystem::file_time_type modified, uintmax_t size);
+
+    /**
+     * Read a file and find out what it is, so it can be served and cached.
+     *
+     * This must be run in the resource's IO context.
+     */
+    Awaitable<std::shared_ptr<const CachedFile>> loadFile(std::filesystem::path filePath,
+                                                          std::filesystem::file_time_type modified, uintmax_t size);
+
+    /**
+     * Stream a file that's too big to keep in memory to the response, if the response can't send it directly.
+     *
+     * This must be run in the resource's IO context.
+     */
+    Awaitable<void> streamFile(Response &response, std::filesystem::path filePath);
+
     IOContext &ioc;
+
+    /**
+     * Stops PUT requests from interfering with each other.
+     */
     Mutex mutex;
+
+    std::unique_ptr<MemoryCache> memoryCache;
+
+    /**
+     * The files that are being loaded. This is only used in the resource's IO context.
+     */
+    std::map<std::filesystem::path, std::shared_ptr<PendingLoad>> pendingLoads;
+
     const std::filesystem::path path;
     const std::filesystem::path index;
     const CacheKind cacheKind;
@@ -25,7 +25,7 @@ Awaitable<void> Server::PutResource::putAsync(Response &response, Request &reque
     assert(!request.getIsPublic());
 
     /* Read input from the request, and possibly write it to a file (that gets opened here). */
-    std::vector<std::vector<std::byte>> dataParts;
+    std::vector<Util::SharedBuffer> dataParts;
 
     // The scope makes the file close as early as possible.
     {
@@ -38,7 +38,7 @@ Awaitable<void> Server::PutResource::putAsync(Response &response, Request &reque
         // Read input from the request.
         while (true) {
             // Read some data from the request body.
-            std::vector<std::byte> dataPart = co_await request.readSome();
+            Util::SharedBuffer dataPart = co_await request.readSome();
             if (dataPart.empty()) {
                 break;
             }
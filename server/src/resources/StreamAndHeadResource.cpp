@@ -5,15 +5,22 @@
 #include "util/asio.hpp"
 #include "util/debug.hpp"
 
+#include <algorithm>
+
 Server::StreamAndHeadResource::~StreamAndHeadResource() = default;
 
 Server::StreamAndHeadResource::StreamAndHeadResource(IOContext &ioc, Path streamPath, size_t bufferSize,
-                                                     Path headPath, size_t headSize, std::filesystem::path path) :
+                                                     Path headPath, size_t headSize, std::filesystem::path path,
+                                                     std::vector<std::byte> syncMarker) :
     Resource(false),
     streamPath(std::move(streamPath)), bufferSize(bufferSize), headPath(std::move(headPath)), headSize(headSize),
-    pushEvent(ioc), popEvent(ioc), file(path.empty() ? Util::File() : Util::File(ioc, std::move(path), true, false))
+    syncMarker(std::move(syncMarker)),
+    file(path.empty() ? Util::File() : Util::File(ioc, std::move(path), true, false))
 {
     assert(this->headPath != this->streamPath || (this->headPath.empty() && headSize == 0));
+    assert(this->syncMarker.empty() ||
+           std::find(this->syncMarker.begin() + 1, this->syncMarker.end(), this->syncMarker[0]) ==
+           this->syncMarker.end());
     head.reserve(headSize);
 }
 
@@ -51,7 +58,7 @@ Awaitable<void> Server::StreamAndHeadResource::putAsync(Response &response, Requ
     /* Read the request's data. */
     while (true) {
         // Get the next piece of data for the segment.
-        std::vector<std::byte> dataPart = co_await request.readSome();
+        Util::SharedBuffer dataPart = co_await request.readSome();
 
         // End of stream.
         if (dataPart.empty()) {
@@ -63,28 +70,76 @@ Awaitable<void> Server::StreamAndHeadResource::putAsync(Response &response, Requ
             size_t headChunkSize = std::min(headSize - head.size(), dataPart.size());
             head.insert(head.end(), dataPart.data(), dataPart.data() + headChunkSize);
         }
+        bytesReceived += dataPart.size();
+
+        // Write to the file if we're given one.
+        if (file) {
+            co_await file.write(dataPart);
+        }
+
+        /* Joinable streams: keep the prologue, and only pass on what a GET request can start from. */
+        if (!syncMarker.empty()) {
+            // Find where the part's sync marker ends if we need to know.
+            std::optional<size_t> markerEnd;
+            bool markerSearched = !prologueComplete || waitingForSync;
+            if (markerSearched) {
+                markerEnd = matchSyncMarker(dataPart);
+            }
+
+            // Append the data to the prologue until the first sync marker, which is then trimmed off the end.
+            if (!prologueComplete) {
+                prologue.insert(prologue.end(), dataPart.data(), dataPart.data() + markerEnd.value_or(dataPart.size()));
+                if (markerEnd) {
+                    prologue.resize(prologue.size() - syncMarker.size());
+                    prologueComplete = true;
+                    pushEvent.notifyAll();
+                }
+            }
+
+            // Nothing wants the data, so don't hold the sender back.
+            if (!streamGetConnected) {
+                continue;
+            }
+
+            // The sender is never held back, since it might be feeding other streams too. If the GET request has fallen
+            // so far behind that the buffer is full, drop data until it can pick up again from a sync marker.
+            if (!waitingForSync && bufferUsed > 0 && bufferUsed + dataPart.size() > bufferSize) {
+                waitingForSync = true;
+                if (!markerSearched) {
+                    syncMarkerMatched = 0;
+                    markerEnd = matchSyncMarker(dataPart);
+                }
+            }
+
+            // Discard data until a sync marker if the GET request joined part way through the stream, or until the
+            // first one after it's caught up if it fell behind. The marker is passed on whole, even if it was received
+            // in several parts.
+            if (waitingForSync) {
+                if (!markerEnd || bufferUsed > 0) {
+                    continue;
+                }
+                waitingForSync = false;
+                bufferUsed += syncMarker.size();
+                buffer.emplace_back(Util::SharedBuffer::copy(syncMarker));
+                dataPart = dataPart.subspan(*markerEnd);
+                pushEvent.notifyAll();
+                if (dataPart.empty()) {
+                    continue;
+                }
+            }
+        }
 
         // Wait for space in the buffer.
-        while (bufferUsed > 0 && bufferUsed + dataPart.size() > bufferSize) {
+        while (syncMarker.empty() && bufferUsed > 0 && bufferUsed + dataPart.size() > bufferSize) {
             co_await popEvent.wait();
         }
 
         // Add the data to the buffer.
         bufferUsed += dataPart.size();
-        if (file) {
-            buffer.emplace_back(dataPart);
-        }
-        else {
-            buffer.emplace_back(std::move(dataPart));
-        }
+        buffer.emplace_back(std::move(dataPart));
 
         // Notify anything that's waiting for more data that it's now available.
         pushEvent.notifyAll();
-
-        // Write to the file if we're given one.
-        if (file) {
-            co_await file.write(dataPart);
-        }
     }
 
     /* Notify anything that's waiting that we're at the end of the stream. */
@@ -94,14 +149,59 @@ Awaitable<void> Server::StreamAndHeadResource::putAsync(Response &response, Requ
 
 Awaitable<void> Server::StreamAndHeadResource::getStream(Response &response)
 {
-    /* Only one client at a time. */
-    if (streamGetConnected) {
+    /* Only one client at a time. A joinable stream is handed over to the newest client, since the old one is most
+       likely gone. */
+    if (streamGetConnected && syncMarker.empty()) {
         throw Error(ErrorKind::Conflict, "Client already connected");
     }
     streamGetConnected = true;
+    unsigned int generation = ++streamGetGeneration;
+
+    // Record that a joinable stream's client has disconnected, unless it's been replaced, so that the PUT request
+    // stops buffering data for it.
+    struct Disconnect final
+    {
+        ~Disconnect()
+        {
+            if (!resource.syncMarker.empty() && resource.streamGetGeneration == generation) {
+                resource.streamGetConnected = false;
+                resource.buffer.clear();
+                resource.bufferUsed = 0;
+                resource.popEvent.notifyAll();
+            }
+        }
+
+        StreamAndHeadResource &resource;
+        unsigned int generation;
+    } disconnect{ *this, generation };
+
+    /* Join the stream part way through: send the prologue, and then the stream from the next sync marker. */
+    if (!syncMarker.empty() && bytesReceived > 0) {
+        // Whatever is buffered was meant for a previous request, and doesn't start at a sync marker.
+        buffer.clear();
+        bufferUsed = 0;
+        popEvent.notifyAll();
+
+        // Have the PUT request skip to the next sync marker. If the prologue is incomplete, that's the one that
+        // completes it, and the matching so far has to be kept.
+        if (prologueComplete) {
+            syncMarkerMatched = 0;
+        }
+        waitingForSync = true;
+
+        // Send the prologue once we have all of it.
+        while (!prologueComplete && !ended) {
+            co_await pushEvent.wait();
+        }
+        if (generation != streamGetGeneration) {
+            co_return;
+        }
+        response << std::span<const std::byte>(prologue);
+        co_await response.flush();
+    }
 
     /* Keep serving for as long as we can. */
-    while (!ended || !buffer.empty()) {
+    while ((!ended || !buffer.empty()) && generation == streamGetGeneration) {
         // Wait until we have some data.
         if (buffer.empty()) {
             assert(!ended);
@@ -143,6 +243,25 @@ Awaitable<void> Server::StreamAndHeadResource::getHead(Response &response) const
     }
 }
 
+std::optional<size_t> Server::StreamAndHeadResource::matchSyncMarker(std::span<const std::byte> data)
+{
+    /* The marker's first byte doesn't appear anywhere else in it, so a mismatch can only be the start of a new match if
+       it's the first byte. */
+    for (size_t i = 0; i < data.size(); i++) {
+        if (data[i] == syncMarker[syncMarkerMatched]) {
+            syncMarkerMatched++;
+        }
+        else {
+            syncMarkerMatched = (data[i] == syncMarker[0]) ? 1 : 0;
+        }
+        if (syncMarkerMatched == syncMarker.size()) {
+            syncMarkerMatched = 0;
+            return i + 1;
+        }
+    }
+    return std::nullopt;
+}
+
 bool Server::StreamAndHeadResource::validatePathAndGetIsHead(const Path &path) const
 {
     /* Route to the correct sub-resource based on the path. */
@@ -4,8 +4,11 @@
 #include "server/Resource.hpp"
 #include "util/Event.hpp"
 #include "util/File.hpp"
+#include "util/SharedBuffer.hpp"
 
 #include <deque>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace Server
@@ -17,6 +20,13 @@ namespace Server
  *
  * This is useful for things like separated ingest for sources that cannot be probed directly.
  *
+ * If given a sync marker, the stream can be joined part way through: data is discarded while nothing is getting the
+ * stream, and a GET request that arrives after the stream has started is sent the data before the first sync marker
+ * (the prologue) followed by the data from the next sync marker onwards. This suits formats like NUT, whose headers are
+ * followed by syncpoints that a demuxer can start from. A joinable stream never holds the PUT request back: if the GET
+ * request falls so far behind that the buffer fills up, data is dropped until the first sync marker after it's caught
+ * up.
+ *
  * Currently, this is always private and has no caching.
  */
 class StreamAndHeadResource final : public Resource
@@ -33,9 +43,12 @@ public:
      * @param bufferSize The maximum amount of data to keep in the buffer.
      * @param headSize The amount of data to keep for the head data. If zero, then there is no head resource.
      * @param path The path of the file to write the received data to.
+     * @param syncMarker The bytes that mark where the stream can be joined. If empty, the stream can't be joined. Its
+     *                   first byte must not appear anywhere else in it.
      */
     explicit StreamAndHeadResource(IOContext &ioc, Path streamPath, size_t bufferSize,
-                                   Path headPath = {}, size_t headSize = 0, std::filesystem::path path = {});
+                                   Path headPath = {}, size_t headSize = 0, std::filesystem::path path = {},
+                                   std::vector<std::byte> syncMarker = {});
 
     size_t getMaxPutRequestLength() const noexcept override;
     bool getAllowNonEmptyPath() const noexcept override;
@@ -68,11 +81,22 @@ private:
      */
     bool validatePathAndGetIsHead(const Path &path) const;
 
+    /**
+     * Look for the sync marker in the next part of the stream.
+     *
+     * Markers that span several parts are found, as long as every part is given to this in order.
+     *
+     * @param data The next part of the stream.
+     * @return The offset in data just after the end of the marker, if the marker ends in data.
+     */
+    std::optional<size_t> matchSyncMarker(std::span<const std::byte> data);
+
     /* The constructor arguments. */
     const Path streamPath;
     const size_t bufferSize;
     const Path headPath;
     const size_t headSize;
+    const std::vector<std::byte> syncMarker;
 
     /**
      * The event to notify when a new data part is available to any GET requests.
@@ -87,7 +111,7 @@ private:
     /**
      * The data we've received for this segment.
      */
-    std::deque<std::vector<std::byte>> buffer;
+    std::deque<Util::SharedBuffer> buffer;
 
     /**
      * The amount of data in the buffer.
@@ -109,6 +133,37 @@ private:
      */
     bool streamGetConnected = false;
 
+    /**
+     * Incremented by each GET request for the stream, so that a request knows when a newer one has replaced it.
+     */
+    unsigned int streamGetGeneration = 0;
+
+    /**
+     * The amount of data received for the stream.
+     */
+    size_t bytesReceived = 0;
+
+    /**
+     * The data received before the first sync marker.
+     */
+    std::vector<std::byte> prologue;
+
+    /**
+     * Whether the first sync marker has been received, so the prologue is complete.
+     */
+    bool prologueComplete = false;
+
+    /**
+     * Whether received data should be discarded until the next sync marker with an empty buffer, because a GET request
+     * has joined the stream part way through or has fallen behind.
+     */
+    bool waitingForSync = false;
+
+    /**
+     * How many bytes of the sync marker have been matched by the end of the data given to matchSyncMarker.
+     */
+    size_t syncMarkerMatched = 0;
+
     /**
      * The first N bytes of data received by the stream.
      */
@@ -9,17 +9,32 @@
 #include "configuration/configuration.hpp"
 #include "log/Log.hpp"
 #include "util/asio.hpp"
+#include "util/BufferPool.hpp"
+#include "util/IOContextPool.hpp"
 #include "util/util.hpp"
 
+#include <array>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/ip/tcp.hpp>
 
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/core/buffers_suffix.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/buffer_body.hpp>
 #include <boost/beast/http/parser.hpp>
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/serializer.hpp>
-#include <boost/beast/http/write.hpp>
 
 #include "util/debug.hpp"
 
@@ -54,6 +69,50 @@ std::string formatEndpoint(const boost::asio::ip::tcp::endpoint &endpoint)
     return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
 }
 
+/**
+ * Closes a file descriptor when it goes out of scope.
+ */
+struct FileDescriptor final
+{
+    ~FileDescriptor()
+    {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    const int fd;
+};
+
+/**
+ * Bind a socket that listens on a TCP port.
+ *
+ * SO_REUSEPORT isn't set, so this fails if something else is already listening on the port, rather than silently
+ * sharing its connections with it. Each IO context accepts from its own duplicate of this socket instead.
+ */
+boost::asio::ip::tcp::acceptor bindListener(IOContext &ioc, int16_t port)
+{
+    // The options have to be set before binding, which is why this isn't done by the acceptor's constructor.
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v6(), port);
+    boost::asio::ip::tcp::acceptor acceptor(ioc, endpoint.protocol());
+    acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    return acceptor;
+}
+
+/**
+ * Duplicate a listening socket's file descriptor, so another IO context can accept from it.
+ */
+int duplicateListener(boost::asio::ip::tcp::acceptor &acceptor)
+{
+    int fd = ::dup(acceptor.native_handle());
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "Could not duplicate listening socket");
+    }
+    return fd;
+}
+
 /**
  * Implementation of Server::HttpServer::Connection, but as a base class so it can be used by the other HTTP classes,
  * while still allowing it to be used by methods of Server::HttpServer without putting lots of boost stuff in its
@@ -69,6 +128,17 @@ struct Connection
     boost::asio::ip::tcp::socket socket;
     boost::beast::flat_buffer buffer;
     const bool allowPrivate;
+
+    /**
+     * Totals of what responses have written to the socket, so the efficiency of the writes can be checked.
+     */
+    struct
+    {
+        size_t flushes = 0;
+        size_t bytes = 0;
+        size_t buffers = 0;
+        size_t syscalls = 0;
+    } written;
 };
 
 /**
@@ -95,61 +165,75 @@ public:
     {
     }
 
-    Awaitable<std::vector<std::byte>> doReadSome() override
+    std::string_view getHeader(boost::beast::http::field field) const override
+    {
+        auto value = parser.get()[field];
+        return { value.data(), value.size() };
+    }
+
+    Awaitable<Util::SharedBuffer> doReadSome() override
     {
         /* Keep trying to read something until we get a non-empty result or end of body. */
         while (!parser.is_done()) {
-            // Allocate a buffer if one doesn't already exist.
-            if (buffer.empty()) {
-                buffer = std::vector<std::byte>(1 << 16);
+            // Allocate a new block if there isn't one, or if there's not much space left in the current one.
+            if (!block || blockSize - blockOffset < minReadSize) {
+                block = Util::BufferPool::getShared().allocate(blockSize);
+                blockOffset = 0;
             }
 
-            // Read some data from the request body.
+            // Read some data from the request body into the unused part of the block.
             boost::beast::http::buffer_body::value_type &body = parser.get().body();
-            body.data = buffer.data();
-            body.size = buffer.size();
+            body.data = block.get() + blockOffset;
+            body.size = blockSize - blockOffset;
             co_await boost::beast::http::async_read_some(connection.socket, connection.buffer, parser,
                                                          boost::asio::use_awaitable);
-            size_t readBodySize = buffer.size() - body.size;
+            size_t readBodySize = blockSize - blockOffset - body.size;
 
             // Don't return a zero-length read, which boost::beast::http::async_read_some can sometimes falsely emit.
             if (readBodySize == 0) {
                 continue;
             }
 
-            // Return the buffer by moving if most of it was used.
-            // The idea is to avoid the copy. If most of it is unused, then it could be inefficient to the entire memory
-            // allocation for just a small amount of data.
-            if (readBodySize >= buffer.size() / 2) {
-                buffer.resize(readBodySize);
-                co_return std::move(buffer);
-            }
-
-            // Return a copy of the data in the buffer.
-            // This keeps the original buffer for reuse.
-            std::vector<std::byte> result;
-            result.insert(result.end(), buffer.begin(), buffer.begin() + readBodySize);
+            // Return the part of the block that was just read into, sharing ownership of the block. Nothing writes to
+            // that part again, and the next read goes after it.
+            Util::SharedBuffer result(block, std::span(block.get() + blockOffset, readBodySize));
+            blockOffset += readBodySize;
             co_return result;
         }
 
         /* Don't keep reading once we've read the end of the body. */
-        co_return std::vector<std::byte>{};
+        co_return Util::SharedBuffer{};
     }
 
 private:
+    /**
+     * The size of the blocks of memory that the request body is read into. This is one of the pool's sizes.
+     */
+    static constexpr size_t blockSize = 1 << 16;
+    static_assert(blockSize == Util::BufferPool::getCapacity(blockSize));
+
+    /**
+     * The smallest amount of space to read into before starting a new block.
+     */
+    static constexpr size_t minReadSize = blockSize / 8;
+
     boost::beast::http::request_parser<boost::beast::http::buffer_body> &parser;
     Connection &connection;
 
     /**
-     * A buffer into which data can be read.
+     * A block of memory into which data can be read.
      *
-     * By making this a std::vector, we achieve two things.
-     * 1. It can be returned from readSome by moving, rather than by copying.
-     * 2. It can be large without overflowing the stack.
-     *
-     * By making this a member variable, it can be shared across multiple reads if those reads are short.
+     * Each read is returned as a Util::SharedBuffer that refers to the part of the block it was read into, so reads
+     * are never copied. By making this a member variable, short reads share a block rather than each having their own
+     * allocation. The block goes back to the pool once the request and everything that kept any of the data is done
+     * with it.
+     */
+    Util::BufferPool::Block block;
+
+    /**
+     * The offset of the first unused byte in block.
      */
-    std::vector<std::byte> buffer;
+    size_t blockOffset = 0;
 };
 
 /**
@@ -182,48 +266,193 @@ public:
     }
 
 private:
-    void writeBody(std::vector<std::byte> data) override
+    void writeBody(std::span<const Util::SharedBuffer> data) override
     {
         /* Put the data into the queue. Actual writing happens when wait is called. */
-        bodyQueue.emplace_back(std::move(data));
+        bodyQueue.insert(bodyQueue.end(), data.begin(), data.end());
     }
 
     Awaitable<void> flushBody(bool end) override
     {
-        /* Get the new body data to send. */
-        std::vector<std::byte> data = Util::concatenate(std::move(bodyQueue));
+        /* There's nothing more to send if a file has ended the body. */
+        if (bodyEnded) {
+            assert(bodyQueue.empty());
+            co_return;
+        }
+        co_await writeQueued(end);
+    }
+
+    Awaitable<bool> writeFileBody(const std::filesystem::path &path, uint64_t offset, uint64_t length) override
+    {
+        /* HEAD requests don't send the body, so there's nothing to gain. */
+        if (discard) {
+            co_return false;
+        }
+
+        /* Open the file, leaving it to the caller to report any problem. */
+        FileDescriptor file{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+        if (file.fd < 0) {
+            co_return false;
+        }
+
+        /* Send the file after whatever's already been written. */
+        // If the headers have been sent, the body is chunked, so the file goes in a chunk of its own.
+        if (serializer.is_header_done()) {
+            co_await writeQueued(false);
+            if (length > 0) {
+                char *chunkHeaderEnd = chunkHeader.data() + chunkHeader.size() - crlf.size();
+                std::to_chars_result result = std::to_chars(chunkHeader.data(), chunkHeaderEnd, length, 16);
+                assert(result.ec == std::errc());
+                chunkHeaderEnd = result.ptr;
+                *chunkHeaderEnd++ = '\r';
+                *chunkHeaderEnd++ = '\n';
+                boost::asio::const_buffer buffer(chunkHeader.data(), chunkHeaderEnd - chunkHeader.data());
+                co_await writeGathered(std::span(&buffer, 1));
+                co_await sendFile(file.fd, offset, length);
+            }
+            std::array<boost::asio::const_buffer, 2> buffers{
+                boost::asio::const_buffer(crlf.data(), length > 0 ? crlf.size() : 0),
+                boost::asio::const_buffer(lastChunk.data(), lastChunk.size())
+            };
+            co_await writeGathered(buffers);
+        }
+
+        // Otherwise, the length of the whole body is known, so it doesn't need to be chunked.
+        else {
+            co_await writeQueued(true, length);
+            co_await sendFile(file.fd, offset, length);
+        }
+        bodyEnded = true;
+        co_return true;
+    }
+
+    /**
+     * Send the body data that's been written, along with the headers if they haven't been sent yet.
+     *
+     * @param end Whether this is the end of the body.
+     * @param fileLength The length of a file that will be sent straight after this, and end the body.
+     */
+    Awaitable<void> writeQueued(bool end, uint64_t fileLength = 0)
+    {
+        /* Take the new body data to send. */
+        std::vector<Util::SharedBuffer> data = std::move(bodyQueue);
+        bodyQueue.clear();
+        size_t dataSize = 0;
+        for (const Util::SharedBuffer &part: data) {
+            dataSize += part.size();
+        }
 
-        /* If we haven't already sent the headers, send them. */
+        /* Collect everything to send for this flush, so it can all go to the socket in one gathered write rather than
+           being copied together or written piece by piece. */
+        std::vector<boost::asio::const_buffer> buffers;
+        buffers.reserve(data.size() + 4);
+
+        // If we haven't already sent the headers, they go first. The serializer only renders the headers: the body is
+        // written directly below.
+        size_t headerSize = 0;
         if (!serializer.is_header_done()) {
-            co_await transmitHeaders(end ? std::optional(data.size()) : std::nullopt);
+            prepareHeaders(end ? std::optional(dataSize + fileLength) : std::nullopt);
+            serializer.split(true);
+            boost::system::error_code ec;
+            serializer.next(ec, [&](boost::system::error_code &, const auto &headerBuffers) {
+                for (boost::asio::const_buffer buffer: boost::beast::buffers_range_ref(headerBuffers)) {
+                    buffers.push_back(buffer);
+                    headerSize += buffer.size();
+                }
+            });
+            if (ec) {
+                throw boost::system::system_error(ec);
+            }
         }
 
-        /* HEAD requests don't *actually* send the body data. Also, don't bother writing anything if there's no data. */
-        if (discard) {
+        // HEAD requests don't *actually* send the body data.
+        if (!discard) {
+            // Chunked encoding frames each flush's data as one chunk. This is done here rather than with the serializer
+            // so that the framing can be part of the same write as the data.
+            const bool chunked = response.chunked();
+            if (chunked && dataSize > 0) {
+                char *chunkHeaderEnd = chunkHeader.data() + chunkHeader.size() - crlf.size();
+                std::to_chars_result result = std::to_chars(chunkHeader.data(), chunkHeaderEnd, dataSize, 16);
+                assert(result.ec == std::errc());
+                chunkHeaderEnd = result.ptr;
+                *chunkHeaderEnd++ = '\r';
+                *chunkHeaderEnd++ = '\n';
+                buffers.emplace_back(chunkHeader.data(), chunkHeaderEnd - chunkHeader.data());
+            }
+            for (const Util::SharedBuffer &part: data) {
+                if (!part.empty()) {
+                    buffers.emplace_back(part.data(), part.size());
+                }
+            }
+            if (chunked && dataSize > 0) {
+                buffers.emplace_back(crlf.data(), crlf.size());
+            }
+            if (chunked && end) {
+                buffers.emplace_back(lastChunk.data(), lastChunk.size());
+            }
+        }
+
+        /* Send it all. */
+        co_await writeGathered(buffers);
+        if (headerSize > 0) {
+            serializer.consume(headerSize);
+            assert(serializer.is_header_done());
+        }
+    }
+
+    /**
+     * Write a sequence of buffers to the socket, in as few system calls as possible, and count what was written.
+     */
+    Awaitable<void> writeGathered(std::span<const boost::asio::const_buffer> buffers)
+    {
+        /* Count the flush. */
+        connection.written.flushes++;
+        if (buffers.empty()) {
             co_return;
         }
+        connection.written.buffers += buffers.size();
+
+        /* Keep writing until everything's gone. Each write_some is a single (vectored) send from the socket. */
+        boost::beast::buffers_suffix<std::span<const boost::asio::const_buffer>> remaining(buffers);
+        size_t remainingSize = boost::beast::buffer_bytes(remaining);
+        while (remainingSize > 0) {
+            size_t n = co_await connection.socket.async_write_some(remaining, boost::asio::use_awaitable);
+            remaining.consume(n);
+            remainingSize -= n;
+            connection.written.bytes += n;
+            connection.written.syscalls++;
+        }
+    }
 
-        /* Send the body data. */
-        if (response.chunked()) {
-            // Chunked encode doesn't seem to like having boost::beast::http::async_write called multiple times, even
-            // with response.body().more set to true, so we write the chunks to the socket directly, as in the
-            // documentation's examples:
-            // https://www.boost.org/doc/libs/1_81_0/libs/beast/doc/html/beast/using_http/chunked_encoding.html
-            if (!data.empty()) {
-                boost::asio::const_buffer buffer(data.data(), data.size());
-                co_await boost::asio::async_write(connection.socket, boost::beast::http::make_chunk(buffer),
-                                                  boost::asio::use_awaitable);
+    /**
+     * Send part of a file to the socket without copying it through memory, and count what was written.
+     */
+    Awaitable<void> sendFile(int fd, uint64_t offset, uint64_t length)
+    {
+        /* The socket has to be non-blocking so that waiting for it to be writable can be left to the IO context. */
+        connection.socket.native_non_blocking(true);
+
+        /* Keep sending until it's all gone. */
+        off_t fileOffset = (off_t)offset;
+        uint64_t remaining = length;
+        while (remaining > 0) {
+            ssize_t n = ::sendfile(connection.socket.native_handle(), fd, &fileOffset,
+                                   (size_t)std::min<uint64_t>(remaining, 1 << 30));
+            if (n > 0) {
+                remaining -= n;
+                connection.written.bytes += n;
+                connection.written.syscalls++;
             }
-            if (end) {
-                co_await boost::asio::async_write(connection.socket, boost::beast::http::make_chunk_last(),
-                                                  boost::asio::use_awaitable);
+            else if (n == 0) {
+                throw std::runtime_error("File ended before it could all be sent.");
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await connection.socket.async_wait(boost::asio::ip::tcp::socket::wait_write,
+                                                      boost::asio::use_awaitable);
+            }
+            else if (errno != EINTR) {
+                throw boost::system::system_error(errno, boost::system::system_category());
             }
-        }
-        else {
-            response.body().data = data.data();
-            response.body().size = data.size();
-            response.body().more = false; // We have the entire message here.
-            co_await boost::beast::http::async_write(connection.socket, serializer, boost::asio::use_awaitable);
         }
     }
 
@@ -300,7 +529,12 @@ private:
         return out.str();
     }
 
-    Awaitable<void> transmitHeaders(std::optional<size_t> contentLength)
+    /**
+     * Fill in the response headers, ready to be serialized.
+     *
+     * @param contentLength The length of the body, if it's known. Otherwise, chunked encoding is used.
+     */
+    void prepareHeaders(std::optional<size_t> contentLength)
     {
         /* Set the response code. */
         response.result(getHttpStatusCode());
@@ -338,10 +572,6 @@ private:
         else {
             response.chunked(true);
         }
-
-        /* Transmit the headers. */
-        co_await boost::beast::http::async_write_header(connection.socket, serializer, boost::asio::use_awaitable);
-        assert(serializer.is_header_done());
     }
 
     /**
@@ -350,7 +580,7 @@ private:
     boost::beast::http::status getHttpStatusCode() const
     {
         if (!getErrorKind()) {
-            return boost::beast::http::status::ok;
+            return getNotModified() ? boost::beast::http::status::not_modified : boost::beast::http::status::ok;
         }
         switch (*getErrorKind()) {
             case Server::ErrorKind::BadRequest: return boost::beast::http::status::bad_request;
@@ -394,7 +624,20 @@ private:
 
     boost::beast::http::response<boost::beast::http::buffer_body> response;
     boost::beast::http::response_serializer<boost::beast::http::buffer_body> serializer{response};
-    std::vector<std::vector<std::byte>> bodyQueue;
+    std::vector<Util::SharedBuffer> bodyQueue;
+
+    /**
+     * Whether a file has been sent to end the body, so nothing more can be sent.
+     */
+    bool bodyEnded = false;
+
+    /**
+     * Storage for the size line at the start of a chunk, which has to survive until the chunk's been written.
+     */
+    std::array<char, 2 * sizeof(size_t) + 2> chunkHeader;
+
+    static constexpr std::string_view crlf = "\r\n";
+    static constexpr std::string_view lastChunk = "0\r\n\r\n";
 };
 
 /**
@@ -433,26 +676,57 @@ struct Server::HttpServer::Connection final : public ::Connection
 
 Server::HttpServer::~HttpServer() = default;
 
-Server::HttpServer::HttpServer(IOContext &ioc, Log::Log &log, const Config::Network &networkConfig,
+Server::HttpServer::HttpServer(IOContextPool &iocs, Log::Log &log, const Config::Network &networkConfig,
                                const Config::Http &httpConfig) :
-    Server(log), ioc(ioc), networkConfig(networkConfig), httpConfig(httpConfig), listenContext(log("listen"))
+    Server(log), ioc(iocs.getMain()), networkConfig(networkConfig), httpConfig(httpConfig),
+    listenContext(log("listen"))
 {
     /* Record the paths that should return ephemeral not-found errors when they don't exist. */
     for (const std::string &path: httpConfig.ephemeralWhenNotFound) {
         addEphemeralWhenNotFound(path);
     }
 
-    /* Start a coroutine in the IO context, so we can return immediately. */
-    spawnDetached(ioc, listenContext,
-                  [this]() -> Awaitable<void> { return listen(this->networkConfig.port, true); },
-                  Log::Level::fatal);
-
-    /* Start another for the public-only port. */
+    /* Bind the ports here, so that failing to do so (e.g: because something else is using them) is an error from the
+       constructor. */
+    boost::asio::ip::tcp::acceptor listener = bindListener(ioc, networkConfig.port);
+    std::optional<boost::asio::ip::tcp::acceptor> publicListener;
     if (networkConfig.publicPort > 0) {
-        spawnDetached(ioc, listenContext,
-                      [this]() -> Awaitable<void> { return listen(this->networkConfig.publicPort, false); },
+        publicListener.emplace(bindListener(ioc, networkConfig.publicPort));
+    }
+
+    /* Start a coroutine in each IO context, so we can return immediately. Each has its own acceptor on a duplicate of
+       the listening socket, and whichever is ready accepts each connection. */
+    for (size_t i = 0; i < iocs.size(); i++) {
+        IOContext &listenIoc = iocs[i];
+        int fd = duplicateListener(listener);
+        spawnDetached(listenIoc, listenContext,
+                      [this, &listenIoc, fd]() -> Awaitable<void> { return listen(listenIoc, fd, true); },
                       Log::Level::fatal);
+
+        // Start another for the public-only port.
+        if (publicListener) {
+            int publicFd = duplicateListener(*publicListener);
+            spawnDetached(listenIoc, listenContext,
+                          [this, &listenIoc, publicFd]() -> Awaitable<void> {
+                              return listen(listenIoc, publicFd, false);
+                          },
+                          Log::Level::fatal);
+        }
+    }
+}
+
+Awaitable<void> Server::HttpServer::invoke(Resource &resource, Response &response, Request &request) const
+{
+    /* Call the resource directly if it's safe to do so from this thread. */
+    if ((request.getType() == Request::Type::get && resource.getAllowConcurrentGet()) ||
+        ioc.get_executor().running_in_this_thread()) {
+        co_await resource(response, request);
+        co_return;
     }
+
+    /* Otherwise, call it from the main IO context. The connection is still only used by one coroutine at a time, so the
+       request and response can be used from there. This coroutine resumes in its own context afterwards. */
+    co_await boost::asio::co_spawn(ioc, resource(response, request), boost::asio::use_awaitable);
 }
 
 Awaitable<bool> Server::HttpServer::onRequest(Connection &connection)
@@ -580,6 +854,11 @@ Awaitable<void> Server::HttpServer::onConnection(Connection &connection)
         connectionContext << Log::Level::error << "Unknown exception while handling request.";
     }
 
+    /* Record how efficiently the responses were written. */
+    connectionContext << "written" << Log::Level::debug << connection.written.bytes << " bytes in "
+                      << connection.written.buffers << " buffers, with " << connection.written.syscalls
+                      << " writes for " << connection.written.flushes << " flushes.";
+
     /* Close the socket. */
     try {
         connection.socket.close();
@@ -592,14 +871,19 @@ Awaitable<void> Server::HttpServer::onConnection(Connection &connection)
     }
 }
 
-Awaitable<void> Server::HttpServer::listen(int16_t port, bool allowPrivate)
+Awaitable<void> Server::HttpServer::listen(IOContext &listenIoc, int fd, bool allowPrivate)
 {
     Log::Context connectionContext = log("acceptor");
 
     /* Listen for connections. */
-    boost::asio::ip::tcp::acceptor acceptor(ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v6(), port));
-
-    acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+    boost::asio::ip::tcp::acceptor acceptor(listenIoc);
+    try {
+        acceptor.assign(boost::asio::ip::tcp::v6(), fd);
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
 
     /* Handle each connection. */
     while (true) {
@@ -608,7 +892,7 @@ Awaitable<void> Server::HttpServer::listen(int16_t port, bool allowPrivate)
             boost::asio::ip::tcp::socket socket = co_await acceptor.async_accept(boost::asio::use_awaitable);
 
             // Spawn a detached coroutine to handle the socket, so we can get back to accepting more connections.
-            spawnDetached(ioc, [this, socket = std::move(socket), allowPrivate]() mutable -> Awaitable<void> {
+            spawnDetached(listenIoc, [this, socket = std::move(socket), allowPrivate]() mutable -> Awaitable<void> {
                 Connection connection(std::move(socket), allowPrivate);
                 co_await onConnection(connection);
             });
@@ -4,6 +4,7 @@
 #include "util/awaitable.hpp"
 
 class IOContext;
+class IOContextPool;
 
 namespace Config
 {
@@ -29,13 +30,18 @@ public:
      *
      * @note The server never terminates.
      *
-     * @param ioc The server is created as a detached coroutine in this context.
+     * @param iocs The server listens with a detached coroutine in each of these contexts. Connections are handled in
+     *             the context that accepted them, except that resources that aren't safe to call from any thread are
+     *             called from the main context.
      * @param networkConfig The server's network configuration object.
      * @param httpConfig The server's HTTP configuration object.
      */
-    explicit HttpServer(IOContext &ioc, Log::Log &log, const Config::Network &networkConfig,
+    explicit HttpServer(IOContextPool &iocs, Log::Log &log, const Config::Network &networkConfig,
                         const Config::Http &httpConfig);
 
+protected:
+    Awaitable<void> invoke(Resource &resource, Response &response, Request &request) const override;
+
 private:
     /**
      * Low level objects about a TCP connection.
@@ -58,11 +64,15 @@ private:
     /**
      * Called by the constructor as a worker coroutine.
      *
-     * @param port The TCP port to listen on.
+     * @param listenIoc The IO context to accept connections in, and in which to handle them.
+     * @param fd A listening socket to accept connections from. This takes ownership of it.
      * @param allowPrivate Whether to allow access to private resources (when the source is appropriate).
      */
-    Awaitable<void> listen(int16_t port, bool allowPrivate);
+    Awaitable<void> listen(IOContext &listenIoc, int fd, bool allowPrivate);
 
+    /**
+     * The main IO context.
+     */
     IOContext &ioc;
     const Config::Network &networkConfig;
     const Config::Http &httpConfig;
@@ -1,36 +1,62 @@
 #include "Path.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <utility>
+
 Server::Path::~Path() = default;
 Server::Path::Path(const Path &) = default;
 Server::Path &Server::Path::operator=(const Path &) = default;
 
+Server::Path::Path(Path &&rhs) noexcept :
+    buffer(std::move(rhs.buffer)), offsets(std::move(rhs.offsets)), first(std::exchange(rhs.first, 0))
+{
+    // Leave the other path empty, rather than with an index that's out of range.
+    rhs.buffer.clear();
+    rhs.offsets.clear();
+}
+
+Server::Path &Server::Path::operator=(Path &&rhs) noexcept
+{
+    buffer = std::move(rhs.buffer);
+    offsets = std::move(rhs.offsets);
+    first = std::exchange(rhs.first, 0);
+    rhs.buffer.clear();
+    rhs.offsets.clear();
+    return *this;
+}
+
 Server::Path::Path(std::string_view path)
 {
-    /* Disallow characters that could pose vulnerabilities. */
-    for (char c: path) {
-        if (c < 0x20 || c > 0x7E) {
-            // This restriction is a bit aggressive, but it does guard against non-canonical UTF-8 directory traversal
-            // attacks.
-            throw Exception("Path contains a character that is not printable ASCII.");
-        }
-        switch (c) {
-            case '\\':
-            case ':':
-                throw Exception("Path contains bad character.");
-        }
+    if (path.size() > std::numeric_limits<uint32_t>::max()) {
+        throw Exception("Path is too long.");
     }
+    buffer.reserve(path.size());
 
-    /* Parse the path from the end backwards, and build the parts buffer in the opposite direction. This ordering makes
-       the pop_front() operation almost free. */
-    while (!path.empty()) {
-        // Find the next separation point.
-        size_t sep = path.rfind('/');
-
-        // Extract the part at the end after the separation point.
-        std::string_view part = path.substr((sep == std::string::npos) ? 0 : (sep + 1));
+    /* Validate and canonicalize the path in a single pass, copying the parts that are kept into the buffer. */
+    size_t partStart = 0;
+    for (size_t i = 0; i <= path.size(); i++) {
+        // Disallow characters that could pose vulnerabilities.
+        if (i < path.size()) {
+            char c = path[i];
+            if (c < 0x20 || c > 0x7E) {
+                // This restriction is a bit aggressive, but it does guard against non-canonical UTF-8 directory
+                // traversal attacks.
+                throw Exception("Path contains a character that is not printable ASCII.");
+            }
+            switch (c) {
+                case '\\':
+                case ':':
+                    throw Exception("Path contains bad character.");
+            }
+            if (c != '/') {
+                continue;
+            }
+        }
 
-        // Remove the last part of the path from the path.
-        path = path.substr(0, (sep == std::string::npos) ? 0 : sep);
+        // Extract the part before this separator (or the end of the path).
+        std::string_view part = path.substr(partStart, i - partStart);
+        partStart = i + 1;
 
         // Filter out empty parts.
         if (part == "." || part.empty()) {
@@ -42,42 +68,62 @@ Server::Path::Path(std::string_view path)
             throw Exception("Path not allowed to contain parent dots.");
         }
 
-        // Add the part to the list of parts.
-        parts.emplace_back(part);
+        // Add the part to the buffer.
+        if (!buffer.empty()) {
+            buffer.push_back('/');
+        }
+        offsets.push_back((uint32_t)buffer.size());
+        buffer.insert(buffer.end(), part.begin(), part.end());
     }
 }
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wzero-as-null-pointer-constant"
-std::strong_ordering Server::Path::operator<=>(const Path &) const noexcept = default; // NOLINT
-#pragma clang diagnostic pop
+std::strong_ordering Server::Path::operator<=>(const Path &rhs) const noexcept
+{
+    // Comparing the joined strings would be a different order, since '/' doesn't sort before every other character.
+    size_t n = std::min(size(), rhs.size());
+    for (size_t i = 0; i < n; i++) {
+        if (std::strong_ordering result = (*this)[i] <=> rhs[i]; result != std::strong_ordering::equal) {
+            return result;
+        }
+    }
+    return size() <=> rhs.size();
+}
 
 Server::Path Server::Path::operator/(const Path &rhs) const
 {
+    /* Shortcuts for when one of the paths is empty, which also avoids adding a separator. */
+    if (rhs.empty()) {
+        return *this;
+    }
+    if (empty()) {
+        return rhs;
+    }
+
+    /* Join the strings, and offset the parts of the subpath. */
+    std::string_view lhsView = view();
+    std::string_view rhsView = rhs.view();
     Server::Path result;
-    result.parts.reserve(parts.size() + rhs.parts.size());
-    result.parts.insert(result.parts.end(), rhs.parts.begin(), rhs.parts.end());
-    result.parts.insert(result.parts.end(), parts.begin(), parts.end());
+    result.buffer.reserve(lhsView.size() + 1 + rhsView.size());
+    result.buffer.insert(result.buffer.end(), lhsView.begin(), lhsView.end());
+    result.buffer.push_back('/');
+    result.buffer.insert(result.buffer.end(), rhsView.begin(), rhsView.end());
+
+    result.offsets.reserve(size() + rhs.size());
+    for (size_t i = first; i < offsets.size(); i++) {
+        result.offsets.push_back(offsets[i] - offsets[first]);
+    }
+    for (size_t i = rhs.first; i < rhs.offsets.size(); i++) {
+        result.offsets.push_back((uint32_t)(lhsView.size() + 1 + rhs.offsets[i] - rhs.offsets[rhs.first]));
+    }
     return result;
 }
 
 Server::Path::operator std::string() const
 {
-    std::string result;
-    for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
-        result += *it + "/";
-    }
-    if (!result.empty()) {
-        result.resize(result.size() - 1); // Remove the trailing /.
-    }
-    return result;
+    return std::string(view());
 }
 
 Server::Path::operator std::filesystem::path() const
 {
-    std::filesystem::path result;
-    for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
-        result /= *it;
-    }
-    return result;
+    return std::filesystem::path(view());
 }
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <boost/container/small_vector.hpp>
+
 #include <cassert>
+#include <cstdint>
 #include <filesystem>
 #include <stdexcept>
 #include <string>
 #include <string_view>
-#include <vector>
 
 namespace Server
 {
 
 /**
  * Represents the path to a resource.
+ *
+ * The path is stored as its canonical string, along with the offset of each part in it. Both are kept inline in the
+ * object unless the path is unusually long, so parsing a request's path doesn't allocate, and removing parts from the
+ * front is just moving an index.
  */
 class Path final
 {
@@ -28,9 +34,9 @@ public:
     ~Path();
     Path() = default;
     Path(const Path &);
-    Path(Path &&) = default;
+    Path(Path &&) noexcept;
     Path &operator=(const Path &);
-    Path &operator=(Path &&) = default;
+    Path &operator=(Path &&) noexcept;
 
     /**
      * Construct a path with this path first and rhs as the subpath.
@@ -49,7 +55,7 @@ public:
     template <typename T> Path(const T &path) : Path(std::string_view(path)) {}
 
     /**
-     * Imposes an arbitrary total ordering.
+     * Orders paths by comparing their parts in order.
      */
     std::strong_ordering operator<=>(const Path &) const noexcept;
 
@@ -58,7 +64,8 @@ public:
      */
     bool operator==(const Path &rhs) const noexcept
     {
-        return (*this <=> rhs) == std::strong_ordering::equal;
+        // Parts can't contain separators, so the joined strings are equal exactly when the parts are.
+        return view() == rhs.view();
     }
 
     /**
@@ -71,15 +78,29 @@ public:
      */
     operator std::filesystem::path() const;
 
+    /**
+     * Get the canonical string form of the path.
+     *
+     * This is the parts separated by '/', without leading or trailing separators. The view is valid until the path is
+     * modified, other than by pop_front(), or destroyed.
+     */
+    std::string_view view() const
+    {
+        if (empty()) {
+            return {};
+        }
+        return { buffer.data() + offsets[first], buffer.size() - offsets[first] };
+    }
+
     /**
      * Get the single part of the request.
      *
      * This call is valid only if there is exactly one part. There is a debug assertion to enforce this.
      */
-    const std::string &operator*() const
+    std::string_view operator*() const
     {
-        assert(parts.size() == 1);
-        return parts[0];
+        assert(size() == 1);
+        return (*this)[0];
     }
 
     /**
@@ -88,10 +109,12 @@ public:
      * @param index The index to get the path part for. The outer-most part has index 0 and the inner-most part has
      *              index size() - 1.
      */
-    const std::string &operator[](size_t index) const
+    std::string_view operator[](size_t index) const
     {
-        assert(index < parts.size());
-        return parts[parts.size() - index - 1]; // The path is stored backwards to aid pop_front().
+        assert(index < size());
+        index += first;
+        size_t end = (index + 1 < offsets.size()) ? (offsets[index + 1] - 1) : buffer.size(); // Before the separator.
+        return { buffer.data() + offsets[index], end - offsets[index] };
     }
 
     /**
@@ -99,7 +122,7 @@ public:
      */
     bool empty() const
     {
-        return parts.empty();
+        return first == offsets.size();
     }
 
     /**
@@ -107,23 +130,23 @@ public:
      */
     size_t size() const
     {
-        return parts.size();
+        return offsets.size() - first;
     }
 
     /**
      * Get the outer-most part of the path.
      */
-    const std::string &front() const
+    std::string_view front() const
     {
-        return parts.back(); // The path is stored backwards to aid pop_front().
+        return (*this)[0];
     }
 
     /**
      * Get the inner-most part of the path.
      */
-    const std::string &back() const
+    std::string_view back() const
     {
-        return parts.front(); // The path is stored backwards to aid pop_front().
+        return (*this)[size() - 1];
     }
 
     /**
@@ -131,11 +154,36 @@ public:
      */
     void pop_front()
     {
-        parts.pop_back(); // The path is stored backwards to aid this method.
+        assert(!empty());
+        first++; // The part is left in the buffer, since nothing can refer to it any more.
     }
 
 private:
-    std::vector<std::string> parts;
+    /**
+     * The number of characters that are stored without allocating. This is enough for most of the paths that are
+     * requested.
+     */
+    static constexpr size_t inlineLength = 128;
+
+    /**
+     * The number of parts that are stored without allocating.
+     */
+    static constexpr size_t inlineParts = 8;
+
+    /**
+     * The canonical path, including any parts that have been popped.
+     */
+    boost::container::small_vector<char, inlineLength> buffer;
+
+    /**
+     * The offset of each part in the buffer, including any parts that have been popped.
+     */
+    boost::container::small_vector<uint32_t, inlineParts> offsets;
+
+    /**
+     * The index of the first part that hasn't been popped.
+     */
+    size_t first = 0;
 };
 
 } // namespace Server
@@ -7,9 +7,14 @@
 
 Server::Request::~Request() = default;
 
-Awaitable<std::vector<std::byte>> Server::Request::readSome()
+std::string_view Server::Request::getHeader(boost::beast::http::field) const
 {
-    std::vector<std::byte> data = co_await doReadSome();
+    return {};
+}
+
+Awaitable<Util::SharedBuffer> Server::Request::readSome()
+{
+    Util::SharedBuffer data = co_await doReadSome();
     bytesRead += (int) data.size();
     checkMaxLength();
     co_return data;
@@ -18,9 +23,9 @@ Awaitable<std::vector<std::byte>> Server::Request::readSome()
 Awaitable<std::vector<std::byte>> Server::Request::readAll()
 {
     /* Extract all the data. */
-    std::vector<std::vector<std::byte>> dataParts;
+    std::vector<Util::SharedBuffer> dataParts;
     while (true) {
-        std::vector<std::byte> data = co_await readSome();
+        Util::SharedBuffer data = co_await readSome();
         if (data.empty()) {
             break;
         }
@@ -28,7 +33,7 @@ Awaitable<std::vector<std::byte>> Server::Request::readAll()
     }
 
     /* Concatenate and return. */
-    co_return Util::concatenate(std::move(dataParts));
+    co_return Util::concatenate(dataParts);
 }
 
 Awaitable<std::string> Server::Request::readAllAsString()
@@ -2,8 +2,11 @@
 
 #include "Path.hpp"
 
+#include <string_view>
 #include <vector>
+#include <boost/beast/http/field.hpp>
 #include "util/awaitable.hpp"
+#include "util/SharedBuffer.hpp"
 
 namespace Server
 {
@@ -49,7 +52,13 @@ public:
     };
 
     virtual ~Request();
-    explicit Request(Path path, Type type, bool isPublic) : path(std::move(path)), type(type), isPublic(isPublic) {}
+    explicit Request(Path path, Type type, bool isPublic) :
+        path(std::move(path)), originalPath(this->path.view()), type(type), isPublic(isPublic)
+    {
+    }
+
+    Request(const Request &) = delete;
+    Request &operator=(const Request &) = delete;
 
     /**
      * Transform this request into a request from within its outer-most path part.
@@ -69,6 +78,14 @@ public:
         return path;
     }
 
+    /**
+     * Get the canonical string form of the path the request was made for, before any parts were popped.
+     */
+    std::string_view getOriginalPath() const
+    {
+        return originalPath;
+    }
+
     /**
      * Get the type of this request.
      *
@@ -87,18 +104,27 @@ public:
         return isPublic;
     }
 
+    /**
+     * Get the value of a request header.
+     *
+     * @return The header's value, or empty if the request doesn't have the header. This stays valid for as long as the
+     *         request does.
+     */
+    virtual std::string_view getHeader(boost::beast::http::field field) const;
+
 protected:
     /**
      * Read some data from the request body.
      *
      * @return The data that was read. This returns an empty result when the request body is finished.
      */
-    virtual Awaitable<std::vector<std::byte>> doReadSome() = 0;
+    virtual Awaitable<Util::SharedBuffer> doReadSome() = 0;
 
 public:
 
     /// Wraps doReadSome() in a thing that counts the bytes extracted and stores in `bytesRead`
-    Awaitable<std::vector<std::byte>> readSome();
+    /// The result can be kept and passed on (e.g: to responses) without copying it.
+    Awaitable<Util::SharedBuffer> readSome();
 
     /**
      * Read all the (remaining, if readSome() has already been called) body data.
@@ -129,6 +155,12 @@ public:
 
 private:
     Path path;
+
+    /**
+     * Popping parts from the path leaves its buffer alone, so this stays valid.
+     */
+    const std::string_view originalPath;
+
     const Type type;
     const bool isPublic;
 
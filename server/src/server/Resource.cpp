@@ -9,6 +9,8 @@ Server::Resource::~Resource() = default;
 
 bool Server::Resource::getAllowNonEmptyPath() const noexcept { return false; }
 
+bool Server::Resource::getAllowConcurrentGet() const noexcept { return false; }
+
 Awaitable<void> Server::Resource::getAsync(Response&, Request&) {
     unsupportedHttpVerb("GET");
 }
@@ -87,6 +87,17 @@ public:
      */
     virtual bool getAllowNonEmptyPath() const noexcept;
 
+    /**
+     * Determine whether GET requests for this resource can be serviced from any of the server's threads.
+     *
+     * If this returns false, then operator() will only be called for GET requests from the server's main IO context.
+     * Other request types are always handled in the main IO context. Resources that return true must synchronize
+     * anything their GET handler shares with the rest of the program.
+     *
+     * The default is false.
+     */
+    virtual bool getAllowConcurrentGet() const noexcept;
+
 private:
     /**
      * Whether the resource can be public.
@@ -13,6 +13,20 @@ void Server::Response::setErrorAndMessage(ErrorKind kind, std::string_view messa
     }
 }
 
+Awaitable<bool> Server::Response::writeFile(const std::filesystem::path &path, uint64_t offset, uint64_t length)
+{
+    bool written = co_await writeFileBody(path, offset, length);
+    if (written) {
+        writeStarted = true;
+    }
+    co_return written;
+}
+
+Awaitable<bool> Server::Response::writeFileBody(const std::filesystem::path &, uint64_t, uint64_t)
+{
+    co_return false;
+}
+
 Awaitable<void> Server::Response::flush(bool end)
 {
     Awaitable<void> result = flushBody(end);
@@ -4,6 +4,7 @@
 #include "Error.hpp"
 
 #include <cassert>
+#include <filesystem>
 #include <optional>
 #include <span>
 #include <vector>
@@ -11,6 +12,7 @@
 #include <cstdint>
 #include <boost/beast/http/field.hpp>
 #include "util/awaitable.hpp"
+#include "util/SharedBuffer.hpp"
 
 namespace Server
 {
@@ -85,6 +87,18 @@ public:
         cacheKind = kind;
     }
 
+    /**
+     * Set that the client already has the current content, so the response has no body.
+     *
+     * This is only for GET requests that made a conditional request (e.g: with If-None-Match). If this method is
+     * called, it must be called before operator<< and wait, and nothing must be written to the body.
+     */
+    void setNotModified()
+    {
+        assert(!getWriteStarted());
+        notModified = true;
+    }
+
     /**
      * Set the MIME type.
      *
@@ -97,6 +111,36 @@ public:
         mimeType = std::move(type);
     }
 
+    /**
+     * Write (by appending) several pieces of data to the response body as a single write.
+     *
+     * None of the data is copied, so this is useful for things like putting a header in front of some shared data.
+     *
+     * @see wait.
+     *
+     * @param parts The data to write, in order.
+     */
+    Response &write(std::span<const Util::SharedBuffer> parts)
+    {
+        writeBody(parts);
+        writeStarted = true; // We've now started writing. This is after writeBody() so it can detect the first write.
+        return *this;
+    }
+
+    /**
+     * Write (by appending) data to the response body.
+     *
+     * The data is shared rather than copied.
+     *
+     * @see wait.
+     *
+     * @param data The data to write.
+     */
+    Response &operator<<(Util::SharedBuffer data)
+    {
+        return write(std::span(&data, 1));
+    }
+
     /**
      * Write (by appending) data to the response body.
      *
@@ -106,9 +150,7 @@ public:
      */
     Response &operator<<(std::vector<std::byte> data)
     {
-        writeBody(std::move(data));
-        writeStarted = true; // We've now started writing. This is after writeBody() so it can detect the first write.
-        return *this;
+        return (*this) << Util::SharedBuffer(std::move(data));
     }
 
     /**
@@ -120,7 +162,7 @@ public:
      */
     Response &operator<<(std::span<const std::byte> data)
     {
-        return (*this) << std::vector<std::byte>(data.begin(), data.end());
+        return (*this) << Util::SharedBuffer::copy(data);
     }
 
     /**
@@ -135,6 +177,22 @@ public:
         return (*this) << std::span((const std::byte *)string.data(), string.size());
     }
 
+    /**
+     * Write (by appending) part of a file to the response body, sending it straight from the file if possible.
+     *
+     * If the implementation supports it, the data goes from the file to the client without being copied through memory.
+     * Otherwise, nothing is written, and the caller should write the data some other way (e.g: by reading it with
+     * Util::File and using operator<<).
+     *
+     * The file must be the last thing written to the body, so nothing else can be written if this succeeds.
+     *
+     * @param path The file to send.
+     * @param offset The offset of the first byte to send.
+     * @param length The number of bytes to send. The file must have at least this many bytes after the offset.
+     * @return Whether the data was written.
+     */
+    Awaitable<bool> writeFile(const std::filesystem::path &path, uint64_t offset, uint64_t length);
+
     /**
      * Wait for outstanding response body data to be written, at least down to some "low water line" buffer level.
      *
@@ -181,6 +239,14 @@ protected:
         return cacheKind;
     }
 
+    /**
+     * Determine whether setNotModified has been called.
+     */
+    bool getNotModified() const
+    {
+        return notModified;
+    }
+
     /**
      * Get the MIME type kind.
      *
@@ -195,9 +261,16 @@ private:
     /**
      * Write some data to the response body.
      *
-     * @param data The data to write to the response body.
+     * @param data The data to write to the response body. The parts are written in order, and are a single write.
+     */
+    virtual void writeBody(std::span<const Util::SharedBuffer> data) = 0;
+
+    /**
+     * Implementation for writeFile.
+     *
+     * This must send any body data that's been written first. The default doesn't support writing files.
      */
-    virtual void writeBody(std::vector<std::byte> data) = 0;
+    virtual Awaitable<bool> writeFileBody(const std::filesystem::path &path, uint64_t offset, uint64_t length);
 
     /**
      * Implementation for wait.
@@ -209,6 +282,7 @@ private:
     std::optional<ErrorKind> errorKind;
     CacheKind cacheKind = CacheKind::fixed;
     std::string mimeType;
+    bool notModified = false;
     bool writeStarted = false;
 
 protected:
@@ -8,8 +8,10 @@
 #include "util/debug.hpp"
 
 #include <algorithm>
+#include <charconv>
 #include <map>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 /// @addtogroup server
@@ -78,163 +80,198 @@ void checkResourceRestrictions(const Server::Resource &resource, Server::Request
 }
 
 /**
- * A resource that has children.
+ * Get the key for a range of numbered paths.
  *
- * Resources of this type form a tree in which other resources can be looked up.
+ * @param directory The directory that the paths are in.
+ * @param prefix The part of the paths' names before the number.
+ * @return The string form of the paths, up to the number.
  */
-class TreeResource final : public Server::Resource
+std::string getNumberedPathKey(const Server::Path &directory, std::string_view prefix)
 {
-public:
-    ~TreeResource() override = default;
-    TreeResource() : Server::Resource(true) {} // This needs to be public to allow sub-resources to be public.
+    std::string key = (std::string)directory;
+    if (!key.empty()) {
+        key += '/';
+    }
+    key += prefix;
+    return key;
+}
+
+const char *getRequestTypeString(Server::Request::Type type)
+{
+    switch (type) {
+        case Server::Request::Type::get: return "get";
+        case Server::Request::Type::post: return "post";
+        case Server::Request::Type::put: return "put";
+        case Server::Request::Type::options: return "options";
+    }
+    unreachable();
+}
+
+} // namespace
 
+/// @}
+
+/**
+ * The names of the nodes in the resource tree, each stored once however many nodes have it.
+ *
+ * The same few names recur throughout the tree (e.g: each channel has the same quality and segment names), so each is
+ * kept once here, and the nodes refer to it. Each name is counted, so it's forgotten once no node has it.
+ *
+ * This is only used while the tree is locked for modification.
+ */
+class Server::Server::NameTable final
+{
+public:
     /**
-     * Recursively traverse the request's path until we get to the resource to request. Then pass the request to that
-     * resource.
+     * Get the stored copy of a name, storing it if it's new.
      *
-     * This throws the appropriate exception if .
+     * @return A view of the stored name, which is valid until the matching call to release.
      */
-    Awaitable<void> operator()(Server::Response &response, Server::Request &request) override
+    std::string_view acquire(std::string_view name)
     {
-        /* Don't allow directory listing of resources. */
-        if (request.getPath().empty()) {
-            throw Server::Error(Server::ErrorKind::Forbidden);
-        }
-
-        /* Find the resource referred to. */
-        auto it = children.find(request.getPath().front());
-        if (it == children.end()) {
-            throw Server::Error(Server::ErrorKind::NotFound);
+        auto it = names.find(name);
+        if (it == names.end()) {
+            it = names.emplace(name, 0).first;
         }
-
-        // This can keep TreeResources after they're deleted from the tree, but that's OK. It also keeps non-tree
-        // resources after they're deleted. The purpose of this is to make sure deletions don't break requests that are
-        // in progress.
-        std::shared_ptr<Resource> child = it->second; // Keep ownership.
-        assert(child); // If the child doesn't exist, it should have been deleted from the tree entirely.
-        Resource &resource = *child;
-
-        /* Pop the outer-most path component and try to call the resource.  */
-        request.popPathPart();
-        checkResourceRestrictions(resource, request);
-        co_await resource(response, request); // Wait for the resource to finish so the shared pointer keeps it alive.
+        it->second++;
+        return it->first;
     }
 
     /**
-     * Find (and possibly create as null) a resource.
-     *
-     * @param child The name of the child to find.
-     * @return A reference to the smart pointer for the resource.
+     * Forget one use of a name that was acquired.
      */
-    std::shared_ptr<Server::Resource> &operator[](std::string_view child)
+    void release(std::string_view name)
     {
-        return children[std::string(child)];
+        auto it = names.find(name);
+        assert(it != names.end());
+        if (--it->second == 0) {
+            names.erase(it);
+        }
     }
 
+private:
     /**
-     * Find a resource.
-     *
-     * @param child The name of the child to find.
-     * @return A pointer to the smart pointer for the resource. Nullptr if the resource does not exist.
+     * The number of nodes with each name.
      */
-    std::shared_ptr<Server::Resource> *at(std::string_view child)
-    {
-        auto it = children.find(std::string(child));
-        return (it == children.end()) ? nullptr : &it->second;
-    }
+    std::map<std::string, size_t, std::less<>> names;
+};
 
-    bool getAllowNonEmptyPath() const noexcept override
+/**
+ * A node in the resource tree.
+ *
+ * A node is either a leaf, which has a resource, or an intermediate node, which has children. The name of each node is
+ * interned in the server's name table, and its parent's map of children refers to it, so looking up a child with a
+ * view of a request's path component doesn't allocate anything.
+ */
+struct Server::Server::Node final
+{
+    ~Node()
     {
-        return true;
+        /* Destroy the children first, since they use the name table too. */
+        children.clear();
+        names.release(name);
     }
 
+    explicit Node(NameTable &names, std::string_view name) : names(names), name(names.acquire(name)) {}
+
     /**
-     * Determine if this resource has any children.
+     * Find a child.
+     *
+     * @return The child, or nullptr if it doesn't exist.
      */
-    bool empty() const
+    Node *find(std::string_view child) const
     {
-        return children.empty();
+        auto it = children.find(child);
+        return (it == children.end()) ? nullptr : it->second.get();
     }
 
     /**
-     * Erase the given child.
+     * Find a child, creating it if it doesn't exist.
      */
-    void erase(std::string_view child)
+    Node &operator[](std::string_view child)
     {
-        children.erase(std::string(child));
+        if (Node *node = find(child)) {
+            return *node;
+        }
+        auto node = std::make_unique<Node>(names, child);
+        std::string_view key = node->name;
+        return *children.emplace(key, std::move(node)).first->second;
     }
 
     /**
-     * Remove null resources and empty trees.
+     * Determine whether this is an intermediate node.
      */
-    void prune()
+    bool isTree() const
     {
-        for (auto it = children.begin(); it != children.end();) {
-            if (auto *tree = dynamic_cast<TreeResource *>(it->second.get())) {
-                tree->prune();
-                if (tree->empty()) {
-                    children.erase(it++);
-                    continue;
-                }
-            }
-            ++it;
-        }
+        return !children.empty();
     }
 
-private:
-    std::map<std::string, std::shared_ptr<Server::Resource>> children;
-};
+    /**
+     * Where the node's name is stored.
+     */
+    NameTable &names;
 
-const char *getRequestTypeString(Server::Request::Type type)
-{
-    switch (type) {
-        case Server::Request::Type::get: return "get";
-        case Server::Request::Type::post: return "post";
-        case Server::Request::Type::put: return "put";
-        case Server::Request::Type::options: return "options";
-    }
-    unreachable();
-}
+    /**
+     * The path component that leads to this node from its parent. This refers to the name table.
+     */
+    const std::string_view name;
 
-} // namespace
+    /**
+     * The resource, if this is a leaf node.
+     */
+    std::shared_ptr<Resource> resource;
 
-/// @}
+    /**
+     * The children, if this is an intermediate node, by name. The keys refer to the name table.
+     */
+    std::unordered_map<std::string_view, std::unique_ptr<Node>> children;
+};
 
 Server::Server::~Server() = default;
 
-Server::Server::Server(Log::Log &log) : log(log), logContext(log("server")) {}
+Server::Server::Server(Log::Log &log) :
+    log(log), logContext(log("server")), names(std::make_unique<NameTable>()), root(std::make_unique<Node>(*names, ""))
+{
+}
 
 void Server::Server::addEphemeralWhenNotFound(Path path)
 {
-    ephemeralWhenNotFound.emplace(std::move(path));
+    ephemeralWhenNotFound.emplace(path.view());
+}
+
+void Server::Server::setEphemeralWhenNotFoundRange(const Path &directory, std::string_view prefix, unsigned int begin,
+                                                   unsigned int end)
+{
+    std::string key = getNumberedPathKey(directory, prefix);
+    std::unique_lock lock(ephemeralWhenNotFoundRangesMutex);
+    ephemeralWhenNotFoundRanges.insert_or_assign(std::move(key), std::pair(begin, end));
+}
+
+void Server::Server::removeEphemeralWhenNotFoundRange(const Path &directory, std::string_view prefix)
+{
+    std::string key = getNumberedPathKey(directory, prefix);
+    std::unique_lock lock(ephemeralWhenNotFoundRangesMutex);
+    ephemeralWhenNotFoundRanges.erase(key);
 }
 
 Awaitable<void> Server::Server::operator()(Response &response, Request &request) const
 {
     Log::Context requestLog = log("request");
-    requestLog << "what" << Log::Level::info << (std::string)request.getPath() << ", "
+    requestLog << "what" << Log::Level::info << request.getPath().view() << ", "
                << (request.getIsPublic() ? "public" : "private") << ", "
                << getRequestTypeString(request.getType());
 
     bool waitForResponse = false; // Call response.wait after the try/catch block, and then return.
     std::string what; // Somewhere to put the internal error message if we can get one.
 
-    /* We need a copy of the original request path in case we need it later. */
-    Path originalPath = request.getPath();
-
     /* Try to handle the request. */
     try {
-        /* Grab the root resource (whatever it is, but it's probably a TreeResource), and make sure it exists. */
-        std::shared_ptr<Resource> currentRoot = root; // Keep ownership.
-        if (!currentRoot) {
-            throw Error(ErrorKind::NotFound);
-        }
-        Resource &resource = *currentRoot;
+        /* Find the resource. */
+        // This keeps ownership of the resource, so the request can complete even if it's removed from the tree.
+        std::shared_ptr<Resource> resource = findResource(request);
 
-        /* We kept a shared ownership to the root resource above, so now we can just call it. This will probably call
-           TreeResource::operator(). The root gets the entire path. */
-        checkResourceRestrictions(resource, request);
-        co_await resource(response, request);
+        /* Call it, and wait for it to finish so the shared pointer keeps it alive. */
+        co_await invoke(*resource, response, request);
 
         /* Wait for the response to be written to the network, and return. */
         co_await response.flush(true);
@@ -257,7 +294,7 @@ Awaitable<void> Server::Server::operator()(Response &response, Request &request)
 
             // Set the response's cache kind to ephemeral if we have a not found path in the set of ephemeral not
             // founds.
-            if (e.kind == ErrorKind::NotFound && ephemeralWhenNotFound.contains(originalPath)) {
+            if (e.kind == ErrorKind::NotFound && getIsEphemeralWhenNotFound(request.getOriginalPath())) {
                 response.setCacheKind(CacheKind::ephemeral);
             }
 
@@ -294,49 +331,82 @@ Awaitable<void> Server::Server::operator()(Response &response, Request &request)
     }
 }
 
-std::shared_ptr<Server::Resource> &Server::Server::getOrCreateLeafNode(const Path &path, bool existing)
+Awaitable<void> Server::Server::invoke(Resource &resource, Response &response, Request &request) const
 {
-    /* Tree traversal. */
-    std::shared_ptr<Resource> *node = &root;
-    for (size_t i = 0; i < path.size(); ++i) {
-        assert(node); // The node variable is always created from a reference.
+    co_await resource(response, request);
+}
 
-        // Create a tree node if the node is null.
-        if (!*node) {
-            *node = std::make_shared<TreeResource>();
+std::shared_ptr<Server::Resource> Server::Server::findResource(Request &request) const
+{
+    std::shared_lock lock(treeMutex);
+
+    /* Intermediate nodes only allow public access for GET requests. The resource gets the same check, but this decides
+       which error is returned for paths that don't exist. */
+    if (root->isTree() && request.getType() != Request::Type::get && request.getIsPublic()) {
+        throw Error(ErrorKind::Forbidden);
+    }
+
+    /* Traverse the tree until we find a leaf. Each leaf's resource gets what's left of the path. */
+    const Node *node = root.get();
+    while (node->isTree()) {
+        // Don't allow directory listing of resources.
+        if (request.getPath().empty()) {
+            throw Error(ErrorKind::Forbidden);
         }
 
-        // Make sure we're not trying to create the child of a leaf node.
-        auto *tree = dynamic_cast<TreeResource *>(node->get());
-        if (!tree) {
-            if (auto *rootTree = dynamic_cast<TreeResource *>(root.get())) {
-                // This is expensive in the exceptional case, but this means we don't need to track the history of our
-                // traversal in the non-exceptional case to be able to find where we might have created tree nodes.
-                rootTree->prune();
-            }
+        // Find the child referred to, and pop the path component that refers to it.
+        node = node->find(request.getPath().front());
+        if (!node) {
+            throw Error(ErrorKind::NotFound);
+        }
+        request.popPathPart();
+    }
+
+    /* Check the resource can handle the request. */
+    if (!node->resource) {
+        throw Error(ErrorKind::NotFound); // This only happens if the tree is empty.
+    }
+    checkResourceRestrictions(*node->resource, request);
+    return node->resource;
+}
+
+std::shared_ptr<Server::Resource> &Server::Server::getOrCreateLeafNode(const Path &path, bool existing)
+{
+    /* Follow the nodes that exist, making sure we're not trying to create the child of a leaf node. */
+    Node *node = root.get();
+    size_t i = 0;
+    for (; i < path.size(); ++i) {
+        if (node->resource) {
             throw std::runtime_error("Cannot get/create child \"" + (std::string)path + "\" of server resource.");
         }
+        Node *child = node->find(path[i]);
+        if (!child) {
+            break;
+        }
+        node = child;
+    }
 
-        // Get/create the next node.
-        node = &(*tree)[path[i]];
+    /* Create the rest. Nothing can fail after this. */
+    if (i < path.size()) {
+        for (; i < path.size(); ++i) {
+            node = &(*node)[path[i]];
+        }
+        return node->resource;
     }
-    assert(node);
 
     /* Check that the node is what we expect. */
-    // None of the nodes we return from this should be a TreeResource.
-    if (dynamic_cast<TreeResource *>(node->get())) {
-        // This cannot happen by the node creation operation above.
+    // None of the nodes we return from this should be an intermediate node.
+    if (node->isTree()) {
         throw std::runtime_error("Path \"" + (std::string)path + "\" points to intermediate server tree node.");
     }
 
     // Check that the node is not an existing node if we're not allowed it.
-    if (!existing && *node) {
-        // This cannot happen by the node creation operation above.
+    if (!existing && node->resource) {
         throw std::runtime_error("Path \"" + (std::string)path + "\" points to existing server resource.");
     }
 
     /* Done :) */
-    return *node;
+    return node->resource;
 }
 
 void Server::Server::logResourceChange(const Path &path, bool added, bool removed)
@@ -355,61 +425,71 @@ void Server::Server::logResourceChange(const Path &path, bool added, bool remove
     logContext << type << Log::Level::info << (std::string)path;
 }
 
-void Server::Server::removeResourceOrTree(const Path &path, bool allowTreeRemoval)
+bool Server::Server::getIsEphemeralWhenNotFound(std::string_view path) const
 {
-    /* Tree traversal to find the tree node path to the leaf to remove. */
-    std::vector<TreeResource *> intermediateNodes;
-    intermediateNodes.reserve(path.size());
+    /* Check the individual paths. */
+    if (ephemeralWhenNotFound.contains(path)) {
+        return true;
+    }
 
-    std::shared_ptr<Resource> *node = &root;
-    for (size_t i = 0; i < path.size(); ++i) {
-        assert(node); // The node variable is always created from a reference, except where it's checked for nullness.
+    /* Split the number off the end of the path. */
+    size_t numberStart = path.size();
+    while (numberStart > 0 && path[numberStart - 1] >= '0' && path[numberStart - 1] <= '9') {
+        numberStart--;
+    }
+    unsigned int number;
+    std::from_chars_result result = std::from_chars(path.data() + numberStart, path.data() + path.size(), number);
+    if (result.ec != std::errc() || result.ptr != path.data() + path.size()) {
+        return false; // There's no number, or it's too big to be in any range.
+    }
 
-        // Make sure we're not erasing a non-existent node.
-        if (!*node) {
-            throw std::runtime_error("Cannot erase non-existent server resource \"" + (std::string)path + "\".");
-        }
+    /* Check whether the number's in the range for the rest of the path. */
+    std::shared_lock lock(ephemeralWhenNotFoundRangesMutex);
+    auto it = ephemeralWhenNotFoundRanges.find(path.substr(0, numberStart));
+    return it != ephemeralWhenNotFoundRanges.end() && number >= it->second.first && number < it->second.second;
+}
 
+void Server::Server::removeResourceOrTree(const Path &path, bool allowTreeRemoval)
+{
+    std::unique_lock lock(treeMutex);
+
+    /* Tree traversal to find the tree node path to the node to remove. */
+    std::vector<Node *> nodes;
+    nodes.reserve(path.size() + 1);
+    nodes.push_back(root.get());
+    for (size_t i = 0; i < path.size(); ++i) {
         // Make sure we're not trying to erase the child of a leaf node.
-        auto *tree = dynamic_cast<TreeResource *>(node->get());
-        if (!tree) {
+        if (!nodes.back()->isTree()) {
             throw std::runtime_error("Cannot erase child \"" + (std::string)path + "\" of leaf server tree node.");
         }
 
-        // Save this node in the list of intermediates and get the next one.
-        intermediateNodes.push_back(tree);
-
-        node = (*tree).at(path[i]);
+        // Get the next node.
+        Node *node = nodes.back()->find(path[i]);
         if (!node) {
             throw std::runtime_error("Cannot remove non-existing server tree node \"" + (std::string)path + "\".");
         }
+        nodes.push_back(node);
     }
-    assert(node);
-    assert(intermediateNodes.size() == path.size()); // Number of lookups, and therefore number of intermediate nodes.
+    assert(nodes.size() == path.size() + 1); // The root, and then one node per path component.
 
     /* Check that we're not trying to remove an intermediate node. */
-    if (!allowTreeRemoval && dynamic_cast<TreeResource *>(node->get())) {
+    if (!allowTreeRemoval && nodes.back()->isTree()) {
         throw std::runtime_error("Cannot remove intermediate server tree node \"" + (std::string)path + "\".");
     }
+    if (!nodes.back()->isTree() && !nodes.back()->resource) {
+        throw std::runtime_error("Cannot erase non-existent server resource \"" + (std::string)path + "\".");
+    }
 
     /* Once we get here, we know we're doing the removal. Log it. */
     logResourceChange(path, false, true);
 
-    /* Iterate backwards, removing the resource and any consequently empty trees. */
-    for (size_t j = 0; j < path.size(); ++j) {
-        size_t i = path.size() - j - 1;
-
-        assert(intermediateNodes[i]);
-        assert(j == 0 || intermediateNodes[i + 1]->empty());
-
-        intermediateNodes[i]->erase(path[i]);
-        if (!intermediateNodes[i]->empty()) {
+    /* Remove the node, and any consequently empty parents. The root is emptied rather than removed. */
+    for (size_t i = path.size(); i > 0; --i) {
+        nodes[i - 1]->children.erase(path[i - 1]);
+        if (nodes[i - 1]->isTree()) {
             return; // This node is not empty, so neither will any of its parents be.
         }
     }
-
-    // The root node is now empty.
-    assert(intermediateNodes[0] == root.get());
-    assert(intermediateNodes[0]->empty());
-    root.reset();
+    root->children.clear();
+    root->resource.reset();
 }
@@ -4,9 +4,12 @@
 
 #include "log/Log.hpp"
 
+#include <map>
 #include <memory>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 
 /**
  * @defgroup server Server
@@ -35,6 +38,8 @@ class Response;
  * This is subclassed by the implementation of the HTTP server to provide an implementation that's suitable for the
  * asynchronous networking stuff the HTTP server does. The idea is to separate out the generic stuff like finding the
  * right resource and enforcing resource restrictions from the HTTP/networking specific stuff.
+ *
+ * Requests may be handled from any thread, but the resource tree must only be modified from one thread at a time.
  */
 class Server
 {
@@ -106,6 +111,30 @@ public:
      */
     void addEphemeralWhenNotFound(Path path);
 
+    /**
+     * Use ephemeral caching for the Not Found responses of a range of numbered paths.
+     *
+     * This is like addEphemeralWhenNotFound, but for a sequence of resources that are created over time, like segments.
+     * It covers the names in a directory that are a prefix followed by a number (with any number of leading zeros) in
+     * the range, without adding anything to the resource tree for each of them. Setting the range for a directory and
+     * prefix again replaces the previous range.
+     *
+     * @param directory The path of the directory that the numbered paths are in.
+     * @param prefix The part of the name before the number.
+     * @param begin The first number in the range.
+     * @param end One past the last number in the range.
+     */
+    void setEphemeralWhenNotFoundRange(const Path &directory, std::string_view prefix, unsigned int begin,
+                                       unsigned int end);
+
+    /**
+     * Stop using ephemeral caching for the Not Found responses of a range of numbered paths.
+     *
+     * @param directory The directory given to setEphemeralWhenNotFoundRange.
+     * @param prefix The prefix given to setEphemeralWhenNotFoundRange.
+     */
+    void removeEphemeralWhenNotFoundRange(const Path &directory, std::string_view prefix);
+
 protected:
     explicit Server(Log::Log &log);
 
@@ -121,6 +150,18 @@ protected:
      */
     Awaitable<void> operator()(Response &response, Request &request) const;
 
+    /**
+     * Call a resource to service a request.
+     *
+     * This is called by operator() once the resource has been found and its restrictions checked. Subclasses can
+     * override it to control where (e.g: which thread) the resource is called from.
+     *
+     * @param resource The resource to call.
+     * @param response The response object for the request.
+     * @param request The request object, with its path relative to the resource.
+     */
+    virtual Awaitable<void> invoke(Resource &resource, Response &response, Request &request) const;
+
     /**
      * The log to write to.
      */
@@ -131,7 +172,21 @@ protected:
      */
     Log::Context logContext;
 
+    /**
+     * Find the resource that should service a request.
+     *
+     * This checks the resource's restrictions, and pops the path components that lead to the resource from the
+     * request's path.
+     *
+     * @param request The request to find the resource for.
+     * @return The resource to call. This is never null.
+     */
+    std::shared_ptr<Resource> findResource(Request &request) const;
+
 private:
+    class NameTable;
+    struct Node;
+
     /**
      * Add a resource to the server, replacing any that already exists.
      *
@@ -145,6 +200,8 @@ private:
     template <typename ResourceType, typename... Args>
     std::shared_ptr<ResourceType> addOrReplaceResource(bool replace, const Path &path, Args &&...args)
     {
+        std::unique_lock lock(treeMutex);
+
         /* Get the node that we're going to insert into, and check it's not a tree. */
         std::shared_ptr<Resource> &node = getOrCreateLeafNode(path, replace);
 
@@ -162,11 +219,11 @@ private:
     /**
      * Create a leaf node (i.e: smart pointer to a resource) in the resources tree.
      *
-     * @param path The path to the node to find. This must not point to an intermediate node in the tree and
-     *             must not point to a child of a resource (other than a tree resource, which implements an intermediate
-     *             node).
+     * @param path The path to the node to find. This must not point to an intermediate node in the tree and must not
+     *             point to a child of a resource.
      * @param existing Permit returning an existing node.
-     * @return A pointer to the node. Or nullptr if it doesn't exist and isn't allowed to be created.
+     * @return A reference to the node's resource, which is null if the node was just created.
+     * @throws std::runtime_error if the conditions on path are not met, in which case the tree is unchanged.
      */
     std::shared_ptr<Resource> &getOrCreateLeafNode(const Path &path, bool existing);
 
@@ -188,6 +245,18 @@ private:
      */
     void logResourceChange(const Path &path, bool added, bool removed);
 
+    /**
+     * Determine whether the Not Found response for a path should use ephemeral caching.
+     *
+     * @param path The canonical string form of the path.
+     */
+    bool getIsEphemeralWhenNotFound(std::string_view path) const;
+
+    /**
+     * The names of the nodes in the resource tree. This is declared before the tree so it outlives it.
+     */
+    std::unique_ptr<NameTable> names;
+
     /**
      * The root node in the resource tree.
      *
@@ -195,12 +264,27 @@ private:
      * order that such a request can complete successfully, operator() keeps a shared pointer to the Resource it's
      * using.
      */
-    std::shared_ptr<Resource> root;
+    std::unique_ptr<Node> root;
+
+    /**
+     * Protects the resource tree, so requests can be handled by threads other than the one that modifies the tree.
+     */
+    mutable std::shared_mutex treeMutex;
+
+    /**
+     * Paths that return ephemeral rather than fixed Not Found errors if non-existent, in canonical string form.
+     */
+    std::set<std::string, std::less<>> ephemeralWhenNotFound;
+
+    /**
+     * Ranges of numbered paths that return ephemeral Not Found errors, as [begin, end), by the path up to the number.
+     */
+    std::map<std::string, std::pair<unsigned int, unsigned int>, std::less<>> ephemeralWhenNotFoundRanges;
 
     /**
-     * Paths that return ephemeral rather than fixed Not Found errors if non-existent.
+     * Protects ephemeralWhenNotFoundRanges, which can change while requests are being handled.
      */
-    std::set<Path> ephemeralWhenNotFound;
+    mutable std::shared_mutex ephemeralWhenNotFoundRangesMutex;
 };
 
 } // namespace Server
@@ -0,0 +1,107 @@
+#include "BufferPool.hpp"
+
+#include <cassert>
+#include <new>
+
+/**
+ * Allocates shared_ptr's combined control block and data from the pool.
+ */
+template <typename T> class Util::BufferPool::Allocator final
+{
+public:
+    using value_type = T;
+
+    Allocator(BufferPool &pool, size_t index) : pool(pool), index(index) {}
+    template <typename U> Allocator(const Allocator<U> &other) : pool(other.pool), index(other.index) {}
+
+    T *allocate(size_t n)
+    {
+        return (T *)pool.allocateRaw(index, n * sizeof(T));
+    }
+
+    void deallocate(T *pointer, size_t n)
+    {
+        pool.deallocateRaw(index, pointer, n * sizeof(T));
+    }
+
+    template <typename U> bool operator==(const Allocator<U> &rhs) const
+    {
+        return &pool == &rhs.pool && index == rhs.index;
+    }
+
+private:
+    template <typename U> friend class Allocator;
+
+    BufferPool &pool;
+    const size_t index;
+};
+
+Util::BufferPool::~BufferPool()
+{
+    for (FreeList &freeList: freeLists) {
+        for (void *block: freeList.blocks) {
+            ::operator delete(block);
+        }
+    }
+}
+
+Util::BufferPool::BufferPool(size_t maxFreeBytes) : maxFreeBytes(maxFreeBytes) {}
+
+Util::BufferPool &Util::BufferPool::getShared()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+Util::BufferPool::Block Util::BufferPool::allocate(size_t size)
+{
+    size_t capacity = getCapacity(size);
+    size_t index = (capacity > maxBlockSize) ? numSizes : (std::bit_width(capacity / minBlockSize) - 1);
+    return std::allocate_shared_for_overwrite<std::byte[]>(Allocator<std::byte>(*this, index), capacity);
+}
+
+size_t Util::BufferPool::getFreeCount() const
+{
+    std::lock_guard lock(mutex);
+    size_t count = 0;
+    for (const FreeList &freeList: freeLists) {
+        count += freeList.blocks.size();
+    }
+    return count;
+}
+
+void *Util::BufferPool::allocateRaw(size_t index, size_t allocationSize)
+{
+    /* Reuse a free block if there is one. */
+    if (index < numSizes) {
+        std::lock_guard lock(mutex);
+        FreeList &freeList = freeLists[index];
+        assert(freeList.allocationSize == 0 || freeList.allocationSize == allocationSize);
+        freeList.allocationSize = allocationSize;
+        if (!freeList.blocks.empty()) {
+            void *block = freeList.blocks.back();
+            freeList.blocks.pop_back();
+            return block;
+        }
+    }
+
+    /* Otherwise, allocate a new one. */
+    return ::operator new(allocationSize);
+}
+
+void Util::BufferPool::deallocateRaw(size_t index, void *pointer, size_t allocationSize)
+{
+    /* Keep the block if there's room for it. */
+    if (index < numSizes) {
+        std::lock_guard lock(mutex);
+        FreeList &freeList = freeLists[index];
+        assert(freeList.allocationSize == allocationSize);
+        if ((freeList.blocks.size() + 1) * allocationSize <= maxFreeBytes) {
+            freeList.blocks.push_back(pointer);
+            return;
+        }
+    }
+
+    /* Otherwise, free it. */
+    ::operator delete(pointer);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// @addtogroup util
+/// @{
+
+namespace Util
+{
+
+/**
+ * A pool of blocks of memory that data is read into, such as request bodies.
+ *
+ * Blocks are handed out with shared ownership, so they can be sliced into SharedBuffer objects that are kept by any
+ * number of things (e.g: segment histories, interleaves and file writers). When the last of these releases its
+ * reference, the block goes back to the pool rather than being freed, so a steady stream of reads does no allocation.
+ *
+ * Block sizes are rounded up to a power of two, and each size has its own list of free blocks. Blocks bigger than
+ * maxBlockSize aren't pooled.
+ *
+ * This is thread-safe. Blocks can be released from any thread.
+ */
+class BufferPool final
+{
+public:
+    /**
+     * A block of memory. Its size is what was asked for, rounded up by getCapacity().
+     */
+    using Block = std::shared_ptr<std::byte[]>;
+
+    /**
+     * The size of the smallest blocks.
+     */
+    static constexpr size_t minBlockSize = 1 << 12;
+
+    /**
+     * The size of the biggest blocks that are pooled.
+     */
+    static constexpr size_t maxBlockSize = 1 << 20;
+
+    /**
+     * The default number of bytes of free blocks that are kept for each size.
+     */
+    static constexpr size_t defaultMaxFreeBytes = 1 << 26;
+
+    /**
+     * Destroy the pool. All the blocks it handed out must have been released.
+     */
+    ~BufferPool();
+
+    /**
+     * Constructor :)
+     *
+     * @param maxFreeBytes The number of bytes of free blocks to keep for each size. Blocks that are released when this
+     *                     many are already free are freed.
+     */
+    explicit BufferPool(size_t maxFreeBytes = defaultMaxFreeBytes);
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /**
+     * Get the pool that's shared by the whole process.
+     */
+    static BufferPool &getShared();
+
+    /**
+     * Get the size of the block that would be returned for a given size.
+     */
+    static constexpr size_t getCapacity(size_t size)
+    {
+        return (size > maxBlockSize) ? size : std::max(minBlockSize, std::bit_ceil(size));
+    }
+
+    /**
+     * Get a block. Its contents are unspecified.
+     *
+     * @param size The minimum size of the block. The block is getCapacity(size) bytes long.
+     */
+    Block allocate(size_t size);
+
+    /**
+     * Get the number of free blocks that are being kept, of all sizes.
+     */
+    size_t getFreeCount() const;
+
+private:
+    template <typename T> class Allocator;
+
+    /**
+     * The number of sizes that are pooled.
+     */
+    static constexpr size_t numSizes = std::bit_width(maxBlockSize / minBlockSize);
+
+    /**
+     * The free blocks of one size.
+     */
+    struct FreeList final
+    {
+        /**
+         * The size of the allocations in the list, which includes shared_ptr's control block. This is zero until the
+         * first block of this size is allocated.
+         */
+        size_t allocationSize = 0;
+
+        std::vector<void *> blocks;
+    };
+
+    /**
+     * Allocate memory for a block and its control block.
+     *
+     * @param index The index of the free list for the block's size, or numSizes if it isn't pooled.
+     * @param allocationSize The size of the memory.
+     */
+    void *allocateRaw(size_t index, size_t allocationSize);
+
+    /**
+     * Return memory from allocateRaw() to the pool.
+     */
+    void deallocateRaw(size_t index, void *pointer, size_t allocationSize);
+
+    const size_t maxFreeBytes;
+
+    /**
+     * Protects freeLists.
+     */
+    mutable std::mutex mutex;
+
+    std::array<FreeList, numSizes> freeLists;
+};
+
+} // namespace Util
+
+/// @}
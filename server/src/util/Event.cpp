@@ -2,46 +2,177 @@
 
 #include "asio.hpp"
 
-#include <boost/asio/as_tuple.hpp>
-#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/this_coro.hpp>
 
-/* Unfortunately, boost::asio doesn't seem to provide any mechanism to await non-exceptionally on something that's
-   notified from another coroutine. This Event class is based on the idea of using a Boost timer from this post:
-   https://stackoverflow.com/a/17029022. */
+#include <cassert>
+#include <utility>
 
 /**
- * A timer object that waits (almost) indefinitely.
+ * A coroutine that's waiting on the event.
+ *
+ * This lives in the waiting coroutine's frame, and is linked into the list of waiters while it's waiting.
  */
-struct Event::Timer final
+struct Event::Waiter final
 {
-    explicit Timer(IOContext &ioc) : timer(ioc)
+    ~Waiter();
+
+    /**
+     * The list of the event being waited on. This is shared, so the waiter can safely unlink itself even if the event
+     * is destroyed while it's waiting. It's only set by the waiting coroutine.
+     */
+    std::shared_ptr<Waiters> waiters;
+
+    Waiter *prev = nullptr;
+    Waiter *next = nullptr;
+
+    /**
+     * Whether this is in the list of waiters.
+     */
+    bool linked = false;
+
+    /**
+     * The waiting coroutine's executor, which is where it has to be resumed.
+     */
+    boost::asio::any_io_executor executor;
+
+    /**
+     * Resumes the waiting coroutine.
+     */
+    boost::asio::any_completion_handler<void()> handler;
+};
+
+/**
+ * The list of coroutines that are waiting, oldest first.
+ */
+struct Event::Waiters final
+{
+    /**
+     * Add a waiter to the end of the list.
+     *
+     * The mutex must be held.
+     */
+    void push(Waiter &waiter)
+    {
+        assert(!waiter.linked);
+        waiter.prev = tail;
+        waiter.next = nullptr;
+        (tail ? tail->next : head) = &waiter;
+        tail = &waiter;
+        waiter.linked = true;
+    }
+
+    /**
+     * Remove a waiter from the list.
+     *
+     * The mutex must be held.
+     */
+    void remove(Waiter &waiter)
+    {
+        assert(waiter.linked);
+        (waiter.prev ? waiter.prev->next : head) = waiter.next;
+        (waiter.next ? waiter.next->prev : tail) = waiter.prev;
+        waiter.prev = nullptr;
+        waiter.next = nullptr;
+        waiter.linked = false;
+    }
+
+    /**
+     * Remove the oldest waiter from the list, and resume it in its own executor.
+     *
+     * The mutex must be held. The resumption is always posted, so neither the caller nor the lock is re-entered by the
+     * coroutine it's resuming, which can destroy the waiter as soon as it's posted.
+     *
+     * @return Whether there was a waiter.
+     */
+    bool resumeOldest()
     {
-        /* The std::chrono::years value is guaranteed to allow at least this. */
-        timer.expires_from_now(std::chrono::years(40000));
+        if (!head) {
+            return false;
+        }
+        Waiter &waiter = *head;
+        remove(waiter);
+        boost::asio::any_io_executor executor = std::move(waiter.executor);
+        boost::asio::post(executor, std::move(waiter.handler));
+        return true;
     }
 
-    boost::asio::steady_timer timer;
+    std::mutex mutex;
+    Waiter *head = nullptr;
+    Waiter *tail = nullptr;
 };
 
-Event::~Event() = default;
-Event::Event(IOContext &ioc) : ioc(ioc) {}
+Event::Waiter::~Waiter()
+{
+    /* If the coroutine is destroyed while waiting (e.g: because its IO context is being destroyed), make sure the list
+       doesn't refer to it. */
+    if (waiters) {
+        std::lock_guard lock(waiters->mutex);
+        if (linked) {
+            waiters->remove(*this);
+        }
+    }
+}
+
+Event::~Event()
+{
+    /* Wake everything that's still waiting. */
+    notifyAll();
+}
+
+Event::Event() : waiters(std::make_shared<Waiters>()) {}
+
+Event::Event(Event &&other) : waiters(std::exchange(other.waiters, std::make_shared<Waiters>())) {}
 
 Awaitable<void> Event::wait() const
 {
-    if (!timer) {
-        timer = std::make_unique<Timer>(ioc);
-    }
+    /* Add this coroutine to the list once it's suspended, so it can't be resumed before it's ready. */
+    Waiter waiter;
+    waiter.waiters = waiters;
+    waiter.executor = co_await boost::asio::this_coro::executor;
+    co_await boost::asio::async_initiate<const boost::asio::use_awaitable_t<> &, void()>(
+        [&waiter](auto handler) {
+            std::lock_guard lock(waiter.waiters->mutex);
+            waiter.handler = boost::asio::any_completion_handler<void()>(std::move(handler));
+            waiter.waiters->push(waiter);
+        },
+        boost::asio::use_awaitable);
+}
+
+Awaitable<void> Event::wait(std::unique_lock<std::mutex> &lock) const
+{
+    assert(lock.owns_lock());
 
-    // The use of boost::asio::as_tuple makes this return normally even if an exception (due to timer cancellation)
-    // happens.
-    co_await timer->timer.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+    /* Register the wait before giving up the lock. This happens once the coroutine has suspended, so the notification
+       can't resume it too early. */
+    Waiter waiter;
+    waiter.waiters = waiters;
+    waiter.executor = co_await boost::asio::this_coro::executor;
+    co_await boost::asio::async_initiate<const boost::asio::use_awaitable_t<> &, void()>(
+        [&waiter, &lock](auto handler) {
+            {
+                std::lock_guard waitersLock(waiter.waiters->mutex);
+                waiter.handler = boost::asio::any_completion_handler<void()>(std::move(handler));
+                waiter.waiters->push(waiter);
+            }
+            lock.unlock();
+        },
+        boost::asio::use_awaitable);
+    lock.lock();
 }
 
 void Event::notifyAll()
 {
-    if (!timer) {
-        return;
-    }
-    timer->timer.cancel();
-    timer.reset();
+    /* Resume the whole list, oldest first, so that anything that waits after this waits for the next notification. */
+    std::lock_guard lock(waiters->mutex);
+    while (waiters->resumeOldest()) {}
+}
+
+bool Event::notifyOne()
+{
+    /* Resume the oldest waiter. */
+    std::lock_guard lock(waiters->mutex);
+    return waiters->resumeOldest();
 }
@@ -1,23 +1,36 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "util/awaitable.hpp"
 
-class IOContext;
-
 /// @addtogroup asio
 /// @{
 
 /**
  * An event-like object for asynchronous IO.
+ *
+ * The event may be waited on from coroutines in any IO context, and notified from any thread. Waiters are kept in an
+ * intrusive list whose nodes live in the waiting coroutines, so waiting doesn't allocate anything beyond what
+ * boost::asio recycles between operations. Waiters are woken in the order they started waiting.
  */
 class Event final
 {
 public:
+    /**
+     * Destroy the event.
+     *
+     * Any coroutines still waiting on the event are woken, as if it had been notified.
+     */
     ~Event();
-    explicit Event(IOContext &ioc);
+    Event();
 
-    Event(Event &&) = default;
+    /**
+     * Move the event's waiters to a new event.
+     *
+     * The moved-from event is left valid, with nothing waiting on it.
+     */
+    Event(Event &&other);
 
     /**
      * Wait for the event to happen.
@@ -26,16 +39,37 @@ public:
      */
     Awaitable<void> wait() const;
 
+    /**
+     * Wait for the event to happen, unlocking a mutex while waiting.
+     *
+     * This works like std::condition_variable::wait: the wait is registered before the lock is released, so a
+     * notification from another thread that happens after the caller checked its condition (with the lock held) can't
+     * be missed. The lock is held again when this returns.
+     *
+     * Spurious wakeups are permitted.
+     *
+     * @param lock A lock that's locked, and that's held by the thread that's producing whatever is being waited for
+     *             while it changes the condition being waited for.
+     */
+    Awaitable<void> wait(std::unique_lock<std::mutex> &lock) const;
+
     /**
      * Wake everything that's waiting on this event.
      */
     void notifyAll();
 
+    /**
+     * Wake the coroutine that's been waiting on this event for the longest.
+     *
+     * @return Whether there was anything waiting. If so, exactly one waiter will resume.
+     */
+    bool notifyOne();
+
 private:
-    struct Timer;
+    struct Waiter;
+    struct Waiters;
 
-    IOContext &ioc;
-    mutable std::unique_ptr<Timer> timer;
+    std::shared_ptr<Waiters> waiters;
 };
 
 /// @}
@@ -70,18 +70,21 @@ Util::File::File([[maybe_unused]] IOContext &ioc, std::filesystem::path path, bo
 
 Util::File &Util::File::operator=(File &&other) = default;
 
-Awaitable<std::vector<std::byte>> Util::File::readSome()
+Awaitable<Util::SharedBuffer> Util::File::readSome()
 {
     /* Keep trying to read something until we get a non-empty result or end of body. */
     while (true) {
-        // Allocate a buffer if one doesn't already exist.
-        if (buffer.empty()) {
-            buffer = std::vector<std::byte>(1 << 16);
+        // Get a new block if there isn't one, or if there's not much space left in the current one.
+        if (!block || blockSize - blockOffset < minReadSize) {
+            block = BufferPool::getShared().allocate(blockSize);
+            blockOffset = 0;
         }
+        std::byte *data = block.get() + blockOffset;
+        size_t size = blockSize - blockOffset;
 
         // Try to read some data from the file.
 #ifdef BOOST_ASIO_HAS_IO_URING
-        auto [e, n] = co_await file->file.async_read_some(boost::asio::buffer(buffer),
+        auto [e, n] = co_await file->file.async_read_some(boost::asio::buffer(data, size),
                                                           boost::asio::as_tuple(boost::asio::use_awaitable));
 #else // BOOST_ASIO_HAS_IO_URING
         // Even if we got end-of-file before, we might have more to read now.
@@ -89,7 +92,7 @@ Awaitable<std::vector<std::byte>> Util::File::readSome()
 
         // Try to read from the file.
         try {
-            file->file.read((char *)buffer.data(), buffer.size());
+            file->file.read((char *)data, (std::streamsize)size);
         }
         catch (const std::ios::failure &) {
             if (!file->file.eof()) {
@@ -100,28 +103,22 @@ Awaitable<std::vector<std::byte>> Util::File::readSome()
         // Figure out how much we read and if we got to the end of the file.
         size_t n = file->file.gcount();
         if (n == 0 && file->file.eof()) {
-            co_return std::vector<std::byte>();
+            co_return SharedBuffer();
         }
         assert(n > 0);
 #endif // BOOST_ASIO_HAS_IO_URING
 
-        // Return the buffer by moving if most of it was used.
-        // The idea is to avoid the copy. If most of it is unused, then it could be inefficient to the entire memory
-        // allocation for just a small amount of data.
-        if (n >= buffer.size() / 2) {
-            buffer.resize(n);
-            co_return std::move(buffer);
-        }
-
-        // Otherwise, copy the data if there isn't enough for the above optimization to be efficient.
-        else if (n > 0) {
-            co_return std::vector<std::byte>(buffer.begin(), buffer.begin() + n);
+        // Return the part of the block that was just read into, sharing ownership of the block. Nothing writes to that
+        // part again, and the next read goes after it.
+        if (n > 0) {
+            blockOffset += n;
+            co_return SharedBuffer(block, std::span(data, n));
         }
 
 #ifdef BOOST_ASIO_HAS_IO_URING
         // Handle end of file by returning empty.
         if (e == boost::asio::error::eof) {
-            co_return std::vector<std::byte>();
+            co_return SharedBuffer();
         }
 
         // Other errors.
@@ -134,9 +131,9 @@ Awaitable<std::vector<std::byte>> Util::File::readSome()
 
 Awaitable<std::vector<std::byte>> Util::File::readAll()
 {
-    std::vector<std::vector<std::byte>> dataParts;
+    std::vector<SharedBuffer> dataParts;
     while (true) {
-        std::vector<std::byte> part = co_await readSome();
+        SharedBuffer part = co_await readSome();
         if (part.empty()) {
             co_return Util::concatenate(dataParts);
         }
@@ -6,6 +6,8 @@
 #include <string_view>
 #include <vector>
 #include "util/awaitable.hpp"
+#include "util/BufferPool.hpp"
+#include "util/SharedBuffer.hpp"
 
 class IOContext;
 
@@ -49,9 +51,10 @@ public:
     /**
      * Read some data from the file.
      *
-     * @return The read data, or empty if end of file.
+     * @return The read data, or empty if end of file. This refers to a block from the shared BufferPool, which goes
+     *         back to the pool once nothing refers to it.
      */
-    Awaitable<std::vector<std::byte>> readSome();
+    Awaitable<SharedBuffer> readSome();
 
     /**
      * Read all (remaining) data from the file.
@@ -106,11 +109,26 @@ private:
     std::filesystem::path path;
 
     /**
-     * An internal buffer used for efficiency.
+     * The size of the blocks that the file is read into.
+     */
+    static constexpr size_t blockSize = 1 << 16;
+
+    /**
+     * The smallest amount of space to read into before starting a new block.
+     */
+    static constexpr size_t minReadSize = blockSize / 8;
+
+    /**
+     * The block that the file is being read into.
      *
-     * If the read chunk is large enough, it'll be returned in this buffer as an optimization.
+     * Short reads share a block rather than each having their own, and nothing is copied.
+     */
+    BufferPool::Block block;
+
+    /**
+     * The offset of the first unused byte in block.
      */
-    std::vector<std::byte> buffer;
+    size_t blockOffset = 0;
 };
 
 } // namespace Util
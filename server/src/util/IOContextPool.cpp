@@ -0,0 +1,57 @@
+#include "IOContextPool.hpp"
+
+#include "asio.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+
+#include <algorithm>
+
+IOContextPool::~IOContextPool()
+{
+    stop();
+}
+
+IOContextPool::IOContextPool(IOContext &ioc, unsigned int numThreads) : ioc(ioc)
+{
+    /* Figure out how many threads to use. */
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    /* Create the worker contexts. Each is only ever run by one thread. */
+    workers.reserve(numThreads - 1);
+    for (unsigned int i = 1; i < numThreads; i++) {
+        workers.emplace_back(std::make_unique<IOContext>(1));
+    }
+}
+
+void IOContextPool::run()
+{
+    /* Start the workers. */
+    // The work guards keep the worker contexts running even if they temporarily run out of work (e.g: because nothing's
+    // listening on them yet).
+    threads.reserve(workers.size());
+    for (std::unique_ptr<IOContext> &worker: workers) {
+        threads.emplace_back([&worker = *worker]() {
+            auto guard = boost::asio::make_work_guard(worker);
+            worker.run();
+        });
+    }
+
+    /* Run the main context on this thread. */
+    ioc.run();
+
+    /* The main context is where everything interesting is controlled from, so there's nothing left to do. */
+    stop();
+}
+
+void IOContextPool::stop()
+{
+    for (std::unique_ptr<IOContext> &worker: workers) {
+        worker->stop();
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    threads.clear();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class IOContext;
+
+/// @addtogroup asio
+/// @{
+
+/**
+ * A set of IO contexts, each of which is run by its own thread.
+ *
+ * The first IO context is the main one. It's given to the constructor and is run by the thread that calls run(). It's
+ * the one that everything that isn't specifically meant to be multi-threaded (e.g: the configuration, the ffmpeg
+ * processes, and the DASH ingest) lives in. The rest are worker contexts, which are created by the pool and are each
+ * run by a thread that the pool creates.
+ */
+class IOContextPool final
+{
+public:
+    /**
+     * Stop the worker contexts and wait for their threads to finish.
+     */
+    ~IOContextPool();
+
+    /**
+     * Constructor :)
+     *
+     * @param ioc The main IO context.
+     * @param numThreads The total number of threads (and therefore IO contexts), including the main one. Zero means to
+     *                   use one per CPU.
+     */
+    explicit IOContextPool(IOContext &ioc, unsigned int numThreads = 1);
+
+    IOContextPool(const IOContextPool &) = delete;
+    IOContextPool &operator=(const IOContextPool &) = delete;
+
+    /**
+     * Get the number of IO contexts, including the main one.
+     */
+    size_t size() const
+    {
+        return workers.size() + 1;
+    }
+
+    /**
+     * Get an IO context.
+     *
+     * @param index The index of the IO context. Index 0 is the main IO context.
+     */
+    IOContext &operator[](size_t index) const
+    {
+        return index ? *workers[index - 1] : ioc;
+    }
+
+    /**
+     * Get the main IO context.
+     */
+    IOContext &getMain() const
+    {
+        return ioc;
+    }
+
+    /**
+     * Run every IO context.
+     *
+     * The worker contexts are run on their own threads, and the main one is run on the calling thread. This returns
+     * when the main IO context runs out of work, at which point the worker contexts are stopped.
+     */
+    void run();
+
+private:
+    /**
+     * Stop the worker contexts and join their threads.
+     */
+    void stop();
+
+    IOContext &ioc;
+    std::vector<std::unique_ptr<IOContext>> workers;
+    std::vector<std::thread> threads;
+};
+
+/// @}
@@ -10,6 +10,8 @@ Awaitable<Mutex::LockGuard> Mutex::lockGuard()
 
 Awaitable<void> Mutex::lock()
 {
+    /* Wait until the mutex is free. Something else might have taken it between it being unlocked and this resuming, and
+       the event permits spurious wakeups. */
     while (locked) {
         co_await event.wait();
     }
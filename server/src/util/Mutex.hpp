@@ -7,6 +7,11 @@
 
 /**
  * A mutex-like object for asynchronous IO.
+ *
+ * Unlocking the mutex wakes only the coroutine that's been waiting for it for the longest, rather than waking every
+ * waiter to race for it. The woken coroutine takes the mutex if it's still free by the time it runs, and waits again
+ * otherwise, so the mutex is never left locked by a waiter that doesn't run (e.g: because its IO context is shutting
+ * down).
  */
 class Mutex final
 {
@@ -49,8 +54,6 @@ public:
         Mutex *parent;
     };
 
-    explicit Mutex(IOContext &ioc) : event(ioc) {}
-
     /**
      * Lock the mutex, and get a RAII object that unlocks it when it goes out of scope.
      */
@@ -62,12 +65,12 @@ public:
     Awaitable<void> lock();
 
     /**
-     * Unlock the mutex.
+     * Unlock the mutex, and wake the next coroutine waiting for it.
      */
     void unlock()
     {
         locked = false;
-        event.notifyAll();
+        event.notifyOne();
     }
 
 private:
@@ -0,0 +1,132 @@
+#include "RandomPool.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <random>
+
+namespace
+{
+
+/**
+ * The increment between SplitMix64 states.
+ */
+constexpr uint64_t splitMixGamma = 0x9E3779B97F4A7C15;
+
+} // namespace
+
+void Util::fillRandom(std::span<std::byte> dst, uint64_t &seed)
+{
+    /* Generate whole words. */
+    size_t numWords = dst.size() / sizeof(uint64_t);
+    uint64_t base = seed;
+    for (size_t i = 0; i < numWords; i++) {
+        uint64_t z = base + (i + 1) * splitMixGamma;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        z ^= z >> 31;
+        memcpy(dst.data() + i * sizeof(uint64_t), &z, sizeof(uint64_t));
+    }
+    seed = base + numWords * splitMixGamma;
+
+    /* Generate the leftover bytes from one more word. */
+    size_t remainder = dst.size() % sizeof(uint64_t);
+    if (remainder > 0) {
+        std::byte last[sizeof(uint64_t)];
+        fillRandom(last, seed);
+        memcpy(dst.data() + numWords * sizeof(uint64_t), last, remainder);
+    }
+}
+
+Util::RandomPool::~RandomPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    needNext.notify_one();
+    thread.join();
+}
+
+Util::RandomPool::RandomPool(size_t blockSize) :
+    blockSize(blockSize), seed([]() {
+        std::random_device device;
+        return ((uint64_t)device() << 32) | device();
+    }()),
+    current(generate(blockSize)), thread([this]() { run(); })
+{
+}
+
+Util::RandomPool &Util::RandomPool::getShared()
+{
+    static RandomPool pool;
+    return pool;
+}
+
+Util::SharedBuffer Util::RandomPool::get(size_t length)
+{
+    /* Requests that are too big to be sliced from a block get their own data. */
+    if (length > blockSize) {
+        std::shared_ptr<const Block> block = generate(length);
+        return SharedBuffer(block, *block);
+    }
+
+    std::unique_lock lock(mutex);
+
+    /* Move on to the next block if there isn't enough left in this one. */
+    bool usedNext = false;
+    if (offset + length > current->size()) {
+        // If the background thread hasn't caught up, this request gets its own data rather than waiting for it or
+        // reusing bytes that have already been handed out.
+        if (!next) {
+            lock.unlock();
+            std::shared_ptr<const Block> block = generate(length);
+            return SharedBuffer(block, *block);
+        }
+        current = std::move(next);
+        offset = 0;
+        usedNext = true;
+    }
+
+    /* Hand out a slice of the current block. */
+    SharedBuffer result(current, std::span(current->data() + offset, length));
+    offset += length;
+    lock.unlock();
+
+    /* Have the background thread replace the block that's been used. */
+    if (usedNext) {
+        needNext.notify_one();
+    }
+    return result;
+}
+
+std::shared_ptr<const Util::RandomPool::Block> Util::RandomPool::generate(size_t size)
+{
+    // Reserve a part of the sequence under the lock, then generate it without the lock.
+    uint64_t blockSeed;
+    {
+        std::lock_guard lock(mutex);
+        blockSeed = seed;
+        seed += (size / sizeof(uint64_t) + 1) * splitMixGamma;
+    }
+    auto block = std::make_shared<Block>(size);
+    fillRandom(*block, blockSeed);
+    return block;
+}
+
+void Util::RandomPool::run()
+{
+    std::unique_lock lock(mutex);
+    while (true) {
+        // Wait until the next block is needed.
+        needNext.wait(lock, [this]() { return stopping || !next; });
+        if (stopping) {
+            return;
+        }
+
+        // Generate it without holding the lock.
+        lock.unlock();
+        std::shared_ptr<const Block> block = generate(blockSize);
+        lock.lock();
+        next = std::move(block);
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "SharedBuffer.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/// @addtogroup util
+/// @{
+
+namespace Util
+{
+
+/**
+ * Fill some memory with pseudorandom bytes.
+ *
+ * This is meant for making data incompressible, not for anything that needs to be unpredictable. Each 64-bit word is a
+ * function of its position in the sequence alone (it's SplitMix64), so the loop has no dependencies between iterations
+ * and the compiler can vectorise it.
+ *
+ * @param dst The memory to fill.
+ * @param seed The position in the sequence to start at. This is advanced past the words that were generated.
+ */
+void fillRandom(std::span<std::byte> dst, uint64_t &seed);
+
+/**
+ * A pool of random (and therefore incompressible) bytes, which is used to pad streams.
+ *
+ * Padding is handed out as slices of a large block that's shared between all its users, so getting padding neither
+ * allocates nor generates anything. The next block is generated by a background thread while the current one is being
+ * used up. No byte is ever handed out twice: if the background thread falls behind, padding is generated on demand.
+ *
+ * This is thread-safe.
+ */
+class RandomPool final
+{
+public:
+    /**
+     * The default size of the blocks that padding is sliced from.
+     */
+    static constexpr size_t defaultBlockSize = 1 << 21;
+
+    ~RandomPool();
+
+    /**
+     * Constructor :)
+     *
+     * @param blockSize The size of the blocks to slice padding from. Requests for more than this are generated
+     *                  specially.
+     */
+    explicit RandomPool(size_t blockSize = defaultBlockSize);
+
+    RandomPool(const RandomPool &) = delete;
+    RandomPool &operator=(const RandomPool &) = delete;
+
+    /**
+     * Get the pool that's shared by the whole process.
+     */
+    static RandomPool &getShared();
+
+    /**
+     * Get some random bytes.
+     *
+     * @param length The number of bytes to get.
+     */
+    SharedBuffer get(size_t length);
+
+private:
+    using Block = std::vector<std::byte>;
+
+    /**
+     * Generate a new block.
+     *
+     * The mutex must not be held.
+     */
+    std::shared_ptr<const Block> generate(size_t size);
+
+    /**
+     * The body of the background thread.
+     */
+    void run();
+
+    const size_t blockSize;
+
+    /**
+     * Protects everything below.
+     */
+    std::mutex mutex;
+
+    /**
+     * Tells the background thread when the next block is needed, or when it should stop.
+     */
+    std::condition_variable needNext;
+
+    /**
+     * The position in the random sequence to generate the next block from.
+     */
+    uint64_t seed;
+
+    /**
+     * The block that's currently being handed out.
+     */
+    std::shared_ptr<const Block> current;
+
+    /**
+     * The offset in current of the first byte that hasn't been handed out.
+     */
+    size_t offset = 0;
+
+    /**
+     * The block to use when current is used up. This is null while the background thread is generating it.
+     */
+    std::shared_ptr<const Block> next;
+
+    /**
+     * Whether the background thread should stop.
+     */
+    bool stopping = false;
+
+    /**
+     * The background thread. This is last so it's started after everything it uses has been constructed.
+     */
+    std::thread thread;
+};
+
+} // namespace Util
+
+/// @}
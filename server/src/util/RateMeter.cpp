@@ -0,0 +1,65 @@
+#include "RateMeter.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+Util::RateMeter::~RateMeter() = default;
+
+Util::RateMeter::RateMeter(std::chrono::steady_clock::duration window, unsigned int numBuckets) :
+    bucketDuration(std::max(window / std::max(numBuckets, 1u), std::chrono::steady_clock::duration(1))),
+    buckets(std::max(numBuckets, 1u))
+{
+}
+
+void Util::RateMeter::add(size_t amount, std::chrono::steady_clock::time_point now)
+{
+    advance(now);
+    buckets[(size_t)currentBucket % buckets.size()] += amount;
+    total += amount;
+}
+
+size_t Util::RateMeter::getAmountInWindow(std::chrono::steady_clock::time_point now)
+{
+    advance(now);
+    return total;
+}
+
+double Util::RateMeter::getRate(std::chrono::steady_clock::time_point now)
+{
+    std::chrono::duration<double> window = bucketDuration * buckets.size();
+    return (double)getAmountInWindow(now) / window.count();
+}
+
+void Util::RateMeter::advance(std::chrono::steady_clock::time_point now)
+{
+    int64_t bucket = now.time_since_epoch() / bucketDuration;
+
+    /* The first time, there's nothing to expire. */
+    if (!started) {
+        currentBucket = bucket;
+        started = true;
+        return;
+    }
+
+    /* Don't go backwards. */
+    if (bucket <= currentBucket) {
+        return;
+    }
+
+    /* If the whole window has passed, everything's expired. */
+    if (bucket - currentBucket >= (int64_t)buckets.size()) {
+        std::fill(buckets.begin(), buckets.end(), 0);
+        total = 0;
+        currentBucket = bucket;
+        return;
+    }
+
+    /* Otherwise, empty each bucket that's being reused for a new period of time. */
+    while (currentBucket < bucket) {
+        currentBucket++;
+        size_t &expiring = buckets[(size_t)currentBucket % buckets.size()];
+        assert(total >= expiring);
+        total -= expiring;
+        expiring = 0;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @addtogroup util
+/// @{
+
+namespace Util
+{
+
+/**
+ * Measures how much data has passed through something over a sliding window of time.
+ *
+ * The window is divided into a ring of equal buckets, and a running total is kept of what's in them, so adding data and
+ * finding out how much is in the window both take constant time. The cost is resolution: data is counted until the
+ * bucket it was added to leaves the window, so the effective window is between one bucket shorter than the requested
+ * window and the requested window.
+ *
+ * This is not thread-safe.
+ */
+class RateMeter final
+{
+public:
+    /**
+     * The default number of buckets to divide the window into.
+     */
+    static constexpr unsigned int defaultNumBuckets = 16;
+
+    ~RateMeter();
+
+    /**
+     * Constructor :)
+     *
+     * @param window The duration to measure over.
+     * @param numBuckets The number of buckets to divide the window into. More buckets give better resolution, but use
+     *                   more memory and make large gaps between uses slightly slower.
+     */
+    explicit RateMeter(std::chrono::steady_clock::duration window, unsigned int numBuckets = defaultNumBuckets);
+
+    /**
+     * Record some data.
+     *
+     * @param amount The amount of data, in whatever unit is convenient (usually bytes).
+     * @param now The current time. This should never be earlier than that given in a previous call.
+     */
+    void add(size_t amount, std::chrono::steady_clock::time_point now);
+
+    /**
+     * Get the amount of data recorded within the window.
+     *
+     * @param now The current time. This should never be earlier than that given in a previous call.
+     */
+    size_t getAmountInWindow(std::chrono::steady_clock::time_point now);
+
+    /**
+     * Get the rate that data has been recorded at over the window, per second.
+     *
+     * @param now The current time. This should never be earlier than that given in a previous call.
+     */
+    double getRate(std::chrono::steady_clock::time_point now);
+
+private:
+    /**
+     * Move the ring forward to the bucket containing the given time, emptying the buckets that leave the window.
+     */
+    void advance(std::chrono::steady_clock::time_point now);
+
+    /**
+     * The duration of each bucket.
+     */
+    const std::chrono::steady_clock::duration bucketDuration;
+
+    /**
+     * The amount of data recorded in each bucket. The bucket for a time is its bucket number modulo the number of
+     * buckets.
+     */
+    std::vector<size_t> buckets;
+
+    /**
+     * The number of the bucket that contains the latest time given, counting from the clock's epoch.
+     */
+    int64_t currentBucket = 0;
+
+    /**
+     * The sum of buckets.
+     */
+    size_t total = 0;
+
+    /**
+     * Whether currentBucket has been set.
+     */
+    bool started = false;
+};
+
+} // namespace Util
+
+/// @}
@@ -0,0 +1,14 @@
+#include "SharedBuffer.hpp"
+
+Util::SharedBuffer::SharedBuffer(std::vector<std::byte> data)
+{
+    /* Don't bother allocating anything to own nothing. */
+    if (data.empty()) {
+        return;
+    }
+
+    /* Move the vector into shared ownership. Moving a vector doesn't move its data, so the span stays valid. */
+    auto storage = std::make_shared<const std::vector<std::byte>>(std::move(data));
+    bytes = *storage;
+    owner = std::move(storage);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+/// @addtogroup util
+/// @{
+
+namespace Util
+{
+
+/**
+ * An immutable, reference counted block of bytes.
+ *
+ * Copying one of these shares the data rather than copying it, so the same received chunk can be given to any number
+ * of responses (possibly in different threads) without any per-response copies or allocations.
+ */
+class SharedBuffer final
+{
+public:
+    SharedBuffer() = default;
+
+    /**
+     * Take ownership of some data, without copying it.
+     */
+    SharedBuffer(std::vector<std::byte> data);
+
+    /**
+     * Refer to some data owned by something else.
+     *
+     * @param owner The object that keeps the data alive. The data must not be modified while this object exists.
+     * @param data The data to refer to.
+     */
+    explicit SharedBuffer(std::shared_ptr<const void> owner, std::span<const std::byte> data) :
+        owner(std::move(owner)), bytes(data)
+    {
+    }
+
+    /**
+     * Create a buffer containing a copy of some data.
+     */
+    static SharedBuffer copy(std::span<const std::byte> data)
+    {
+        return SharedBuffer(std::vector<std::byte>(data.begin(), data.end()));
+    }
+
+    /**
+     * Get a buffer that refers to part of this one's data, sharing ownership with it.
+     *
+     * @param offset The offset of the part, in bytes.
+     * @param count The length of the part, in bytes. By default, this is the rest of the data.
+     */
+    SharedBuffer subspan(size_t offset, size_t count = std::dynamic_extent) const
+    {
+        return SharedBuffer(owner, bytes.subspan(offset, count));
+    }
+
+    const std::byte *data() const
+    {
+        return bytes.data();
+    }
+
+    size_t size() const
+    {
+        return bytes.size();
+    }
+
+    bool empty() const
+    {
+        return bytes.empty();
+    }
+
+    const std::byte *begin() const
+    {
+        return bytes.data();
+    }
+
+    const std::byte *end() const
+    {
+        return bytes.data() + bytes.size();
+    }
+
+    operator std::span<const std::byte>() const
+    {
+        return bytes;
+    }
+
+private:
+    /**
+     * Keeps the data alive.
+     */
+    std::shared_ptr<const void> owner;
+
+    /**
+     * The data itself.
+     */
+    std::span<const std::byte> bytes;
+};
+
+} // namespace Util
+
+/// @}
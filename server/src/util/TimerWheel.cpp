@@ -0,0 +1,300 @@
+#include "TimerWheel.hpp"
+
+#include "asio.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace
+{
+
+/**
+ * Owns the wheel that's shared by everything in an IO context.
+ */
+class TimerWheelService final : public boost::asio::execution_context::service
+{
+public:
+    static inline boost::asio::execution_context::id id;
+
+    explicit TimerWheelService(boost::asio::io_context &ioc) :
+        service(ioc), wheel(static_cast<IOContext &>(ioc))
+    {
+    }
+
+    Util::TimerWheel wheel;
+
+private:
+    /* The asio timer's own service cancels its pending wait, so there's nothing to do here. */
+    void shutdown() override {}
+};
+
+} // namespace
+
+struct Util::TimerWheel::Impl final
+{
+    /**
+     * The number of bits of the tick number that each level covers.
+     */
+    static constexpr unsigned int slotBits = 6;
+
+    static constexpr uint64_t numSlots = (uint64_t)1 << slotBits;
+    static constexpr unsigned int numLevels = 4;
+
+    Impl(IOContext &ioc, Clock::duration resolution) : timer(ioc), resolution(resolution), epoch(Clock::now()) {}
+
+    /**
+     * Get the tick that a time is in.
+     *
+     * @param time The time.
+     * @param roundUp Whether to round up to the next tick, rather than down, if the time isn't at the start of a tick.
+     */
+    uint64_t getTick(Clock::time_point time, bool roundUp) const
+    {
+        if (time <= epoch) {
+            return 0;
+        }
+        Clock::duration sinceEpoch = time - epoch;
+        return (uint64_t)(sinceEpoch / resolution) + (roundUp && sinceEpoch % resolution != Clock::duration::zero());
+    }
+
+    /**
+     * Add a timer to the front of a list.
+     */
+    static void link(Timer *&list, Timer &timer)
+    {
+        assert(!timer.list);
+        timer.list = &list;
+        timer.prev = nullptr;
+        timer.next = list;
+        if (list) {
+            list->prev = &timer;
+        }
+        list = &timer;
+    }
+
+    /**
+     * Remove a timer from whatever list it's in.
+     */
+    static void unlink(Timer &timer)
+    {
+        assert(timer.list);
+        (timer.prev ? timer.prev->next : *timer.list) = timer.next;
+        if (timer.next) {
+            timer.next->prev = timer.prev;
+        }
+        timer.list = nullptr;
+        timer.prev = nullptr;
+        timer.next = nullptr;
+    }
+
+    /**
+     * Put a timer in the slot for its deadline.
+     *
+     * The level is the highest one at which the deadline and the current tick are in different slots, so the timer is
+     * moved down a level each time the current tick reaches the start of its slot, until it's in the bottom level.
+     */
+    void insert(Timer &timer)
+    {
+        // Anything that's due goes straight into the batch being run.
+        if (timer.deadline <= now) {
+            link(due, timer);
+            return;
+        }
+
+        // Find the level.
+        uint64_t difference = timer.deadline ^ now;
+        unsigned int level = 0;
+        while (level + 1 < numLevels && (difference >> (slotBits * (level + 1))) != 0) {
+            level++;
+        }
+
+        // Deadlines beyond the top level wait in the top level's last slot to be reinserted.
+        uint64_t slot = ((difference >> (slotBits * numLevels)) != 0) ?
+                        ((now >> (slotBits * level)) - 1) % numSlots :
+                        (timer.deadline >> (slotBits * level)) % numSlots;
+        link(slots[level][slot], timer);
+    }
+
+    /**
+     * Move the current tick forward, gathering the timers that become due.
+     */
+    void advance(uint64_t target)
+    {
+        while (now < target) {
+            now++;
+
+            /* Move timers down from the levels whose slots start at this tick. */
+            for (unsigned int level = numLevels - 1; level > 0; level--) {
+                if ((now & (((uint64_t)1 << (slotBits * level)) - 1)) != 0) {
+                    continue;
+                }
+                Timer *&list = slots[level][(now >> (slotBits * level)) % numSlots];
+                while (list) {
+                    Timer &timer = *list;
+                    unlink(timer);
+                    insert(timer);
+                }
+            }
+
+            /* Everything in the bottom level's slot for this tick is due. */
+            Timer *&list = slots[0][now % numSlots];
+            while (list) {
+                Timer &timer = *list;
+                unlink(timer);
+                link(due, timer);
+            }
+        }
+    }
+
+    /**
+     * Run the timers that are due.
+     */
+    void fire()
+    {
+        while (due) {
+            // Take everything out of the timer first, because the callback's allowed to destroy it.
+            Timer &timer = *due;
+            unlink(timer);
+            count--;
+            std::function<void()> callback = std::move(timer.callback);
+            callback();
+        }
+    }
+
+    /**
+     * Get the next tick that the wheel needs to wake in.
+     *
+     * That's either the next tick with something in the bottom level, or the start of the next bottom level rotation,
+     * where the timers in the higher levels might need moving down.
+     */
+    uint64_t getNextWake() const
+    {
+        uint64_t boundary = (now | (numSlots - 1)) + 1;
+        for (uint64_t tick = now + 1; tick < boundary; tick++) {
+            if (slots[0][tick % numSlots]) {
+                return tick;
+            }
+        }
+        return boundary;
+    }
+
+    /**
+     * Make sure the wheel wakes no later than the start of a given tick.
+     */
+    void wakeBy(uint64_t tick)
+    {
+        if (armed && wakeTick <= tick) {
+            return;
+        }
+        armed = true;
+        wakeTick = tick;
+
+        // Changing the expiry cancels any earlier wait, whose handler then does nothing.
+        timer.expires_at(epoch + resolution * tick);
+        timer.async_wait([this](const boost::system::error_code &error) {
+            if (!error) {
+                onWake();
+            }
+        });
+    }
+
+    /**
+     * Run everything that's due, and wait for the next thing.
+     */
+    void onWake()
+    {
+        armed = false;
+        advance(getTick(Clock::now(), false));
+        fire();
+        if (count > 0) {
+            wakeBy(getNextWake());
+        }
+    }
+
+    boost::asio::steady_timer timer;
+    const Clock::duration resolution;
+
+    /**
+     * The time of the start of tick 0.
+     */
+    const Clock::time_point epoch;
+
+    /**
+     * The latest tick that's been processed.
+     */
+    uint64_t now = 0;
+
+    /**
+     * The number of timers that are scheduled, including those that are due.
+     */
+    size_t count = 0;
+
+    /**
+     * The tick that the asio timer is waiting for, if armed.
+     */
+    uint64_t wakeTick = 0;
+    bool armed = false;
+
+    std::array<std::array<Timer *, numSlots>, numLevels> slots{};
+
+    /**
+     * Timers that are due, and are about to be run.
+     */
+    Timer *due = nullptr;
+};
+
+Util::TimerWheel::~TimerWheel() = default;
+
+Util::TimerWheel::TimerWheel(IOContext &ioc, Clock::duration resolution) :
+    impl(std::make_unique<Impl>(ioc, std::max(resolution, Clock::duration(1))))
+{
+}
+
+Util::TimerWheel &Util::TimerWheel::get(IOContext &ioc)
+{
+    return boost::asio::use_service<TimerWheelService>((boost::asio::io_context &)ioc).wheel;
+}
+
+size_t Util::TimerWheel::size() const
+{
+    return impl->count;
+}
+
+Util::TimerWheel::Timer::~Timer()
+{
+    cancel();
+}
+
+Util::TimerWheel::Timer::Timer(TimerWheel &wheel) : wheel(wheel) {}
+
+void Util::TimerWheel::Timer::expiresAt(Clock::time_point time, std::function<void()> newCallback)
+{
+    Impl &impl = *wheel.impl;
+    cancel();
+
+    /* If there's nothing in the wheel, it might not have been kept up to date, so catch up with the present. */
+    if (impl.count == 0) {
+        impl.now = std::max(impl.now, impl.getTick(Clock::now(), false));
+    }
+
+    /* Add the timer. Anything that's already due is run in the next tick, rather than from in here. */
+    deadline = std::max(impl.getTick(time, true), impl.now + 1);
+    callback = std::move(newCallback);
+    impl.insert(*this);
+    impl.count++;
+
+    /* Make sure the wheel wakes in time for it, or for it to be moved down a level. */
+    impl.wakeBy(std::min(deadline, (impl.now | (Impl::numSlots - 1)) + 1));
+}
+
+void Util::TimerWheel::Timer::cancel()
+{
+    if (list) {
+        Impl::unlink(*this);
+        wheel.impl->count--;
+    }
+    callback = nullptr;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+class IOContext;
+
+/// @addtogroup util
+/// @{
+
+namespace Util
+{
+
+/**
+ * Runs callbacks at given times, for large numbers of long-lived timers that are created and cancelled a lot.
+ *
+ * Timers are kept in a hierarchical wheel: several levels of 64 slots, where each level's slots are 64 times as long as
+ * the level below's. Scheduling and cancelling a timer are constant time, and a single underlying asio timer wakes the
+ * wheel once per tick that has something due (or once every 64 ticks to move timers down a level). Every timer that's
+ * due in a tick is run in the same batch.
+ *
+ * Times are rounded up to the next tick, so callbacks run up to one resolution late, and never early.
+ *
+ * The wheel and its timers must only be used from the thread running the IO context.
+ */
+class TimerWheel final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Timer;
+
+    /**
+     * The default tick length.
+     */
+    static constexpr Clock::duration defaultResolution = std::chrono::milliseconds(10);
+
+    /**
+     * Destroy the wheel. Any timers still scheduled must have been destroyed or cancelled.
+     */
+    ~TimerWheel();
+
+    /**
+     * Constructor :)
+     *
+     * @param ioc The IO context to run the callbacks in.
+     * @param resolution The length of a tick.
+     */
+    explicit TimerWheel(IOContext &ioc, Clock::duration resolution = defaultResolution);
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * Get the wheel that's shared by everything in an IO context.
+     *
+     * This is created on first use with the default resolution, and lasts until the IO context is destroyed.
+     */
+    static TimerWheel &get(IOContext &ioc);
+
+    /**
+     * Get the number of timers that are scheduled.
+     */
+    size_t size() const;
+
+private:
+    struct Impl;
+
+    std::unique_ptr<Impl> impl;
+};
+
+/**
+ * A callback that's scheduled in a TimerWheel.
+ *
+ * The timer is cancelled when it's destroyed, so the callback can safely refer to whatever owns the timer. It's fine
+ * for the callback to destroy its own timer.
+ */
+class TimerWheel::Timer final
+{
+public:
+    /**
+     * Cancel the timer and destroy it.
+     */
+    ~Timer();
+
+    /**
+     * Create a timer that isn't scheduled.
+     */
+    explicit Timer(TimerWheel &wheel);
+
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+    /**
+     * Schedule the timer, replacing any earlier schedule.
+     *
+     * @param time When to run the callback.
+     * @param callback What to run. This is run at most once, from the wheel's IO context. It must not throw.
+     */
+    void expiresAt(Clock::time_point time, std::function<void()> callback);
+
+    /**
+     * Schedule the timer, replacing any earlier schedule.
+     *
+     * @param delay How long from now to run the callback.
+     * @param callback What to run. This is run at most once, from the wheel's IO context. It must not throw.
+     */
+    void expiresAfter(Clock::duration delay, std::function<void()> callback)
+    {
+        expiresAt(Clock::now() + delay, std::move(callback));
+    }
+
+    /**
+     * Stop the callback from running, if it hasn't already.
+     */
+    void cancel();
+
+    /**
+     * Determine whether the callback is still waiting to be run.
+     */
+    bool getIsScheduled() const
+    {
+        return list;
+    }
+
+private:
+    friend struct TimerWheel::Impl;
+
+    TimerWheel &wheel;
+
+    /**
+     * The head of the list this timer is in, or null if it isn't scheduled.
+     */
+    Timer **list = nullptr;
+
+    Timer *prev = nullptr;
+    Timer *next = nullptr;
+
+    /**
+     * The tick that the timer is due in.
+     */
+    uint64_t deadline = 0;
+
+    std::function<void()> callback;
+};
+
+} // namespace Util
+
+/// @}
@@ -4,6 +4,26 @@
 
 #include <boost/asio/co_spawn.hpp>
 
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Run awaitables from a queue one at a time until there are none left.
+ *
+ * @param next The index of the next awaitable to run, which is shared with the other runners.
+ */
+Awaitable<void> runQueue(std::span<Awaitable<void>> awaitables, size_t &next)
+{
+    while (next < awaitables.size()) {
+        co_await std::move(awaitables[next++]);
+    }
+}
+
+} // namespace
+
 void spawnDetached(IOContext &ioc, Log::Context &log, std::function<Awaitable<void>()> fn, Log::Level level)
 {
     spawnDetached(ioc, [fn = std::move(fn), &log, level]() mutable -> Awaitable<void> {
@@ -30,3 +50,15 @@ Awaitable<void> awaitTree(std::span<Awaitable<void>> awaitables)
                   awaitTree(awaitables.subspan(awaitables.size() / 2)));
     }
 }
+
+Awaitable<void> awaitTree(std::span<Awaitable<void>> awaitables, size_t maxParallel)
+{
+    size_t next = 0;
+    size_t numRunners = std::min(std::max(maxParallel, (size_t)1), awaitables.size());
+    std::vector<Awaitable<void>> runners;
+    runners.reserve(numRunners);
+    for (size_t i = 0; i < numRunners; i++) {
+        runners.emplace_back(runQueue(awaitables, next));
+    }
+    co_await awaitTree(runners);
+}
@@ -78,4 +78,13 @@ void spawnDetached(IOContext &ioc, Log::Context &log, std::function<Awaitable<vo
  */
 Awaitable<void> awaitTree(std::span<Awaitable<void>> awaitables);
 
+/**
+ * Wait for all of a set of void awaitables, running at most a given number of them at once.
+ *
+ * The awaitables are started in order, each as soon as an earlier one finishes.
+ *
+ * @param maxParallel The maximum number of awaitables to run at once. If 0, this is treated as 1.
+ */
+Awaitable<void> awaitTree(std::span<Awaitable<void>> awaitables, size_t maxParallel);
+
 /// @}
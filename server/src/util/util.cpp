@@ -36,6 +36,26 @@ std::vector<std::byte> Util::concatenate(std::vector<std::vector<std::byte>> dat
     return allData;
 }
 
+std::vector<std::byte> Util::concatenate(std::span<const SharedBuffer> dataParts)
+{
+    /* Allocate space for a vector of the right size. */
+    std::size_t totalSize = 0;
+    for (const SharedBuffer &part: dataParts) {
+        totalSize += part.size();
+    }
+
+    std::vector<std::byte> allData;
+    allData.reserve(totalSize);
+
+    /* Concatenate the buffer. */
+    for (const SharedBuffer &part: dataParts) {
+        allData.insert(allData.end(), part.begin(), part.end());
+    }
+
+    /* Done :) */
+    return allData;
+}
+
 std::vector<std::byte> Util::readFile(const std::filesystem::path &path)
 {
     std::ifstream f;
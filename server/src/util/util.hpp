@@ -1,4 +1,7 @@
+#include "SharedBuffer.hpp"
+
 #include <filesystem>
+#include <span>
 #include <vector>
 
 /**
@@ -18,6 +21,11 @@ namespace Util
  */
 std::vector<std::byte> concatenate(std::vector<std::vector<std::byte>> dataParts);
 
+/**
+ * Concatenate shared buffers.
+ */
+std::vector<std::byte> concatenate(std::span<const SharedBuffer> dataParts);
+
 /**
  * Synchronously read the contents of a file.
  */
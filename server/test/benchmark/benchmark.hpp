@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+/**
+ * Run something repeatedly for a while, and print how quickly it went.
+ *
+ * @param name The name of the benchmark.
+ * @param unit The name of what fn counts, e.g: "bytes".
+ * @param fn Does some work, and returns how many units of work it did.
+ * @param minTime The minimum time to keep running fn for.
+ */
+void runBenchmark(std::string_view name, std::string_view unit, const std::function<size_t()> &fn,
+                  std::chrono::steady_clock::duration minTime = std::chrono::seconds(1));
+
+/**
+ * Get the number of times the global operator new has been called so far.
+ */
+size_t getAllocationCount();
+
+/**
+ * Compare the ways of getting blocks to read request bodies into.
+ */
+void benchmarkBuffers();
+
+/**
+ * Measure the latency and allocations of waking coroutines with Event.
+ */
+void benchmarkEvent();
+
+/**
+ * Compare the ways of generating padding.
+ */
+void benchmarkPadding();
+
+/**
+ * Measure looking up, adding and removing resources in the server's resource tree.
+ */
+void benchmarkResources();
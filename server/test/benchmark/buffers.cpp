@@ -0,0 +1,88 @@
+#include "benchmark.hpp"
+
+#include "util/BufferPool.hpp"
+#include "util/SharedBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t blockSize = 1 << 16;
+constexpr size_t minReadSize = blockSize / 8;
+
+/**
+ * The number of segments that are kept, like a segment history.
+ */
+constexpr size_t historyLength = 32;
+
+/**
+ * The amount of data in each segment.
+ */
+constexpr size_t segmentSize = 1 << 20;
+
+/**
+ * Reads a stream into shared blocks the way requests do, and keeps the reads in a rolling history of segments.
+ *
+ * @param name The name of the benchmark.
+ * @param getBlock Gets a new block of blockSize bytes, and returns its data and its owner.
+ */
+template <typename GetBlock> void benchmarkIngest(const std::string &name, GetBlock getBlock)
+{
+    std::vector<std::vector<Util::SharedBuffer>> history(historyLength);
+    std::minstd_rand random;
+    std::uniform_int_distribution<size_t> fragmentSize(1 << 10, 1 << 14);
+    std::shared_ptr<const void> block;
+    std::byte *blockData = nullptr;
+    size_t blockOffset = blockSize;
+    size_t segmentIndex = 0;
+
+    size_t bytes = 0;
+    size_t allocations = getAllocationCount();
+    runBenchmark(name, "bytes", [&]() {
+        // Start a new segment, dropping the oldest one.
+        std::vector<Util::SharedBuffer> &segment = history[segmentIndex++ % historyLength];
+        segment.clear();
+
+        // Fill it with reads of CMAF fragment-ish sizes.
+        for (size_t size = 0; size < segmentSize;) {
+            if (blockSize - blockOffset < minReadSize) {
+                std::tie(blockData, block) = getBlock();
+                blockOffset = 0;
+            }
+            size_t n = std::min(fragmentSize(random), blockSize - blockOffset);
+            memset(blockData + blockOffset, (int)n, n);
+            segment.emplace_back(block, std::span(blockData + blockOffset, n));
+            blockOffset += n;
+            size += n;
+        }
+        bytes += segmentSize;
+        return segmentSize;
+    });
+    std::cout << name << ": " << (double)(getAllocationCount() - allocations) * (1 << 20) / (double)bytes
+              << " allocations/MiB" << std::endl;
+}
+
+} // namespace
+
+void benchmarkBuffers()
+{
+    benchmarkIngest("make_shared vector", []() {
+        auto block = std::make_shared<std::vector<std::byte>>(blockSize);
+        return std::pair<std::byte *, std::shared_ptr<const void>>(block->data(), block);
+    });
+
+    benchmarkIngest("BufferPool", []() {
+        Util::BufferPool::Block block = Util::BufferPool::getShared().allocate(blockSize);
+        return std::pair<std::byte *, std::shared_ptr<const void>>(block.get(), block);
+    });
+}
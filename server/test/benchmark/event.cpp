@@ -0,0 +1,171 @@
+#include "benchmark.hpp"
+
+#include "util/Event.hpp"
+#include "util/asio.hpp"
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/**
+ * The way Event used to work (by cancelling a timer per executor), for comparison.
+ */
+class TimerEvent final
+{
+public:
+    TimerEvent() = default;
+
+    Awaitable<void> wait()
+    {
+        std::shared_ptr<boost::asio::steady_timer> timer = getTimer(co_await boost::asio::this_coro::executor);
+        co_await timer->async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+    }
+
+    void notifyAll()
+    {
+        std::vector<std::shared_ptr<boost::asio::steady_timer>> notified;
+        {
+            std::lock_guard lock(mutex);
+            notified.swap(timers);
+        }
+        for (std::shared_ptr<boost::asio::steady_timer> &timer: notified) {
+            boost::asio::any_io_executor executor = timer->get_executor();
+            boost::asio::dispatch(executor, [timer = std::move(timer)]() { timer->cancel(); });
+        }
+    }
+
+private:
+    std::shared_ptr<boost::asio::steady_timer> getTimer(const boost::asio::any_io_executor &executor)
+    {
+        std::lock_guard lock(mutex);
+        for (const std::shared_ptr<boost::asio::steady_timer> &timer: timers) {
+            if (timer->get_executor() == executor) {
+                return timer;
+            }
+        }
+        auto timer = std::make_shared<boost::asio::steady_timer>(executor);
+        timer->expires_from_now(std::chrono::years(40000));
+        return timers.emplace_back(std::move(timer));
+    }
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<boost::asio::steady_timer>> timers;
+};
+
+/**
+ * Take turns with another player, each waking the other in turn.
+ */
+template <typename EventType>
+Awaitable<void> play(EventType &mine, EventType &theirs, int &turn, int me, size_t rounds)
+{
+    for (size_t i = 0; i < rounds; i++) {
+        while (turn != me) {
+            co_await mine.wait();
+        }
+        turn = 1 - me;
+        theirs.notifyAll();
+    }
+}
+
+/**
+ * Wake a group of listeners at once, and wait for all of them to acknowledge it.
+ */
+template <typename EventType>
+Awaitable<void> broadcast(EventType &go, EventType &done, size_t &generation, size_t &acks, size_t numListeners,
+                          size_t rounds)
+{
+    for (size_t i = 0; i < rounds; i++) {
+        acks = 0;
+        generation++;
+        go.notifyAll();
+        while (acks < numListeners) {
+            co_await done.wait();
+        }
+    }
+}
+
+/**
+ * Wait for each of a broadcaster's notifications.
+ */
+template <typename EventType>
+Awaitable<void> listen(EventType &go, EventType &done, const size_t &generation, size_t &acks, size_t numListeners,
+                       size_t rounds)
+{
+    size_t seen = 0;
+    while (seen < rounds) {
+        while (generation == seen) {
+            co_await go.wait();
+        }
+        seen = generation;
+        if (++acks == numListeners) {
+            done.notifyAll();
+        }
+    }
+}
+
+/**
+ * Measure how quickly an event type can wake a coroutine, and how much it allocates doing so.
+ */
+template <typename EventType>
+void benchmarkEventType(const std::string &name)
+{
+    constexpr size_t rounds = 10000;
+    constexpr size_t numListeners = 64;
+    IOContext ioc;
+
+    /* Two coroutines waking each other, which is the latency of a single wakeup. */
+    size_t wakeups = 0;
+    size_t allocations = getAllocationCount();
+    runBenchmark(name + " ping-pong", "wakeups", [&]() {
+        EventType a;
+        EventType b;
+        int turn = 0;
+        spawnDetached(ioc, play(b, a, turn, 1, rounds));
+        spawnDetached(ioc, play(a, b, turn, 0, rounds));
+        ioc.restart();
+        ioc.run();
+        wakeups += rounds * 2;
+        return rounds * 2;
+    });
+    std::cout << name << " ping-pong: " << (double)(getAllocationCount() - allocations) / (double)wakeups
+              << " allocations/wakeup" << std::endl;
+
+    /* One coroutine waking lots of others. */
+    wakeups = 0;
+    allocations = getAllocationCount();
+    runBenchmark(name + " broadcast to " + std::to_string(numListeners), "wakeups", [&]() {
+        EventType go;
+        EventType done;
+        size_t generation = 0;
+        size_t acks = 0;
+        for (size_t i = 0; i < numListeners; i++) {
+            spawnDetached(ioc, listen(go, done, generation, acks, numListeners, rounds / numListeners));
+        }
+        spawnDetached(ioc, broadcast(go, done, generation, acks, numListeners, rounds / numListeners));
+        ioc.restart();
+        ioc.run();
+        size_t n = (rounds / numListeners) * (numListeners + 1);
+        wakeups += n;
+        return n;
+    });
+    std::cout << name << " broadcast to " << numListeners << ": "
+              << (double)(getAllocationCount() - allocations) / (double)wakeups << " allocations/wakeup" << std::endl;
+}
+
+} // namespace
+
+void benchmarkEvent()
+{
+    benchmarkEventType<TimerEvent>("timer cancellation");
+    benchmarkEventType<Event>("Event");
+}
@@ -0,0 +1,103 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+
+/**
+ * Every benchmark, and what it's called on the command line.
+ */
+const std::pair<std::string_view, void (*)()> benchmarks[] = {
+    { "buffers", benchmarkBuffers },
+    { "event", benchmarkEvent },
+    { "padding", benchmarkPadding },
+    { "resources", benchmarkResources },
+};
+
+/**
+ * The number of times the global operator new has been called.
+ */
+std::atomic<size_t> allocationCount = 0;
+
+} // namespace
+
+/* Count allocations, so benchmarks can report how much they allocate. The other forms of operator new forward to
+   either the plain or the aligned one, and the other forms of operator delete forward to the matching one of these. */
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *result = std::malloc(size ? size : 1);
+    if (!result) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    // aligned_alloc needs the size to be a non-zero multiple of the alignment.
+    size_t align = (size_t)alignment;
+    void *result = std::aligned_alloc(align, std::max<size_t>(1, (size + align - 1) / align) * align);
+    if (!result) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+size_t getAllocationCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+void runBenchmark(std::string_view name, std::string_view unit, const std::function<size_t()> &fn,
+                  std::chrono::steady_clock::duration minTime)
+{
+    /* Keep running until enough time has passed. */
+    size_t units = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end;
+    do {
+        units += fn();
+        end = std::chrono::steady_clock::now();
+    } while (end - start < minTime);
+
+    /* Report the rate. */
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << name << ": " << (double)units / seconds << " " << unit << "/s" << std::endl;
+}
+
+/**
+ * Run the benchmarks named on the command line, or all of them if none are.
+ */
+int main(int argc, char **argv)
+{
+    for (const auto &[name, fn]: benchmarks) {
+        bool selected = argc <= 1;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || name == argv[i];
+        }
+        if (selected) {
+            fn();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "benchmark.hpp"
+
+#include "util/RandomPool.hpp"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/**
+ * The way padding used to be generated, for comparison.
+ */
+std::vector<std::byte> getRandomDataMinstd(unsigned int length)
+{
+    thread_local std::minstd_rand engine;
+    thread_local std::uniform_int_distribution<uint32_t> distribution(0, ~(uint32_t)0);
+    unsigned int n = (length + 3) / 4;
+    std::vector<std::byte> result(n * 4);
+    for (unsigned int i = 0; i < n; i++) {
+        uint32_t value = distribution(engine);
+        memcpy(result.data() + i * 4, &value, 4);
+    }
+    return result;
+}
+
+} // namespace
+
+void benchmarkPadding()
+{
+    for (unsigned int length: { 1u << 10, 1u << 16 }) {
+        std::string suffix = " (" + std::to_string(length) + " byte padding)";
+
+        runBenchmark("minstd_rand" + suffix, "bytes", [length]() {
+            return getRandomDataMinstd(length).size();
+        });
+
+        uint64_t seed = 0;
+        runBenchmark("fillRandom" + suffix, "bytes", [length, &seed]() {
+            std::vector<std::byte> data(length);
+            Util::fillRandom(data, seed);
+            return data.size();
+        });
+
+        runBenchmark("RandomPool" + suffix, "bytes", [length]() {
+            return Util::RandomPool::getShared().get(length).size();
+        });
+    }
+}
@@ -0,0 +1,200 @@
+#include "benchmark.hpp"
+
+#include "log/MemoryLog.hpp"
+#include "server/Request.hpp"
+#include "server/Resource.hpp"
+#include "server/Server.hpp"
+#include "util/asio.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr unsigned int numChannels = 50;
+constexpr unsigned int numStreams = 8;
+constexpr unsigned int numSegments = 60;
+
+/**
+ * Get the path of a segment, in the same shape as the real ones.
+ */
+std::string getSegmentPath(unsigned int channel, unsigned int stream, unsigned int segment)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "channel%u/uid%08x/chunk-stream%u-%09u.m4s", channel, channel * 2654435761u, stream,
+             segment);
+    return path;
+}
+
+class BenchmarkRequest final : public Server::Request
+{
+public:
+    ~BenchmarkRequest() override = default;
+    using Request::Request;
+
+    Awaitable<Util::SharedBuffer> doReadSome() override
+    {
+        co_return Util::SharedBuffer{};
+    }
+};
+
+/**
+ * The server, with its lookup exposed.
+ */
+class BenchmarkServer final : public Server::Server
+{
+public:
+    ~BenchmarkServer() override = default;
+    explicit BenchmarkServer(Log::Log &log) : Server(log) {}
+
+    using Server::findResource;
+};
+
+/**
+ * The way the resource tree used to work (ordered maps of strings, with dynamic_cast to find the intermediate nodes),
+ * for comparison.
+ */
+class LegacyTree final
+{
+public:
+    void add(const Server::Path &path, std::shared_ptr<Server::Resource> resource)
+    {
+        std::unique_lock lock(mutex);
+        std::shared_ptr<Server::Resource> *node = &root;
+        for (size_t i = 0; i < path.size(); ++i) {
+            if (!*node) {
+                *node = std::make_shared<TreeResource>();
+            }
+            auto *tree = dynamic_cast<TreeResource *>(node->get());
+            node = &tree->children[std::string(path[i])];
+        }
+        *node = std::move(resource);
+    }
+
+    void remove(const Server::Path &path)
+    {
+        std::unique_lock lock(mutex);
+        std::vector<TreeResource *> intermediateNodes;
+        std::shared_ptr<Server::Resource> *node = &root;
+        for (size_t i = 0; i < path.size(); ++i) {
+            auto *tree = dynamic_cast<TreeResource *>(node->get());
+            intermediateNodes.push_back(tree);
+            node = &tree->children.find(std::string(path[i]))->second;
+        }
+        for (size_t j = 0; j < path.size(); ++j) {
+            size_t i = path.size() - j - 1;
+            intermediateNodes[i]->children.erase(std::string(path[i]));
+            if (!intermediateNodes[i]->children.empty()) {
+                return;
+            }
+        }
+        root.reset();
+    }
+
+    std::shared_ptr<Server::Resource> find(Server::Request &request) const
+    {
+        std::shared_lock lock(mutex);
+        std::shared_ptr<Server::Resource> resource = root;
+        while (auto *tree = dynamic_cast<TreeResource *>(resource.get())) {
+            auto it = tree->children.find(request.getPath().front());
+            if (it == tree->children.end()) {
+                return nullptr;
+            }
+            request.popPathPart();
+            resource = it->second;
+        }
+        return resource;
+    }
+
+private:
+    class TreeResource final : public Server::Resource
+    {
+    public:
+        std::map<std::string, std::shared_ptr<Server::Resource>, std::less<>> children;
+    };
+
+    std::shared_ptr<Server::Resource> root;
+    mutable std::shared_mutex mutex;
+};
+
+/**
+ * Measure lookups and segment churn in a tree of a given type.
+ *
+ * @param add Adds a resource at a path.
+ * @param remove Removes the resource at a path.
+ * @param find Finds the resource for a request.
+ */
+void benchmarkTree(const std::string &name, const std::function<void(const Server::Path &)> &add,
+                   const std::function<void(const Server::Path &)> &remove,
+                   const std::function<bool(Server::Request &)> &find)
+{
+    /* Fill the tree with a realistic number of segments. */
+    std::vector<Server::Path> paths;
+    for (unsigned int channel = 0; channel < numChannels; channel++) {
+        for (unsigned int stream = 0; stream < numStreams; stream++) {
+            for (unsigned int segment = 0; segment < numSegments; segment++) {
+                paths.emplace_back(getSegmentPath(channel, stream, segment));
+                add(paths.back());
+            }
+        }
+    }
+
+    /* Look up segments in a random order. */
+    std::minstd_rand random;
+    std::shuffle(paths.begin(), paths.end(), random);
+    runBenchmark(name + " lookup", "lookups", [&]() {
+        for (const Server::Path &path: paths) {
+            BenchmarkRequest request(path, Server::Request::Type::get, true);
+            if (!find(request)) {
+                throw std::runtime_error("Lookup failed.");
+            }
+        }
+        return paths.size();
+    });
+
+    /* Create and remove segments, like a live stream does. */
+    std::vector<unsigned int> nextSegments(numChannels, numSegments);
+    runBenchmark(name + " add and remove", "segments", [&]() {
+        constexpr size_t n = 1000;
+        for (size_t i = 0; i < n; i++) {
+            unsigned int channel = (unsigned int)(i % numChannels);
+            unsigned int segment = nextSegments[channel]++;
+            add(getSegmentPath(channel, 0, segment));
+            remove(getSegmentPath(channel, 0, segment - numSegments));
+        }
+        return n;
+    });
+}
+
+} // namespace
+
+void benchmarkResources()
+{
+    IOContext ioc;
+    Log::MemoryLog log(ioc, Log::Level::warning, false);
+    auto resource = std::make_shared<Server::Resource>(true);
+
+    {
+        LegacyTree tree;
+        benchmarkTree("map tree",
+                      [&](const Server::Path &path) { tree.add(path, resource); },
+                      [&](const Server::Path &path) { tree.remove(path); },
+                      [&](Server::Request &request) { return (bool)tree.find(request); });
+    }
+
+    {
+        BenchmarkServer server(log);
+        benchmarkTree("Server",
+                      [&](const Server::Path &path) { server.addResource<Server::Resource>(path, true); },
+                      [&](const Server::Path &path) { server.removeResource(path); },
+                      [&](Server::Request &request) { return (bool)server.findResource(request); });
+    }
+}
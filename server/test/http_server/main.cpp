@@ -7,9 +7,13 @@
 
 #include "configuration/configuration.hpp"
 #include "util/asio.hpp"
+#include "util/IOContextPool.hpp"
 
 #include "log.hpp"
 
+#include <filesystem>
+#include <fstream>
+
 namespace
 {
 
@@ -26,7 +30,7 @@ public:
         response.setCacheKind(Server::CacheKind::none);
         std::string path = request.getPath();
         while (true) {
-            std::vector<std::byte> data = co_await request.readSome();
+            Util::SharedBuffer data = co_await request.readSome();
             if (data.empty()) {
                 break;
             }
@@ -53,7 +57,7 @@ public:
     {
         size_t size = 0;
         while (true) {
-            std::vector<std::byte> data = co_await request.readSome();
+            Util::SharedBuffer data = co_await request.readSome();
             if (data.empty()) {
                 break;
             }
@@ -117,6 +121,30 @@ private:
     bool chunked;
 };
 
+/**
+ * Emits a short message, the end of which comes from a file, using either chunked or non-chunked encoding.
+ */
+class FileResource final : public Server::Resource
+{
+public:
+    FileResource(std::filesystem::path path, bool chunked) : Resource(true), path(std::move(path)), chunked(chunked) {}
+
+    Awaitable<void> getAsync(Server::Response &response, Server::Request &request) override
+    {
+        response << "Cats";
+        if (chunked) {
+            co_await response.flush();
+        }
+        if (!co_await response.writeFile(path, 2, std::filesystem::file_size(path) - 4)) {
+            response << " can't be sent";
+        }
+    }
+
+private:
+    std::filesystem::path path;
+    bool chunked;
+};
+
 } // namespace
 
 int main()
@@ -124,13 +152,21 @@ int main()
     Config::Network networkConfig = { .port = 12480 };
     Config::Http httpConfig = {};
     IOContext ioc;
+    IOContextPool iocs(ioc, 2); // Exercise handing requests between threads.
     ExpectNeverLog log(ioc);
-    Server::HttpServer server(ioc, log, networkConfig, httpConfig);
+    Server::HttpServer server(iocs, log, networkConfig, httpConfig);
     server.addResource<EchoResource>("Echo");
     server.addResource<LengthResource>("Length");
     server.addResource<LongResource>("Long", false);
     server.addResource<LongResource>("LongChunk", true);
     server.addResource<ShortChunkResource>("ShortChunk");
     server.addResource<Server::ConstantResource>("Short", "Cats are cute :D", "text/plain");
-    ioc.run();
+
+    // The file resources send the middle of a file.
+    std::filesystem::path filePath =
+        std::filesystem::temp_directory_path() / "live-video-streamer-server_test.HttpServerFile";
+    std::ofstream(filePath) << "xx are cute :Dxx";
+    server.addResource<FileResource>("File", filePath, false);
+    server.addResource<FileResource>("FileChunk", filePath, true);
+    iocs.run();
 }
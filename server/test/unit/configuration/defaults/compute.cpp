@@ -0,0 +1,140 @@
+#include "configuration/defaults.hpp"
+#include "configuration/configuration.hpp"
+#include "ffmpeg/ffprobe.hpp"
+#include "media/MediaInfo.hpp"
+
+#include "coro_test.hpp"
+#include "data.hpp"
+
+#include <thread>
+
+namespace
+{
+
+/**
+ * Get a configuration with 1080p and 720p qualities at 25fps, neither of which has a preset.
+ *
+ * @param calibration The compute.calibration field.
+ */
+Config::Root getConfig(std::string calibration)
+{
+    return {
+        .channels = {
+            {
+                "/live", {
+                    .source = {
+                        .url = getSmpteDataPath(1920, 1080, 25, 1, 48000).string()
+                    },
+                    .qualities = {
+                        {
+                            .video = {
+                                .width = 1920,
+                                .height = 1080
+                            }
+                        },
+                        {
+                            .video = {
+                                .width = 1280,
+                                .height = 720
+                            }
+                        }
+                    }
+                }
+            }
+        },
+        .compute = {
+            .calibration = std::move(calibration),
+            .budget = 200
+        }
+    };
+}
+
+/**
+ * Fill in the defaults with a fake calibration.
+ *
+ * The throughputs are scaled by the number of CPUs, so that the presets that fit the budget don't depend on the host
+ * the test runs on.
+ *
+ * @param calibrated Set to whether the calibration was asked for.
+ */
+Awaitable<void> fillInDefaults(IOContext &ioc, Config::Root &config, bool &calibrated)
+{
+    double cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    co_await Config::fillInDefaults([&ioc](const std::string &url, const std::vector<std::string> &arguments) ->
+                                    Awaitable<MediaInfo::SourceInfo> {
+        co_return co_await Ffmpeg::ffprobe(ioc, url, arguments);
+    }, config, [&calibrated, cpus](const std::string &path, const std::vector<Codec::VideoCodec> &codecs) ->
+               Awaitable<std::vector<Config::EncoderThroughput>> {
+        calibrated = true;
+        EXPECT_EQ("calibration.json", path);
+        EXPECT_EQ(std::vector<Codec::VideoCodec>{ Codec::VideoCodec::h264 }, codecs);
+        co_return std::vector<Config::EncoderThroughput>{
+            { Codec::VideoCodec::h264, Config::H26xPreset::faster, 1280, 720, 80000000 / cpus },
+            { Codec::VideoCodec::h264, Config::H26xPreset::fast, 1280, 720, 40000000 / cpus },
+            { Codec::VideoCodec::h264, Config::H26xPreset::medium, 1280, 720, 20000000 / cpus }
+        };
+    });
+}
+
+} // namespace
+
+/**
+ * Check that the presets are sped up, the one that saves the most first, until they fit the budget.
+ *
+ * At medium, the qualities take 2.592 and 1.152 CPUs, and the budget is 2. Speeding up the 1080p quality saves the most
+ * at each step, and it fits once that's at faster.
+ */
+CORO_TEST(ConfigDefaults, ComputeCalibrated, ioc)
+{
+    Config::Root config = getConfig("calibration.json");
+    bool calibrated = false;
+    co_await fillInDefaults(ioc, config, calibrated);
+
+    EXPECT_TRUE(calibrated);
+    const std::vector<Config::Quality> &qualities = config.channels.at("/live").qualities;
+    EXPECT_EQ(2, qualities.size());
+    if (qualities.size() != 2) {
+        co_return;
+    }
+    EXPECT_EQ(Config::H26xPreset::faster, qualities[0].video.h26xPreset);
+    EXPECT_EQ(Config::H26xPreset::medium, qualities[1].video.h26xPreset);
+}
+
+/**
+ * Check that configured presets count against the budget.
+ */
+CORO_TEST(ConfigDefaults, ComputeFixedPreset, ioc)
+{
+    Config::Root config = getConfig("calibration.json");
+    config.channels.at("/live").qualities[0].video.h26xPreset = Config::H26xPreset::fast;
+    bool calibrated = false;
+    co_await fillInDefaults(ioc, config, calibrated);
+
+    // The 1080p quality takes 1.296 CPUs, which leaves 0.704 for the 720p quality.
+    const std::vector<Config::Quality> &qualities = config.channels.at("/live").qualities;
+    EXPECT_EQ(2, qualities.size());
+    if (qualities.size() != 2) {
+        co_return;
+    }
+    EXPECT_EQ(Config::H26xPreset::fast, qualities[0].video.h26xPreset);
+    EXPECT_EQ(Config::H26xPreset::fast, qualities[1].video.h26xPreset);
+}
+
+/**
+ * Check that the crude model is used if there's no calibration.
+ */
+CORO_TEST(ConfigDefaults, ComputeUncalibrated, ioc)
+{
+    Config::Root config = getConfig("");
+    bool calibrated = false;
+    co_await fillInDefaults(ioc, config, calibrated);
+
+    EXPECT_FALSE(calibrated);
+    const std::vector<Config::Quality> &qualities = config.channels.at("/live").qualities;
+    EXPECT_EQ(2, qualities.size());
+    if (qualities.size() != 2) {
+        co_return;
+    }
+    EXPECT_EQ(Config::H26xPreset::medium, qualities[0].video.h26xPreset);
+    EXPECT_EQ(Config::H26xPreset::medium, qualities[1].video.h26xPreset);
+}
@@ -0,0 +1,114 @@
+#include "dash/FanOut.hpp"
+
+#include "coro_test.hpp"
+
+#include <boost/asio/this_coro.hpp>
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+
+namespace
+{
+
+TEST(FanOut, WakesEverySubscriberInBatches)
+{
+    constexpr int numSubscribers = 5;
+    IOContext ioc;
+    Dash::FanOut fanOut(2);
+    std::mutex mutex;
+    size_t numChunks = 0;
+    int woken = 0;
+
+    // Each subscriber waits for the first chunk.
+    for (int i = 0; i < numSubscribers; i++) {
+        testCoSpawn([&]() -> Awaitable<void> {
+            std::unique_lock lock(mutex);
+            Dash::FanOut::Subscriber subscriber(fanOut, co_await boost::asio::this_coro::executor);
+            while (numChunks == 0) {
+                co_await subscriber.wait(lock);
+            }
+            subscriber.delivered(0, numChunks);
+            woken++;
+        }, ioc);
+    }
+    ioc.poll();
+    EXPECT_EQ(0, woken);
+
+    // Publishing the chunk should eventually wake all of them, even though they're woken two at a time.
+    {
+        std::lock_guard lock(mutex);
+        numChunks++;
+        fanOut.publish(std::chrono::steady_clock::now());
+    }
+    fanOut.notify();
+    ioc.poll();
+    EXPECT_EQ(numSubscribers, woken);
+
+    Dash::FanOut::Stats stats = fanOut.getStats();
+    EXPECT_EQ(1, stats.chunks);
+    EXPECT_LE(stats.maxSpread, stats.maxTimeToLast);
+}
+
+TEST(FanOut, MergesLanes)
+{
+    IOContext iocA;
+    IOContext iocB;
+    Dash::FanOut fanOut;
+    std::mutex mutex;
+    size_t numChunks = 1;
+    int woken = 0;
+
+    // Subscribers in different IO contexts record their deliveries separately, but they're counted together. The
+    // first chunk was published before they subscribed, so they're catching up on it.
+    fanOut.publish(std::chrono::steady_clock::now() - std::chrono::seconds(10));
+    for (IOContext *ioc: { &iocA, &iocB }) {
+        testCoSpawn([&]() -> Awaitable<void> {
+            std::unique_lock lock(mutex);
+            Dash::FanOut::Subscriber subscriber(fanOut, co_await boost::asio::this_coro::executor);
+            while (numChunks < 2) {
+                co_await subscriber.wait(lock);
+            }
+            subscriber.delivered(0, numChunks);
+            woken++;
+        }, *ioc);
+    }
+    iocA.poll();
+    iocB.poll();
+
+    {
+        std::lock_guard lock(mutex);
+        numChunks++;
+        fanOut.publish(std::chrono::steady_clock::now());
+    }
+    fanOut.notify();
+    iocA.poll();
+    iocB.poll();
+    EXPECT_EQ(2, woken);
+
+    Dash::FanOut::Stats stats = fanOut.getStats();
+    EXPECT_EQ(1, stats.chunks);
+    EXPECT_LT(stats.maxTimeToLast, std::chrono::seconds(10));
+    EXPECT_LE(stats.maxSpread, stats.maxTimeToLast);
+}
+
+TEST(FanOut, LateSubscribersAreNotCounted)
+{
+    IOContext ioc;
+    Dash::FanOut fanOut;
+    std::mutex mutex;
+
+    // A subscriber that arrives after the chunk was published is catching up, so its delivery isn't counted.
+    fanOut.publish(std::chrono::steady_clock::now());
+    testCoSpawn([&]() -> Awaitable<void> {
+        std::unique_lock lock(mutex);
+        Dash::FanOut::Subscriber subscriber(fanOut, co_await boost::asio::this_coro::executor);
+        subscriber.delivered(0, 1);
+        co_return;
+    }, ioc);
+    ioc.poll();
+
+    EXPECT_EQ(0, fanOut.getStats().chunks);
+}
+
+} // namespace
@@ -3,6 +3,11 @@
 #include "coro_test.hpp"
 #include "log/MemoryLog.hpp"
 #include "resources/TestResource.hpp"
+#include "server/Response.hpp"
+#include "util/Event.hpp"
+#include "util/util.hpp"
+
+#include <boost/asio/steady_timer.hpp>
 
 #include <random>
 
@@ -70,10 +75,43 @@ std::vector<std::byte> getData(size_t size, int seed = 0)
     return result;
 }
 
+/**
+ * Wait for a while.
+ */
+Awaitable<void> sleep(IOContext &ioc, std::chrono::milliseconds duration)
+{
+    boost::asio::steady_timer timer(ioc);
+    timer.expires_after(duration);
+    co_await timer.async_wait(boost::asio::use_awaitable);
+}
+
+/**
+ * A response that records each write separately, so that padding (which is random) can be checked by its header.
+ */
+class RecordingResponse final : public Server::Response
+{
+public:
+    /**
+     * The data given to each write.
+     */
+    std::vector<std::vector<std::byte>> writes;
+
+private:
+    void writeBody(std::span<const Util::SharedBuffer> parts) override
+    {
+        writes.emplace_back(Util::concatenate(parts));
+    }
+
+    Awaitable<void> flushBody(bool) override
+    {
+        co_return;
+    }
+};
+
 CORO_TEST(InterleaveResource, SimpleLength1, ioc)
 {
     Log::MemoryLog log(ioc, Log::Level::fatal, false);
-    Dash::InterleaveResource resource(ioc, log, 1);
+    Dash::InterleaveResource resource(log, 1);
     EXPECT_FALSE(resource.hasEnded());
 
     resource.addStreamData(getShortData(), 0); // A data chunk.
@@ -92,7 +130,7 @@ CORO_TEST(InterleaveResource, SimpleLength1, ioc)
 CORO_TEST(InterleaveResource, SimpleLength2, ioc)
 {
     Log::MemoryLog log(ioc, Log::Level::fatal, false);
-    Dash::InterleaveResource resource(ioc, log, 1);
+    Dash::InterleaveResource resource(log, 1);
     EXPECT_FALSE(resource.hasEnded());
 
     resource.addStreamData(getData(3 << 8), 0); // A data chunk.
@@ -111,7 +149,7 @@ CORO_TEST(InterleaveResource, SimpleLength2, ioc)
 CORO_TEST(InterleaveResource, SimpleLength4, ioc)
 {
     Log::MemoryLog log(ioc, Log::Level::fatal, false);
-    Dash::InterleaveResource resource(ioc, log, 1);
+    Dash::InterleaveResource resource(log, 1);
     EXPECT_FALSE(resource.hasEnded());
 
     resource.addStreamData(getData(3 << 16), 0); // A data chunk.
@@ -130,7 +168,7 @@ CORO_TEST(InterleaveResource, SimpleLength4, ioc)
 CORO_TEST(InterleaveResource, TwoStreams, ioc)
 {
     Log::MemoryLog log(ioc, Log::Level::fatal, false);
-    Dash::InterleaveResource resource(ioc, log, 2);
+    Dash::InterleaveResource resource(log, 2);
     EXPECT_FALSE(resource.hasEnded());
 
     resource.addStreamData(getShortData(), 0); // A data chunk.
@@ -154,10 +192,36 @@ CORO_TEST(InterleaveResource, TwoStreams, ioc)
     }});
 }
 
+CORO_TEST(InterleaveResource, EndStreams, ioc)
+{
+    Log::MemoryLog log(ioc, Log::Level::fatal, false);
+    unsigned int numGets = 0;
+    Dash::InterleaveResource resource(log, 2, 0, ~0u, ~0u, [&numGets]() { numGets++; });
+    EXPECT_FALSE(resource.hasEnded());
+
+    resource.addStreamData(getShortData(), 0); // A data chunk.
+    resource.addStreamData({}, 0); // End of stream.
+    EXPECT_FALSE(resource.hasEnded());
+
+    resource.endStreams(); // Ends only the stream that hasn't already ended.
+    EXPECT_TRUE(resource.hasEnded());
+
+    resource.addStreamData(getShortData(), 1); // Ignored, because the stream has ended.
+    EXPECT_TRUE(resource.hasEnded());
+
+    TestRequest request;
+    co_await testResource(resource, request, {{
+        getChunkLength1(getShortData(), 0),
+        getChunkLength1({}, 0),
+        getChunkLength1({}, 1)
+    }});
+    EXPECT_EQ(1, numGets);
+}
+
 CORO_TEST(InterleaveResource, ControlChunk, ioc)
 {
     Log::MemoryLog log(ioc, Log::Level::fatal, false);
-    Dash::InterleaveResource resource(ioc, log, 1);
+    Dash::InterleaveResource resource(log, 1);
     EXPECT_FALSE(resource.hasEnded());
 
     resource.addStreamData(getShortData(), 0); // A data chunk.
@@ -181,4 +245,121 @@ CORO_TEST(InterleaveResource, ControlChunk, ioc)
     }});
 }
 
+/* Check that a request that's been sent less than the minimum over a whole window is padded up to it. */
+CORO_TEST(InterleaveResource, PaddingSlow, ioc)
+{
+    using namespace std::chrono_literals;
+    Log::MemoryLog log(ioc, Log::Level::fatal, false);
+    Dash::InterleaveResource resource(log, 1, 1000, 20);
+
+    RecordingResponse response;
+    Event finished;
+    bool isFinished = false;
+    testCoSpawn([&]() -> Awaitable<void> {
+        TestRequest request;
+        co_await resource(response, request);
+        isFinished = true;
+        finished.notifyAll();
+    }, ioc);
+
+    // The first chunk is sent less than a window after the request started, so it's not padded.
+    resource.addStreamData(getShortData(), 0);
+    co_await sleep(ioc, 1ms);
+
+    // The second chunk is sent after the first has left the window, so it's all there is in the window.
+    co_await sleep(ioc, 40ms);
+    resource.addStreamData(getShortData(), 0);
+    co_await sleep(ioc, 1ms);
+
+    // There's no padding once the interleave has ended.
+    resource.addStreamData({}, 0);
+    while (!isFinished) {
+        co_await finished.wait();
+    }
+
+    ASSERT_EQ(4, response.writes.size());
+    EXPECT_EQ(getChunkLength1(getShortData()), response.writes[0]);
+    EXPECT_EQ(getChunkLength1(getShortData()), response.writes[1]);
+    EXPECT_EQ(getChunkLength1({}), response.writes[3]);
+
+    // The padding is a discard control chunk whose data makes the window up to the minimum. Its own header isn't
+    // counted.
+    size_t paddingSize = 1000 - getChunkLength1(getShortData()).size();
+    const std::vector<std::byte> &padding = response.writes[2];
+    ASSERT_EQ(paddingSize + 4, padding.size());
+    EXPECT_EQ((std::byte)(Dash::InterleaveResource::maxStreams | (1 << 6)), padding[0]);
+    EXPECT_EQ((std::byte)((paddingSize + 1) & 0xFF), padding[1]);
+    EXPECT_EQ((std::byte)((paddingSize + 1) >> 8), padding[2]);
+    EXPECT_EQ((std::byte)Dash::ControlChunkType::discard, padding[3]);
+}
+
+/* Check that a request that joins late isn't padded, and gets only the stored media and control chunks. */
+CORO_TEST(InterleaveResource, PaddingLateJoin, ioc)
+{
+    using namespace std::chrono_literals;
+    Log::MemoryLog log(ioc, Log::Level::fatal, false);
+    Dash::InterleaveResource resource(log, 1, 1000, 20);
+
+    // An early request would be padded after this.
+    resource.addStreamData(getShortData(), 0);
+    co_await sleep(ioc, 40ms);
+    resource.addStreamData(getShortData(), 0);
+    resource.addControlChunk(getShortData(), Dash::ControlChunkType::discard);
+
+    // The late request catches up with one write, and so was sent all of it within the window.
+    std::vector<std::byte> controlChunkRef = getShortData();
+    controlChunkRef.insert(controlChunkRef.begin(), (std::byte)Dash::ControlChunkType::discard);
+    Event finished;
+    bool isFinished = false;
+    testCoSpawn([&]() -> Awaitable<void> {
+        TestRequest request;
+        co_await testResource(resource, request, {{
+            getChunkLength1(getShortData()),
+            getChunkLength1(getShortData()),
+            getChunkLength1(controlChunkRef, Dash::InterleaveResource::maxStreams),
+            getChunkLength1({})
+        }});
+        isFinished = true;
+        finished.notifyAll();
+    }, ioc);
+    co_await sleep(ioc, 1ms);
+
+    resource.addStreamData({}, 0);
+    while (!isFinished) {
+        co_await finished.wait();
+    }
+}
+
+/* Check that a request that's being sent more than the minimum isn't padded. */
+CORO_TEST(InterleaveResource, PaddingKeepingUp, ioc)
+{
+    using namespace std::chrono_literals;
+    Log::MemoryLog log(ioc, Log::Level::fatal, false);
+    Dash::InterleaveResource resource(log, 1, 64, 20);
+
+    Event finished;
+    bool isFinished = false;
+    testCoSpawn([&]() -> Awaitable<void> {
+        TestRequest request;
+        std::vector<std::vector<std::byte>> chunks;
+        for (int i = 0; i < 10; i++) {
+            chunks.emplace_back(getChunkLength1(getData(64, i)));
+        }
+        chunks.emplace_back(getChunkLength1({}));
+        co_await testResource(resource, request, std::vector<std::span<const std::byte>>(chunks.begin(), chunks.end()));
+        isFinished = true;
+        finished.notifyAll();
+    }, ioc);
+
+    // Each chunk is more than the minimum on its own, so the window is always full when the request is sent one.
+    for (int i = 0; i < 10; i++) {
+        resource.addStreamData(getData(64, i), 0);
+        co_await sleep(ioc, 5ms);
+    }
+    resource.addStreamData({}, 0);
+    while (!isFinished) {
+        co_await finished.wait();
+    }
+}
+
 } // namespace
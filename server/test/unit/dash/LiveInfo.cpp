@@ -95,8 +95,9 @@ TEST(DashLiveInfo, Complex)
             }
         }
     }, "/live/test");
-    EXPECT_EQ("{\"audioConfigs\":[{\"bitrate\":64,\"codec\":\"aac\"},{\"bitrate\":64,\"codec\":\"aac\"}],"
-              "\"avMap\":[[0,3],[1,null],[2,4]],\"path\":\"live/test\",\"segmentDuration\":15000,\"segmentPreavailability\":4000,"
+    // The qualities with audio have the same audio, so they share it.
+    EXPECT_EQ("{\"audioConfigs\":[{\"bitrate\":64,\"codec\":\"aac\"}],"
+              "\"avMap\":[[0,3],[1,null],[2,3]],\"path\":\"live/test\",\"segmentDuration\":15000,\"segmentPreavailability\":4000,"
               "\"videoConfigs\":[{\"bitrate\":2048,"
                                  "\"bufferCtrl\":{\"extraBuffer\":180,\"initialBuffer\":1000,\"minBuffer\":500,"
                                                  "\"minimumInitTime\":2000,\"seekBuffer\":250},"
@@ -110,3 +111,34 @@ TEST(DashLiveInfo, Complex)
                                                  "\"minimumInitTime\":4000,\"seekBuffer\":500},"
                                  "\"codec\":\"h264\",\"height\":360,\"width\":640}]}", infoJson);
 }
+
+TEST(DashLiveInfo, DifferentAudio)
+{
+    std::string infoJson = Dash::getLiveInfo({
+        .qualities = {
+            {
+                .video = {
+                    .width = 1920,
+                    .height = 1080,
+                    .bitrate = 2048
+                },
+                .audio = {
+                    .sampleRate = 48000,
+                    .bitrate = 128
+                }
+            },
+            {
+                .video = {
+                    .width = 1280,
+                    .height = 720,
+                    .bitrate = 1024
+                },
+                .audio = {
+                    .sampleRate = 48000
+                }
+            }
+        }
+    }, "/live/test");
+    EXPECT_EQ("{\"audioConfigs\":[{\"bitrate\":128,\"codec\":\"aac\"},{\"bitrate\":64,\"codec\":\"aac\"}],"
+              "\"avMap\":[[0,2],[1,3]],", infoJson.substr(0, infoJson.find("\"path\"")));
+}
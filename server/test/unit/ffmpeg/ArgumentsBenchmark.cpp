@@ -0,0 +1,156 @@
+#include "ffmpeg/Arguments.hpp"
+#include "configuration/configuration.hpp"
+
+#include "ArgumentsTestImpl.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+/**
+ * Make a quality with the given resolution and frame rate.
+ */
+Config::Quality getQuality(unsigned int width, unsigned int height, unsigned int frameRate)
+{
+    return {
+        .video = {
+            .width = width,
+            .height = height,
+            .frameRate = {
+                .type = Config::FrameRate::fps,
+                .numerator = frameRate
+            }
+        }
+    };
+}
+
+/**
+ * A channel with a ladder of qualities that aren't in order of size, the smallest of which have a higher frame rate than
+ * the largest.
+ */
+Config::Channel getConfig()
+{
+    return {
+        .source = {
+            .url = "rtsp://192.0.2.3",
+            .timestamp = true
+        },
+        .qualities = {
+            getQuality(1280, 720, 25),
+            getQuality(1920, 1080, 25),
+            getQuality(640, 360, 50),
+            getQuality(640, 360, 25)
+        },
+        .ffmpeg = {
+            .benchmark = 10
+        }
+    };
+}
+
+TEST(FfmpegArguments, BenchmarkCascade)
+{
+    check({
+        /* Global arguments. */
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+        "-benchmark",
+
+        /* Input arguments. */
+        "-rtbufsize", "1024",
+        "-thread_queue_size", "0",
+        "-rtsp_transport", "tcp",
+        "-i", "rtsp://192.0.2.3",
+
+        /* Filtering. The 50 fps quality can't be scaled from the larger ones, so it's scaled from the source, and the
+           other quality of the same size is scaled from it. */
+        "-filter_complex", "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; "
+                           "[vsrc]split=2[vin1][vin2]; "
+                           "[vin1]fps=25/1,scale=1920x1080,drawtext=text='%{gmtime} UTC':x=48:y=48:fontsize=64:"
+                           "borderw=4:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[vs1]; [vs1]split=2[v1][vin0]; "
+                           "[vin0]fps=25/1,scale=1280x720[v0]; "
+                           "[vin2]fps=50/1,scale=640x360,drawtext=text='%{gmtime} UTC':x=16:y=16:fontsize=21:"
+                           "borderw=1:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[vs2]; [vs2]split=2[v2][vin3]; "
+                           "[vin3]fps=25/1,scale=640x360[v3]; ",
+
+        /* Output. */
+        "-map", "[v0]", "-map", "[v1]", "-map", "[v2]", "-map", "[v3]",
+        "-t", "10",
+        "-f", "null",
+        "-"
+    }, Ffmpeg::Arguments::benchmarkFilter(getConfig(), true));
+}
+
+TEST(FfmpegArguments, BenchmarkNoCascade)
+{
+    check({
+        /* Global arguments. */
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+        "-benchmark",
+
+        /* Input arguments. */
+        "-rtbufsize", "1024",
+        "-thread_queue_size", "0",
+        "-rtsp_transport", "tcp",
+        "-i", "rtsp://192.0.2.3",
+
+        /* Filtering. */
+        "-filter_complex", "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; "
+                           "[vsrc]split=4[vin0][vin1][vin2][vin3]; "
+                           "[vin0]fps=25/1,scale=1280x720,drawtext=text='%{gmtime} UTC':x=32:y=32:fontsize=42:"
+                           "borderw=2:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[v0]; "
+                           "[vin1]fps=25/1,scale=1920x1080,drawtext=text='%{gmtime} UTC':x=48:y=48:fontsize=64:"
+                           "borderw=4:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[v1]; "
+                           "[vin2]fps=50/1,scale=640x360,drawtext=text='%{gmtime} UTC':x=16:y=16:fontsize=21:"
+                           "borderw=1:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[v2]; "
+                           "[vin3]fps=25/1,scale=640x360,drawtext=text='%{gmtime} UTC':x=16:y=16:fontsize=21:"
+                           "borderw=1:fontcolor=#ffffff:bordercolor=#000000:"
+                           "fontfile=/usr/share/fonts/TTF/DejaVuSansMono.ttf[v3]; ",
+
+        /* Output. */
+        "-map", "[v0]", "-map", "[v1]", "-map", "[v2]", "-map", "[v3]",
+        "-t", "10",
+        "-f", "null",
+        "-"
+    }, Ffmpeg::Arguments::benchmarkFilter(getConfig(), false));
+}
+
+TEST(FfmpegArguments, Calibrate)
+{
+    check({
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+        "-benchmark",
+        "-f", "lavfi",
+        "-i", "testsrc2=size=1280x720:rate=25",
+        "-frames:v", "100",
+        "-pix_fmt:v", "yuv420p",
+        "-c:v", "h265",
+        "-crf:v", "25",
+        "-preset:v", "veryfast",
+        "-tune:v", "zerolatency",
+        "-f", "null",
+        "-"
+    }, Ffmpeg::Arguments::calibrate(1280, 720, 100, Codec::VideoCodec::h265, Config::H26xPreset::veryfast));
+
+    // The baseline only generates the video.
+    check({
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+        "-benchmark",
+        "-f", "lavfi",
+        "-i", "testsrc2=size=640x360:rate=25",
+        "-frames:v", "100",
+        "-pix_fmt:v", "yuv420p",
+        "-f", "null",
+        "-"
+    }, Ffmpeg::Arguments::calibrate(640, 360, 100, std::nullopt, Config::H26xPreset::medium));
+}
+
+} // namespace
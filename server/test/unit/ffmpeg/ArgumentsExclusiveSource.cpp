@@ -0,0 +1,32 @@
+#include "ffmpeg/Arguments.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+TEST(FfmpegArguments, ExclusiveSourceNormal)
+{
+    EXPECT_FALSE(Ffmpeg::Arguments::getIsExclusiveSource("http://example.com/spiders.mp4", {}));
+    EXPECT_FALSE(Ffmpeg::Arguments::getIsExclusiveSource("rtmp://example.com/spiders?key=listening", {}));
+    EXPECT_FALSE(Ffmpeg::Arguments::getIsExclusiveSource("/srv/listen/spiders.mp4", { "-f", "mp4" }));
+}
+
+TEST(FfmpegArguments, ExclusiveSourceIngest)
+{
+    EXPECT_TRUE(Ffmpeg::Arguments::getIsExclusiveSource("ingest_http://example.com/spiders", {}));
+}
+
+TEST(FfmpegArguments, ExclusiveSourceDevice)
+{
+    EXPECT_TRUE(Ffmpeg::Arguments::getIsExclusiveSource("/dev/video0", {}));
+    EXPECT_TRUE(Ffmpeg::Arguments::getIsExclusiveSource("DeckLink Mini Recorder", { "-f", "decklink" }));
+}
+
+TEST(FfmpegArguments, ExclusiveSourceListen)
+{
+    EXPECT_TRUE(Ffmpeg::Arguments::getIsExclusiveSource("rtmp://0.0.0.0/spiders", { "-listen", "1" }));
+    EXPECT_TRUE(Ffmpeg::Arguments::getIsExclusiveSource("srt://0.0.0.0:9000?mode=listener", {}));
+}
+
+} // namespace
@@ -146,6 +146,7 @@ TEST(FfmpegArguments, LivestreamForIngest)
         "-index_correction", "0",
         "-tcp_nodelay", "1",
         "-method", "PUT",
+        "-http_persistent", "1",
         "-remove_at_exit", "1",
         "http://localhost:8080/live/uid/manifest.mpd",
     }, Ffmpeg::Arguments::liveStream(config, {}, "live/uid"));
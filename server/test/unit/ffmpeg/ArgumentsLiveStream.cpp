@@ -117,6 +117,7 @@ TEST(FfmpegArguments, Simple)
         "-index_correction", "0",
         "-tcp_nodelay", "1",
         "-method", "PUT",
+        "-http_persistent", "1",
         "-remove_at_exit", "1",
         "http://localhost:8080/live/uid/manifest.mpd",
     }, Ffmpeg::Arguments::liveStream(config, {}, "live/uid"));
@@ -231,6 +232,7 @@ TEST(FfmpegArguments, Fractional)
         "-index_correction", "0",
         "-tcp_nodelay", "1",
         "-method", "PUT",
+        "-http_persistent", "1",
         "-remove_at_exit", "1",
         "http://localhost:8080/live/uid/manifest.mpd",
     }, Ffmpeg::Arguments::liveStream(config, {}, "live/uid"));
@@ -338,13 +340,13 @@ TEST(FfmpegArguments, TwoVideoStreams)
         /* Filtering. */
         "-filter_complex", "nullsrc,zmq=bind_address='',nullsink; "
                            "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; "
-                           "[vsrc]split=2[vin0][vin1]; "
-                           "[vin0]fps=25/1,scale=1920x1080[v0]; "
+                           "[vsrc]split=1[vin0]; "
+                           "[vin0]fps=25/1,scale=1920x1080[vs0]; [vs0]split=2[v0][vin1]; "
                            "[vin1]fps=25/1,scale=1280x720[v1]; "
-                           "[0:a]volume@ablank=volume=0.0:enable=0[asrc]; [asrc]asplit=2[a0][a1]; ",
+                           "[0:a]volume@ablank=volume=0.0:enable=0[a0]; ",
 
-        /* Map. */
-        "-map", "[v0]", "-map", "[v1]", "-map", "[a0]", "-map", "[a1]",
+        /* Map. The qualities have the same audio, so they share it. */
+        "-map", "[v0]", "-map", "[v1]", "-map", "[a0]",
 
         /* Per stream-type arguments. */
         "-pix_fmt:v", "yuv420p",
@@ -383,11 +385,6 @@ TEST(FfmpegArguments, TwoVideoStreams)
         "-c:a:0", "aac",
         "-b:a:0", "64k",
 
-        /* Audio stream 1 arguments. */
-        // Common arguments.
-        "-c:a:1", "aac",
-        "-b:a:1", "64k",
-
         /* Output arguments. */
         // PTS updates.
         "-stats_mux_pre:v:0", "pipe:1",
@@ -418,6 +415,7 @@ TEST(FfmpegArguments, TwoVideoStreams)
         "-index_correction", "0",
         "-tcp_nodelay", "1",
         "-method", "PUT",
+        "-http_persistent", "1",
         "-remove_at_exit", "1",
         "http://localhost:8080/live/uid/manifest.mpd",
     }, Ffmpeg::Arguments::liveStream(config, {}, "live/uid"));
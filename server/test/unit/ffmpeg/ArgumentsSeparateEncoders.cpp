@@ -0,0 +1,327 @@
+#include "ffmpeg/Arguments.hpp"
+#include "configuration/configuration.hpp"
+
+#include "ArgumentsTestImpl.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+/**
+ * A channel with two qualities, only the second of which has audio.
+ */
+Config::Channel getConfig()
+{
+    return {
+        .source = {
+            .url = "rtsp://192.0.2.3"
+        },
+        .qualities = {
+            {
+                .video = {
+                    .width = 1920,
+                    .height = 1080,
+                    .frameRate = {
+                        .type = Config::FrameRate::fps,
+                        .numerator = 25
+                    },
+                    .bitrate = 2048,
+                    .minBitrate = 512,
+                    .rateControlBufferLength = 333,
+                    .h26xPreset = Config::H26xPreset::faster
+                }
+            },
+            {
+                .video = {
+                    .width = 1280,
+                    .height = 720,
+                    .frameRate = {
+                        .type = Config::FrameRate::fps,
+                        .numerator = 25
+                    },
+                    .bitrate = 1024,
+                    .minBitrate = 256,
+                    .rateControlBufferLength = 333,
+                    .h26xPreset = Config::H26xPreset::faster
+                },
+                .audio = {
+                    .sampleRate = 48000
+                }
+            }
+        },
+        .ffmpeg = {
+            .filterZmq = "ipc:///tmp/live/abcd",
+            .separateEncoders = true
+        }
+    };
+}
+
+TEST(FfmpegArguments, SeparateEncodersDecode)
+{
+    Config::Channel config = getConfig();
+    check({
+        /* Global arguments. */
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+
+        /* Input arguments. */
+        // Realtime arguments.
+        "-rtbufsize", "1024",
+        "-thread_queue_size", "0",
+
+        // RTSP arguments.
+        "-rtsp_transport", "tcp",
+
+        // Common arguments.
+        "-i", "rtsp://192.0.2.3",
+
+        /* Filtering. */
+        "-filter_complex", "nullsrc,zmq=bind_address='ipc\\:///tmp/live/abcd',nullsink; "
+                           "[0:v]drawbox@vblank=thickness=fill:c=#000000:enable=0[vsrc]; "
+                           "[vsrc]split=1[vin0]; "
+                           "[vin0]fps=25/1,scale=1920x1080[vs0]; [vs0]split=2[v0][vin1]; "
+                           "[vin1]fps=25/1,scale=1280x720[v1]; "
+                           "[0:a]volume@ablank=volume=0.0:enable=0[asrc]; [asrc]asplit=2[a0][a1]; ",
+
+        /* Quality 0 output, which also reports the timestamps. */
+        "-map", "[v0]",
+        "-pix_fmt:v", "yuv420p",
+        "-c:v", "rawvideo",
+        "-c:a", "pcm_s16le",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-stats_mux_pre:v:0", "pipe:1",
+        "-stats_mux_pre_fmt:v:0", "{pts} {tb}",
+        "-f", "nut",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "http://localhost:8080/decode/live/uid/0",
+
+        /* Quality 1 output. */
+        "-map", "[v1]",
+        "-map", "[a1]",
+        "-pix_fmt:v", "yuv420p",
+        "-c:v", "rawvideo",
+        "-c:a", "pcm_s16le",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-f", "nut",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "http://localhost:8080/decode/live/uid/1"
+    }, Ffmpeg::Arguments::liveDecode(config, {}, "decode/live/uid"));
+
+    Ffmpeg::Arguments test = Ffmpeg::Arguments::liveDecode(config, {}, "decode/live/uid");
+    EXPECT_EQ("rtsp://192.0.2.3", test.getSourceUrl());
+    EXPECT_TRUE(test.getCacheProbe());
+}
+
+TEST(FfmpegArguments, SeparateEncodersEncode)
+{
+    Config::Channel config = getConfig();
+    check({
+        /* Global arguments. */
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+
+        /* Input arguments. */
+        "-rtbufsize", "1024",
+        "-thread_queue_size", "0",
+        "-f", "nut",
+        "-i", "http://localhost:8080/decode/live/uid/1",
+
+        /* Video output. */
+        "-map", "0:v",
+        "-pix_fmt:v", "yuv420p",
+        "-c:v:0", "h264",
+        "-crf:v:0", "25",
+        "-minrate:v:0", "256",
+        "-bufsize:v:0", "340k",
+        "-forced-idr:v:0", "1",
+        "-force_key_frames:v:0", "expr:if(isnan(prev_forced_t), 1, gte(t, (floor(prev_forced_t * 1000 / 15000) + 1) * "
+                                 "15000 / 1000))",
+        "-maxrate:v:0", "1024k",
+        "-preset:v:0", "faster",
+        "-tune:v:0", "zerolatency",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-f", "dash",
+        "-adaptation_sets", "id=0,streams=v",
+        "-use_timeline", "0",
+        "-use_template", "1",
+        "-dash_segment_type", "mp4",
+        "-single_file", "0",
+        "-init_seg_name", "init-stream1.$ext$",
+        "-media_seg_name", "chunk-stream1-$Number%09d$.$ext$",
+        "-seg_duration", "15",
+        "-format_options", "movflags=cmaf",
+        "-frag_type", "every_frame",
+        "-window_size", "3",
+        "-extra_window_size", "2",
+        "-utc_timing_url", "https://time.akamai.com/?iso",
+        "-target_latency", "1",
+        "-ldash", "1",
+        "-streaming", "1",
+        "-index_correction", "0",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "-http_persistent", "1",
+        "-remove_at_exit", "1",
+        "http://localhost:8080/live/uid/manifest-stream1.mpd",
+
+        /* Audio output. The first quality has no audio, so this is the first audio stream. */
+        "-map", "0:a",
+        "-ac:a", "1",
+        "-c:a:0", "aac",
+        "-b:a:0", "64k",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-f", "dash",
+        "-adaptation_sets", "id=0,streams=a",
+        "-use_timeline", "0",
+        "-use_template", "1",
+        "-dash_segment_type", "mp4",
+        "-single_file", "0",
+        "-init_seg_name", "init-stream2.$ext$",
+        "-media_seg_name", "chunk-stream2-$Number%09d$.$ext$",
+        "-seg_duration", "15",
+        "-format_options", "movflags=cmaf",
+        "-frag_type", "every_frame",
+        "-window_size", "3",
+        "-extra_window_size", "2",
+        "-utc_timing_url", "https://time.akamai.com/?iso",
+        "-target_latency", "1",
+        "-ldash", "1",
+        "-streaming", "1",
+        "-index_correction", "0",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "-http_persistent", "1",
+        "-remove_at_exit", "1",
+        "http://localhost:8080/live/uid/manifest-stream2.mpd"
+    }, Ffmpeg::Arguments::liveEncode(config, {}, "decode/live/uid", "live/uid", 1));
+
+    // The encoders don't probe: the decoder does.
+    EXPECT_FALSE(Ffmpeg::Arguments::liveEncode(config, {}, "decode/live/uid", "live/uid", 0).getCacheProbe());
+}
+
+TEST(FfmpegArguments, SeparateEncodersResume)
+{
+    // The stream started 0.52s in, part way through the key frame interval, so the first segment runs until the
+    // key frame at 30s, and the third starts at 45s. The audio has no such gaps between its key frames.
+    Config::Channel config = getConfig();
+    check({
+        /* Global arguments. */
+        "-loglevel", "repeat+level+info",
+        "-nostdin",
+
+        /* Input arguments. */
+        "-rtbufsize", "1024",
+        "-thread_queue_size", "0",
+        "-f", "nut",
+        "-i", "http://localhost:8080/decode/live/uid/1",
+
+        /* Video output, starting at the third segment. */
+        "-map", "0:v",
+        "-filter:v:0", "select='gte(t, 45000 * 1 / 1000)'",
+        "-pix_fmt:v", "yuv420p",
+        "-c:v:0", "h264",
+        "-crf:v:0", "25",
+        "-minrate:v:0", "256",
+        "-bufsize:v:0", "340k",
+        "-forced-idr:v:0", "1",
+        "-force_key_frames:v:0", "expr:if(isnan(prev_forced_t), 1, gte(t, (floor(prev_forced_t * 1000 / 15000) + 1) * "
+                                 "15000 / 1000))",
+        "-maxrate:v:0", "1024k",
+        "-preset:v:0", "faster",
+        "-tune:v:0", "zerolatency",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-f", "dash",
+        "-adaptation_sets", "id=0,streams=v",
+        "-use_timeline", "0",
+        "-use_template", "1",
+        "-dash_segment_type", "mp4",
+        "-single_file", "0",
+        "-init_seg_name", "init-stream1.$ext$",
+        "-media_seg_name", "chunk-stream1-$Number%09d$.$ext$",
+        "-seg_duration", "15",
+        "-format_options", "movflags=cmaf",
+        "-frag_type", "every_frame",
+        "-window_size", "3",
+        "-extra_window_size", "2",
+        "-utc_timing_url", "https://time.akamai.com/?iso",
+        "-target_latency", "1",
+        "-ldash", "1",
+        "-streaming", "1",
+        "-index_correction", "0",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "-http_persistent", "1",
+        "-remove_at_exit", "1",
+        "http://localhost:8080/live/uid/manifest-stream1.mpd",
+
+        /* Audio output. The first quality has no audio, so this is the first audio stream. */
+        "-map", "0:a",
+        "-filter:a:0", "aselect='gte(t, 2746800000 * 1 / 90000000)'",
+        "-ac:a", "1",
+        "-c:a:0", "aac",
+        "-b:a:0", "64k",
+        "-flush_packets", "1",
+        "-fflags", "flush_packets",
+        "-copyts",
+        "-f", "dash",
+        "-adaptation_sets", "id=0,streams=a",
+        "-use_timeline", "0",
+        "-use_template", "1",
+        "-dash_segment_type", "mp4",
+        "-single_file", "0",
+        "-init_seg_name", "init-stream2.$ext$",
+        "-media_seg_name", "chunk-stream2-$Number%09d$.$ext$",
+        "-seg_duration", "15",
+        "-format_options", "movflags=cmaf",
+        "-frag_type", "every_frame",
+        "-window_size", "3",
+        "-extra_window_size", "2",
+        "-utc_timing_url", "https://time.akamai.com/?iso",
+        "-target_latency", "1",
+        "-ldash", "1",
+        "-streaming", "1",
+        "-index_correction", "0",
+        "-tcp_nodelay", "1",
+        "-method", "PUT",
+        "-http_persistent", "1",
+        "-remove_at_exit", "1",
+        "http://localhost:8080/live/uid/manifest-stream2.mpd"
+    }, Ffmpeg::Arguments::liveEncode(config, {}, "decode/live/uid", "live/uid", 1, Ffmpeg::Timestamp(46800, 1, 90000),
+                                     3));
+}
+
+TEST(FfmpegArguments, VideoSegmentStart)
+{
+    // Three key frame intervals of 2/3s per segment.
+    Config::Dash dash{ .segmentDuration = 2000 };
+    Config::VideoQuality video{ .gopsPerSegment = 3 };
+
+    // Starting on the grid, the segments are whole segment durations.
+    EXPECT_EQ(Ffmpeg::Timestamp(0, 1, 1), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 0, 1, 1 }, 1));
+    EXPECT_EQ(Ffmpeg::Timestamp(2, 1, 1), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 0, 1, 1 }, 2));
+    EXPECT_EQ(Ffmpeg::Timestamp(4, 1, 1), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 0, 1, 1 }, 3));
+
+    // Starting part way through a key frame interval, each later segment starts at the key frame after a whole number
+    // of segment durations.
+    EXPECT_EQ(Ffmpeg::Timestamp(1, 1, 2), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 1, 1, 2 }, 1));
+    EXPECT_EQ(Ffmpeg::Timestamp(8, 1, 3), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 1, 1, 2 }, 2));
+    EXPECT_EQ(Ffmpeg::Timestamp(14, 1, 3), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { 1, 1, 2 }, 3));
+
+    // The same goes for timestamps before zero.
+    EXPECT_EQ(Ffmpeg::Timestamp(2, 1, 1), Ffmpeg::Arguments::getVideoSegmentStart(dash, video, { -1, 1, 2 }, 2));
+}
+
+} // namespace
@@ -0,0 +1,21 @@
+#include "ffmpeg/benchmark.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(FfmpegBenchmark, Times)
+{
+    std::optional<Ffmpeg::BenchmarkResult> result =
+        Ffmpeg::parseBenchmarkLine("bench: utime=12.345s stime=0.067s rtime=10.001s");
+
+    ASSERT_TRUE(result);
+    EXPECT_EQ(std::chrono::milliseconds(12345), result->userTime);
+    EXPECT_EQ(std::chrono::milliseconds(67), result->systemTime);
+    EXPECT_EQ(std::chrono::milliseconds(10001), result->realTime);
+}
+
+TEST(FfmpegBenchmark, OtherLines)
+{
+    EXPECT_FALSE(Ffmpeg::parseBenchmarkLine("bench: maxrss=123456KiB"));
+    EXPECT_FALSE(Ffmpeg::parseBenchmarkLine("Press [q] to stop, [?] for help"));
+    EXPECT_FALSE(Ffmpeg::parseBenchmarkLine("bench: utime=1s stime=0.000s rtime=1.000s"));
+}
@@ -2,9 +2,13 @@
 
 #include "configuration/configuration.hpp"
 
+#include "util/json.hpp"
+
 #include "coro_test.hpp"
 #include "data.hpp"
 
+#include <fstream>
+
 namespace
 {
 
@@ -71,4 +75,52 @@ CORO_TEST(Ffprobe, ConcurrentCache, ioc)
     EXPECT_EQ(&*ffprobed1, &*ffprobed2);
 }
 
+/**
+ * Write a probe cache file with a single result for a source that doesn't exist, so that ffprobe would fail.
+ *
+ * @param age How long ago the result was probed.
+ */
+std::filesystem::path writeProbeCache(std::chrono::seconds age)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "live-video-streamer-server_test.ProbeCache";
+    std::ofstream(path) << Json::dump(nlohmann::json::array({
+        {
+            { "url", "/nonexistent/source.ts" },
+            { "arguments", nlohmann::json::array() },
+            { "probedAt", std::chrono::duration_cast<std::chrono::seconds>(
+                (std::chrono::system_clock::now() - age).time_since_epoch()).count() },
+            { "video", { { "width", 1280 }, { "height", 720 }, { "frameRate", { 50, 1 } } } }
+        }
+    }));
+    return path;
+}
+
+CORO_TEST(Ffprobe, StoredCache, ioc)
+{
+    // The stored result is used instead of running ffprobe, which would fail.
+    Ffmpeg::setProbeCache(writeProbeCache(std::chrono::seconds(10)), std::chrono::seconds(60));
+    MediaInfo::SourceInfo ffprobed = co_await Ffmpeg::ffprobe(ioc, "/nonexistent/source.ts");
+    Ffmpeg::setProbeCache({}, std::chrono::seconds(0));
+
+    MediaInfo::SourceInfo ref = {
+        .video = MediaInfo::VideoStreamInfo{
+            .width = 1280,
+            .height = 720,
+            .frameRateNumerator = 50,
+            .frameRateDenominator = 1
+        }
+    };
+    EXPECT_EQ(ref, ffprobed);
+}
+
+CORO_TEST(Ffprobe, ExpiredCache, ioc)
+{
+    // The stored result is too old, so ffprobe is run, and fails.
+    Ffmpeg::setProbeCache(writeProbeCache(std::chrono::seconds(120)), std::chrono::seconds(60));
+    Ffmpeg::ProbeResult ffprobed = co_await Ffmpeg::ffprobe(ioc, "/nonexistent/source.ts");
+    Ffmpeg::setProbeCache({}, std::chrono::seconds(0));
+
+    EXPECT_THROW(*ffprobed, std::exception);
+}
+
 } // namespace
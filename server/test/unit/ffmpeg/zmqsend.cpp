@@ -0,0 +1,191 @@
+#include "ffmpeg/zmqsend.hpp"
+
+#include "coro_test.hpp"
+
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+/**
+ * A stand-in for FFmpeg's zmq filter: a ZMTP 3.0 REP server on a unix socket.
+ *
+ * It reads a given number of requests before replying to any of them, so a client that waits for each reply before
+ * sending the next request gets stuck.
+ */
+class ZmqServer final
+{
+public:
+    ~ZmqServer()
+    {
+        std::filesystem::remove(path);
+    }
+
+    /**
+     * Constructor :)
+     *
+     * @param name Distinguishes the socket from other tests'.
+     */
+    explicit ZmqServer(IOContext &ioc, std::string name) :
+        path(std::filesystem::temp_directory_path() /
+             ("lvss-zmqsend-" + std::to_string(getpid()) + "-" + name + ".sock")),
+        acceptor((boost::asio::io_context &)ioc)
+    {
+        std::filesystem::remove(path);
+        acceptor.open();
+        acceptor.bind(boost::asio::local::stream_protocol::endpoint(path.string()));
+        acceptor.listen();
+    }
+
+    /**
+     * Get the address to give zmqsend.
+     */
+    std::string getAddress() const
+    {
+        return "ipc://" + path.string();
+    }
+
+    /**
+     * Accept a connection, and answer batches of requests on it until it's closed.
+     *
+     * @param batchSize The number of requests to read before replying.
+     */
+    Awaitable<void> serve(size_t batchSize)
+    {
+        boost::asio::local::stream_protocol::socket socket = co_await acceptor.async_accept(boost::asio::use_awaitable);
+        connections++;
+
+        /* Handshake. */
+        std::string greeting(64, '\0');
+        greeting[0] = (char)0xff;
+        greeting[9] = 0x7f;
+        greeting[10] = 3;
+        greeting.replace(12, 4, "NULL");
+        co_await boost::asio::async_write(socket, boost::asio::buffer(greeting), boost::asio::use_awaitable);
+        std::string peerGreeting = co_await read(socket, 64);
+        EXPECT_EQ(greeting, peerGreeting);
+
+        std::string ready = co_await readFrame(socket);
+        EXPECT_EQ(std::string("\x04\x19\x05READY\x0bSocket-Type\0\0\0\x03REQ", 27), ready);
+        std::string readyReply("\x04\x19\x05READY\x0bSocket-Type\0\0\0\x03REP", 27);
+        co_await boost::asio::async_write(socket, boost::asio::buffer(readyReply), boost::asio::use_awaitable);
+
+        /* Answer requests. */
+        try {
+            while (true) {
+                std::string replies;
+                for (size_t i = 0; i < batchSize; i++) {
+                    EXPECT_EQ(std::string("\x01\x00", 2), co_await readFrame(socket));
+                    std::string request = (co_await readFrame(socket)).substr(2);
+                    requests.push_back(request);
+                    std::string reply = request.ends_with("bad") ? "-22 Invalid argument" : "0 Success";
+                    replies += std::string("\x01\x00", 2);
+                    replies += (char)0;
+                    replies += (char)reply.size();
+                    replies += reply;
+                }
+                co_await boost::asio::async_write(socket, boost::asio::buffer(replies), boost::asio::use_awaitable);
+            }
+        }
+        catch (const boost::system::system_error &) {
+            // The client disconnected.
+        }
+    }
+
+    /**
+     * The requests that have been received.
+     */
+    std::vector<std::string> requests;
+
+    /**
+     * The number of connections that have been accepted.
+     */
+    unsigned int connections = 0;
+
+private:
+    static Awaitable<std::string> read(boost::asio::local::stream_protocol::socket &socket, size_t length)
+    {
+        std::string result(length, '\0');
+        co_await boost::asio::async_read(socket, boost::asio::buffer(result), boost::asio::use_awaitable);
+        co_return result;
+    }
+
+    /**
+     * Read a short frame, including its flags and length.
+     */
+    static Awaitable<std::string> readFrame(boost::asio::local::stream_protocol::socket &socket)
+    {
+        std::string header = co_await read(socket, 2);
+        co_return header + co_await read(socket, (uint8_t)header[1]);
+    }
+
+    std::filesystem::path path;
+    boost::asio::local::stream_protocol::acceptor acceptor;
+};
+
+} // namespace
+
+/**
+ * Check that the commands are sent in order without waiting for each other's replies, and are timed.
+ */
+CORO_TEST(FfmpegZmqsend, Pipelined, ioc)
+{
+    ZmqServer server(ioc, "Pipelined");
+    spawnDetached(ioc, [&server]() { return server.serve(2); });
+
+    std::vector<Ffmpeg::ZmqCommand> commands{
+        { "vblank", "enable", "1" },
+        { "ablank", "enable", "1" }
+    };
+    std::vector<std::chrono::microseconds> latencies = co_await Ffmpeg::zmqsend(ioc, server.getAddress(), commands);
+    Ffmpeg::zmqDisconnect(server.getAddress());
+
+    EXPECT_EQ((std::vector<std::string>{ "vblank enable 1", "ablank enable 1" }), server.requests);
+    EXPECT_EQ(2, latencies.size());
+    if (latencies.size() != 2) {
+        co_return;
+    }
+    EXPECT_LE(latencies[0], latencies[1]);
+}
+
+/**
+ * Check that the connection is kept open between calls.
+ */
+CORO_TEST(FfmpegZmqsend, Persistent, ioc)
+{
+    ZmqServer server(ioc, "Persistent");
+    spawnDetached(ioc, [&server]() { return server.serve(1); });
+
+    for (std::string_view enable: std::vector<std::string_view>{ "1", "0", "1" }) {
+        std::vector<Ffmpeg::ZmqCommand> commands{ { "vblank", "enable", enable } };
+        co_await Ffmpeg::zmqsend(ioc, server.getAddress(), commands);
+    }
+    Ffmpeg::zmqDisconnect(server.getAddress());
+
+    EXPECT_EQ(1, server.connections);
+    EXPECT_EQ((std::vector<std::string>{ "vblank enable 1", "vblank enable 0", "vblank enable 1" }), server.requests);
+}
+
+/**
+ * Check that a command that fails causes an exception.
+ */
+CORO_TEST(FfmpegZmqsend, Error, ioc)
+{
+    ZmqServer server(ioc, "Error");
+    spawnDetached(ioc, [&server]() { return server.serve(1); });
+
+    std::vector<Ffmpeg::ZmqCommand> commands{ { "vblank", "enable", "bad" } };
+    EXPECT_THROW(co_await Ffmpeg::zmqsend(ioc, server.getAddress(), commands), std::runtime_error);
+    Ffmpeg::zmqDisconnect(server.getAddress());
+    EXPECT_EQ((std::vector<std::string>{ "vblank enable bad" }), server.requests);
+}
@@ -0,0 +1,136 @@
+#include "instance/handover.hpp"
+
+#include "log/MemoryLog.hpp"
+
+#include "coro_test.hpp"
+#include "log.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+/**
+ * Wait for a while.
+ */
+Awaitable<void> sleep(IOContext &ioc, std::chrono::milliseconds duration)
+{
+    boost::asio::steady_timer timer(ioc);
+    timer.expires_after(duration);
+    co_await timer.async_wait(boost::asio::use_awaitable);
+}
+
+/**
+ * Stands in for a channel, with a stub ffmpeg process and DASH resources that record what's done to them.
+ */
+struct StubChannel final
+{
+    /**
+     * Stands in for Dash::DashResources.
+     */
+    struct Dash final
+    {
+        Awaitable<bool> waitForFirstSegment(std::chrono::milliseconds timeout)
+        {
+            co_await sleep(channel.ioc, std::min(channel.warmUpTime, timeout));
+            bool ready = channel.warmUpTime <= timeout;
+            channel.events.push_back(channel.name + (ready ? " ready" : " timed out"));
+            co_return ready;
+        }
+
+        void publish()
+        {
+            channel.events.push_back(channel.name + " published");
+        }
+
+        void markSuperseded()
+        {
+            channel.events.push_back(channel.name + " superseded");
+        }
+
+        StubChannel &channel;
+    };
+
+    /**
+     * Stop the stub ffmpeg, which takes a little while, like a real one.
+     */
+    Awaitable<void> kill()
+    {
+        events.push_back(name + " stopping");
+        co_await sleep(ioc, 10ms);
+        events.push_back(name + " stopped");
+    }
+
+    IOContext &ioc;
+    std::vector<std::string> &events;
+    std::string name;
+
+    /**
+     * How long the stub ffmpeg takes to produce the first segment of every stream.
+     */
+    std::chrono::milliseconds warmUpTime;
+
+    Dash dash{ *this };
+};
+
+CORO_TEST(Handover, SwitchesBeforeStopping, ioc)
+{
+    ExpectNeverLog log(ioc);
+    Log::Context logContext = log("handover");
+    std::vector<std::string> events;
+    StubChannel oldChannel{ ioc, events, "old", 0ms };
+    StubChannel newChannel{ ioc, events, "new", 50ms };
+
+    // The old channel keeps going while the new one warms up.
+    bool ready = false;
+    bool finished = false;
+    spawnDetached(ioc, [&]() -> Awaitable<void> {
+        ready = co_await Instance::handOverChannel(logContext, oldChannel, newChannel, 1000ms);
+        finished = true;
+    });
+    co_await sleep(ioc, 25ms);
+    EXPECT_TRUE(events.empty());
+    EXPECT_FALSE(finished);
+
+    // Once it's ready, clients are moved over before the old one is stopped, and the handover waits for the old one
+    // to stop.
+    while (!finished) {
+        co_await sleep(ioc, 5ms);
+    }
+    EXPECT_TRUE(ready);
+    EXPECT_EQ((std::vector<std::string>{
+        "new ready",
+        "new published",
+        "old superseded",
+        "old stopping",
+        "old stopped"
+    }), events);
+}
+
+CORO_TEST(Handover, TimesOut, ioc)
+{
+    Log::MemoryLog log(ioc, Log::Level::fatal, false);
+    Log::Context logContext = log("handover");
+    std::vector<std::string> events;
+    StubChannel oldChannel{ ioc, events, "old", 0ms };
+    StubChannel newChannel{ ioc, events, "new", 1h };
+
+    // A new channel that never gets going is stopped once the timeout has passed, and the old one is kept.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(co_await Instance::handOverChannel(logContext, oldChannel, newChannel, 30ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 30ms);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    EXPECT_EQ((std::vector<std::string>{
+        "new timed out",
+        "new stopping",
+        "new stopped"
+    }), events);
+}
+
+} // namespace
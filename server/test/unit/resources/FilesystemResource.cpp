@@ -1,12 +1,16 @@
 #include "resources/FilesystemResource.hpp"
 
+#include "util/Event.hpp"
 #include "util/util.hpp"
 
 #include "coro_test.hpp"
 #include "data.hpp"
 #include "TestResource.hpp"
 
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 
 namespace
 {
@@ -50,6 +54,29 @@ CORO_TEST(FilesystemResource, Twice, ioc)
     }
 }
 
+CORO_TEST(FilesystemResource, Concurrent, ioc)
+{
+    auto absolutePath = getSmpteDataPath(1920, 1080, 25, 1, 48000);
+    auto relativePath = std::filesystem::relative(absolutePath, getTestDataPath());
+    std::vector<std::byte> expected = Util::readFile(absolutePath);
+
+    // Requests that miss the cache at the same time share one load of the file, and should all get it.
+    Server::FilesystemResource resource(ioc, getTestDataPath());
+    Event finished;
+    int numFinished = 0;
+    for (int i = 0; i < 4; i++) {
+        testCoSpawn([&]() -> Awaitable<void> {
+            TestRequest request(Server::Path(relativePath.string()), Server::Request::Type::get);
+            co_await testResource(resource, request, expected, "video/x-matroska");
+            numFinished++;
+            finished.notifyAll();
+        }, ioc);
+    }
+    while (numFinished < 4) {
+        co_await finished.wait();
+    }
+}
+
 CORO_TEST(FilesystemResource, Write, ioc)
 {
     /* Get somewhere to put the test filesystem resource. */
@@ -71,9 +98,11 @@ CORO_TEST(FilesystemResource, Write, ioc)
         co_await testResource(resource, request);
     }
 
-    /* Check the write. */
+    /* Check the write, and that the temporary file it was written to has gone. */
     EXPECT_TRUE(std::filesystem::exists(basePath / relativePath));
     EXPECT_EQ(refData, Util::readFile(basePath / relativePath));
+    EXPECT_EQ(1, std::distance(std::filesystem::directory_iterator(basePath / relativePath.parent_path()),
+                               std::filesystem::directory_iterator()));
 
     /*  Read the file. */
     {
@@ -113,4 +142,98 @@ CORO_TEST(FilesystemResource, BadWrite, ioc)
     std::filesystem::remove_all(basePath);
 }
 
+CORO_TEST(FilesystemResource, Changed, ioc)
+{
+    /* Get somewhere to put the test filesystem resource. */
+    std::filesystem::path basePath =
+        std::filesystem::temp_directory_path() / "live-video-streamer-server_test.FilesystemResourceChangedTest";
+    std::filesystem::remove_all(basePath);
+    std::filesystem::create_directory(basePath);
+    std::filesystem::path filePath = basePath / "test.json";
+
+    /* Read the file, so it's cached. */
+    Server::FilesystemResource resource(ioc, basePath);
+    std::ofstream(filePath) << "[1]";
+    {
+        TestRequest request("test.json", Server::Request::Type::get);
+        co_await testResource(resource, request, "[1]", "application/json");
+    }
+
+    /* Change the file without changing its size, and check that the new version is read. */
+    std::ofstream(filePath) << "[2]";
+    std::filesystem::last_write_time(filePath, std::filesystem::last_write_time(filePath) + std::chrono::seconds(1));
+    {
+        TestRequest request("test.json", Server::Request::Type::get);
+        co_await testResource(resource, request, "[2]", "application/json");
+    }
+
+    /* Clean up :) */
+    std::filesystem::remove_all(basePath);
+}
+
+CORO_TEST(FilesystemResource, NotModified, ioc)
+{
+    /* Get somewhere to put the test filesystem resource. */
+    std::filesystem::path basePath =
+        std::filesystem::temp_directory_path() / "live-video-streamer-server_test.FilesystemResourceNotModifiedTest";
+    std::filesystem::remove_all(basePath);
+    std::filesystem::create_directory(basePath);
+
+    /* Make a file with a known modification time: 2001-02-03 04:05:06 UTC. */
+    std::filesystem::path filePath = basePath / "test.json";
+    std::ofstream(filePath) << "[1]";
+    std::filesystem::last_write_time(filePath, std::chrono::file_clock::from_sys(
+        std::chrono::sys_days(std::chrono::year(2001) / 2 / 3) + std::chrono::hours(4) + std::chrono::minutes(5) +
+        std::chrono::seconds(6)));
+
+    /* The thing to test. */
+    Server::FilesystemResource resource(ioc, basePath);
+
+    /* Check the different ways the client can say what it has. */
+    {
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "Sat, 03 Feb 2001 04:05:06 GMT");
+        co_await testResourceNotModified(resource, request, "application/json");
+    }
+    {
+        // A later date, in the obsolete RFC 850 format.
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "Sunday, 04-Feb-01 00:00:00 GMT");
+        co_await testResourceNotModified(resource, request, "application/json");
+    }
+    {
+        // A later date, in asctime format.
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "Sat Feb  3 04:05:07 2001");
+        co_await testResourceNotModified(resource, request, "application/json");
+    }
+    {
+        // An earlier date.
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "Sat, 03 Feb 2001 04:05:05 GMT");
+        co_await testResource(resource, request, "[1]", "application/json");
+    }
+    {
+        // Not a date.
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "yesterday");
+        co_await testResource(resource, request, "[1]", "application/json");
+    }
+    {
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_none_match, "\"nope\", *");
+        co_await testResourceNotModified(resource, request, "application/json");
+    }
+    {
+        // If-None-Match takes precedence.
+        TestRequest request("test.json", Server::Request::Type::get);
+        request.setHeader(boost::beast::http::field::if_modified_since, "Sat, 03 Feb 2001 04:05:06 GMT");
+        request.setHeader(boost::beast::http::field::if_none_match, "\"nope\"");
+        co_await testResource(resource, request, "[1]", "application/json");
+    }
+
+    /* Clean up :) */
+    std::filesystem::remove_all(basePath);
+}
+
 } // namespace
@@ -1,11 +1,57 @@
 #include "resources/StreamAndHeadResource.hpp"
 
+#include "server/Response.hpp"
+#include "util/Event.hpp"
+
 #include "coro_test.hpp"
 #include "TestResource.hpp"
 
+#include <string>
+
 namespace
 {
 
+/**
+ * A response whose client doesn't read anything until it's released.
+ */
+class StalledResponse final : public Server::Response
+{
+public:
+    StalledResponse() = default;
+
+    /**
+     * Let the client read what it's been sent.
+     */
+    void release()
+    {
+        released = true;
+        event.notifyAll();
+    }
+
+    /**
+     * What's been written to the response.
+     */
+    std::string data;
+
+private:
+    void writeBody(std::span<const Util::SharedBuffer> parts) override
+    {
+        for (const Util::SharedBuffer &part: parts) {
+            data.append((const char *)part.data(), part.size());
+        }
+    }
+
+    Awaitable<void> flushBody(bool) override
+    {
+        while (!released) {
+            co_await event.wait();
+        }
+    }
+
+    Event event;
+    bool released = false;
+};
+
 /* Check the basic functionality, */
 CORO_TEST(StreamAndHeadResource, Simple, ioc)
 {
@@ -186,4 +232,116 @@ CORO_TEST(StreamAndHeadResource, DoubleGet, ioc)
     }
 }
 
+/**
+ * The sync marker for the joinable stream tests.
+ */
+std::vector<std::byte> getSyncMarker()
+{
+    const std::string_view marker = "SYNC";
+    return { (const std::byte *)marker.data(), (const std::byte *)marker.data() + marker.size() };
+}
+
+/* Check that a joinable stream discards what's received with nothing getting it, apart from the prologue. */
+CORO_TEST(StreamAndHeadResource, JoinablePrologue, ioc)
+{
+    Server::StreamAndHeadResource resource(ioc, "stream", 1 << 20, {}, 0, {}, getSyncMarker());
+
+    // The sync markers are split between parts, to check that they're still found.
+    const std::string_view string = "Electrons SYNCare SYNCfundamental";
+    const std::span<const std::byte> data((const std::byte *)string.data(), string.size());
+    const std::span<const std::byte> parts[] = {
+        data.subspan(0, 12),
+        data.subspan(12, 8),
+        data.subspan(20)
+    };
+
+    {
+        TestRequest request("stream", Server::Request::Type::put, parts);
+        co_await testResource(resource, request, std::span<const std::span<const std::byte>>{}, {},
+                              Server::CacheKind::none);
+    }
+    {
+        TestRequest request("stream");
+        co_await testResource(resource, request, "Electrons ", {}, Server::CacheKind::none);
+    }
+}
+
+/* Check that a joinable stream can be joined more than once. */
+CORO_TEST(StreamAndHeadResource, JoinableDoubleGet, ioc)
+{
+    Server::StreamAndHeadResource resource(ioc, "stream", 1 << 20, {}, 0, {}, getSyncMarker());
+
+    {
+        TestRequest request("stream", Server::Request::Type::put, "Electrons SYNCare SYNCfundamental");
+        co_await testResource(resource, request, std::span<const std::span<const std::byte>>{}, {},
+                              Server::CacheKind::none);
+    }
+    {
+        TestRequest request("stream");
+        co_await testResource(resource, request, "Electrons ", {}, Server::CacheKind::none);
+    }
+    {
+        TestRequest request("stream");
+        co_await testResource(resource, request, "Electrons ", {}, Server::CacheKind::none);
+    }
+}
+
+/* Check that a joinable stream whose client isn't reading doesn't hold up the sender, which might be feeding other
+   streams, and that it picks up again at a sync marker. */
+CORO_TEST(StreamAndHeadResource, JoinableStalledGet, ioc)
+{
+    Server::StreamAndHeadResource slow(ioc, "stream", 16, {}, 0, {}, getSyncMarker());
+    Server::StreamAndHeadResource fast(ioc, "stream", 1 << 20, {}, 0, {}, getSyncMarker());
+    Event finished;
+    int numFinished = 0;
+
+    const std::string_view string = "HEADSYNC0123456789SYNCabcdefghijSYNCklmn";
+    const std::span<const std::byte> data((const std::byte *)string.data(), string.size());
+    const std::span<const std::byte> parts[] = {
+        data.subspan(0, 8),
+        data.subspan(8, 8),
+        data.subspan(16, 8),
+        data.subspan(24, 8),
+        data.subspan(32)
+    };
+
+    // One client never reads, and the other reads everything.
+    StalledResponse slowResponse;
+    testCoSpawn([&]() -> Awaitable<void> {
+        TestRequest request("stream");
+        co_await slow(slowResponse, request);
+        numFinished++;
+        finished.notifyAll();
+    }, ioc);
+    testCoSpawn([&]() -> Awaitable<void> {
+        TestRequest request("stream");
+        co_await testResource(fast, request, string, {}, Server::CacheKind::none);
+        numFinished++;
+        finished.notifyAll();
+    }, ioc);
+
+    // Something that sends to both streams in turn, like a decoder that's feeding several encoders. It would never
+    // get to the second stream if the first one held it back.
+    testCoSpawn([&]() -> Awaitable<void> {
+        for (Server::StreamAndHeadResource *resource: { &slow, &fast }) {
+            TestRequest request("stream", Server::Request::Type::put, parts);
+            co_await testResource(*resource, request, std::span<const std::span<const std::byte>>{}, {},
+                                  Server::CacheKind::none);
+        }
+        numFinished++;
+        finished.notifyAll();
+    }, ioc);
+    while (numFinished < 2) {
+        co_await finished.wait();
+    }
+
+    // The stalled client gets what fitted in the buffer. What came after it was dropped, including the last sync
+    // marker, since the buffer hadn't emptied by then.
+    slowResponse.release();
+    while (numFinished < 3) {
+        co_await finished.wait();
+    }
+    EXPECT_EQ("HEADSYNC01234567", slowResponse.data);
+}
+
 } // namespace
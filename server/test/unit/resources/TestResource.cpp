@@ -2,6 +2,7 @@
 
 #include "server/Resource.hpp"
 #include "server/Response.hpp"
+#include "util/util.hpp"
 
 #include <gtest/gtest.h>
 
@@ -73,9 +74,10 @@ public:
      * @param mimeType The expected MIME type.
      * @param cacheKind The expected cache.
      * @param errorKind The expected error kind.
+     * @param notModified Whether the response should say that the client already has the content.
      */
     void check(bool checkChunks, std::span<const std::span<const std::byte>> data, std::string_view mimeType,
-               Server::CacheKind cacheKind, std::optional<Server::ErrorKind> errorKind) const
+               Server::CacheKind cacheKind, std::optional<Server::ErrorKind> errorKind, bool notModified) const
     {
         std::vector<std::byte> accumulatedRef;
         for (const auto &chunk: data) {
@@ -89,6 +91,7 @@ public:
         EXPECT_EQ(cacheKind, getCacheKind()) << "Reference cache kind: " << cacheKindToString(cacheKind)
                                              << ", actual cache kind: " << cacheKindToString(getCacheKind());
         EXPECT_EQ(mimeType, getMimeType());
+        EXPECT_EQ(notModified, getNotModified());
         EXPECT_EQ(accumulatedRef.size(), accumulatedData.size()); // Easier to read than the next one.
 
         if (isText(accumulatedRef)) {
@@ -109,12 +112,13 @@ public:
     }
 
 private:
-    void writeBody(std::vector<std::byte> data) override
+    void writeBody(std::span<const Util::SharedBuffer> data) override
     {
         EXPECT_FALSE(ended);
         EXPECT_EQ(writeStarted, getWriteStarted());
-        accumulatedData.insert(accumulatedData.end(), data.begin(), data.end());
-        chunkedData.emplace_back(std::move(data));
+        std::vector<std::byte> chunk = Util::concatenate(data);
+        accumulatedData.insert(accumulatedData.end(), chunk.begin(), chunk.end());
+        chunkedData.emplace_back(std::move(chunk));
         writeStarted = true;
     }
 
@@ -135,7 +139,8 @@ private:
 
 Awaitable<void> testResourceImpl(Server::Resource &resource, TestRequest &request, bool checkChunks,
                                  std::span<const std::span<const std::byte>> result, std::string_view mimeType,
-                                 Server::CacheKind cacheKind, std::optional<Server::ErrorKind> errorKind)
+                                 Server::CacheKind cacheKind, std::optional<Server::ErrorKind> errorKind,
+                                 bool notModified = false)
 {
     /* Check that the test is valid. */
     assert(request.getPath().empty() || resource.getAllowNonEmptyPath());
@@ -164,7 +169,7 @@ Awaitable<void> testResourceImpl(Server::Resource &resource, TestRequest &reques
     }
 
     /* Check the result. */
-    response.check(checkChunks, result, mimeType, cacheKind, errorKind);
+    response.check(checkChunks, result, mimeType, cacheKind, errorKind, notModified);
 }
 
 } // namespace
@@ -180,9 +185,15 @@ TestRequest::TestRequest(Server::Path path, Type type, std::span<const std::span
     this->setMaxLength(acc);
 }
 
-Awaitable<std::vector<std::byte>> TestRequest::doReadSome()
+std::string_view TestRequest::getHeader(boost::beast::http::field field) const
 {
-    std::vector<std::byte> result;
+    auto it = headers.find(field);
+    return (it == headers.end()) ? std::string_view{} : std::string_view(it->second);
+}
+
+Awaitable<Util::SharedBuffer> TestRequest::doReadSome()
+{
+    Util::SharedBuffer result;
     if (dataReadIndex < data.size()) {
         result = std::move(data[dataReadIndex++]);
     }
@@ -209,3 +220,9 @@ Awaitable<void> testResource(Server::Resource &resource, TestRequest &request, s
 {
     co_return co_await testResourceImpl(resource, request, false, {{result}}, mimeType, cacheKind, errorKind);
 }
+
+Awaitable<void> testResourceNotModified(Server::Resource &resource, TestRequest &request, std::string_view mimeType,
+                                        Server::CacheKind cacheKind)
+{
+    co_return co_await testResourceImpl(resource, request, false, {}, mimeType, cacheKind, {}, true);
+}
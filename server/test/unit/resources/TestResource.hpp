@@ -6,7 +6,10 @@
 
 #include "util/asio.hpp"
 
+#include <map>
+#include <optional>
 #include <span>
+#include <string>
 
 namespace Server
 {
@@ -63,9 +66,19 @@ public:
     {
     }
 
-    Awaitable<std::vector<std::byte>> doReadSome() override;
+    /**
+     * Set a header for the resource to see.
+     */
+    void setHeader(boost::beast::http::field field, std::string value)
+    {
+        headers[field] = std::move(value);
+    }
+
+    std::string_view getHeader(boost::beast::http::field field) const override;
+    Awaitable<Util::SharedBuffer> doReadSome() override;
 
 private:
+    std::map<boost::beast::http::field, std::string> headers;
     std::vector<std::vector<std::byte>> data;
     size_t dataReadIndex = 0;
     bool fullyRead = false;
@@ -130,6 +143,19 @@ inline Awaitable<void> testResource(Server::Resource &resource,
     return testResource(resource, request, std::span<const std::byte>{}, {}, cacheKind, errorKind);
 }
 
+/**
+ * Check that the response to a request of a resource is that the client already has the current content.
+ *
+ * @param resource The resource to make a request of.
+ * @param request The request to pass ot the resource.
+ * @param mimeType The expected MIME type.
+ * @param cacheKind The expected cache kind.
+ */
+Awaitable<void> testResourceNotModified(Server::Resource &resource,
+                                        TestRequest &request,
+                                        std::string_view mimeType = {},
+                                        Server::CacheKind cacheKind = Server::CacheKind::fixed);
+
 /**
  * Check that the response to a request of a resource is a given error.
  *
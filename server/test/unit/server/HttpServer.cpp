@@ -361,6 +361,43 @@ CORO_TEST(HttpServer, ShortChunk, ioc)
               checkAndFilterDateHeader(co_await socket.readAllAsString()));
 }
 
+CORO_TEST(HttpServer, File, ioc)
+{
+    Socket socket(ioc);
+    co_await socket.write("GET /File HTTP/1.0\r\n"
+                          "\r\n");
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Server: Spectral Compute Ultra Low Latency Video Streamer\r\n"
+              "Cache-Control: public, max-age=600\r\n"
+              "Access-Control-Allow-Origin: *\r\n"
+              "Content-Length: 16\r\n"
+              "\r\n"
+              "Cats are cute :D",
+              checkAndFilterDateHeader(co_await socket.readAllAsString()));
+}
+
+CORO_TEST(HttpServer, FileChunk, ioc)
+{
+    Socket socket(ioc);
+    co_await socket.write("GET /FileChunk HTTP/1.0\r\n"
+                          "\r\n");
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Server: Spectral Compute Ultra Low Latency Video Streamer\r\n"
+              "Cache-Control: public, max-age=600\r\n"
+              "Access-Control-Allow-Origin: *\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "\r\n"
+              "4\r\n"
+              "Cats\r\n"
+              "c\r\n"
+              " are cute :D\r\n"
+              "0\r\n"
+              "\r\n",
+              checkAndFilterDateHeader(co_await socket.readAllAsString()));
+}
+
 CORO_TEST(HttpServer, ShortKeepAlive, ioc)
 {
     Socket socket(ioc);
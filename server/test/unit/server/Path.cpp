@@ -183,4 +183,64 @@ TEST(Path, OperatorDivideString)
     EXPECT_EQ(4, c.size());
 }
 
+TEST(Path, OperatorDividePopped)
+{
+    Server::Path a("alpha/beta");
+    Server::Path b("gamma/delta");
+    a.pop_front();
+    b.pop_front();
+    Server::Path c = a / b;
+    EXPECT_EQ("beta/delta", c.view());
+    ASSERT_EQ(2, c.size());
+    EXPECT_EQ("beta", c[0]);
+    EXPECT_EQ("delta", c[1]);
+}
+
+TEST(Path, View)
+{
+    Server::Path path("/alpha//./beta/gamma/");
+    EXPECT_EQ("alpha/beta/gamma", path.view());
+    path.pop_front();
+    EXPECT_EQ("beta/gamma", path.view());
+    EXPECT_EQ(Server::Path("beta/gamma"), path);
+    path.pop_front();
+    path.pop_front();
+    EXPECT_EQ("", path.view());
+    EXPECT_EQ(Server::Path(), path);
+}
+
+TEST(Path, Ordering)
+{
+    // '/' sorts after '-', but a shorter part sorts first.
+    EXPECT_LT(Server::Path("a/b"), Server::Path("a-b"));
+    EXPECT_LT(Server::Path("a"), Server::Path("a/b"));
+    EXPECT_LT(Server::Path("a/b"), Server::Path("a/c"));
+    EXPECT_GT(Server::Path("b"), Server::Path("a/z"));
+    EXPECT_EQ(std::strong_ordering::equal, Server::Path("a/b") <=> Server::Path("/a//b/"));
+}
+
+TEST(Path, Long)
+{
+    // More parts and characters than are stored inline.
+    std::string pathStr;
+    for (int i = 0; i < 100; i++) {
+        pathStr += "/part" + std::to_string(i);
+    }
+    Server::Path path(pathStr);
+    ASSERT_EQ(100, path.size());
+    EXPECT_EQ("part0", path.front());
+    EXPECT_EQ("part57", path[57]);
+    EXPECT_EQ("part99", path.back());
+    EXPECT_EQ(pathStr.substr(1), (std::string)path);
+}
+
+TEST(Path, Move)
+{
+    Server::Path a("alpha/beta");
+    a.pop_front();
+    Server::Path b = std::move(a);
+    EXPECT_EQ("beta", *b);
+    EXPECT_TRUE(a.empty()); // NOLINT(bugprone-use-after-move)
+}
+
 } // namespace
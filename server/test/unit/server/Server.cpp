@@ -20,6 +20,29 @@ SERVER_TEST(Server, NotFoundEphemeral, server)
     co_await server("alpha/beta", Server::ErrorKind::NotFound, Server::CacheKind::ephemeral);
 }
 
+SERVER_TEST(Server, NotFoundEphemeralRange, server)
+{
+    server.setEphemeralWhenNotFoundRange("alpha", "segment-", 5, 8);
+    co_await server("alpha/segment-4", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+    co_await server("alpha/segment-005", Server::ErrorKind::NotFound, Server::CacheKind::ephemeral);
+    co_await server("alpha/segment-7", Server::ErrorKind::NotFound, Server::CacheKind::ephemeral);
+    co_await server("alpha/segment-8", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+    co_await server("alpha/segment-", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+    co_await server("beta/segment-5", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+
+    // Paths in the range that exist are found as normal.
+    server.addResource("alpha/segment-6");
+    co_await server("alpha/segment-6", 0);
+
+    // Setting the range again replaces it.
+    server.setEphemeralWhenNotFoundRange("alpha", "segment-", 8, 9);
+    co_await server("alpha/segment-7", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+    co_await server("alpha/segment-8", Server::ErrorKind::NotFound, Server::CacheKind::ephemeral);
+
+    server.removeEphemeralWhenNotFoundRange("alpha", "segment-");
+    co_await server("alpha/segment-8", Server::ErrorKind::NotFound, Server::CacheKind::fixed);
+}
+
 SERVER_TEST(Server, Error, server)
 {
     server.addResource("alpha/beta", nullptr);
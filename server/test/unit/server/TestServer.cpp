@@ -4,6 +4,7 @@
 #include "server/SynchronousResource.hpp"
 
 #include "util/asio.hpp"
+#include "util/util.hpp"
 
 #include <gtest/gtest.h>
 
@@ -225,9 +226,9 @@ public:
     ~ServerTestRequest() override = default;
     using Request::Request;
 
-    Awaitable<std::vector<std::byte>> doReadSome() override
+    Awaitable<Util::SharedBuffer> doReadSome() override
     {
-        co_return std::vector<std::byte>{};
+        co_return Util::SharedBuffer{};
     }
 };
 
@@ -264,12 +265,12 @@ private:
     /**
      * Decode a record.
      */
-    void writeBody(std::vector<std::byte> data) override
+    void writeBody(std::span<const Util::SharedBuffer> data) override
     {
         EXPECT_FALSE(ended);
         EXPECT_FALSE(written);
         EXPECT_FALSE(getWriteStarted());
-        record = ServerTestRecord(std::move(data));
+        record = ServerTestRecord(Util::concatenate(data));
         if (record.getType() == ServerTestRecord::defaultType) {
             ADD_FAILURE() << "Default record type was received as response body.";
         }
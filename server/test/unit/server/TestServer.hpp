@@ -21,6 +21,8 @@ public:
     using Server::removeResource;
     using Server::removeResourceTree;
     using Server::addEphemeralWhenNotFound;
+    using Server::setEphemeralWhenNotFoundRange;
+    using Server::removeEphemeralWhenNotFoundRange;
 
     /**
      * Add a resource with a given set of permissions and capabilities.
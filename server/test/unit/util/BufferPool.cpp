@@ -0,0 +1,88 @@
+#include "util/BufferPool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+TEST(BufferPool, Capacity)
+{
+    EXPECT_EQ(Util::BufferPool::minBlockSize, Util::BufferPool::getCapacity(1));
+    EXPECT_EQ(1 << 16, Util::BufferPool::getCapacity(1 << 16));
+    EXPECT_EQ(1 << 17, Util::BufferPool::getCapacity((1 << 16) + 1));
+    EXPECT_EQ(Util::BufferPool::maxBlockSize + 1, Util::BufferPool::getCapacity(Util::BufferPool::maxBlockSize + 1));
+}
+
+TEST(BufferPool, ReusesReleasedBlocks)
+{
+    Util::BufferPool pool;
+
+    // A released block goes back to the pool, and is handed out again for the same size.
+    Util::BufferPool::Block block = pool.allocate(1 << 16);
+    std::byte *data = block.get();
+    std::shared_ptr<const void> sharer = block; // Something that kept part of the data, e.g: a SharedBuffer.
+    block.reset();
+    EXPECT_EQ(0, pool.getFreeCount());
+    sharer.reset();
+    EXPECT_EQ(1, pool.getFreeCount());
+
+    block = pool.allocate(40000);
+    EXPECT_EQ(data, block.get());
+    EXPECT_EQ(0, pool.getFreeCount());
+
+    // Other sizes have their own blocks.
+    Util::BufferPool::Block other = pool.allocate(100);
+    EXPECT_NE(data, other.get());
+    other.reset();
+    block.reset();
+    EXPECT_EQ(2, pool.getFreeCount());
+}
+
+TEST(BufferPool, LimitsFreeBlocks)
+{
+    Util::BufferPool pool(3 << 16);
+    std::vector<Util::BufferPool::Block> blocks;
+    for (int i = 0; i < 8; i++) {
+        blocks.emplace_back(pool.allocate(1 << 16));
+    }
+    blocks.clear();
+
+    // Each block takes a little more than 64 KiB, because of the shared pointer's control block.
+    EXPECT_EQ(2, pool.getFreeCount());
+}
+
+TEST(BufferPool, BigBlocksAreNotPooled)
+{
+    Util::BufferPool pool;
+    Util::BufferPool::Block block = pool.allocate(Util::BufferPool::maxBlockSize * 2);
+    block.get()[Util::BufferPool::maxBlockSize * 2 - 1] = std::byte(1);
+    block.reset();
+    EXPECT_EQ(0, pool.getFreeCount());
+}
+
+TEST(BufferPool, ReleaseFromOtherThreads)
+{
+    constexpr int numThreads = 4;
+    constexpr int numBlocks = 1000;
+    Util::BufferPool pool;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&pool]() {
+            for (int j = 0; j < numBlocks; j++) {
+                Util::BufferPool::Block block = pool.allocate(1 << 12);
+                block[0] = std::byte(j);
+                std::thread([block = std::move(block)]() {}).join();
+            }
+        });
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    EXPECT_GE(numThreads, pool.getFreeCount());
+    EXPECT_LE(1, pool.getFreeCount());
+}
+
+} // namespace
@@ -4,13 +4,19 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace
 {
 
 TEST(Event, WaitNotify)
 {
     IOContext ioc;
-    Event event(ioc);
+    Event event;
     bool fired = false;
 
     // The wait happens first (this relies on boost::asio::co_spawn forming an in-order queue), so the notifyAll should
@@ -31,7 +37,7 @@ TEST(Event, WaitNotify)
 TEST(Event, WaitOnly)
 {
     IOContext ioc;
-    Event event(ioc);
+    Event event;
     bool fired = false;
 
     testCoSpawn([&event, &fired]() -> Awaitable<void> {
@@ -46,7 +52,7 @@ TEST(Event, WaitOnly)
 TEST(Event, NotifyWait)
 {
     IOContext ioc;
-    Event event(ioc);
+    Event event;
     bool fired = false;
 
     // The notifyAll happens first (this relies on boost::asio::co_spawn forming an in-order queue), so the wait should
@@ -64,4 +70,125 @@ TEST(Event, NotifyWait)
     EXPECT_FALSE(fired);
 }
 
+TEST(Event, NotifyOneInOrder)
+{
+    IOContext ioc;
+    Event event;
+    std::vector<int> woken;
+
+    for (int i = 0; i < 3; i++) {
+        testCoSpawn([&event, &woken, i]() -> Awaitable<void> {
+            co_await event.wait();
+            woken.push_back(i);
+        }, ioc);
+    }
+    ioc.poll();
+
+    // Each notifyOne should wake exactly one waiter, oldest first.
+    EXPECT_TRUE(event.notifyOne());
+    ioc.poll();
+    EXPECT_EQ(std::vector<int>({ 0 }), woken);
+
+    EXPECT_TRUE(event.notifyOne());
+    EXPECT_TRUE(event.notifyOne());
+    EXPECT_FALSE(event.notifyOne());
+    ioc.poll();
+    EXPECT_EQ(std::vector<int>({ 0, 1, 2 }), woken);
+}
+
+TEST(Event, DestroyWakes)
+{
+    IOContext ioc;
+    auto event = std::make_unique<Event>();
+    bool fired = false;
+
+    testCoSpawn([&event, &fired]() -> Awaitable<void> {
+        co_await event->wait();
+        fired = true;
+    }, ioc);
+    ioc.poll();
+
+    // Whatever is still waiting when the event goes is woken, rather than left suspended.
+    event.reset();
+    ioc.poll();
+    EXPECT_TRUE(fired);
+}
+
+TEST(Event, DestroyAfterNotify)
+{
+    IOContext ioc;
+    auto event = std::make_unique<Event>();
+    bool fired = false;
+
+    testCoSpawn([&event, &fired]() -> Awaitable<void> {
+        co_await event->wait();
+        fired = true;
+    }, ioc);
+    ioc.poll();
+
+    // The event is gone by the time the notified waiter resumes, which mustn't touch it.
+    event->notifyAll();
+    event.reset();
+    ioc.poll();
+    EXPECT_TRUE(fired);
+}
+
+TEST(Event, Move)
+{
+    IOContext ioc;
+    Event event;
+    bool fired = false;
+
+    testCoSpawn([&event, &fired]() -> Awaitable<void> {
+        co_await event.wait();
+        fired = true;
+    }, ioc);
+    ioc.poll();
+
+    // The waiter moves with the event, and the moved-from event is still usable.
+    Event moved(std::move(event));
+    event.notifyAll();
+    ioc.poll();
+    EXPECT_FALSE(fired);
+
+    moved.notifyAll();
+    ioc.poll();
+    EXPECT_TRUE(fired);
+}
+
+TEST(Event, CrossThread)
+{
+    constexpr int count = 10000;
+    IOContext ioc;
+    IOContext workerIoc;
+    Event event;
+    std::mutex mutex;
+    int produced = 0;
+    int consumed = 0;
+
+    // The consumer runs in its own thread's IO context, and the producer notifies from this thread. A lost wakeup would
+    // leave the consumer waiting until the timeout.
+    testCoSpawn([&]() -> Awaitable<void> {
+        std::unique_lock lock(mutex);
+        while (consumed < count) {
+            while (consumed == produced) {
+                co_await event.wait(lock);
+            }
+            consumed = produced;
+        }
+    }, workerIoc);
+    std::thread worker([&workerIoc]() { workerIoc.run_for(std::chrono::seconds(10)); });
+
+    for (int i = 0; i < count; i++) {
+        {
+            std::lock_guard lock(mutex);
+            produced++;
+        }
+        event.notifyAll();
+    }
+
+    worker.join();
+    EXPECT_EQ(count, consumed);
+}
+
 } // namespace
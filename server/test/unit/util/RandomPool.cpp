@@ -0,0 +1,55 @@
+#include "util/RandomPool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+namespace
+{
+
+TEST(RandomPool, FillRandomContinuesSequence)
+{
+    // Generating in two parts should give the same result as generating all at once.
+    uint64_t seedA = 1234;
+    std::vector<std::byte> a(64);
+    Util::fillRandom(a, seedA);
+
+    uint64_t seedB = 1234;
+    std::vector<std::byte> b(64);
+    Util::fillRandom(std::span(b).first(24), seedB);
+    Util::fillRandom(std::span(b).subspan(24), seedB);
+
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(seedA, seedB);
+    EXPECT_NE(std::vector<std::byte>(64), a);
+}
+
+TEST(RandomPool, Sizes)
+{
+    Util::RandomPool pool(1000);
+
+    // Enough requests to use up several blocks.
+    for (size_t i = 0; i < 100; i++) {
+        EXPECT_EQ(300, pool.get(300).size());
+    }
+
+    // Requests that are larger than a block.
+    Util::SharedBuffer big = pool.get(5000);
+    EXPECT_EQ(5000, big.size());
+    EXPECT_NE(nullptr, big.data());
+}
+
+TEST(RandomPool, NoRepeats)
+{
+    Util::RandomPool pool(64);
+
+    // Use blocks up faster than the background thread can replace them. No slice should be handed out twice.
+    std::set<std::vector<std::byte>> slices;
+    for (size_t i = 0; i < 1000; i++) {
+        Util::SharedBuffer slice = pool.get(48);
+        EXPECT_TRUE(slices.emplace(slice.begin(), slice.end()).second) << i;
+    }
+}
+
+} // namespace
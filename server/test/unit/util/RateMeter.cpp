@@ -0,0 +1,45 @@
+#include "util/RateMeter.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+TEST(RateMeter, Empty)
+{
+    Util::RateMeter meter(1000ms, 10);
+    EXPECT_EQ(0, meter.getAmountInWindow(std::chrono::steady_clock::time_point(10s)));
+}
+
+TEST(RateMeter, SumsWithinWindow)
+{
+    std::chrono::steady_clock::time_point start(10s);
+    Util::RateMeter meter(1000ms, 10);
+    meter.add(100, start);
+    meter.add(20, start + 50ms);
+    meter.add(3, start + 450ms);
+    EXPECT_EQ(123, meter.getAmountInWindow(start + 450ms));
+    EXPECT_DOUBLE_EQ(123.0, meter.getRate(start + 450ms));
+}
+
+TEST(RateMeter, Expires)
+{
+    std::chrono::steady_clock::time_point start(10s);
+    Util::RateMeter meter(1000ms, 10);
+    meter.add(100, start);
+    meter.add(20, start + 500ms);
+
+    // The first bucket has left the window, but the second hasn't.
+    EXPECT_EQ(20, meter.getAmountInWindow(start + 1000ms));
+
+    // Everything has left the window.
+    EXPECT_EQ(0, meter.getAmountInWindow(start + 1500ms));
+
+    // Gaps longer than the window are handled.
+    meter.add(7, start + 1h);
+    EXPECT_EQ(7, meter.getAmountInWindow(start + 1h + 10ms));
+}
+
+} // namespace
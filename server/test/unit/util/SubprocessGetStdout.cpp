@@ -91,7 +91,7 @@ TEST(SubprocessGetStdout, SpawnTwice)
 CORO_TEST(SubprocessGetStdout, SpawnFromCoro, ioc)
 {
     /* Make it possible for this coroutine to tell when its detached child coroutine finishes. */
-    Event event(ioc);
+    Event event;
     int finished = 0;
 
     /* Spawn a detached coroutine to run a subprocess. */
@@ -115,7 +115,7 @@ CORO_TEST(SubprocessGetStdout, SpawnFromCoro, ioc)
 CORO_TEST(SubprocessGetStdout, SpawnTwiceFromCoro, ioc)
 {
     /* Make it possible for this coroutine to tell when its detached child coroutines finish. */
-    Event event(ioc);
+    Event event;
     int finished = 0;
 
     /* Spawn a detached coroutine to run subprocesses. */
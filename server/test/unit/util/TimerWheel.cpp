@@ -0,0 +1,110 @@
+#include "util/TimerWheel.hpp"
+
+#include "util/asio.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+TEST(TimerWheel, RunsInDeadlineOrder)
+{
+    IOContext ioc;
+    Util::TimerWheel wheel(ioc, 1ms);
+    std::vector<int> fired;
+
+    Util::TimerWheel::Timer late(wheel);
+    Util::TimerWheel::Timer early(wheel);
+    late.expiresAfter(30ms, [&fired]() { fired.push_back(2); });
+    early.expiresAfter(10ms, [&fired]() { fired.push_back(1); });
+    EXPECT_EQ(2, wheel.size());
+
+    ioc.run_for(100ms);
+    EXPECT_EQ(std::vector<int>({ 1, 2 }), fired);
+    EXPECT_EQ(0, wheel.size());
+    EXPECT_FALSE(early.getIsScheduled());
+}
+
+TEST(TimerWheel, NeverEarly)
+{
+    IOContext ioc;
+    Util::TimerWheel wheel(ioc, 5ms);
+    Util::TimerWheel::Clock::time_point deadline = Util::TimerWheel::Clock::now() + 12ms;
+    Util::TimerWheel::Clock::time_point firedAt;
+
+    Util::TimerWheel::Timer timer(wheel);
+    timer.expiresAt(deadline, [&firedAt]() { firedAt = Util::TimerWheel::Clock::now(); });
+    ioc.run_for(100ms);
+    EXPECT_GE(firedAt, deadline);
+}
+
+TEST(TimerWheel, CancelAndReschedule)
+{
+    IOContext ioc;
+    Util::TimerWheel wheel(ioc, 1ms);
+    int fired = 0;
+
+    // Cancelling stops the callback from running, and destroying a timer cancels it.
+    Util::TimerWheel::Timer cancelled(wheel);
+    cancelled.expiresAfter(5ms, [&fired]() { fired += 100; });
+    cancelled.cancel();
+    {
+        Util::TimerWheel::Timer destroyed(wheel);
+        destroyed.expiresAfter(5ms, [&fired]() { fired += 100; });
+    }
+
+    // Rescheduling replaces the earlier schedule.
+    Util::TimerWheel::Timer rescheduled(wheel);
+    rescheduled.expiresAfter(5ms, [&fired]() { fired += 10; });
+    rescheduled.expiresAfter(10ms, [&fired]() { fired += 1; });
+
+    ioc.run_for(50ms);
+    EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheel, LongDelaysMoveDownLevels)
+{
+    IOContext ioc;
+    Util::TimerWheel wheel(ioc, 100us);
+    int fired = 0;
+
+    // At this resolution, this is beyond the bottom two levels of the wheel.
+    Util::TimerWheel::Timer timer(wheel);
+    timer.expiresAfter(500ms, [&fired]() { fired++; });
+    ioc.run_for(400ms);
+    EXPECT_EQ(0, fired);
+    ioc.restart();
+    ioc.run_for(400ms);
+    EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheel, CallbackCanDestroyTimers)
+{
+    IOContext ioc;
+    Util::TimerWheel wheel(ioc, 1ms);
+    auto a = std::make_unique<Util::TimerWheel::Timer>(wheel);
+    auto b = std::make_unique<Util::TimerWheel::Timer>(wheel);
+    int fired = 0;
+
+    // Both are due in the same tick. Whichever runs first destroys both.
+    a->expiresAfter(5ms, [&]() { fired++; a.reset(); b.reset(); });
+    b->expiresAfter(5ms, [&]() { fired++; a.reset(); b.reset(); });
+    ioc.run_for(50ms);
+    EXPECT_EQ(1, fired);
+    EXPECT_EQ(0, wheel.size());
+}
+
+TEST(TimerWheel, SharedPerIOContext)
+{
+    IOContext ioc;
+    IOContext other;
+    EXPECT_EQ(&Util::TimerWheel::get(ioc), &Util::TimerWheel::get(ioc));
+    EXPECT_NE(&Util::TimerWheel::get(ioc), &Util::TimerWheel::get(other));
+}
+
+} // namespace
@@ -0,0 +1,77 @@
+#include "util/asio.hpp"
+
+#include "coro_test.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+
+/**
+ * Tracks how many tasks run at once.
+ */
+struct Tracker final
+{
+    unsigned int running = 0;
+    unsigned int maxRunning = 0;
+    std::vector<int> started;
+    unsigned int finished = 0;
+};
+
+/**
+ * A task that takes a few turns of the IO context to finish.
+ */
+Awaitable<void> task(IOContext &ioc, Tracker &tracker, int index)
+{
+    tracker.started.push_back(index);
+    tracker.running++;
+    tracker.maxRunning = std::max(tracker.maxRunning, tracker.running);
+    for (int i = 0; i < 3; i++) {
+        co_await boost::asio::post((boost::asio::io_context &)ioc, boost::asio::use_awaitable);
+    }
+    tracker.running--;
+    tracker.finished++;
+}
+
+/**
+ * Run ten tasks with the given limit.
+ */
+Awaitable<void> test(IOContext &ioc, Tracker &tracker, size_t maxParallel)
+{
+    std::vector<Awaitable<void>> awaitables;
+    for (int i = 0; i < 10; i++) {
+        awaitables.emplace_back(task(ioc, tracker, i));
+    }
+    co_await awaitTree(awaitables, maxParallel);
+}
+
+} // namespace
+
+CORO_TEST(AwaitTree, Limited, ioc)
+{
+    Tracker tracker;
+    co_await test(ioc, tracker, 3);
+    EXPECT_EQ(3, tracker.maxRunning);
+    EXPECT_EQ((std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), tracker.started);
+    EXPECT_EQ(10, tracker.finished);
+}
+
+CORO_TEST(AwaitTree, MoreThanNeeded, ioc)
+{
+    Tracker tracker;
+    co_await test(ioc, tracker, 20);
+    EXPECT_EQ(10, tracker.maxRunning);
+    EXPECT_EQ(10, tracker.finished);
+}
+
+CORO_TEST(AwaitTree, Zero, ioc)
+{
+    Tracker tracker;
+    co_await test(ioc, tracker, 0);
+    EXPECT_EQ(1, tracker.maxRunning);
+    EXPECT_EQ(10, tracker.finished);
+}